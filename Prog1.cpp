@@ -37,8 +37,14 @@
  * @section compile_section Compiling and Usage 
  *
  * @par Compiling Instructions: 
- *      The Program requires a picture file and 4 to 6 imputs via commandline 
-				aurguments
+ *      The Program requires a picture file and at least 4 imputs via
+				commandline aurguments, more when options are chained
+ *      Built with CMake, see CMakeLists.txt and CMakePresets.json
+   @verbatim
+   cmake --preset release
+   cmake --build --preset release
+   cmake -P cmake/pgo.cmake         (profile guided build in _build/pgo)
+   @endverbatim
  * 
  * @par Usage: 
    @verbatim  
@@ -77,6 +83,80 @@
 
 
 #include "function.h"
+#include "threadpool.h"
+#include "stream.h"
+#include "batch.h"
+#include "stats.h"
+#include "cache.h"
+#include "pyramid.h"
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * reads the rest of the picture whose header is in vars, runs the options on
+ * it, and writes it out.  T is the sample type the header asks for.
+ *
+ * @param[in][out] vars - the picture, header already read
+ * @param[in][out] fin - the file, just past the header
+ * @param[in]      argc - amount of aurguments in argv
+ * @param[in]      argv - list of aurments from commandline
+ * @param[in]      stages - the options in the order given
+ * @param[in]      key - the picture's name in the result cache, empty if
+ *						it is not kept there
+ * @param[in]      levels - pyramid levels written after the picture
+ *
+ * @returns 0 program ran successful
+ * @returns -1 program had an error
+ *
+ *****************************************************************************/
+template <class T>
+static int edit_picture( basic_image<T> &vars, ifstream &fin, int argc,
+	char *argv[], const vector<pipeline_stage> &stages, const string &key,
+	int levels )
+{
+	//checker is a tempory holding string used thoughout the program
+	string checker = "";
+
+	//the output is named first so reading knows if it is the same file
+	vars.fileName = argv[argc-2];
+
+	//reads the pixels, packed when the options allow it
+	{
+		stats_stage timer( "fill", picture_pixels( vars ) );
+		if (picture_fill( vars, fin, argv[argc-1], stages ) != 0)
+			return(-1);
+	}
+
+	//closes input file
+	fin.close();
+
+	{
+		stats_stage timer( "options", picture_pixels( vars ) );
+		runOption( vars, stages );
+	}
+
+	//sets checker to the output variable
+	checker = argv[argc - 3];
+
+	{
+		stats_stage timer( "output", picture_pixels( vars ) );
+		fileOutput( checker, vars );
+	}
+
+	//keeps the written picture for the next run with the same options
+	cache_store( key, vars.fileName );
+
+	//the smaller copies are made from the picture while it is in memory
+	int result = 0;
+	if (levels > 0)
+		result = pyramid_write( vars, levels, argv[argc-2], checker );
+
+	//cleans up all arrays
+	all_array_delete( vars );
+
+	return result;
+}
 
 /**************************************************************************//** 
  * @author Johnathan Ackerman
@@ -96,22 +176,160 @@
  *****************************************************************************/
 int main (int argc, char *argv[])
 {
-	//used to pass brightness value to function
-	int val = 0;
+	//the options in the order given
+	vector<pipeline_stage> stages;
+
+	//loop variable
+	int k = 0;
+
+	//edits the picture a band of rows at a time
+	bool streaming = false;
+
+	//folder and size of the result cache, off when empty
+	string cache_folder;
+	uint64_t cache_megabytes = CACHE_MEGABYTES;
+
+	//the picture's name in the cache, empty if it is not kept there
+	string key;
 
-	//sets value to brightness number
-	if (argc == 6)
+	//pyramid levels written after the picture
+	int levels = 0;
+
+	//takes out -j N so the other aurguments keep their usual places
+	for (k = 1; k + 1 < argc; k++)
 	{
-		val = atoi(argv[2]);
+		if (string(argv[k]) == string("-j"))
+		{
+			int threads = atoi(argv[k + 1]);
+			if (threads < 1)
+			{
+				commandStatement();
+				return -2;
+			}
+			set_threads(threads);
+
+			for ( ; k + 2 < argc; k++)
+				argv[k] = argv[k + 2];
+			argc -= 2;
+			break;
+		}
+	}
+
+	//takes out -m N the same way, it asks for a pyramid of N levels
+	for (k = 1; k + 1 < argc; k++)
+	{
+		if (string(argv[k]) == string("-m"))
+		{
+			levels = atoi(argv[k + 1]);
+			if (levels < 1)
+			{
+				commandStatement();
+				return -2;
+			}
+
+			for ( ; k + 2 < argc; k++)
+				argv[k] = argv[k + 2];
+			argc -= 2;
+			break;
+		}
+	}
+
+	//takes out -l the same way, it asks for streaming mode
+	for (k = 1; k < argc; k++)
+	{
+		if (string(argv[k]) == string("-l"))
+		{
+			streaming = true;
+			for ( ; k + 1 < argc; k++)
+				argv[k] = argv[k + 1];
+			argc -= 1;
+			break;
+		}
+	}
+
+	//takes out --stats too, the statistics print as the program exits
+	for (k = 1; k < argc; k++)
+	{
+		if (string(argv[k]) == string("--stats") ||
+			string(argv[k]) == string("--stats=json"))
+		{
+			stats_start( string(argv[k]) == string("--stats=json") );
+			for ( ; k + 1 < argc; k++)
+				argv[k] = argv[k + 1];
+			argc -= 1;
+			break;
+		}
+	}
+
+	//takes out --cache folder and --cache-size megabytes
+	for (k = 1; k + 1 < argc; )
+	{
+		if (string(argv[k]) == string("--cache"))
+			cache_folder = argv[k + 1];
+		else if (string(argv[k]) == string("--cache-size"))
+		{
+			long long megabytes = atoll(argv[k + 1]);
+			if (megabytes < 1)
+			{
+				commandStatement();
+				return -2;
+			}
+			cache_megabytes = uint64_t(megabytes);
+		}
+		else
+		{
+			k++;
+			continue;
+		}
+
+		for (int j = k; j + 2 < argc; j++)
+			argv[j] = argv[j + 2];
+		argc -= 2;
+	}
+
+	if (!cache_folder.empty() &&
+		!cache_start( cache_folder, cache_megabytes << 20 ))
+	{
+		cout << "Error opening cache folder " << cache_folder << endl;
+		return -1;
 	}
 
 	//checks commandline for usage
-	if (argc < 4 || argc > 6)
+	if (argc < 4 || !parse_pipeline( argc, argv, stages ))
 	{
 		commandStatement();
 		return -2;
 	}
 
+	//the pyramid is made from the whole edited picture
+	if (levels > 0 && streaming)
+	{
+		cout << "-m needs the picture in memory and can not be used with -l"
+			<< endl;
+		return -2;
+	}
+
+	//a new size or a kernel works on the whole picture at once
+	for (const pipeline_stage &stage : stages)
+	{
+		if ((stage.kind == STAGE_RESAMPLE || stage.kind == STAGE_CONVOLVE) &&
+			streaming)
+		{
+			cout << (stage.kind == STAGE_RESAMPLE ? "-r" : "-k") <<
+				" needs the picture in memory and can not be used with -l"
+				<< endl;
+			return -2;
+		}
+
+		//a wrapped edge reads the rows at the other end of the picture
+		if (stage.border.mode == BORDER_WRAP && streaming)
+		{
+			cout << "--border wrap needs the picture in memory and can not "
+				"be used with -l" << endl;
+			return -2;
+		}
+	}
+
 	//defines variables for file opening
 	std::ifstream fin;
 	std::ofstream fout;
@@ -119,13 +337,34 @@ int main (int argc, char *argv[])
 	//pulls in variables from the structor
 	image vars;
 
-	//checker is a tempory holding string used thoughout the program
-	string checker = "";
-
-	//sets checker to the option set by commandline
-	checker = (argv [1]);
+	//a list or pattern of pictures runs in batch mode
+	if (batch_input( argv[argc-1] ))
+		return batch_run( argv[argc-1], argv[argc-2], argv[argc-3], stages,
+			streaming, levels );
 
+	//a picture edited the same way before is copied from the cache.  The
+		//cache keeps one file a picture, so pyramids are always made
+	if (levels == 0 && (string(argv[argc-3]) == string("-oa") ||
+		string(argv[argc-3]) == string("-ob")))
+	{
+		key = cache_key( argv[argc-1], argv[argc-3], stages );
+		if (cache_fetch( key, argv[argc-2] ))
+			return 0;
+	}
 
+	//streaming mode reads, edits, and writes the picture itself.  Options
+		//that need one pass use it too, so the first rows are edited while
+		//the rest are still being read and written, unless the output
+		//would be written over the picture while it is read
+	if (streaming || (levels == 0 && stream_option( stages ) &&
+		!output_is_input( argv[argc-1], argv[argc-2] )))
+	{
+		vars.fileName = argv[argc-2];
+		int result = stream_image( vars, argv[argc-1], argv[argc-3], stages );
+		if (result == 0)
+			cache_store( key, vars.fileName );
+		return result;
+	}
 
 	//opens file using file name from the commandline
 	fin.open(argv[argc-1], ios::in | ios::binary);//uses binary opening to make
@@ -140,46 +379,23 @@ int main (int argc, char *argv[])
 	}
 
 	//grabs picture header from the file
-	read_in_header(vars, fin);
-
-	//makes arrays to store the pixel data
-	array_maker( vars, fin, checker);
-
-	//checks if ascii picture type
-	if ( vars.magic_number == string("P3") )
-		ascii_fill( vars, fin );
-	//checks if binary picture type
-	else if ( vars.magic_number == string("P6") )
-		binary_fill(vars, fin );
-	//checks if magic number was read in correctly
-	else
-	{
-		//cleans up program before exiting
-		cout << "Error with magic number" << endl;
-		all_array_delete( vars);
-		fin.close();
-		return(-1);
+	{
+		stats_stage timer( "header" );
+		read_in_header(vars, fin);
 	}
 
-	//closes input file
-	fin.close();
-
-
-	vars.fileName = argv[argc-2];
-
-	runOption( checker, vars, argv, argc, val);
-
-	//sets checker to the output variable
-	checker = argv[argc - 3];
-
-	fileOutput( checker, vars, argv);
-
-	//cleans up all arrays
-	all_array_delete( vars );
+	//pictures past 255 keep 2 bytes a sample
+	if (vars.max_value > sample_traits<pixel>::largest)
+	{
+		wide_image wide_vars;
+		static_cast<picture_header &>(wide_vars) = vars;
+		return edit_picture( wide_vars, fin, argc, argv, stages, key,
+			levels );
+	}
 
 	//checked program run
 	//cout << "program got to end" << endl;
 
-	return 0;
+	return edit_picture( vars, fin, argc, argv, stages, key, levels );
 
 }
\ No newline at end of file
@@ -0,0 +1,958 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief The asynchronous reader and writer.  Both keep ASYNC_DEPTH chunks
+ * in flight on an io_queue so the disk works while the caller parses,
+ * edits, or formats pixels.  On Linux the queue is an io_uring set up with
+ * plain system calls; if the kernel does not offer it, or it is turned off,
+ * a helper thread runs the requests instead.
+ ****************************************************************************/
+#include <cstring>
+#include <atomic>
+
+#include "asyncio.h"
+#include "stats.h"
+
+//io_uring is only used where the system headers describe it
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_URING 1
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+#endif
+
+//prefetching is only asked for where the system offers it
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_FADVISE 1
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+//set by io_force_thread so the helper thread can be tried on any system
+static atomic<bool> thread_only(false);
+
+
+/*!
+ * @brief the shared memory and file of one io_uring
+ */
+struct uring_ring
+{
+#ifdef HAVE_URING
+	int ring = -1;					/*!< the io_uring */
+	int fd = -1;					/*!< the file the requests run on */
+	void *sq_map = MAP_FAILED;		/*!< submission ring mapping */
+	void *cq_map = MAP_FAILED;		/*!< completion ring mapping */
+	size_t sq_size = 0;				/*!< bytes in sq_map */
+	size_t cq_size = 0;				/*!< bytes in cq_map */
+	io_uring_sqe *sqes = nullptr;	/*!< submission entries */
+	size_t sqes_size = 0;			/*!< bytes in sqes */
+	unsigned *sq_tail = nullptr;	/*!< next submission slot */
+	unsigned *sq_mask = nullptr;	/*!< submission ring size - 1 */
+	unsigned *sq_array = nullptr;	/*!< submission order */
+	unsigned *cq_head = nullptr;	/*!< next completion to take */
+	unsigned *cq_tail = nullptr;	/*!< one past the last completion */
+	unsigned *cq_mask = nullptr;	/*!< completion ring size - 1 */
+	io_uring_cqe *cqes = nullptr;	/*!< completion entries */
+	unsigned unsent = 0;			/*!< entries the kernel has not
+											taken yet */
+
+	bool start( int file, unsigned entries );
+	int enter( bool wait );
+	~uring_ring();
+#endif
+};
+
+
+#ifdef HAVE_URING
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * sets up an io_uring for a file and maps its rings.  Kernels older than
+ * the plain read and write requests are turned down.
+ *
+ * @param[in]      file - the open file, owned by the ring from now on
+ * @param[in]      entries - most requests in flight
+ *
+ * @returns true the ring is ready
+ * @returns false io_uring can not be used, the file is left open
+ *
+ *****************************************************************************/
+bool uring_ring::start( int file, unsigned entries )
+{
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	ring = int(syscall(__NR_io_uring_setup, entries, &params));
+	if (ring < 0)
+		return false;
+
+	//IORING_OP_READ and IORING_OP_WRITE came with this feature
+	if (!(params.features & IORING_FEAT_RW_CUR_POS))
+	{
+		::close(ring);
+		ring = -1;
+		return false;
+	}
+
+	sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single)
+		sq_size = cq_size = max(sq_size, cq_size);
+
+	sq_map = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+	if (sq_map != MAP_FAILED && !single)
+		cq_map = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+	sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+	sqes = (io_uring_sqe *) mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+
+	if (sq_map == MAP_FAILED || (!single && cq_map == MAP_FAILED) ||
+		sqes == (io_uring_sqe *) MAP_FAILED)
+	{
+		if (sqes == (io_uring_sqe *) MAP_FAILED)
+			sqes = nullptr;
+		return false;
+	}
+
+	char *sq = (char *) sq_map;
+	char *cq = (char *) (single ? sq_map : cq_map);
+
+	sq_tail = (unsigned *) (sq + params.sq_off.tail);
+	sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+	sq_array = (unsigned *) (sq + params.sq_off.array);
+	cq_head = (unsigned *) (cq + params.cq_off.head);
+	cq_tail = (unsigned *) (cq + params.cq_off.tail);
+	cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+	cqes = (io_uring_cqe *) (cq + params.cq_off.cqes);
+
+	fd = file;
+	return true;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * hands the kernel the entries it has not taken yet, and waits for a
+ * request to finish if asked.  An interrupted call is made again.  When
+ * the kernel is too busy to take entries they stay in the ring and are
+ * handed over again by the next call, so none is ever left behind.
+ *
+ * @param[in]      wait - also waits for a completion
+ *
+ * @returns 0 the call went through or can be made again
+ * @returns less than 0 the error io_uring_enter failed with
+ *
+ *****************************************************************************/
+int uring_ring::enter( bool wait )
+{
+	while (true)
+	{
+		long taken = syscall(__NR_io_uring_enter, ring, unsent,
+			wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+
+		if (taken >= 0)
+		{
+			unsent -= min(unsent, unsigned(taken));
+			return 0;
+		}
+		if (errno == EAGAIN || errno == EBUSY)
+			return 0;
+		if (errno != EINTR)
+			return -errno;
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * unmaps the rings and closes the io_uring and its file
+ *
+ *****************************************************************************/
+uring_ring::~uring_ring()
+{
+	if (sqes != nullptr)
+		munmap(sqes, sqes_size);
+	if (cq_map != MAP_FAILED)
+		munmap(cq_map, cq_size);
+	if (sq_map != MAP_FAILED)
+		munmap(sq_map, sq_size);
+	if (ring >= 0)
+		::close(ring);
+	if (fd >= 0)
+		::close(fd);
+}
+#endif
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * makes a queue with no file open
+ *
+ *****************************************************************************/
+io_queue::io_queue()
+{
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * waits for the requests still running and closes the file
+ *
+ *****************************************************************************/
+io_queue::~io_queue()
+{
+	close();
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * opens a file for reading, or makes it empty for writing, and gets its
+ * requests ready to run
+ *
+ * @param[in]      name - the file
+ * @param[in]      write - true to write the file, false to read it
+ *
+ * @returns true the file is open
+ * @returns false the file could not be opened
+ *
+ *****************************************************************************/
+bool io_queue::open( const char *name, bool write )
+{
+	close();
+	writing = write;
+	stop = false;
+
+#ifdef HAVE_URING
+	if (!thread_only)
+	{
+		int fd = write ? ::open(name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+			0666) : ::open(name, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return false;
+
+		ring.reset(new uring_ring);
+		if (ring->start( fd, ASYNC_DEPTH ))
+		{
+			opened = true;
+			return true;
+		}
+		ring.reset();
+		::close(fd);
+	}
+#endif
+
+	//the helper thread runs the requests on an fstream
+	file.open(name, write ? ios::out | ios::trunc | ios::binary :
+		ios::in | ios::binary);
+	if (!file)
+		return false;
+
+	helper = thread(&io_queue::work, this);
+	opened = true;
+	return true;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * starts a read into buf, or a write from it, of len bytes at offset.  buf
+ * must stay alive until wait hands slot back.
+ *
+ * @param[in]      slot - number wait gives back for this request
+ * @param[in]      buf - the caller's buffer
+ * @param[in]      len - bytes to move
+ * @param[in]      offset - place in the file
+ *
+ *****************************************************************************/
+void io_queue::submit( int slot, char *buf, size_t len, uint64_t offset )
+{
+	pending++;
+
+#ifdef HAVE_URING
+	if (ring)
+	{
+		unsigned tail = *ring->sq_tail;
+		unsigned index = tail & *ring->sq_mask;
+		io_uring_sqe &entry = ring->sqes[index];
+
+		memset(&entry, 0, sizeof(entry));
+		entry.opcode = writing ? IORING_OP_WRITE : IORING_OP_READ;
+		entry.fd = ring->fd;
+		entry.addr = uint64_t(uintptr_t(buf));
+		entry.len = unsigned(len);
+		entry.off = offset;
+		entry.user_data = uint64_t(slot);
+		ring->sq_array[index] = index;
+
+		//the kernel must see the entry before the new tail
+		__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+		ring->unsent++;
+		ring->enter( false );
+		return;
+	}
+#endif
+
+	{
+		lock_guard<mutex> hold(lock);
+		todo.push_back(request{ slot, buf, len, offset });
+	}
+	wake.notify_one();
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * waits for any request to finish
+ *
+ * @param[out]     result - bytes moved, or less than 0 if it failed
+ *
+ * @returns the slot of the finished request, or -1 if none are running
+ *
+ *****************************************************************************/
+int io_queue::wait( long long &result )
+{
+	if (pending == 0)
+		return -1;
+	pending--;
+
+#ifdef HAVE_URING
+	if (ring)
+	{
+		while (true)
+		{
+			unsigned head = *ring->cq_head;
+
+			if (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+			{
+				io_uring_cqe &entry = ring->cqes[head & *ring->cq_mask];
+				int slot = int(entry.user_data);
+
+				result = entry.res;
+				__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+				return slot;
+			}
+			//entries the kernel turned down before are handed over again
+			int failure = ring->enter( true );
+			if (failure < 0)
+			{
+				result = failure;
+				return -1;
+			}
+		}
+	}
+#endif
+
+	unique_lock<mutex> hold(lock);
+	finished.wait(hold, [this] { return !done.empty(); });
+
+	int slot = done.front().first;
+	result = done.front().second;
+	done.pop_front();
+	return slot;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * waits for the requests still running and closes the file
+ *
+ *****************************************************************************/
+void io_queue::close()
+{
+	long long result = 0;
+
+	while (pending > 0)
+		wait(result);
+
+	if (helper.joinable())
+	{
+		{
+			lock_guard<mutex> hold(lock);
+			stop = true;
+		}
+		wake.notify_all();
+		helper.join();
+	}
+
+	ring.reset();
+	if (file.is_open())
+		file.close();
+	file.clear();
+	todo.clear();
+	done.clear();
+	opened = false;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * the loop the helper thread runs, doing one request at a time in the
+ * order they were given
+ *
+ *****************************************************************************/
+void io_queue::work()
+{
+	while (true)
+	{
+		request next;
+		{
+			unique_lock<mutex> hold(lock);
+			wake.wait(hold, [this] { return stop || !todo.empty(); });
+			if (todo.empty())
+				return;
+			next = todo.front();
+			todo.pop_front();
+		}
+
+		long long result = 0;
+		file.clear();
+		if (writing)
+		{
+			file.seekp(streamoff(next.offset));
+			file.write(next.buf, streamsize(next.len));
+			result = file ? (long long) next.len : -1;
+		}
+		else
+		{
+			file.seekg(streamoff(next.offset));
+			file.read(next.buf, streamsize(next.len));
+			//running into the end of the file is not a failure
+			result = file.bad() ? -1 : (long long) file.gcount();
+		}
+
+		{
+			lock_guard<mutex> hold(lock);
+			done.emplace_back(next.slot, result);
+		}
+		finished.notify_one();
+	}
+}
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * opens a file and starts reading every chunk from offset on
+ *
+ * @param[in]      name - the file
+ * @param[in]      offset - first byte the caller wants
+ *
+ * @returns true the file is open
+ * @returns false the file could not be opened
+ *
+ *****************************************************************************/
+bool async_reader::open( const char *name, uint64_t offset )
+{
+	//loop variable
+	int k = 0;
+
+	if (!queue.open( name, false ))
+		return false;
+
+	chunks.resize(ASYNC_DEPTH);
+	start.assign(ASYNC_DEPTH, 0);
+	got.assign(ASYNC_DEPTH, 0);
+	busy.assign(ASYNC_DEPTH, false);
+	next = offset;
+	current = 0;
+	pos = 0;
+	failed = false;
+
+	for (k = 0; k < ASYNC_DEPTH; k++)
+	{
+		chunks[k].resize(ASYNC_CHUNK);
+		fill(k);
+	}
+	return true;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * reads bytes already in memory instead of a file.  They are handed out
+ * by peek in place, so they must stay alive until the reader is closed.
+ *
+ * @param[in]      data - the bytes
+ * @param[in]      size - amount of bytes
+ *
+ * @returns true the reader is open
+ * @returns false no bytes were given
+ *
+ *****************************************************************************/
+bool async_reader::open_memory( const char *data, size_t size )
+{
+	if (data == nullptr && size > 0)
+		return false;
+
+	queue.close();
+	memory = (data != nullptr) ? data : "";
+	memory_size = size;
+	pos = 0;
+	return true;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives the next bytes of the file that have already arrived, waiting only
+ * if none have.  They stay in the reader's chunk, so nothing is copied;
+ * skip moves past the ones used.  Each chunk used up is sent for the next
+ * part of the file.  Once a read has failed nothing more is given, and
+ * error tells it apart from the end of the file.
+ *
+ * @param[out]     count - amount of bytes ready, 0 at the end of the file
+ *						or after a failed read
+ *
+ * @returns the first byte ready
+ *
+ *****************************************************************************/
+const char *async_reader::peek( size_t &count )
+{
+	count = 0;
+
+	if (memory != nullptr)
+	{
+		count = (pos < memory_size) ? memory_size - pos : 0;
+		return (count > 0) ? memory + pos : nullptr;
+	}
+
+	while (queue.is_open())
+	{
+		//waits for the chunk being read from
+		while (busy[current])
+			finish(current);
+
+		if (failed)
+			break;
+
+		if (pos < got[current])
+		{
+			count = got[current] - pos;
+			return chunks[current].data() + pos;
+		}
+
+		//a chunk that came back short is the end of the file
+		if (got[current] < ASYNC_CHUNK)
+			break;
+
+		fill(current);
+		current = (current + 1) % ASYNC_DEPTH;
+		pos = 0;
+	}
+	return nullptr;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * copies the next bytes of the file
+ *
+ * @param[out]     dst - receives the bytes
+ * @param[in]      count - amount of bytes wanted
+ *
+ * @returns the amount of bytes copied, less than count at the end of the
+ *			file or when a read failed, which error tells
+ *
+ *****************************************************************************/
+size_t async_reader::read( char *dst, size_t count )
+{
+	size_t copied = 0;
+	size_t ready = 0;
+
+	while (copied < count)
+	{
+		const char *src = peek( ready );
+		if (ready == 0)
+			break;
+
+		size_t take = min(count - copied, ready);
+		memcpy(dst + copied, src, take);
+		skip( take );
+		copied += take;
+	}
+	return copied;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * waits for the requests still running and closes the file
+ *
+ *****************************************************************************/
+void async_reader::close()
+{
+	memory = nullptr;
+	queue.close();
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * sends a chunk for the next part of the file
+ *
+ * @param[in]      slot - the chunk
+ *
+ *****************************************************************************/
+void async_reader::fill( int slot )
+{
+	start[slot] = next;
+	got[slot] = 0;
+	busy[slot] = true;
+	next += ASYNC_CHUNK;
+
+	queue.submit( slot, chunks[slot].data(), ASYNC_CHUNK, start[slot] );
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * waits for a request and records what it read.  A read the kernel cut
+ * short is sent again for the rest of its chunk, one that read nothing is
+ * the end of the file, and one that failed is kept in failed the way
+ * async_writer keeps a failed write.
+ *
+ * @param[in]      slot - the chunk being waited for
+ *
+ *****************************************************************************/
+void async_reader::finish( int slot )
+{
+	long long result = 0;
+	int ready = queue.wait( result );
+
+	if (ready < 0)
+	{
+		//nothing is running, so the chunk will never fill
+		busy[slot] = false;
+		if (result < 0)
+			failed = true;
+		return;
+	}
+
+	busy[ready] = false;
+	if (result < 0)
+		failed = true;
+	if (result <= 0)
+		return;
+
+	got[ready] += size_t(result);
+	stats_read( uint64_t(result) );
+	if (got[ready] < ASYNC_CHUNK)
+	{
+		busy[ready] = true;
+		queue.submit( ready, chunks[ready].data() + got[ready],
+			ASYNC_CHUNK - got[ready], start[ready] + got[ready] );
+	}
+}
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * makes a file empty and gets it ready to write
+ *
+ * @param[in]      name - the file
+ *
+ * @returns true the file is open
+ * @returns false the file could not be made
+ *
+ *****************************************************************************/
+bool async_writer::open( const char *name )
+{
+	//loop variable
+	int k = 0;
+
+	if (!queue.open( name, true ))
+		return false;
+
+	chunks.resize(ASYNC_DEPTH);
+	start.assign(ASYNC_DEPTH, 0);
+	length.assign(ASYNC_DEPTH, 0);
+	put.assign(ASYNC_DEPTH, 0);
+	busy.assign(ASYNC_DEPTH, false);
+	next = 0;
+	current = 0;
+	used = 0;
+	failed = false;
+
+	for (k = 0; k < ASYNC_DEPTH; k++)
+		chunks[k].resize(ASYNC_CHUNK);
+	return true;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * writes to the end of a buffer in memory instead of a file.  The buffer
+ * must stay alive until the writer is closed.
+ *
+ * @param[in][out] buffer - where the bytes go
+ *
+ * @returns true the buffer is open
+ *
+ *****************************************************************************/
+bool async_writer::open_memory( vector<char> &buffer )
+{
+	queue.close();
+	memory = &buffer;
+	used = buffer.size();
+	failed = false;
+	return true;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * adds bytes to the end of the file.  They are copied into the chunk being
+ * filled, and a full chunk is sent to be written.
+ *
+ * @param[in]      src - the bytes
+ * @param[in]      count - amount of bytes
+ *
+ *****************************************************************************/
+void async_writer::write( const char *src, size_t count )
+{
+	if (memory != nullptr)
+	{
+		memory->insert(memory->end(), src, src + count);
+		return;
+	}
+
+	while (count > 0 && queue.is_open())
+	{
+		size_t take = min(count, chunks[current].size() - used);
+
+		memcpy(chunks[current].data() + used, src, take);
+		used += take;
+		src += take;
+		count -= take;
+
+		if (used == chunks[current].size())
+			flush();
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives room for the next count bytes of the file inside the chunk being
+ * filled, so they can be made in place instead of copied in.  commit says
+ * how many were made.
+ *
+ * @param[in]      count - most bytes that will be made
+ *
+ * @returns the room, or nullptr if no file is open
+ *
+ *****************************************************************************/
+char *async_writer::reserve( size_t count )
+{
+	if (memory != nullptr)
+	{
+		used = memory->size();
+		memory->resize(used + count);
+		return memory->data() + used;
+	}
+
+	if (!queue.is_open())
+		return nullptr;
+
+	if (chunks[current].size() - used < count)
+		flush();
+
+	//a chunk only grows for a caller that needs more than one chunk at once
+	if (chunks[current].size() < count)
+		chunks[current].resize(count);
+
+	return chunks[current].data() + used;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * adds bytes made in the room reserve gave to the end of the file
+ *
+ * @param[in]      count - amount of bytes made
+ *
+ *****************************************************************************/
+void async_writer::commit( size_t count )
+{
+	if (memory != nullptr)
+	{
+		memory->resize(used + count);
+		return;
+	}
+
+	used += count;
+
+	if (used == chunks[current].size())
+		flush();
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * writes what is left, waits for every write, and closes the file
+ *
+ * @returns true every byte was written
+ * @returns false a write failed
+ *
+ *****************************************************************************/
+bool async_writer::close()
+{
+	long long result = 0;
+
+	memory = nullptr;
+	if (!queue.is_open())
+		return !failed;
+
+	flush();
+	while (true)
+	{
+		int slot = queue.wait( result );
+		if (slot < 0)
+			break;
+		finish( slot, result );
+	}
+	queue.close();
+	return !failed;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * sends the chunk being filled to be written and moves on to the next one,
+ * waiting if it is still being written
+ *
+ *****************************************************************************/
+void async_writer::flush()
+{
+	long long result = 0;
+
+	if (used > 0)
+	{
+		start[current] = next;
+		length[current] = used;
+		put[current] = 0;
+		busy[current] = true;
+		next += used;
+
+		queue.submit( current, chunks[current].data(), used, next - used );
+		current = (current + 1) % ASYNC_DEPTH;
+		used = 0;
+	}
+
+	while (busy[current])
+	{
+		int slot = queue.wait( result );
+		if (slot < 0)
+			break;
+		finish( slot, result );
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * records a finished write.  A write the kernel cut short is sent again
+ * for the rest of its chunk.
+ *
+ * @param[in]      slot - the chunk
+ * @param[in]      result - bytes written, or less than 0 if it failed
+ *
+ *****************************************************************************/
+void async_writer::finish( int slot, long long result )
+{
+	busy[slot] = false;
+	if (result <= 0)
+	{
+		failed = true;
+		return;
+	}
+
+	put[slot] += size_t(result);
+	stats_written( uint64_t(result) );
+	if (put[slot] < length[slot])
+	{
+		busy[slot] = true;
+		queue.submit( slot, chunks[slot].data() + put[slot],
+			length[slot] - put[slot], start[slot] + put[slot] );
+	}
+}
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * makes every file opened from now on use the helper thread instead of
+ * io_uring
+ *
+ * @param[in]      on - true for the helper thread
+ *
+ *****************************************************************************/
+void io_force_thread( bool on )
+{
+	thread_only = on;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * asks the system to start reading a whole file into its cache, so it is
+ * ready when a later call opens it.  Nothing happens where the system has
+ * no such request.
+ *
+ * @param[in]      name - the file
+ *
+ *****************************************************************************/
+void file_prefetch( const char *name )
+{
+#ifdef HAVE_FADVISE
+	int fd = ::open(name, O_RDONLY);
+	if (fd < 0)
+		return;
+
+#ifdef POSIX_FADV_WILLNEED
+	posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+	::close(fd);
+#else
+	(void) name;
+#endif
+}
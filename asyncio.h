@@ -0,0 +1,183 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief this file contains the asynchronous file reader and writer the
+ * picture input and output go through.  Reads are issued ahead of the
+ * caller and writes finish behind it, using io_uring where the system has
+ * it and a helper thread everywhere else.  It should be included with
+ * asyncio.cpp.
+ ****************************************************************************/
+#ifndef  __ASYNCIO__H__
+#define __ASYNCIO__H__
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+
+
+using namespace std;
+
+
+//bytes moved by one read or write request
+const size_t ASYNC_CHUNK = size_t(1) << 20;
+
+//requests a file keeps in flight
+const int ASYNC_DEPTH = 4;
+
+
+struct uring_ring;
+
+
+/*!
+ * @brief an open file with a queue of reads or writes running on it
+ *
+ * @details each request moves bytes between the file and a buffer the
+ *				caller keeps alive until the request finishes, and is known
+ *				by the slot number it was given.  The kernel runs the
+ *				requests through io_uring when it can; otherwise a helper
+ *				thread runs them in order on an fstream.
+ */
+class io_queue
+{
+public:
+	io_queue();
+	~io_queue();
+	io_queue( const io_queue & ) = delete;
+	io_queue &operator=( const io_queue & ) = delete;
+
+	bool open( const char *name, bool write );
+	void submit( int slot, char *buf, size_t len, uint64_t offset );
+	int wait( long long &result );
+	void close();
+
+	/*! @brief tells if a file is open */
+	bool is_open() const { return opened; }
+	/*! @brief tells if the requests go through io_uring */
+	bool uring() const { return ring != nullptr; }
+
+private:
+	/*!
+	 * @brief one read or write waiting for the helper thread
+	 */
+	struct request
+	{
+		int slot;			/*!< number the caller gave it */
+		char *buf;			/*!< caller's buffer */
+		size_t len;			/*!< bytes to move */
+		uint64_t offset;	/*!< place in the file */
+	};
+
+	void work();
+
+	bool opened = false;				/*!< a file is open */
+	bool writing = false;				/*!< requests are writes */
+	int pending = 0;					/*!< requests not yet waited for */
+	unique_ptr<uring_ring> ring;		/*!< the io_uring, if used */
+
+	fstream file;						/*!< file the helper thread uses */
+	thread helper;						/*!< runs requests without io_uring */
+	mutex lock;							/*!< guards the fields below */
+	condition_variable wake;			/*!< signals a request or stop */
+	condition_variable finished;		/*!< signals a finished request */
+	deque<request> todo;				/*!< requests not yet started */
+	deque<pair<int, long long>> done;	/*!< slots finished and results */
+	bool stop = false;					/*!< tells the helper to exit */
+};
+
+
+/*!
+ * @brief reads a file front to back with the next chunks already on
+ *				their way
+ *
+ * @details it can also read a picture already in memory, which is then
+ *				handed out in place with nothing read ahead
+ */
+class async_reader
+{
+public:
+	bool open( const char *name, uint64_t offset );
+	bool open_memory( const char *data, size_t size );
+	const char *peek( size_t &count );
+	void skip( size_t count ) { pos += count; }
+	size_t read( char *dst, size_t count );
+	void close();
+
+	/*! @brief tells if a file or memory is open */
+	bool is_open() const { return queue.is_open() || memory != nullptr; }
+	/*! @brief tells if a read went wrong, peek and read then give no more */
+	bool error() const { return failed; }
+
+private:
+	void fill( int slot );
+	void finish( int slot );
+
+	io_queue queue;						/*!< the file and its requests */
+	vector<vector<char>> chunks;		/*!< ASYNC_DEPTH buffers */
+	vector<uint64_t> start;				/*!< file offset of each chunk */
+	vector<size_t> got;					/*!< bytes in each chunk so far */
+	vector<bool> busy;					/*!< chunk has a request running */
+	uint64_t next = 0;					/*!< offset the next chunk reads */
+	int current = 0;					/*!< chunk being read from */
+	size_t pos = 0;						/*!< next byte in that chunk, or in
+													memory */
+	bool failed = false;				/*!< a read went wrong */
+	const char *memory = nullptr;		/*!< bytes read from memory */
+	size_t memory_size = 0;				/*!< amount of them */
+};
+
+
+/*!
+ * @brief writes a file front to back, the filled chunks written out while
+ *				the caller fills the next ones
+ *
+ * @details it can also add the bytes to the end of a buffer in memory
+ *				instead, made in place by reserve the same way
+ */
+class async_writer
+{
+public:
+	bool open( const char *name );
+	bool open_memory( vector<char> &buffer );
+	void write( const char *src, size_t count );
+	void write( const string &text ) { write(text.data(), text.size()); }
+	char *reserve( size_t count );
+	void commit( size_t count );
+	bool close();
+
+	/*! @brief tells if a file or buffer is open */
+	bool is_open() const { return queue.is_open() || memory != nullptr; }
+
+private:
+	void flush();
+	void finish( int slot, long long result );
+
+	io_queue queue;						/*!< the file and its requests */
+	vector<vector<char>> chunks;		/*!< ASYNC_DEPTH buffers, grown by
+												reserve if needed */
+	vector<uint64_t> start;				/*!< file offset of each chunk */
+	vector<size_t> length;				/*!< bytes to write from each */
+	vector<size_t> put;					/*!< bytes written from each */
+	vector<bool> busy;					/*!< chunk has a request running */
+	uint64_t next = 0;					/*!< offset the next chunk goes */
+	int current = 0;					/*!< chunk being filled */
+	size_t used = 0;					/*!< bytes filled in that chunk */
+	bool failed = false;				/*!< a write went wrong */
+	vector<char> *memory = nullptr;		/*!< buffer written to instead */
+};
+
+
+/*******************************************************************************
+ *                         Function Prototypes
+ ******************************************************************************/
+void io_force_thread( bool on );
+void file_prefetch( const char *name );
+
+
+#endif
@@ -0,0 +1,497 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief Batch mode.  One thread reads pictures, the calling thread runs
+ * the options on them across the shared pool, and one thread writes them
+ * out, so the files of one picture are read and written while the next is
+ * being edited.  The pictures in flight are held to a memory budget, and
+ * freed colorbands are kept for the next picture of the same size.
+ ****************************************************************************/
+#include <thread>
+#include <chrono>
+
+#include "batch.h"
+#include "stream.h"
+#include "stats.h"
+#include "cache.h"
+#include "pyramid.h"
+
+//file name patterns are only expanded where the system offers it
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_GLOB 1
+#include <glob.h>
+#endif
+
+
+//bytes of pictures that may be read but not yet written
+static const size_t BATCH_BYTES = size_t(1) << 30;
+
+//colorbands an edited picture may hold: red, green, blue, grey, temporary
+static const int PICTURE_BANDS = 5;
+
+//freed colorbands kept for the next picture
+static const size_t RECYCLE_PLANES = 2 * PICTURE_BANDS;
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * tells if the picture named on the command line is really a list of
+ * pictures, either @ and a file holding one name per line or a pattern
+ * with * or ?
+ *
+ * @param[in]          name - the picture aurgument
+ *
+ * @returns true the aurgument names many pictures
+ * @returns false the aurgument is one picture
+ *
+ *****************************************************************************/
+bool batch_input( const char *name )
+{
+	return name[0] == '@' || strpbrk(name, "*?") != nullptr;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * makes the list of pictures.  A list file may hold blank lines and lines
+ * starting with #, which are skipped.
+ *
+ * @param[in]          inputs - @ and a list file, or a pattern
+ * @param[out]         names - the pictures in order
+ *
+ * @returns true the list was read
+ * @returns false the list file could not be opened or nothing matched
+ *
+ *****************************************************************************/
+bool batch_inputs( const char *inputs, vector<string> &names )
+{
+	names.clear();
+
+	if (inputs[0] == '@')
+	{
+		ifstream list(inputs + 1);
+		string line;
+
+		if (!list)
+			return false;
+
+		while (getline(list, line))
+		{
+			//trims spaces from both ends
+			size_t first = line.find_first_not_of(" \t\r");
+			size_t last = line.find_last_not_of(" \t\r");
+
+			if (first == string::npos || line[first] == '#')
+				continue;
+			names.push_back(line.substr(first, last - first + 1));
+		}
+		return true;
+	}
+
+#ifdef HAVE_GLOB
+	glob_t found;
+
+	if (glob(inputs, 0, nullptr, &found) == 0)
+	{
+		for (size_t i = 0; i < found.gl_pathc; i++)
+			names.push_back(found.gl_pathv[i]);
+	}
+	globfree(&found);
+#endif
+
+	return !names.empty();
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives the output basename for a picture: the folder, then the picture's
+ * file name without its folder or ending
+ *
+ * @param[in]          folder - where the output goes
+ * @param[in]          input - name of the picture file
+ *
+ * @returns the output basename
+ *
+ *****************************************************************************/
+string batch_output( const string &folder, const string &input )
+{
+	size_t slash = input.find_last_of("/\\");
+	string name = (slash == string::npos) ? input : input.substr(slash + 1);
+	size_t dot = name.find_last_of('.');
+
+	if (dot != string::npos && dot > 0)
+		name.erase(dot);
+
+	if (folder.empty() || folder.back() == '/' || folder.back() == '\\')
+		return folder + name;
+	return folder + '/' + name;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * edits every picture in the list with the same options and reports how
+ * fast it went.  Pictures that can not be read are reported and skipped.
+ * Pictures found in the result cache are copied from it without being
+ * read.
+ *
+ * @param[in]          inputs - @ and a list file, or a pattern
+ * @param[in]          folder - where the output goes
+ * @param[in]          checker - -oa or -ob
+ * @param[in]          stages - the options in the order given
+ * @param[in]          streaming - edit each picture in streaming mode
+ * @param[in]          levels - pyramid levels written after each picture,
+ *							not made in streaming mode
+ *
+ * @returns 0 every picture was written
+ * @returns -1 the list could not be read or a picture failed
+ * @returns -2 the output option was not understood
+ *
+ *****************************************************************************/
+int batch_run( const char *inputs, const char *folder, string checker,
+	const vector<pipeline_stage> &stages, bool streaming, int levels )
+{
+	vector<string> names;
+
+	//totals for the report
+	int written = 0;
+	int failed = 0;
+	int cached = 0;
+	double pixels = 0;
+
+	if (checker != string("-oa") && checker != string("-ob"))
+	{
+		commandStatement();
+		return -2;
+	}
+
+	if (!batch_inputs( inputs, names ))
+	{
+		cout << "Error reading picture list " << inputs << endl;
+		return -1;
+	}
+
+	auto start = chrono::steady_clock::now();
+
+	if (streaming)
+	{
+		//streaming already keeps memory small, one picture at a time
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			const string &name = names[i];
+			picture_header vars;
+			vars.fileName = batch_output( folder, name );
+
+			string key = cache_key( name.c_str(), checker, stages );
+			if (cache_fetch( key, vars.fileName ))
+			{
+				cached++;
+				continue;
+			}
+
+			//the next file is loaded into the cache while this one runs
+			if (i + 1 < names.size())
+				file_prefetch( names[i + 1].c_str() );
+
+			if (stream_image( vars, name.c_str(), checker, stages ) == 0)
+			{
+				cache_store( key, vars.fileName );
+				written++;
+				pixels += double(vars.rows) * vars.cols;
+			}
+			else
+				failed++;
+		}
+	}
+	else
+	{
+		batch_queue loaded;
+		batch_queue finished;
+		batch_budget budget;
+
+		plane_recycle( RECYCLE_PLANES );
+
+		//reads the pictures in order, waiting while too many are in flight
+		thread reader([&]
+		{
+			//a picture too big for memory fails alone, not the batch
+			allocation_throws( true );
+
+			for (size_t i = 0; i < names.size(); i++)
+			{
+				const string &name = names[i];
+				unique_ptr<batch_item> item(new batch_item);
+
+				//the cache keeps one file a picture, so pyramids are made
+				if (levels == 0)
+					item->key = cache_key( name.c_str(), checker, stages );
+				if (cache_fetch( item->key, batch_output( folder, name ) ))
+				{
+					cached++;
+					continue;
+				}
+
+				ifstream fin(name.c_str(), ios::in | ios::binary);
+
+				item->input = name;
+				if (!fin)
+				{
+					cout << "Error opening file " << name << endl;
+					queue_push( loaded, move(item) );
+					continue;
+				}
+
+				{
+					stats_stage timer( "header" );
+					read_in_header( item->vars, fin );
+				}
+				if (!fin || !header_valid( item->vars ))
+				{
+					cout << "Error with the header of " << name << endl;
+					queue_push( loaded, move(item) );
+					continue;
+				}
+				item->vars.fileName = batch_output( folder, name );
+				item->bytes = size_t(max(item->vars.rows, 0)) *
+					size_t(max(item->vars.cols, 0)) * PICTURE_BANDS;
+
+				//pictures past 255 keep 2 bytes a sample
+				if (item->vars.max_value > sample_traits<pixel>::largest)
+				{
+					static_cast<picture_header &>(item->wide_vars) = item->vars;
+					item->wide = true;
+					item->bytes *= sizeof(wide_pixel);
+				}
+				budget_take( budget, item->bytes );
+
+				//the next file is loaded into the cache while this one is read
+				if (i + 1 < names.size())
+					file_prefetch( names[i + 1].c_str() );
+
+				try
+				{
+					stats_stage timer( "fill", picture_pixels( item->vars ) );
+					if (item->wide)
+						item->loaded = (picture_fill( item->wide_vars, fin,
+							name.c_str(), stages ) == 0);
+					else
+						item->loaded = (picture_fill( item->vars, fin,
+							name.c_str(), stages ) == 0);
+				}
+				catch (const bad_alloc &)
+				{
+					cout << "memory or allocation error " << name << endl;
+					item->loaded = false;
+				}
+				fin.close();
+				queue_push( loaded, move(item) );
+			}
+			queue_close( loaded );
+		});
+
+		//writes the edited pictures and hands their memory back
+		thread writer([&]
+		{
+			string output = checker;
+			unique_ptr<batch_item> item;
+
+			while ((item = queue_pop( finished )) != nullptr)
+			{
+				//a picture that can not be written is counted and freed,
+					//and the batch goes on
+				bool done = item->loaded;
+				if (done)
+				{
+					stats_stage timer( "output", picture_pixels( item->vars ) );
+					string basename = batch_output( folder, item->input );
+					if (item->wide)
+					{
+						done = (picture_write( output, item->wide_vars ) == 0);
+						if (done)
+							cache_store( item->key,
+								item->wide_vars.fileName );
+						if (done && levels > 0)
+							done = (pyramid_write( item->wide_vars, levels,
+								basename, output ) == 0);
+					}
+					else
+					{
+						done = (picture_write( output, item->vars ) == 0);
+						if (done)
+							cache_store( item->key, item->vars.fileName );
+						if (done && levels > 0)
+							done = (pyramid_write( item->vars, levels,
+								basename, output ) == 0);
+					}
+				}
+
+				if (done)
+				{
+					written++;
+					pixels += double(item->vars.rows) * item->vars.cols;
+				}
+				else
+					failed++;
+
+				if (item->wide)
+					all_array_delete( item->wide_vars );
+				else
+					all_array_delete( item->vars );
+				budget_give( budget, item->bytes );
+			}
+		});
+
+		//edits each picture as it arrives
+		unique_ptr<batch_item> item;
+		allocation_throws( true );
+		while ((item = queue_pop( loaded )) != nullptr)
+		{
+			if (item->loaded)
+			{
+				stats_stage timer( "options", picture_pixels( item->vars ) );
+				try
+				{
+					if (item->wide)
+						runOption( item->wide_vars, stages );
+					else
+						runOption( item->vars, stages );
+				}
+				catch (const bad_alloc &)
+				{
+					cout << "memory or allocation error " << item->input <<
+						endl;
+					item->loaded = false;
+				}
+			}
+			queue_push( finished, move(item) );
+		}
+		allocation_throws( false );
+		queue_close( finished );
+
+		reader.join();
+		writer.join();
+		plane_recycle( 0 );
+	}
+
+	double seconds = chrono::duration<double>(
+		chrono::steady_clock::now() - start).count();
+	seconds = max(seconds, 1e-9);
+	written += cached;
+
+	cout << written << " pictures written, ";
+	if (cache_enabled())
+		cout << cached << " from the cache, ";
+	cout << failed << " failed, " <<
+		fixed << setprecision(1) << pixels / 1e6 << " megapixels in " <<
+		setprecision(3) << seconds << " s (" << setprecision(1) <<
+		written / seconds << " pictures/s, " << pixels / 1e6 / seconds <<
+		" megapixels/s)" << endl;
+
+	return failed ? -1 : 0;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * adds a picture to the back of a queue
+ *
+ * @param[in][out]     queue - the queue
+ * @param[in]          item - the picture
+ *
+ *****************************************************************************/
+void queue_push( batch_queue &queue, unique_ptr<batch_item> item )
+{
+	{
+		lock_guard<mutex> hold(queue.lock);
+		queue.items.push_back(move(item));
+	}
+	queue.ready.notify_one();
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * takes the picture at the front of a queue, waiting for one if needed
+ *
+ * @param[in][out]     queue - the queue
+ *
+ * @returns the picture, or nullptr once the queue is closed and empty
+ *
+ *****************************************************************************/
+unique_ptr<batch_item> queue_pop( batch_queue &queue )
+{
+	unique_lock<mutex> hold(queue.lock);
+	queue.ready.wait(hold, [&] { return queue.closed ||
+		!queue.items.empty(); });
+
+	if (queue.items.empty())
+		return nullptr;
+
+	unique_ptr<batch_item> item = move(queue.items.front());
+	queue.items.pop_front();
+	return item;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * marks that no more pictures will be added to a queue
+ *
+ * @param[in][out]     queue - the queue
+ *
+ *****************************************************************************/
+void queue_close( batch_queue &queue )
+{
+	{
+		lock_guard<mutex> hold(queue.lock);
+		queue.closed = true;
+	}
+	queue.ready.notify_all();
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * holds memory for a picture, waiting until it fits in BATCH_BYTES.  A
+ * picture larger than the whole budget still goes through alone.
+ *
+ * @param[in][out]     budget - the budget
+ * @param[in]          bytes - memory the picture needs
+ *
+ *****************************************************************************/
+void budget_take( batch_budget &budget, size_t bytes )
+{
+	unique_lock<mutex> hold(budget.lock);
+	budget.freed.wait(hold, [&] { return budget.used == 0 ||
+		budget.used + bytes <= BATCH_BYTES; });
+	budget.used += bytes;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives back the memory a written picture held
+ *
+ * @param[in][out]     budget - the budget
+ * @param[in]          bytes - memory the picture held
+ *
+ *****************************************************************************/
+void budget_give( batch_budget &budget, size_t bytes )
+{
+	{
+		lock_guard<mutex> hold(budget.lock);
+		budget.used -= bytes;
+	}
+	budget.freed.notify_all();
+}
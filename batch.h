@@ -0,0 +1,73 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief this file contains batch mode, which edits a whole list of
+ * pictures in one run, reading, editing, and writing different pictures
+ * at the same time.  It should be included with batch.cpp.
+ ****************************************************************************/
+#ifndef  __BATCH__H__
+#define __BATCH__H__
+
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+
+#include "function.h"
+
+
+/*!
+ * @brief one picture on its way through batch mode
+ */
+struct batch_item
+{
+	string input;			/*!< file the picture came from */
+	string key;				/*!< its name in the result cache, empty if it
+									is not kept there */
+	image vars;				/*!< the picture */
+	wide_image wide_vars;	/*!< the picture if it has 2 byte samples */
+	bool wide = false;		/*!< wide_vars holds the picture */
+	size_t bytes = 0;		/*!< memory held against the budget */
+	bool loaded = false;	/*!< the picture was read */
+};
+
+/*!
+ * @brief hands pictures from one thread to the next, in order
+ */
+struct batch_queue
+{
+	mutex lock;							/*!< guards the fields below */
+	condition_variable ready;			/*!< signals a push or close */
+	deque<unique_ptr<batch_item>> items;	/*!< pictures waiting */
+	bool closed = false;				/*!< no more pictures will come */
+};
+
+/*!
+ * @brief memory held by pictures that have been read but not yet written
+ */
+struct batch_budget
+{
+	mutex lock;					/*!< guards used */
+	condition_variable freed;	/*!< signals memory was given back */
+	size_t used = 0;			/*!< bytes held right now */
+};
+
+
+/*******************************************************************************
+ *                         Function Prototypes
+ ******************************************************************************/
+bool batch_input( const char *name );
+bool batch_inputs( const char *inputs, vector<string> &names );
+string batch_output( const string &folder, const string &input );
+int batch_run( const char *inputs, const char *folder, string checker,
+	const vector<pipeline_stage> &stages, bool streaming, int levels = 0 );
+
+void queue_push( batch_queue &queue, unique_ptr<batch_item> item );
+unique_ptr<batch_item> queue_pop( batch_queue &queue );
+void queue_close( batch_queue &queue );
+
+void budget_take( batch_budget &budget, size_t bytes );
+void budget_give( batch_budget &budget, size_t bytes );
+
+
+#endif
@@ -0,0 +1,601 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief the microbenchmarks for the picture input and output routines and
+ * for each option on its own.  Synthetic pictures are written at the sizes
+ * asked for, from VGA up to 100 megapixels, and every routine is timed on
+ * each of them.  The results are printed as a table and can be written as
+ * JSON to compare two builds.
+ *
+ * @par Compiling:
+ * the bench target of CMakeLists.txt, linked with the picture_core library
+ *
+ * @par Usage:
+   @verbatim
+   bench [-j N] [--simd scalar|sse41|avx2] [--sizes vga,1080p,12mp,100mp|all]
+         [--wide] [--filter text] [--min-time seconds] [--repetitions N]
+         [--dir folder] [--json file]
+   @endverbatim
+ ****************************************************************************/
+#include "bench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+#include "../function.h"
+#include "../kernels.h"
+#include "../threadpool.h"
+#include "../pipeline.h"
+
+
+/*!
+ * @brief a picture size the benchmarks are run at
+ */
+struct bench_size
+{
+	const char *name;	/*!< name used in the benchmark names */
+	int cols;			/*!< columns of the picture */
+	int rows;			/*!< rows of the picture */
+};
+
+//every size known, --sizes picks from these
+static const bench_size BENCH_SIZES[] =
+{
+	{ "vga", 640, 480 },
+	{ "1080p", 1920, 1080 },
+	{ "12mp", 4000, 3000 },
+	{ "100mp", 10000, 10000 }
+};
+
+//sizes run when --sizes is not given, 100mp needs several gigabytes of disk
+static const char *BENCH_DEFAULT_SIZES = "vga,1080p,12mp";
+
+
+/*!
+ * @brief the files and loaded picture the benchmarks of one size share
+ */
+template <class T>
+struct bench_picture
+{
+	bench_size size;			/*!< its size */
+	string binary;				/*!< name of the P6 file */
+	string ascii;				/*!< name of the P3 file */
+	string output;				/*!< name the output benchmarks write */
+	uint64_t binary_body = 0;	/*!< bytes of samples in the P6 file */
+	uint64_t ascii_body = 0;	/*!< bytes of samples in the P3 file */
+	basic_image<T> master;		/*!< the picture as read */
+};
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * tells how the benchmark program is used
+ *
+ *****************************************************************************/
+static void bench_usage()
+{
+	cout << "Usage: bench [-j N] [--simd scalar|sse41|avx2] "
+		<< "[--sizes vga,1080p,12mp,100mp|all] [--wide] [--filter text] "
+		<< "[--min-time seconds] [--repetitions N] [--dir folder] "
+		<< "[--json file]" << endl;
+	cout << "-j N = threads the options run on" << endl;
+	cout << "--simd = highest instruction set the kernels use" << endl;
+	cout << "--sizes = picture sizes to run, " << BENCH_DEFAULT_SIZES
+		<< " if not given" << endl;
+	cout << "--wide = 2 byte samples, a max_value of 65535" << endl;
+	cout << "--filter = only runs benchmarks whose name holds the text"
+		<< endl;
+	cout << "--dir = folder the synthetic pictures are written to" << endl;
+	cout << "--json = also writes the results as JSON to the file" << endl;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives the sample at a place in the synthetic picture.  It mixes smooth
+ * gradients with noise so the filters and the ascii number widths see
+ * something like a photograph rather than a flat colour.
+ *
+ * @param[in]      row - row of the sample
+ * @param[in]      col - column of the sample
+ * @param[in]      band - 0 red, 1 green, 2 blue
+ * @param[in]      top - largest sample value
+ *
+ * @returns the sample
+ *
+ *****************************************************************************/
+static int bench_sample( int row, int col, int band, int top )
+{
+	uint32_t noise = uint32_t(row) * 73856093u ^ uint32_t(col) * 19349663u ^
+		uint32_t(band + 1) * 83492791u;
+	noise = (noise ^ (noise >> 13)) * 0x5bd1e995u;
+	noise ^= noise >> 15;
+
+	int base = ((row + col * (band + 1)) % 512) * top / 1023;
+	int value = base + int(noise % uint32_t(top / 2 + 1));
+
+	return min(value, top);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * writes the synthetic picture of a size as a P6 and a P3 file
+ *
+ * @param[in][out] picture - the size and file names, given the body sizes
+ * @param[in]      top - max_value of the files
+ *
+ * @returns true both files were written
+ * @returns false a file could not be written
+ *
+ *****************************************************************************/
+template <class T>
+static bool bench_write( bench_picture<T> &picture, int top )
+{
+	//loop variables
+	int i = 0;
+	int j = 0;
+	int c = 0;
+
+	int rows = picture.size.rows;
+	int cols = picture.size.cols;
+	int width = (top > 255) ? 2 : 1;
+
+	ostringstream header;
+	header << "# bench\n" << cols << ' ' << rows << '\n' << top << '\n';
+
+	ofstream binary(picture.binary.c_str(), ios::out | ios::binary);
+	ofstream ascii(picture.ascii.c_str(), ios::out | ios::binary);
+	if (!binary || !ascii)
+		return false;
+
+	binary << "P6\n" << header.str();
+	ascii << "P3\n" << header.str();
+
+	vector<char> bytes(size_t(cols) * 3 * width);
+	string text;
+
+	picture.binary_body = 0;
+	picture.ascii_body = 0;
+	for (i = 0; i < rows; i++)
+	{
+		text.clear();
+		for (j = 0; j < cols; j++)
+		{
+			for (c = 0; c < 3; c++)
+			{
+				int value = bench_sample( i, j, c, top );
+				size_t at = (size_t(j) * 3 + c) * width;
+
+				if (width == 2)
+				{
+					bytes[at] = char(value >> 8);
+					bytes[at + 1] = char(value & 255);
+				}
+				else
+					bytes[at] = char(value);
+
+				text += to_string(value);
+				text += '\n';
+			}
+		}
+		binary.write(bytes.data(), streamsize(bytes.size()));
+		ascii.write(text.data(), streamsize(text.size()));
+		picture.binary_body += bytes.size();
+		picture.ascii_body += text.size();
+	}
+
+	return bool(binary) && bool(ascii);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * opens a benchmark picture and reads its header, leaving the file just
+ * past it the way the fill routines expect
+ *
+ * @param[out]     vars - gets the header
+ * @param[out]     fin - the open file
+ * @param[in]      name - the file's name
+ *
+ *****************************************************************************/
+static void bench_open( picture_header &vars, ifstream &fin,
+	const string &name )
+{
+	fin.open(name.c_str(), ios::in | ios::binary);
+	if (!fin)
+	{
+		cout << "Error opening file " << name << endl;
+		exit(-1);
+	}
+	read_in_header(vars, fin);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * makes a copy of the loaded picture for a benchmark to change, so every
+ * benchmark starts from the same picture
+ *
+ * @param[in]      master - the picture as read
+ *
+ * @returns the copy, freed with all_array_delete
+ *
+ *****************************************************************************/
+template <class T>
+static basic_image<T> bench_copy( const basic_image<T> &master )
+{
+	basic_image<T> vars;
+	ifstream none;
+
+	static_cast<picture_header &>(vars) = master;
+	array_maker( vars, none );
+
+	size_t bytes = size_t(master.rows) * master.red.stride * sizeof(T);
+	memcpy(vars.red.data, master.red.data, bytes);
+	memcpy(vars.green.data, master.green.data, bytes);
+	memcpy(vars.blue.data, master.blue.data, bytes);
+
+	return vars;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * registers a benchmark that runs one option on a copy of the picture.
+ * Options that work on the grey band get a picture made grey before the
+ * loop, the way contrast and equalize find it.
+ *
+ * @param[in]      picture - the picture of one size
+ * @param[in]      name - name of the option
+ * @param[in]      grey - the option works on the grey band
+ * @param[in]      work - runs the option once
+ *
+ *****************************************************************************/
+template <class T>
+static void bench_option( bench_picture<T> &picture, const string &name,
+	bool grey, const function<void(basic_image<T> &)> &work )
+{
+	bench_picture<T> *shared = &picture;
+	string suffix = (sizeof(T) > 1) ? "/16bit" : "";
+
+	bench_add( name + "/" + picture.size.name + suffix, picture.size.name,
+		[shared, grey, work] (bench_state &state)
+	{
+		basic_image<T> vars = bench_copy( shared->master );
+		uint64_t pixels = uint64_t(vars.rows) * vars.cols;
+
+		if (grey)
+			greyscale( vars, GREY_LEGACY );
+
+		while (state.keep_running())
+			work( vars );
+
+		state.set_pixels(pixels);
+		state.set_bytes(pixels * (grey ? 1 : 3) * sizeof(T));
+		all_array_delete( vars );
+	});
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * registers the benchmarks of one picture size: reading the header, the
+ * ascii and binary fill and output routines, and each option on its own
+ *
+ * @param[in]      picture - the picture of one size, already written and
+ *						read
+ *
+ *****************************************************************************/
+template <class T>
+static void bench_register( bench_picture<T> &picture )
+{
+	bench_picture<T> *shared = &picture;
+	string size = picture.size.name;
+	string suffix = "/" + size + ((sizeof(T) > 1) ? "/16bit" : "");
+
+	bench_add( "read_in_header" + suffix, size, [shared] (bench_state &state)
+	{
+		ifstream fin(shared->binary.c_str(), ios::in | ios::binary);
+		streamoff length = 0;
+
+		while (state.keep_running())
+		{
+			picture_header vars;
+
+			fin.clear();
+			fin.seekg(0);
+			read_in_header(vars, fin);
+			length = fin.tellg();
+		}
+		state.set_bytes(uint64_t(length));
+		state.set_pixels(uint64_t(shared->size.rows) * shared->size.cols);
+	});
+
+	//the fill routines read into the same arrays every loop
+	for (int binary = 0; binary < 2; binary++)
+	{
+		string name = binary ? "binary_fill/P6" : "ascii_fill/P3";
+
+		bench_add( name + suffix, size, [shared, binary] (bench_state &state)
+		{
+			basic_image<T> vars = bench_copy( shared->master );
+			const string &file = binary ? shared->binary : shared->ascii;
+
+			while (state.keep_running())
+			{
+				ifstream fin;
+
+				state.pause();
+				bench_open( vars, fin, file );
+				state.resume();
+
+				if (binary)
+					binary_fill( vars, fin, file.c_str(), GREY_LEGACY );
+				else
+					ascii_fill( vars, fin, file.c_str(), GREY_LEGACY );
+			}
+			state.set_bytes(binary ? shared->binary_body : shared->ascii_body);
+			state.set_pixels(uint64_t(vars.rows) * vars.cols);
+			all_array_delete( vars );
+		});
+	}
+
+	//the output routines are timed until the last write has finished
+	for (int binary = 0; binary < 2; binary++)
+	{
+		string name = binary ? "binary_out/P6" : "ascii_out/P3";
+
+		bench_add( name + suffix, size, [shared, binary] (bench_state &state)
+		{
+			basic_image<T> &vars = shared->master;
+			ostringstream header;
+			uint64_t bytes = 0;
+
+			vars.magic_number = binary ? "P6" : "P3";
+			read_out_header(vars, header);
+
+			while (state.keep_running())
+			{
+				async_writer fout;
+
+				state.pause();
+				if (!fout.open(shared->output.c_str()))
+				{
+					cout << "Error opening output file" << endl;
+					exit(-1);
+				}
+				fout.write(header.str());
+				state.resume();
+
+				if (binary)
+					binary_out( vars, fout );
+				else
+					ascii_out( vars, fout );
+				fout.close();
+			}
+
+			ifstream written(shared->output.c_str(),
+				ios::in | ios::binary | ios::ate);
+			if (written)
+				bytes = uint64_t(written.tellg()) - header.str().size();
+			state.set_bytes(bytes);
+			state.set_pixels(uint64_t(vars.rows) * vars.cols);
+		});
+	}
+
+	bench_option<T>( picture, "negate", false, [] (basic_image<T> &vars)
+		{ ::negate( vars ); } );
+	bench_option<T>( picture, "brighten", false, [] (basic_image<T> &vars)
+		{ brighten( vars, 20 ); } );
+	bench_option<T>( picture, "greyscale", false, [] (basic_image<T> &vars)
+		{ greyscale( vars, GREY_LEGACY ); } );
+	bench_option<T>( picture, "greyscale/601", false,
+		[] (basic_image<T> &vars) { greyscale( vars, GREY_BT601 ); } );
+	bench_option<T>( picture, "contrast", true, [] (basic_image<T> &vars)
+		{ contrast( vars ); } );
+	bench_option<T>( picture, "equalize", true, [] (basic_image<T> &vars)
+	{
+		pipeline_stage stage;
+		stage.kind = STAGE_EQUALIZE;
+		stage.value = EQUALIZE_CLIP;
+		run_pipeline( vars, vector<pipeline_stage>(1, stage) );
+	});
+	bench_option<T>( picture, "sharpen", false, [] (basic_image<T> &vars)
+		{ sharpen( vars ); } );
+	bench_option<T>( picture, "smooth/r1", false, [] (basic_image<T> &vars)
+		{ smooth( vars, 1 ); } );
+	bench_option<T>( picture, "smooth/r5", false, [] (basic_image<T> &vars)
+		{ smooth( vars, 5 ); } );
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * writes the pictures of every size asked for, reads each one back, runs
+ * the benchmarks and removes the files again
+ *
+ * @param[in]      sizes - the sizes to run
+ * @param[in]      folder - where the files go
+ * @param[in]      options - how to run the benchmarks
+ * @param[out]     results - what they measured
+ *
+ * @returns 0 the benchmarks ran
+ * @returns -1 a file could not be written or read
+ *
+ *****************************************************************************/
+template <class T>
+static int bench_all( const vector<bench_size> &sizes, const string &folder,
+	const bench_options &options, vector<bench_result> &results )
+{
+	vector<unique_ptr<bench_picture<T>>> pictures;
+	int top = sample_traits<T>::largest;
+	int status = 0;
+
+	for (const bench_size &size : sizes)
+	{
+		unique_ptr<bench_picture<T>> picture(new bench_picture<T>);
+		string stem = folder + "/bench_" + size.name +
+			((sizeof(T) > 1) ? "_16" : "");
+
+		picture->size = size;
+		picture->binary = stem + ".ppm";
+		picture->ascii = stem + "_ascii.ppm";
+		picture->output = stem + "_out.ppm";
+		pictures.push_back(move(picture));
+
+		bench_picture<T> &made = *pictures.back();
+		if (!bench_write( made, top ))
+		{
+			cout << "Error writing " << made.binary << endl;
+			status = -1;
+			break;
+		}
+
+		ifstream fin;
+		bench_open( made.master, fin, made.binary );
+		array_maker( made.master, fin );
+		binary_fill( made.master, fin, made.binary.c_str(), GREY_LEGACY );
+
+		bench_register( made );
+	}
+
+	if (status == 0)
+		results = bench_run( options, cout );
+
+	for (unique_ptr<bench_picture<T>> &picture : pictures)
+	{
+		all_array_delete( picture->master );
+		remove(picture->binary.c_str());
+		remove(picture->ascii.c_str());
+		remove(picture->output.c_str());
+	}
+	return status;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * reads the command line, runs the benchmarks and writes the JSON file if
+ * one was asked for
+ *
+ * @param[in]      argc - amount of aurguments in argv
+ * @param[in]      argv - list of aurments from commandline
+ *
+ * @returns 0 the benchmarks ran
+ * @returns -1 a file could not be written
+ * @returns -2 improper aurguments
+ *
+ *****************************************************************************/
+int main( int argc, char *argv[] )
+{
+	bench_options options;
+	string sizes = BENCH_DEFAULT_SIZES;
+	string folder = ".";
+	string json;
+	bool wide = false;
+
+	//loop variable
+	int k = 0;
+
+	for (k = 1; k < argc; k++)
+	{
+		string arg = argv[k];
+		bool more = (k + 1 < argc);
+
+		if (arg == "-j" && more && atoi(argv[k + 1]) > 0)
+			set_threads(atoi(argv[++k]));
+		else if (arg == "--simd" && more)
+		{
+			string level = argv[++k];
+			if (level == "scalar")
+				simd_force(SIMD_SCALAR);
+			else if (level == "sse41")
+				simd_force(SIMD_SSE41);
+			else if (level == "avx2")
+				simd_force(SIMD_AVX2);
+			else
+			{
+				bench_usage();
+				return -2;
+			}
+		}
+		else if (arg == "--sizes" && more)
+			sizes = argv[++k];
+		else if (arg == "--wide")
+			wide = true;
+		else if (arg == "--filter" && more)
+			options.filter = argv[++k];
+		else if (arg == "--min-time" && more && atof(argv[k + 1]) > 0)
+			options.min_time = atof(argv[++k]);
+		else if (arg == "--repetitions" && more && atoi(argv[k + 1]) > 0)
+			options.repetitions = atoi(argv[++k]);
+		else if (arg == "--dir" && more)
+			folder = argv[++k];
+		else if (arg == "--json" && more)
+			json = argv[++k];
+		else
+		{
+			bench_usage();
+			return -2;
+		}
+	}
+
+	//picks the sizes out of the comma list
+	vector<bench_size> chosen;
+	for (const bench_size &size : BENCH_SIZES)
+	{
+		string wanted = "," + sizes + ",";
+		if (sizes == "all" ||
+			wanted.find("," + string(size.name) + ",") != string::npos)
+			chosen.push_back(size);
+	}
+	if (chosen.empty())
+	{
+		bench_usage();
+		return -2;
+	}
+
+	vector<bench_result> results;
+	int status = wide ?
+		bench_all<wide_pixel>( chosen, folder, options, results ) :
+		bench_all<pixel>( chosen, folder, options, results );
+	if (status != 0)
+		return status;
+
+	if (!json.empty())
+	{
+		ofstream out(json.c_str());
+		vector<pair<string, string>> context;
+
+		context.push_back(make_pair("threads", to_string(get_threads())));
+		context.push_back(make_pair("simd", simd_name(simd_active())));
+		context.push_back(make_pair("samples", wide ? "16bit" : "8bit"));
+		context.push_back(make_pair("sizes", sizes));
+#ifdef BENCH_TSC
+		context.push_back(make_pair("cycles", "tsc"));
+#else
+		context.push_back(make_pair("cycles", "none"));
+#endif
+
+		bench_json( out, context, results );
+		if (!out)
+		{
+			cout << "Error writing " << json << endl;
+			return -1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,377 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief this file contains the small timing harness the benchmarks are
+ * written against.  It works like Google Benchmark cut down to what the
+ * picture editor needs: cases are registered with a body that loops on
+ * keep_running, the harness picks the iteration count, and the results are
+ * printed as a table or written as JSON.  It is header only, so the
+ * benchmark program is the only thing that has to include it.
+ ****************************************************************************/
+#ifndef  __BENCH__H__
+#define __BENCH__H__
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+	defined(_M_IX86)
+#define BENCH_TSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+
+using namespace std;
+
+
+/*!
+ * @brief the timer of one benchmark run, handed to the case's body
+ *
+ * @details the body loops while keep_running gives true and does the work
+ *				once per loop.  Work that should not count, such as putting
+ *				the input back, goes between pause and resume.  The body
+ *				tells how many bytes and pixels one loop moves so the
+ *				harness can turn the time into MB/s and cycles per pixel.
+ */
+class bench_state
+{
+public:
+	/*! @brief starts a run of iterations loops */
+	explicit bench_state( long long iterations ) : target(iterations) {}
+
+	/*!
+	 * @brief gives true while there are loops left to run, starting the
+	 *				timer on the first call and stopping it on the last
+	 */
+	bool keep_running()
+	{
+		if (count == 0 && !running)
+			resume();
+		if (count < target)
+		{
+			count++;
+			return true;
+		}
+		pause();
+		return false;
+	}
+
+	/*! @brief stops the timer until resume */
+	void pause()
+	{
+		if (!running)
+			return;
+		elapsed += chrono::steady_clock::now() - started;
+		cycles += bench_state::ticks() - started_ticks;
+		running = false;
+	}
+
+	/*! @brief starts the timer again after pause */
+	void resume()
+	{
+		if (running)
+			return;
+		running = true;
+		started_ticks = bench_state::ticks();
+		started = chrono::steady_clock::now();
+	}
+
+	/*! @brief sets the bytes one loop reads or writes */
+	void set_bytes( uint64_t amount ) { bytes = amount; }
+	/*! @brief sets the pixels one loop works on */
+	void set_pixels( uint64_t amount ) { pixels = amount; }
+
+	/*! @brief loops the run was asked for */
+	long long iterations() const { return target; }
+	/*! @brief seconds the timer ran */
+	double seconds() const
+		{ return chrono::duration<double>(elapsed).count(); }
+
+	/*!
+	 * @brief time stamp counter of the processor, 0 where there is none
+	 */
+	static uint64_t ticks()
+	{
+#ifdef BENCH_TSC
+		return uint64_t(__rdtsc());
+#else
+		return 0;
+#endif
+	}
+
+	long long target = 0;		/*!< loops to run */
+	long long count = 0;		/*!< loops started */
+	bool running = false;		/*!< the timer is running */
+	chrono::steady_clock::time_point started;	/*!< when it last started */
+	chrono::steady_clock::duration elapsed{};	/*!< time it has run */
+	uint64_t started_ticks = 0;	/*!< counter when it last started */
+	uint64_t cycles = 0;		/*!< counter ticks it has run */
+	uint64_t bytes = 0;			/*!< bytes moved by one loop */
+	uint64_t pixels = 0;		/*!< pixels worked on by one loop */
+};
+
+
+/*!
+ * @brief a benchmark and what it is run on
+ */
+struct bench_case
+{
+	string name;		/*!< what is measured and on what */
+	string size;		/*!< name of the picture size */
+	function<void(bench_state &)> body;	/*!< the measured loop */
+};
+
+/*!
+ * @brief what one benchmark measured, the best of its repetitions
+ */
+struct bench_result
+{
+	string name;					/*!< name of the case */
+	string size;					/*!< name of the picture size */
+	long long iterations = 0;		/*!< loops the timed run did */
+	double seconds = 0;				/*!< seconds for one loop */
+	double mb_per_second = 0;		/*!< megabytes moved a second */
+	double cycles_per_pixel = 0;	/*!< counter ticks for each pixel */
+	uint64_t bytes = 0;				/*!< bytes moved by one loop */
+	uint64_t pixels = 0;			/*!< pixels worked on by one loop */
+};
+
+/*!
+ * @brief how the harness runs the cases
+ */
+struct bench_options
+{
+	double min_time = 0.5;		/*!< seconds a timed run should last */
+	int repetitions = 1;		/*!< timed runs, the fastest is kept */
+	string filter;				/*!< only names holding this are run */
+};
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives the list every benchmark is registered in
+ *
+ * @returns the registered cases
+ *
+ *****************************************************************************/
+inline vector<bench_case> &bench_cases()
+{
+	static vector<bench_case> cases;
+	return cases;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * registers a benchmark
+ *
+ * @param[in]      name - what is measured and on what
+ * @param[in]      size - name of the picture size
+ * @param[in]      body - the measured loop
+ *
+ *****************************************************************************/
+inline void bench_add( const string &name, const string &size,
+	const function<void(bench_state &)> &body )
+{
+	bench_case item;
+
+	item.name = name;
+	item.size = size;
+	item.body = body;
+	bench_cases().push_back(item);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs one case until a run lasts at least min_time seconds, growing the
+ * loop count each time the way Google Benchmark does, then keeps the
+ * fastest of the timed runs.
+ *
+ * @param[in]      item - the benchmark
+ * @param[in]      options - how long and how often to run it
+ *
+ * @returns what it measured
+ *
+ *****************************************************************************/
+inline bench_result bench_measure( const bench_case &item,
+	const bench_options &options )
+{
+	bench_result result;
+	long long iterations = 1;
+
+	//loop variable
+	int r = 0;
+
+	result.name = item.name;
+	result.size = item.size;
+
+	//finds a loop count that fills min_time
+	while (true)
+	{
+		bench_state state(iterations);
+		item.body(state);
+
+		double taken = state.seconds();
+		if (taken >= options.min_time || iterations >= 1000000000)
+			break;
+
+		double grow = (taken > 0) ? 1.4 * options.min_time / taken : 10;
+		grow = min(10.0, max(2.0, grow));
+		iterations = max(iterations + 1, (long long)(iterations * grow));
+	}
+
+	for (r = 0; r < max(1, options.repetitions); r++)
+	{
+		bench_state state(iterations);
+		item.body(state);
+
+		double each = state.seconds() / double(iterations);
+		if (r > 0 && each >= result.seconds)
+			continue;
+
+		result.iterations = iterations;
+		result.seconds = each;
+		result.bytes = state.bytes;
+		result.pixels = state.pixels;
+		result.mb_per_second = (each > 0) ?
+			double(state.bytes) / each / 1e6 : 0;
+		result.cycles_per_pixel = (state.pixels > 0) ?
+			double(state.cycles) / double(iterations) /
+			double(state.pixels) : 0;
+	}
+
+	return result;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs every registered case the filter lets through, printing a table
+ * line for each as it finishes
+ *
+ * @param[in]      options - how to run them
+ * @param[in][out] out - where the table goes
+ *
+ * @returns what each case measured
+ *
+ *****************************************************************************/
+inline vector<bench_result> bench_run( const bench_options &options,
+	ostream &out )
+{
+	vector<bench_result> results;
+
+	out << left << setw(40) << "benchmark" << right << setw(12) << "ms"
+		<< setw(12) << "MB/s" << setw(14) << "cycles/pixel" << setw(12)
+		<< "iterations" << endl;
+
+	for (const bench_case &item : bench_cases())
+	{
+		if (!options.filter.empty() &&
+			item.name.find(options.filter) == string::npos)
+			continue;
+
+		bench_result result = bench_measure( item, options );
+		results.push_back(result);
+
+		out << left << setw(40) << result.name << right << fixed
+			<< setprecision(3) << setw(12) << result.seconds * 1e3
+			<< setprecision(1) << setw(12) << result.mb_per_second
+			<< setprecision(3) << setw(14) << result.cycles_per_pixel
+			<< setw(12) << result.iterations << endl;
+	}
+
+	return results;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * puts quotes around text and escapes it for JSON
+ *
+ * @param[in]      text - the text
+ *
+ * @returns the quoted text
+ *
+ *****************************************************************************/
+inline string bench_quote( const string &text )
+{
+	string quoted = "\"";
+
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			quoted += '\\';
+		if ((unsigned char) c < 0x20)
+			quoted += ' ';
+		else
+			quoted += c;
+	}
+	return quoted + "\"";
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * writes the results as JSON, one benchmark to a line so two runs can be
+ * compared with diff.  The context holds what the run was made on, such as
+ * the thread count and instruction set.
+ *
+ * @param[in][out] out - where the JSON goes
+ * @param[in]      context - names and values describing the run
+ * @param[in]      results - what the cases measured
+ *
+ *****************************************************************************/
+inline void bench_json( ostream &out,
+	const vector<pair<string, string>> &context,
+	const vector<bench_result> &results )
+{
+	//loop variable
+	size_t i = 0;
+
+	out << "{\n  \"context\": {";
+	for (i = 0; i < context.size(); i++)
+		out << (i ? ", " : "") << bench_quote(context[i].first) << ": "
+			<< bench_quote(context[i].second);
+	out << "},\n  \"benchmarks\": [\n";
+
+	for (i = 0; i < results.size(); i++)
+	{
+		const bench_result &result = results[i];
+		ostringstream line;
+
+		line << setprecision(9) << "    {\"name\": "
+			<< bench_quote(result.name)
+			<< ", \"size\": " << bench_quote(result.size)
+			<< ", \"iterations\": " << result.iterations
+			<< ", \"seconds\": " << result.seconds
+			<< ", \"bytes\": " << result.bytes
+			<< ", \"pixels\": " << result.pixels
+			<< ", \"mb_per_second\": " << result.mb_per_second
+			<< ", \"cycles_per_pixel\": " << result.cycles_per_pixel << "}";
+
+		out << line.str() << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+}
+
+
+#endif
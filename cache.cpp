@@ -0,0 +1,594 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief The result cache.  Each kept picture is a file in the cache folder
+ * named by two xxHash64 hashes, one of the input file and one of the
+ * options and output format, with the ending the edited picture was
+ * written with.  A file is copied in under a temporary name and then
+ * renamed, so runs sharing the folder never see half of one, and finding a
+ * file sets its time, so the files used longest ago are the first removed
+ * once the folder grows past its limit.
+ ****************************************************************************/
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+
+#include "cache.h"
+#include "asyncio.h"
+#include "stats.h"
+#include "convolve.h"
+
+//files are cloned where the file system shares blocks between them
+#ifdef __linux__
+#define HAVE_FICLONE 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+
+namespace fs = std::filesystem;
+
+
+//goes into every options hash; raise it when a change to the options
+	//changes the pictures they make, so older kept files are not used
+static const char CACHE_FORMAT[] = "prog1 cache 1";
+
+//the folder is trimmed to this share of its limit, so it is not trimmed
+	//again on the very next store
+static const uint64_t TRIM_PERCENT = 90;
+
+//the xxHash64 primes
+static const uint64_t PRIME1 = 11400714785074694791ULL;
+static const uint64_t PRIME2 = 14029467366897019727ULL;
+static const uint64_t PRIME3 = 1609587929392839161ULL;
+static const uint64_t PRIME4 = 9650029242287828579ULL;
+static const uint64_t PRIME5 = 2870177450012600261ULL;
+
+//set once by cache_start
+static atomic<bool> cache_active(false);
+static fs::path cache_folder;
+static uint64_t cache_limit = 0;
+
+//bytes the folder is thought to hold, counted the first time a picture is
+	//stored and kept up to date as pictures are stored and removed
+static mutex cache_lock;
+static bool cache_counted = false;
+static uint64_t cache_bytes = 0;
+
+//numbers the temporary files of this run
+static atomic<uint64_t> cache_temps(0);
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * turns a 64 bit number to the left
+ *
+ * @param[in]      value - the number
+ * @param[in]      bits - places to turn it
+ *
+ * @returns the turned number
+ *
+ *****************************************************************************/
+static inline uint64_t rotate_left( uint64_t value, int bits )
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * reads 8 bytes as a little endian number
+ *
+ * @param[in]      bytes - where they are
+ *
+ * @returns the number
+ *
+ *****************************************************************************/
+static inline uint64_t read_64( const unsigned char *bytes )
+{
+	uint64_t value;
+	memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * reads 4 bytes as a little endian number
+ *
+ * @param[in]      bytes - where they are
+ *
+ * @returns the number
+ *
+ *****************************************************************************/
+static inline uint32_t read_32( const unsigned char *bytes )
+{
+	uint32_t value;
+	memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * mixes 8 bytes into one of the running sums
+ *
+ * @param[in]      sum - the running sum
+ * @param[in]      value - the 8 bytes
+ *
+ * @returns the new sum
+ *
+ *****************************************************************************/
+static inline uint64_t hash_round( uint64_t sum, uint64_t value )
+{
+	sum += value * PRIME2;
+	sum = rotate_left(sum, 31);
+	return sum * PRIME1;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * mixes one running sum into the hash once the bytes are done
+ *
+ * @param[in]      hash - the hash so far
+ * @param[in]      sum - the running sum
+ *
+ * @returns the new hash
+ *
+ *****************************************************************************/
+static inline uint64_t hash_merge( uint64_t hash, uint64_t sum )
+{
+	hash ^= hash_round(0, sum);
+	return hash * PRIME1 + PRIME4;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * starts a hash with no bytes in it
+ *
+ * @param[in]      seed - number the hash starts from
+ *
+ *****************************************************************************/
+hash_state::hash_state( uint64_t seed ) : seed(seed)
+{
+	lane[0] = seed + PRIME1 + PRIME2;
+	lane[1] = seed + PRIME2;
+	lane[2] = seed;
+	lane[3] = seed - PRIME1;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * adds bytes to the hash.  They are taken a 32 byte stripe at a time, 8
+ * bytes into each running sum, and a piece of a stripe left at the end is
+ * held until more bytes come.
+ *
+ * @param[in]      data - the bytes
+ * @param[in]      count - amount of them
+ *
+ *****************************************************************************/
+void hash_state::add( const void *data, size_t count )
+{
+	const unsigned char *bytes = (const unsigned char *) data;
+	const unsigned char *end = bytes + count;
+
+	total += count;
+
+	//finishes the stripe held from before
+	if (held > 0)
+	{
+		size_t take = min(count, sizeof(spare) - held);
+		memcpy(spare + held, bytes, take);
+		held += take;
+		bytes += take;
+		if (held < sizeof(spare))
+			return;
+
+		for (int k = 0; k < 4; k++)
+			lane[k] = hash_round(lane[k], read_64(spare + 8 * k));
+		held = 0;
+	}
+
+	//whole stripes are taken where they are
+	uint64_t first = lane[0], second = lane[1];
+	uint64_t third = lane[2], fourth = lane[3];
+	for ( ; end - bytes >= 32; bytes += 32)
+	{
+		first = hash_round(first, read_64(bytes));
+		second = hash_round(second, read_64(bytes + 8));
+		third = hash_round(third, read_64(bytes + 16));
+		fourth = hash_round(fourth, read_64(bytes + 24));
+	}
+	lane[0] = first;
+	lane[1] = second;
+	lane[2] = third;
+	lane[3] = fourth;
+
+	held = end - bytes;
+	memcpy(spare, bytes, held);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives the hash of every byte added so far.  More bytes may still be
+ * added afterwards.
+ *
+ * @returns the xxHash64 of the bytes
+ *
+ *****************************************************************************/
+uint64_t hash_state::digest() const
+{
+	uint64_t hash;
+
+	if (total >= sizeof(spare))
+	{
+		hash = rotate_left(lane[0], 1) + rotate_left(lane[1], 7) +
+			rotate_left(lane[2], 12) + rotate_left(lane[3], 18);
+		for (int k = 0; k < 4; k++)
+			hash = hash_merge(hash, lane[k]);
+	}
+	else
+		hash = seed + PRIME5;
+
+	hash += total;
+
+	//the bytes short of a stripe, 8, then 4, then 1 at a time
+	const unsigned char *bytes = spare;
+	const unsigned char *end = spare + held;
+	for ( ; end - bytes >= 8; bytes += 8)
+	{
+		hash ^= hash_round(0, read_64(bytes));
+		hash = rotate_left(hash, 27) * PRIME1 + PRIME4;
+	}
+	if (end - bytes >= 4)
+	{
+		hash ^= uint64_t(read_32(bytes)) * PRIME1;
+		hash = rotate_left(hash, 23) * PRIME2 + PRIME3;
+		bytes += 4;
+	}
+	for ( ; bytes < end; bytes++)
+	{
+		hash ^= *bytes * PRIME5;
+		hash = rotate_left(hash, 11) * PRIME1;
+	}
+
+	//spreads every bit across the whole hash
+	hash ^= hash >> 33;
+	hash *= PRIME2;
+	hash ^= hash >> 29;
+	hash *= PRIME3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * hashes bytes that are all in memory at once
+ *
+ * @param[in]      data - the bytes
+ * @param[in]      count - amount of them
+ * @param[in]      seed - number the hash starts from
+ *
+ * @returns the xxHash64 of the bytes
+ *
+ *****************************************************************************/
+uint64_t hash_bytes( const void *data, size_t count, uint64_t seed )
+{
+	hash_state hash(seed);
+	hash.add(data, count);
+	return hash.digest();
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * turns the cache on, making its folder if it is not there
+ *
+ * @param[in]      folder - where the kept pictures go
+ * @param[in]      max_bytes - size the folder is kept under
+ *
+ * @returns true the folder is ready
+ * @returns false the folder could not be made
+ *
+ *****************************************************************************/
+bool cache_start( const string &folder, uint64_t max_bytes )
+{
+	error_code error;
+
+	fs::create_directories(folder, error);
+	if (!fs::is_directory(folder, error))
+		return false;
+
+	cache_folder = folder;
+	cache_limit = max_bytes;
+	cache_active = true;
+	return true;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * tells if --cache was given
+ *
+ * @returns true pictures are looked for and kept in the cache
+ * @returns false the cache is off
+ *
+ *****************************************************************************/
+bool cache_enabled()
+{
+	return cache_active.load(memory_order_relaxed);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * names the cache file for editing a picture.  The whole input file is
+ * hashed, header and all, through the reader the pictures are read with.
+ * The options are hashed as parse_pipeline left them, so -s and -s 1 are
+ * the same, along with the output format and CACHE_FORMAT.  A border
+ * other than keep is added to its stage, so options without one keep the
+ * names they had.
+ *
+ * @param[in]      input - name of the picture file
+ * @param[in]      checker - -oa or -ob
+ * @param[in]      stages - the options in the order given
+ *
+ * @returns the name, or an empty string if the cache is off or the file
+ *				could not be opened or read
+ *
+ *****************************************************************************/
+string cache_key( const char *input, const string &checker,
+	const vector<pipeline_stage> &stages )
+{
+	if (!cache_enabled())
+		return string();
+
+	stats_stage timer( "hash" );
+	async_reader file;
+	hash_state body;
+	const char *bytes;
+	size_t count = 0;
+
+	if (!file.open( input, 0 ))
+		return string();
+	while ((bytes = file.peek( count )) != nullptr)
+	{
+		body.add(bytes, count);
+		file.skip( count );
+	}
+	file.close();
+	//a picture only partly read must not be found again under its name
+	if (file.error())
+		return string();
+
+	string options = string(CACHE_FORMAT) + ' ' + checker;
+	for (const pipeline_stage &stage : stages)
+	{
+		options += ' ' + to_string(int(stage.kind)) + ':' +
+			to_string(stage.value);
+		if (stage.kind == STAGE_RESAMPLE)
+			options += ':' + to_string(stage.cols) + 'x' +
+				to_string(stage.rows);
+		if (stage.kind == STAGE_CONVOLVE)
+			options += ':' + kernel_text( *stage.kernel );
+		if (stage.border.mode != BORDER_KEEP)
+			options += ":b" + to_string(int(stage.border.mode)) + ',' +
+				to_string(stage.border.fill);
+	}
+
+	char name[33];
+	snprintf(name, sizeof(name), "%016llx%016llx",
+		(unsigned long long) body.digest(),
+		(unsigned long long) hash_bytes(options.data(), options.size()));
+	return name;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * copies a file, replacing one already there.  Where the file system can,
+ * the copy is a FICLONE reflink that shares the blocks until either file
+ * is written; otherwise it is a plain copy.
+ *
+ * @param[in]      from - the file copied
+ * @param[in]      to - the copy
+ *
+ * @returns true the file was copied
+ * @returns false it could not be
+ *
+ *****************************************************************************/
+static bool cache_copy( const fs::path &from, const fs::path &to )
+{
+	error_code error;
+
+#ifdef HAVE_FICLONE
+	int in = open(from.c_str(), O_RDONLY);
+	if (in >= 0)
+	{
+		int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		bool cloned = (out >= 0 && ioctl(out, FICLONE, in) == 0);
+
+		if (out >= 0)
+			close(out);
+		close(in);
+		if (cloned)
+			return true;
+	}
+#endif
+
+	return fs::copy_file(from, to, fs::copy_options::overwrite_existing,
+		error);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * copies a kept picture to the output, if there is one, and marks it as
+ * just used
+ *
+ * @param[in]      key - name from cache_key, empty to skip the cache
+ * @param[in]      basename - output name, without its ending
+ *
+ * @returns true the picture was found and copied
+ * @returns false it has to be edited
+ *
+ *****************************************************************************/
+bool cache_fetch( const string &key, const string &basename )
+{
+	if (key.empty())
+		return false;
+
+	stats_stage timer( "cache" );
+
+	//edited pictures end up colour or grey, never both
+	for (const char *ending : { ".ppm", ".pgm" })
+	{
+		fs::path kept = cache_folder / (key + ending);
+		error_code error;
+
+		if (!fs::exists(kept, error) || !cache_copy( kept, basename + ending ))
+			continue;
+
+		fs::last_write_time(kept, fs::file_time_type::clock::now(), error);
+		stats_cache( true );
+		return true;
+	}
+
+	stats_cache( false );
+	return false;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * removes the kept pictures used longest ago until the folder is back
+ * under TRIM_PERCENT of its limit.  Only files named the way cache_store
+ * names them are counted or removed.  cache_lock is held.
+ *
+ *****************************************************************************/
+static void cache_trim()
+{
+	struct kept_file
+	{
+		fs::file_time_type used;
+		uint64_t bytes;
+		fs::path name;
+	};
+	vector<kept_file> files;
+	error_code error;
+
+	cache_bytes = 0;
+	for (fs::directory_iterator entry(cache_folder, error), last;
+		!error && entry != last; entry.increment(error))
+	{
+		const fs::path &name = entry->path();
+		error_code failed;
+
+		if (name.stem().string().size() != 32 ||
+			(name.extension() != ".ppm" && name.extension() != ".pgm"))
+			continue;
+
+		kept_file file;
+		file.used = entry->last_write_time(failed);
+		file.bytes = entry->file_size(failed);
+		file.name = name;
+		if (failed)
+			continue;
+		files.push_back(file);
+		cache_bytes += file.bytes;
+	}
+
+	if (cache_bytes <= cache_limit)
+		return;
+
+	sort(files.begin(), files.end(), []( const kept_file &a,
+		const kept_file &b ) { return a.used < b.used; });
+
+	uint64_t target = cache_limit / 100 * TRIM_PERCENT;
+	for (const kept_file &file : files)
+	{
+		if (cache_bytes <= target)
+			break;
+		if (fs::remove(file.name, error))
+		{
+			cache_bytes -= file.bytes;
+			stats_evict( file.bytes );
+		}
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * keeps a copy of an edited picture in the cache, then trims the folder
+ * if it has grown past its limit.  A picture that can not be kept is
+ * left out without an error; the output itself is already written.
+ *
+ * @param[in]      key - name from cache_key, empty to skip the cache
+ * @param[in]      output - the written picture, with its ending
+ *
+ *****************************************************************************/
+void cache_store( const string &key, const string &output )
+{
+	if (key.empty())
+		return;
+
+	stats_stage timer( "cache" );
+	fs::path written(output);
+	fs::path kept = cache_folder / (key + written.extension().string());
+	fs::path temp = cache_folder / (key + '.' + to_string(
+		chrono::steady_clock::now().time_since_epoch().count()) + '.' +
+		to_string(cache_temps++) + ".tmp");
+	error_code error;
+
+	if (!cache_copy( written, temp ))
+	{
+		fs::remove(temp, error);
+		return;
+	}
+	uint64_t bytes = fs::file_size(temp, error);
+	fs::rename(temp, kept, error);
+	if (error)
+	{
+		fs::remove(temp, error);
+		return;
+	}
+
+	//the first store counts what earlier runs left in the folder
+	lock_guard<mutex> hold(cache_lock);
+	if (!cache_counted)
+	{
+		cache_counted = true;
+		cache_trim();
+	}
+	else if ((cache_bytes += bytes) > cache_limit)
+		cache_trim();
+}
@@ -0,0 +1,61 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief this file contains the result cache --cache turns on.  An edited
+ * picture is kept in a folder under a name made from a hash of the input
+ * file and of the options it was edited with, so running the same options
+ * on an unchanged picture again copies the kept file instead of reading
+ * and editing it.  The folder is held under a size limit by removing the
+ * files used longest ago.  It should be included with cache.cpp.
+ ****************************************************************************/
+#ifndef  __CACHE__H__
+#define __CACHE__H__
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "function.h"
+
+
+//folder size --cache keeps to when --cache-size is not given, in megabytes
+const uint64_t CACHE_MEGABYTES = 1024;
+
+
+/*!
+ * @brief xxHash64 of bytes handed to it a piece at a time
+ *
+ * @details gives the same hash as hashing all of the bytes at once, however
+ *				they are split up
+ */
+class hash_state
+{
+public:
+	explicit hash_state( uint64_t seed = 0 );
+
+	void add( const void *data, size_t count );
+	uint64_t digest() const;
+
+private:
+	uint64_t lane[4];			/*!< the four running sums */
+	uint64_t seed;				/*!< seed the hash started from */
+	uint64_t total = 0;			/*!< bytes added so far */
+	unsigned char spare[32];	/*!< bytes not yet a whole stripe */
+	size_t held = 0;			/*!< amount of them */
+};
+
+
+/*******************************************************************************
+ *                         Function Prototypes
+ ******************************************************************************/
+bool cache_start( const string &folder, uint64_t max_bytes );
+bool cache_enabled();
+string cache_key( const char *input, const string &checker,
+	const vector<pipeline_stage> &stages );
+bool cache_fetch( const string &key, const string &basename );
+void cache_store( const string &key, const string &output );
+uint64_t hash_bytes( const void *data, size_t count, uint64_t seed = 0 );
+
+
+#endif
@@ -0,0 +1,27 @@
+# Runs a batch with pictures whose headers can not be loaded ahead of a
+# good one and fails unless the good one is still written and the run
+# reports the failures.  Run by ctest:
+#
+#   cmake -DPROG1=prog1 -DINPUT=in.ppm -DOUTPUT=out -P batch_skip.cmake
+file(REMOVE_RECURSE "${OUTPUT}")
+file(MAKE_DIRECTORY "${OUTPUT}/in" "${OUTPUT}/out")
+
+file(WRITE "${OUTPUT}/in/a_negative.ppm" "P6\n-5 3\n255\n")
+file(WRITE "${OUTPUT}/in/b_huge.ppm" "P6\n100000000 100000000\n255\n")
+file(WRITE "${OUTPUT}/in/c_magic.ppm" "P9\n3 3\n255\n")
+file(WRITE "${OUTPUT}/in/d_max.ppm" "P6\n3 3\n70000\n")
+configure_file("${INPUT}" "${OUTPUT}/in/e_good.ppm" COPYONLY)
+
+execute_process(
+  COMMAND "${PROG1}" -n -ob "${OUTPUT}/out" "${OUTPUT}/in/*.ppm"
+  RESULT_VARIABLE result
+  OUTPUT_VARIABLE report)
+if(result EQUAL 0)
+  message(FATAL_ERROR "the batch did not report its failed pictures")
+endif()
+if(NOT report MATCHES "1 pictures written, 4 failed")
+  message(FATAL_ERROR "the batch did not count every picture:\n${report}")
+endif()
+if(NOT EXISTS "${OUTPUT}/out/e_good.ppm")
+  message(FATAL_ERROR "the good picture after the bad ones was not written")
+endif()
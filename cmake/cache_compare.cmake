@@ -0,0 +1,47 @@
+# Edits a picture without the result cache, then twice with it, and fails
+# if either cached run gives a different picture or the cache does not end
+# up holding the one picture.  Run by ctest:
+#
+#   cmake -DPROG1=prog1 -DINPUT=in.ppm -DOUTPUT=out "-DOPTIONS=-s -c"
+#         -P cache_compare.cmake
+separate_arguments(options UNIX_COMMAND "${OPTIONS}")
+
+file(REMOVE_RECURSE "${OUTPUT}_folder")
+
+foreach(mode IN ITEMS plain miss hit)
+  if(mode STREQUAL "plain")
+    set(flag "")
+  else()
+    set(flag --cache "${OUTPUT}_folder")
+  endif()
+
+  file(REMOVE "${OUTPUT}_${mode}.ppm" "${OUTPUT}_${mode}.pgm")
+  execute_process(
+    COMMAND "${PROG1}" ${flag} ${options} -ob "${OUTPUT}_${mode}" "${INPUT}"
+    RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "prog1 ${flag} ${OPTIONS} failed: ${result}")
+  endif()
+
+  file(GLOB written "${OUTPUT}_${mode}.p?m")
+  if(NOT written)
+    message(FATAL_ERROR "prog1 ${flag} ${OPTIONS} wrote no picture")
+  endif()
+  set(${mode}_file "${written}")
+
+  # the first cached run keeps its picture, the second finds it
+  file(GLOB kept "${OUTPUT}_folder/*.p?m")
+  list(LENGTH kept count)
+  if(NOT mode STREQUAL "plain" AND NOT count EQUAL 1)
+    message(FATAL_ERROR "the cache holds ${count} pictures after the ${mode}")
+  endif()
+endforeach()
+
+foreach(mode IN ITEMS miss hit)
+  execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files "${plain_file}" "${${mode}_file}"
+    RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "the cache ${mode} picture differs for ${OPTIONS}")
+  endif()
+endforeach()
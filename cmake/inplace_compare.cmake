@@ -0,0 +1,63 @@
+# Edits a copy of a picture with the output written over it, alone and in
+# batch mode, and fails if the result differs from writing it elsewhere.
+# Run by ctest:
+#
+#   cmake -DPROG1=prog1 -DINPUT=in.ppm -DOUTPUT=out "-DOPTIONS=-n"
+#         ["-DSIZE=3000 2000"] -P inplace_compare.cmake
+#
+# SIZE resamples the picture first, to one bigger than what is read ahead
+separate_arguments(options UNIX_COMMAND "${OPTIONS}")
+
+file(REMOVE_RECURSE "${OUTPUT}")
+file(MAKE_DIRECTORY "${OUTPUT}/batch")
+
+if(SIZE)
+  separate_arguments(size UNIX_COMMAND "${SIZE}")
+  execute_process(
+    COMMAND "${PROG1}" -r ${size} -ob "${OUTPUT}/source" "${INPUT}"
+    RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "prog1 -r ${SIZE} failed: ${result}")
+  endif()
+  set(INPUT "${OUTPUT}/source.ppm")
+endif()
+execute_process(
+  COMMAND "${PROG1}" ${options} -ob "${OUTPUT}/picture" "${INPUT}"
+  RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "prog1 ${OPTIONS} failed: ${result}")
+endif()
+file(GLOB expected "${OUTPUT}/picture.p?m")
+get_filename_component(ending "${expected}" EXT)
+
+# the copy has the ending the output will have, so it is written over
+configure_file("${INPUT}" "${OUTPUT}/inplace${ending}" COPYONLY)
+configure_file("${INPUT}" "${OUTPUT}/batch/inplace${ending}" COPYONLY)
+
+foreach(mode IN ITEMS single batch)
+  if(mode STREQUAL "batch")
+    set(basename "${OUTPUT}/batch")
+    set(input "${OUTPUT}/batch/*${ending}")
+    set(written "${OUTPUT}/batch/inplace${ending}")
+  else()
+    set(basename "${OUTPUT}/inplace")
+    set(input "${OUTPUT}/inplace${ending}")
+    set(written "${input}")
+  endif()
+
+  execute_process(
+    COMMAND "${PROG1}" ${options} -ob "${basename}" "${input}"
+    RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "prog1 ${OPTIONS} over its input (${mode}) "
+      "failed: ${result}")
+  endif()
+
+  execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files "${expected}" "${written}"
+    RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "prog1 ${OPTIONS} written over its input (${mode}) "
+      "differs from writing it elsewhere")
+  endif()
+endforeach()
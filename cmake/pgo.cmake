@@ -0,0 +1,57 @@
+# Builds a profile guided prog1 and bench.  The first build is made with
+# PICTURE_PGO=GENERATE and trained by running the ctest tests labelled
+# train: every option on the test picture and the benchmark corpus.  The
+# same folder is then built again with PICTURE_PGO=USE.
+#
+#   cmake [-DBUILD_DIR=folder] [-DEXTRA=-DPICTURE_NATIVE=OFF] -P cmake/pgo.cmake
+#
+# The default folder is _build/pgo, the same one the pgo-generate and
+# pgo-use presets use.
+get_filename_component(source "${CMAKE_CURRENT_LIST_DIR}/.." ABSOLUTE)
+if(NOT BUILD_DIR)
+  set(BUILD_DIR "${source}/_build/pgo")
+endif()
+separate_arguments(extra UNIX_COMMAND "${EXTRA}")
+set(profiles "${BUILD_DIR}/pgo-data")
+
+function(run)
+  execute_process(COMMAND ${ARGV} RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    list(JOIN ARGV " " command)
+    message(FATAL_ERROR "failed: ${command}")
+  endif()
+endfunction()
+
+function(build phase)
+  run(${CMAKE_COMMAND} -S "${source}" -B "${BUILD_DIR}"
+    -DCMAKE_BUILD_TYPE=Release -DPICTURE_NATIVE=ON -DPICTURE_LTO=ON
+    -DPICTURE_PGO=${phase} "-DPICTURE_PGO_DIR=${profiles}" ${extra})
+  run(${CMAKE_COMMAND} --build "${BUILD_DIR}" --parallel)
+endfunction()
+
+message(STATUS "pgo: instrumented build")
+build(GENERATE)
+
+# old profiles would be mixed into the new ones
+file(GLOB_RECURSE stale "${BUILD_DIR}/*.gcda")
+if(stale)
+  file(REMOVE ${stale})
+endif()
+file(REMOVE_RECURSE "${profiles}")
+file(MAKE_DIRECTORY "${profiles}")
+
+message(STATUS "pgo: training")
+run(${CMAKE_COMMAND} -E chdir "${BUILD_DIR}" ctest -L train
+  --output-on-failure)
+
+# clang leaves raw profiles that have to be merged first
+load_cache("${BUILD_DIR}" READ_WITH_PREFIX pgo_ CMAKE_CXX_COMPILER)
+if(pgo_CMAKE_CXX_COMPILER MATCHES "clang")
+  find_program(profdata NAMES llvm-profdata REQUIRED)
+  file(GLOB raw "${profiles}/*.profraw")
+  run(${profdata} merge "-output=${profiles}/default.profdata" ${raw})
+endif()
+
+message(STATUS "pgo: optimized build")
+build(USE)
+message(STATUS "pgo: done, programs are in ${BUILD_DIR}")
@@ -0,0 +1,35 @@
+# Edits a picture in memory and in streaming mode and fails if the two
+# pictures differ.  Run by ctest:
+#
+#   cmake -DPROG1=prog1 -DINPUT=in.ppm -DOUTPUT=out "-DOPTIONS=-s -c"
+#         -P stream_compare.cmake
+separate_arguments(options UNIX_COMMAND "${OPTIONS}")
+
+foreach(mode IN ITEMS memory stream)
+  if(mode STREQUAL "stream")
+    set(flag -l)
+  else()
+    set(flag "")
+  endif()
+
+  file(REMOVE "${OUTPUT}_${mode}.ppm" "${OUTPUT}_${mode}.pgm")
+  execute_process(
+    COMMAND "${PROG1}" ${flag} ${options} -ob "${OUTPUT}_${mode}" "${INPUT}"
+    RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "prog1 ${flag} ${OPTIONS} failed: ${result}")
+  endif()
+
+  file(GLOB written "${OUTPUT}_${mode}.p?m")
+  if(NOT written)
+    message(FATAL_ERROR "prog1 ${flag} ${OPTIONS} wrote no picture")
+  endif()
+  set(${mode}_file "${written}")
+endforeach()
+
+execute_process(
+  COMMAND ${CMAKE_COMMAND} -E compare_files "${memory_file}" "${stream_file}"
+  RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "streaming and in memory pictures differ for ${OPTIONS}")
+endif()
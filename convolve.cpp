@@ -0,0 +1,1058 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief The convolution.  A kernel that is a column times a row runs as
+ * a pass along the rows into a buffer a band tall and a pass down from
+ * it.  Other kernels weigh the pixels under every weight a tile of
+ * columns at a time, so the rows the kernel covers stay in cache, or,
+ * once there are enough weights for it to be quicker, are multiplied
+ * with each tile in the frequency domain.  Every way gives the same
+ * picture.  Pixels the kernel does not fit over keep their values.
+ ****************************************************************************/
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+
+#include "convolve.h"
+#include "kernels.h"
+#include "threadpool.h"
+
+
+//bands hold at least this many times the rows the kernel covers, so the
+	//rows each band filters again at its top stay cheap
+static const int BAND_TAPS = 4;
+
+//columns weighed at a time, so the rows under a tile stay in cache
+static const int DIRECT_COLS = 1024;
+
+//work of the transforms for each pixel out and each doubling of a tile's
+	//points, in weights of the direct loop.  Measured on 3000x2000 P6
+	//pictures with AVX2, where a 21x21 kernel is about even
+static const double FFT_COST = 24.0;
+
+//side of the smallest tile transformed, it grows to 4 times the kernel
+static const int FFT_SIZE = 256;
+
+
+/*!
+ * @brief what a transform of one size needs worked out ahead
+ */
+struct fft_plan
+{
+	int size = 0;							/*!< points transformed */
+	vector<complex<double>> twiddle;		/*!< e^(-2 pi i k / size) for
+													k below size / 2 */
+	vector<int> reverse;					/*!< bit reversed order */
+};
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * reads a kernel from text.  Weights are whole numbers split by commas
+ * or spaces, rows are split by semicolons or new lines, and a slash
+ * followed by a number gives the divisor, which is otherwise the sum of
+ * the weights, or 1 if that is not above 0.  A # starts a comment that
+ * runs to the end of the line.  The kernel must then pass kernel_valid.
+ *
+ * @param[in]      text - the kernel, such as 1,2,1;2,4,2;1,2,1/16
+ * @param[out]     kernel - the kernel read
+ *
+ * @returns true the kernel was read
+ * @returns false the text is not a kernel this can run
+ *
+ *****************************************************************************/
+bool kernel_parse( const string &text, convolve_kernel &kernel )
+{
+	//loop variable
+	size_t i = 0;
+
+	vector<vector<int>> rows(1);
+	bool divided = false;
+	long divisor = 0;
+	long total = 0;
+
+	while (i < text.size())
+	{
+		char c = text[i];
+
+		if (c == '#')
+		{
+			while (i < text.size() && text[i] != '\n')
+				i++;
+		}
+		else if (isdigit((unsigned char) c) || c == '-' || c == '+')
+		{
+			char *end = nullptr;
+			long value = strtol(text.c_str() + i, &end, 10);
+
+			if (end == text.c_str() + i || labs(value) > MAX_KERNEL_WEIGHT ||
+				(divided && divisor != 0))
+				return false;
+			i = size_t(end - text.c_str());
+			if (divided)
+				divisor = value;
+			else
+				rows.back().push_back(int(value));
+			continue;
+		}
+		else if (c == ';' || (c == '\n' && !divided))
+		{
+			if (divided)
+				return false;
+			if (!rows.back().empty())
+				rows.emplace_back();
+		}
+		else if (c == '/')
+		{
+			if (divided)
+				return false;
+			divided = true;
+		}
+		else if (c != ',' && !isspace((unsigned char) c))
+			return false;
+		i++;
+	}
+
+	if (rows.back().empty())
+		rows.pop_back();
+	if (rows.empty() || (divided && divisor < 1) ||
+		divisor > sample_traits<wide_pixel>::largest)
+		return false;
+
+	kernel.rows = int(rows.size());
+	kernel.cols = int(rows[0].size());
+	kernel.weights.clear();
+	for (const vector<int> &row : rows)
+	{
+		if (int(row.size()) != kernel.cols)
+			return false;
+		for (int weight : row)
+		{
+			total += weight;
+			kernel.weights.push_back(weight);
+		}
+	}
+
+	if (!divided)
+		divisor = (total > 0 && total <= MAX_KERNEL_WEIGHT) ? total : 1;
+	kernel.divisor = int(divisor);
+	return kernel_valid( kernel );
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * tells if a kernel is one convolve can run: both sides odd and at most
+ * MAX_KERNEL, a weight for every place, the sizes of the weights adding
+ * up to more than 0 and at most MAX_KERNEL_WEIGHT, and a divisor from 1
+ * to 65535, so the divisor times the max_value fits 32 bits
+ *
+ * @param[in]      kernel - the kernel
+ *
+ * @returns true the kernel can be run
+ * @returns false it can not
+ *
+ *****************************************************************************/
+bool kernel_valid( const convolve_kernel &kernel )
+{
+	long sizes = 0;
+
+	if (kernel.rows < 1 || kernel.cols < 1 || kernel.rows % 2 == 0 ||
+		kernel.cols % 2 == 0 || kernel.rows > MAX_KERNEL ||
+		kernel.cols > MAX_KERNEL || kernel.divisor < 1 ||
+		kernel.divisor > sample_traits<wide_pixel>::largest ||
+		kernel.weights.size() != size_t(kernel.rows) * kernel.cols)
+		return false;
+
+	for (int weight : kernel.weights)
+	{
+		sizes += labs(weight);
+		if (sizes > MAX_KERNEL_WEIGHT)
+			return false;
+	}
+	return sizes > 0;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * reads the kernel -k was given, from the file named after an @ or from
+ * the argument itself
+ *
+ * @param[in]      spec - @file or the kernel, see kernel_parse
+ * @param[out]     kernel - the kernel read
+ *
+ * @returns true the kernel was read
+ * @returns false the file could not be read or is not a kernel
+ *
+ *****************************************************************************/
+bool kernel_read( const string &spec, convolve_kernel &kernel )
+{
+	if (spec.empty() || spec[0] != '@')
+		return kernel_parse( spec, kernel );
+
+	ifstream fin(spec.c_str() + 1, ios::in | ios::binary);
+	if (!fin)
+		return false;
+
+	ostringstream text;
+	text << fin.rdbuf();
+	return kernel_parse( text.str(), kernel );
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * writes a kernel back out the way kernel_parse reads it, the same text
+ * for the same kernel however it was given
+ *
+ * @param[in]      kernel - the kernel
+ *
+ * @returns the kernel as text
+ *
+ *****************************************************************************/
+string kernel_text( const convolve_kernel &kernel )
+{
+	//loop variable
+	size_t k = 0;
+
+	string text;
+
+	for (k = 0; k < kernel.weights.size(); k++)
+	{
+		if (k > 0)
+			text += (k % kernel.cols == 0) ? ';' : ',';
+		text += to_string(kernel.weights[k]);
+	}
+	return text + '/' + to_string(kernel.divisor);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * tells if a kernel is a column times a row.  The row is the first row
+ * with a weight, divided by what its weights have in common, which makes
+ * every other row a whole number times it if the kernel splits at all.
+ *
+ * @param[in]      kernel - the kernel
+ * @param[out]     across - the row, kernel.cols weights
+ * @param[out]     down - the column, kernel.rows weights
+ *
+ * @returns true the kernel is down times across
+ * @returns false the kernel does not split
+ *
+ *****************************************************************************/
+bool kernel_split( const convolve_kernel &kernel, vector<int> &across,
+	vector<int> &down )
+{
+	//loop variables
+	int i = 0;
+	int j = 0;
+
+	//first row with a weight, and a column where it has one
+	int row = 0;
+	int col = 0;
+	int common = 0;
+
+	while (row < kernel.rows)
+	{
+		for (col = 0; col < kernel.cols; col++)
+			if (kernel.weights[size_t(row) * kernel.cols + col] != 0)
+				break;
+		if (col < kernel.cols)
+			break;
+		row++;
+	}
+
+	across.assign(kernel.cols, 0);
+	down.assign(kernel.rows, 0);
+	for (j = 0; j < kernel.cols; j++)
+	{
+		int a = abs(kernel.weights[size_t(row) * kernel.cols + j]);
+		int b = common;
+
+		while (b != 0)
+		{
+			int r = a % b;
+			a = b;
+			b = r;
+		}
+		common = a;
+	}
+
+	//the row's first weight is kept above 0
+	if (kernel.weights[size_t(row) * kernel.cols + col] < 0)
+		common = -common;
+	for (j = 0; j < kernel.cols; j++)
+		across[j] = kernel.weights[size_t(row) * kernel.cols + j] / common;
+
+	for (i = 0; i < kernel.rows; i++)
+	{
+		int weight = kernel.weights[size_t(i) * kernel.cols + col];
+
+		if (weight % across[col] != 0)
+			return false;
+		down[i] = weight / across[col];
+		for (j = 0; j < kernel.cols; j++)
+			if (kernel.weights[size_t(i) * kernel.cols + j] !=
+				down[i] * across[j])
+				return false;
+	}
+	return true;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives the side of the tiles a kernel is transformed in, at least
+ * FFT_SIZE and 4 times the kernel, a power of 2
+ *
+ * @param[in]      kernel - the kernel
+ *
+ * @returns the side of a tile
+ *
+ *****************************************************************************/
+static int fft_size( const convolve_kernel &kernel )
+{
+	int size = FFT_SIZE;
+
+	while (size < 4 * max(kernel.rows, kernel.cols))
+		size *= 2;
+	return size;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * picks how a kernel is run.  A kernel that splits takes two passes
+ * unless it is a single row or column already, or its row's sums would
+ * not fit the words the first pass keeps for byte samples.  Other
+ * kernels use the frequency domain only when its estimated cost is below
+ * the direct loop's: the direct loop does one step per weight that is not
+ * 0 for each pixel, and the transforms do about FFT_COST steps for each
+ * doubling of a tile's points, spread over the pixels a tile gives.
+ *
+ * @param[in]      kernel - the kernel
+ * @param[in]      top - largest value a sample may have
+ *
+ * @returns the way to run it
+ *
+ *****************************************************************************/
+convolve_path convolve_method( const convolve_kernel &kernel, int top )
+{
+	vector<int> across;
+	vector<int> down;
+	int taps = 0;
+	long sizes = 0;
+
+	for (int weight : kernel.weights)
+		if (weight != 0)
+			taps++;
+
+	if (kernel.rows > 1 && kernel.cols > 1 &&
+		kernel_split( kernel, across, down ))
+	{
+		for (int weight : across)
+			sizes += abs(weight);
+		if (top > sample_traits<pixel>::largest || sizes * top <= INT16_MAX)
+			return CONVOLVE_SEPARABLE;
+	}
+
+	int size = fft_size( kernel );
+	double points = double(size) * size;
+	double out = double(size - kernel.rows + 1) * (size - kernel.cols + 1);
+
+	if (taps > FFT_COST * log2(points) * points / out)
+		return CONVOLVE_FFT;
+	return CONVOLVE_DIRECT;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * turns the sums of a row into pixels: each is divided by the divisor to
+ * the nearest whole number and kept between 0 and top
+ *
+ * @param[in]      sum - the sums of the weighted pixels
+ * @param[out]     out - receives width pixels
+ * @param[in]      width - amount of pixels
+ * @param[in]      divisor - what the sums are divided by
+ * @param[in]      divide - rounding for divisor
+ * @param[in]      top - largest value a pixel may have
+ *
+ *****************************************************************************/
+template <class T>
+static void kernel_result( const int32_t *sum, T *out, int width,
+	int divisor, const box_divider &divide, int top )
+{
+	//loop variable
+	int j = 0;
+
+	//a sum past divisor * top comes out as top anyway
+	int64_t most = int64_t(divisor) * top;
+
+	for (j = 0; j < width; j++)
+		out[j] = box_average<T>(uint32_t(min(most, max(int64_t(0),
+			int64_t(sum[j])))), divide);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs a kernel by weighing the pixels under each weight, skipping the
+ * weights that are 0.  Each band works down a tile of DIRECT_COLS
+ * columns before starting the next, so the rows one row out reads are
+ * mostly still in cache from the row before.
+ *
+ * @param[in]      src - the colorband
+ * @param[out]     dst - receives the inside of the convolved colorband
+ * @param[in]      kernel - the kernel
+ * @param[in]      top - largest value a pixel may have
+ *
+ *****************************************************************************/
+template <class T>
+static void convolve_direct( const basic_plane<T> &src, basic_plane<T> &dst,
+	const convolve_kernel &kernel, int top )
+{
+	//loop variables
+	int r = 0;
+	int c = 0;
+
+	int R = kernel.rows / 2;
+	int C = kernel.cols / 2;
+	int width = src.cols - 2 * C;
+	box_divider divide = make_divider( uint32_t(kernel.divisor), top );
+
+	//the weights that are not 0 and where they sit in the kernel
+	vector<int16_t> weights;
+	vector<int> row_at;
+	vector<int> col_at;
+
+	for (r = 0; r < kernel.rows; r++)
+	{
+		for (c = 0; c < kernel.cols; c++)
+		{
+			int weight = kernel.weights[size_t(r) * kernel.cols + c];
+			if (weight == 0)
+				continue;
+			weights.push_back(int16_t(weight));
+			row_at.push_back(r - R);
+			col_at.push_back(c);
+		}
+	}
+
+	parallel_rows( src.rows - 2 * R, src.cols * int(sizeof(T)) *
+		kernel.rows, [&] (int first, int last)
+	{
+		//loop variables
+		int i = 0;
+		int x = 0;
+		size_t t = 0;
+
+		thread_local vector<const T *> taps;
+		thread_local vector<int32_t> sums;
+
+		taps.resize(weights.size());
+		sums.resize(DIRECT_COLS);
+
+		for (x = 0; x < width; x += DIRECT_COLS)
+		{
+			int count = min(DIRECT_COLS, width - x);
+
+			for (i = first + R; i < last + R; i++)
+			{
+				for (t = 0; t < weights.size(); t++)
+					taps[t] = src[i + row_at[t]] + col_at[t] + x;
+				weigh_row( taps.data(), weights.data(), int(weights.size()),
+					sums.data(), count );
+				kernel_result( sums.data(), dst[i] + C + x, count,
+					kernel.divisor, divide, top );
+			}
+		}
+	});
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs a kernel that is a column times a row.  A band of rows out first
+ * weighs the source rows under it along the row into a buffer kept by
+ * the thread, then weighs those down the column.  The sums along the row
+ * are kept whole, so this gives exactly what weighing every pixel under
+ * the kernel gives.
+ *
+ * @param[in]      src - the colorband
+ * @param[out]     dst - receives the inside of the convolved colorband
+ * @param[in]      kernel - the kernel
+ * @param[in]      top - largest value a pixel may have
+ *
+ *****************************************************************************/
+template <class T>
+static void convolve_separable( const basic_plane<T> &src,
+	basic_plane<T> &dst, const convolve_kernel &kernel, int top )
+{
+	typedef typename sample_traits<T>::filtered filtered;
+
+	//loop variable
+	int k = 0;
+
+	int R = kernel.rows / 2;
+	int C = kernel.cols / 2;
+	int width = src.cols - 2 * C;
+	box_divider divide = make_divider( uint32_t(kernel.divisor), top );
+
+	vector<int> across;
+	vector<int> down;
+	kernel_split( kernel, across, down );
+
+	//the weights of each pass that are not 0, and where they sit
+	vector<int16_t> across_weights;
+	vector<int> across_at;
+	vector<int16_t> down_weights;
+	vector<int> down_at;
+
+	for (k = 0; k < kernel.cols; k++)
+	{
+		if (across[k] != 0)
+		{
+			across_weights.push_back(int16_t(across[k]));
+			across_at.push_back(k);
+		}
+	}
+	for (k = 0; k < kernel.rows; k++)
+	{
+		if (down[k] != 0)
+		{
+			down_weights.push_back(int16_t(down[k]));
+			down_at.push_back(k);
+		}
+	}
+
+	parallel_rows( src.rows - 2 * R, width * int(sizeof(filtered)),
+		[&] (int first, int last)
+	{
+		//loop variables
+		int i = 0;
+		size_t t = 0;
+
+		//rows weighed along, and the taps of each pass
+		thread_local vector<filtered> buffer;
+		thread_local vector<int32_t> sums;
+		thread_local vector<const T *> row_taps;
+		thread_local vector<const filtered *> column_taps;
+
+		//source rows the band reads
+		int low = first;
+		int high = last + 2 * R;
+		size_t need = size_t(high - low) * width;
+
+		if (buffer.size() < need)
+			buffer.resize(need);
+		sums.resize(width);
+		row_taps.resize(across_weights.size());
+		column_taps.resize(down_weights.size());
+
+		for (i = low; i < high; i++)
+		{
+			for (t = 0; t < across_weights.size(); t++)
+				row_taps[t] = src[i] + across_at[t];
+			weigh_row( row_taps.data(), across_weights.data(),
+				int(across_weights.size()),
+				buffer.data() + size_t(i - low) * width, width );
+		}
+
+		for (i = first; i < last; i++)
+		{
+			for (t = 0; t < down_weights.size(); t++)
+				column_taps[t] = buffer.data() + size_t(i + down_at[t] - low) *
+					width;
+			weigh_row( column_taps.data(), down_weights.data(),
+				int(down_weights.size()), sums.data(), width );
+			kernel_result( sums.data(), dst[i + R] + C, width,
+				kernel.divisor, divide, top );
+		}
+	}, BAND_TAPS * kernel.rows );
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * works out the twiddles and the bit reversed order for transforms of
+ * size points, a power of 2
+ *
+ * @param[out]     plan - the plan
+ * @param[in]      size - points transformed
+ *
+ *****************************************************************************/
+static void fft_setup( fft_plan &plan, int size )
+{
+	//loop variable
+	int k = 0;
+
+	const double pi = 3.14159265358979323846;
+	int bits = 0;
+
+	while ((1 << bits) < size)
+		bits++;
+
+	plan.size = size;
+	plan.twiddle.resize(size / 2);
+	for (k = 0; k < size / 2; k++)
+		plan.twiddle[k] = complex<double>(cos(2 * pi * k / size),
+			-sin(2 * pi * k / size));
+
+	plan.reverse.resize(size);
+	for (k = 0; k < size; k++)
+	{
+		int r = 0;
+		for (int b = 0; b < bits; b++)
+			if (k & (1 << b))
+				r |= 1 << (bits - 1 - b);
+		plan.reverse[k] = r;
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * transforms lanes side by side at once: point k of lane x is at
+ * data[k * lanes + x].  One lane is a row; as many lanes as points
+ * transforms every column of a tile, the butterflies running along whole
+ * rows.  The products are written out so the compiler needs no checks
+ * for infinities.
+ *
+ * @param[in]      plan - the plan for the size
+ * @param[in][out] data - the points
+ * @param[in]      lanes - transforms done at once
+ * @param[in]      inverse - transforms back, without dividing by the size
+ *
+ *****************************************************************************/
+static void fft_lanes( const fft_plan &plan, complex<double> *data,
+	int lanes, bool inverse )
+{
+	//loop variables
+	int k = 0;
+	int x = 0;
+
+	int n = plan.size;
+
+	for (k = 0; k < n; k++)
+		if (k < plan.reverse[k])
+			swap_ranges(data + size_t(k) * lanes, data + size_t(k + 1) * lanes,
+				data + size_t(plan.reverse[k]) * lanes);
+
+	for (int length = 2; length <= n; length *= 2)
+	{
+		int half = length / 2;
+		int step = n / length;
+
+		for (int start = 0; start < n; start += length)
+		{
+			for (k = 0; k < half; k++)
+			{
+				double wr = plan.twiddle[k * step].real();
+				double wi = inverse ? -plan.twiddle[k * step].imag() :
+					plan.twiddle[k * step].imag();
+				double *u = (double *) (data + size_t(start + k) * lanes);
+				double *v = (double *) (data + size_t(start + k + half) *
+					lanes);
+
+				for (x = 0; x < 2 * lanes; x += 2)
+				{
+					double re = v[x] * wr - v[x + 1] * wi;
+					double im = v[x] * wi + v[x + 1] * wr;
+
+					v[x] = u[x] - re;
+					v[x + 1] = u[x + 1] - im;
+					u[x] += re;
+					u[x + 1] += im;
+				}
+			}
+		}
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs a kernel in the frequency domain.  The inside of the picture is
+ * cut into tiles size - kernel + 1 pixels a side, and each tile with the
+ * rows and columns the kernel reaches around it is transformed,
+ * multiplied by the kernel's transform, and transformed back; the edges
+ * that wrapped around are thrown away.  The kernel is real, so two tiles
+ * side by side share one transform, the first as its real part and the
+ * second as its imaginary part.  The sums come back whole to within far
+ * less than a half, so rounding them gives exactly what weighing the
+ * pixels gives.
+ *
+ * @param[in]      src - the colorband
+ * @param[out]     dst - receives the inside of the convolved colorband
+ * @param[in]      kernel - the kernel
+ * @param[in]      top - largest value a pixel may have
+ *
+ *****************************************************************************/
+template <class T>
+static void convolve_fft( const basic_plane<T> &src, basic_plane<T> &dst,
+	const convolve_kernel &kernel, int top )
+{
+	//loop variables
+	int r = 0;
+	int c = 0;
+
+	int R = kernel.rows / 2;
+	int C = kernel.cols / 2;
+	box_divider divide = make_divider( uint32_t(kernel.divisor), top );
+
+	int size = fft_size( kernel );
+
+	//pixels out a tile gives each way, and tiles and pairs of them
+	int step_y = size - kernel.rows + 1;
+	int step_x = size - kernel.cols + 1;
+	int tiles_y = (src.rows - 2 * R + step_y - 1) / step_y;
+	int tiles_x = (src.cols - 2 * C + step_x - 1) / step_x;
+	int pairs = (tiles_x + 1) / 2;
+
+	fft_plan plan;
+	fft_setup( plan, size );
+
+	//the kernel turned around the origin, so the transform gives each
+		//pixel the sum of the weights times the pixels under them
+	vector<complex<double>> spectrum(size_t(size) * size);
+	for (r = 0; r < kernel.rows; r++)
+		for (c = 0; c < kernel.cols; c++)
+			spectrum[size_t((R - r + size) % size) * size +
+				(C - c + size) % size] = complex<double>(
+				kernel.weights[size_t(r) * kernel.cols + c], 0.0);
+	for (r = 0; r < size; r++)
+		fft_lanes( plan, spectrum.data() + size_t(r) * size, 1, false );
+	fft_lanes( plan, spectrum.data(), size, false );
+
+	//the transform back is size * size times too large
+	double scale = 1.0 / (double(size) * size);
+
+	parallel_rows( tiles_y, size * size * int(sizeof(complex<double>)),
+		[&] (int first, int last)
+	{
+		//loop variables
+		int y = 0;
+		int x = 0;
+		int p = 0;
+
+		thread_local vector<complex<double>> tile;
+		thread_local vector<int32_t> sums;
+		tile.resize(size_t(size) * size);
+		sums.resize(2 * step_x);
+
+		for (int ty = first; ty < last; ty++)
+		{
+			//first row out of the tile, and rows out it really has
+			int y0 = R + ty * step_y;
+			int height = min(step_y, src.rows - R - y0);
+
+			for (p = 0; p < pairs; p++)
+			{
+				int x0 = C + 2 * p * step_x;
+
+				//columns out of the pair
+				int width = min(2 * step_x, src.cols - C - x0);
+
+				for (y = 0; y < size; y++)
+				{
+					int sy = y0 - R + y;
+					complex<double> *line = tile.data() + size_t(y) * size;
+
+					for (x = 0; x < size; x++)
+					{
+						int a = x0 - C + x;
+						int b = a + step_x;
+						double re = (sy < src.rows && a < src.cols) ?
+							double(src[sy][a]) : 0.0;
+						double im = (sy < src.rows && b < src.cols) ?
+							double(src[sy][b]) : 0.0;
+						line[x] = complex<double>(re, im);
+					}
+					fft_lanes( plan, line, 1, false );
+				}
+				fft_lanes( plan, tile.data(), size, false );
+
+				for (size_t k = 0; k < tile.size(); k++)
+				{
+					double re = tile[k].real() * spectrum[k].real() -
+						tile[k].imag() * spectrum[k].imag();
+					double im = tile[k].real() * spectrum[k].imag() +
+						tile[k].imag() * spectrum[k].real();
+					tile[k] = complex<double>(re, im);
+				}
+
+				//only the rows that did not wrap are turned back along
+				fft_lanes( plan, tile.data(), size, true );
+				for (y = R; y < R + height; y++)
+				{
+					complex<double> *line = tile.data() + size_t(y) * size;
+
+					fft_lanes( plan, line, 1, true );
+					for (x = 0; x < width; x++)
+					{
+						const complex<double> &value = (x < step_x) ?
+							line[C + x] : line[C + x - step_x];
+						double sum = (x < step_x) ? value.real() :
+							value.imag();
+						sums[x] = int32_t(llround(sum * scale));
+					}
+					kernel_result( sums.data(), dst[y0 + y - R] + x0, width,
+						kernel.divisor, divide, top );
+				}
+			}
+		}
+	}, 1 );
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * convolves the pixels within half the kernel of an edge, reading the
+ * pixels past the edge the way border says.  Each is weighed one at a
+ * time, which costs the kernel's size for each of them but leaves the
+ * inside to the faster ways.  A row past the top or bottom with
+ * BORDER_CONSTANT is all fill, so it adds the fill times its weights.
+ *
+ * @param[in]      src - the colorband
+ * @param[out]     dst - receives the edges of the convolved colorband
+ * @param[in]      kernel - the kernel
+ * @param[in]      top - largest value a pixel may have
+ * @param[in]      border - what is read past the edges
+ *
+ *****************************************************************************/
+template <class T>
+static void convolve_edges( const basic_plane<T> &src, basic_plane<T> &dst,
+	const convolve_kernel &kernel, int top, const stencil_border &border )
+{
+	int R = kernel.rows / 2;
+	int C = kernel.cols / 2;
+	int rows = src.rows;
+	int cols = src.cols;
+
+	box_divider divide = make_divider( uint32_t(kernel.divisor), top );
+
+	//the inside columns, none if the picture is narrower than the kernel
+	int left = C;
+	int right = cols - C;
+	if (right <= left)
+		left = right = cols;
+
+	//sum of each row of weights, what a row of fill adds
+	vector<int32_t> row_sums(kernel.rows, 0);
+	for (int r = 0; r < kernel.rows; r++)
+		for (int c = 0; c < kernel.cols; c++)
+			row_sums[r] += kernel.weights[r * kernel.cols + c];
+
+	parallel_rows( rows, cols * int(sizeof(T)), [&] (int first, int last)
+	{
+		//loop variables
+		int i = 0;
+		int x = 0;
+		int r = 0;
+		int c = 0;
+
+		//the sums of a row, and the columns each column of weights reads
+		vector<int32_t> sums(cols);
+		vector<int> places(kernel.cols);
+
+		for (i = first; i < last; i++)
+		{
+			//a row with its whole kernel inside only has its sides to do
+			bool side = (i >= R && i < rows - R);
+
+			for (x = 0; x < cols; x = (side && x + 1 == left) ?
+				max(right, left) : x + 1)
+			{
+				int32_t sum = 0;
+
+				for (c = 0; c < kernel.cols; c++)
+					places[c] = border_index( x + c - C, cols, border.mode );
+
+				for (r = 0; r < kernel.rows; r++)
+				{
+					int place = border_index( i + r - R, rows, border.mode );
+					const int *weights = &kernel.weights[r * kernel.cols];
+
+					if (place < 0)
+					{
+						sum += border.fill * row_sums[r];
+						continue;
+					}
+
+					const T *line = src[place];
+					for (c = 0; c < kernel.cols; c++)
+						sum += weights[c] * (places[c] < 0 ? border.fill :
+							int32_t(line[places[c]]));
+				}
+				sums[x] = sum;
+			}
+
+			//the sides are turned into pixels, the inside is left alone
+			if (side && left < right)
+			{
+				kernel_result( sums.data(), dst[i], left, kernel.divisor,
+					divide, top );
+				kernel_result( sums.data() + right, dst[i] + right,
+					cols - right, kernel.divisor, divide, top );
+			}
+			else
+				kernel_result( sums.data(), dst[i], cols, kernel.divisor,
+					divide, top );
+		}
+	});
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * convolves one colorband into dst, the way convolve_method picks.  With
+ * BORDER_KEEP the rows and columns within half the kernel of an edge keep
+ * their values; otherwise convolve_edges does them, and a picture smaller
+ * than the kernel is all edge.
+ *
+ * @param[in]      src - the colorband
+ * @param[out]     dst - receives the convolved colorband, the same size
+ * @param[in]      kernel - the kernel
+ * @param[in]      top - largest value a pixel may have
+ * @param[in]      border - what is read past the edges
+ *
+ *****************************************************************************/
+template <class T>
+void convolve_plane( const basic_plane<T> &src, basic_plane<T> &dst,
+	const convolve_kernel &kernel, int top, const stencil_border &border )
+{
+	//loop variable
+	int i = 0;
+
+	int R = kernel.rows / 2;
+	int C = kernel.cols / 2;
+
+	bool small = (src.rows < kernel.rows || src.cols < kernel.cols);
+
+	if (border.mode != BORDER_KEEP)
+		convolve_edges( src, dst, kernel, top, border );
+
+	//a picture smaller than the kernel stays as it is
+	else if (small)
+	{
+		for (i = 0; i < src.rows; i++)
+			memcpy(dst[i], src[i], src.cols * sizeof(T));
+	}
+
+	//edge rows and columns keep their values
+	else
+	{
+		for (i = 0; i < src.rows; i++)
+		{
+			if (i < R || i >= src.rows - R)
+				memcpy(dst[i], src[i], src.cols * sizeof(T));
+			else
+			{
+				memcpy(dst[i], src[i], C * sizeof(T));
+				memcpy(dst[i] + src.cols - C, src[i] + src.cols - C,
+					C * sizeof(T));
+			}
+		}
+	}
+
+	if (small)
+		return;
+
+	switch (convolve_method( kernel, top ))
+	{
+	case CONVOLVE_SEPARABLE:
+		convolve_separable( src, dst, kernel, top );
+		break;
+
+	case CONVOLVE_FFT:
+		convolve_fft( src, dst, kernel, top );
+		break;
+
+	case CONVOLVE_DIRECT:
+		convolve_direct( src, dst, kernel, top );
+		break;
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * convolves the picture, its grey band if it has one and its colorbands
+ * otherwise.  A packed picture is split into colorbands first.  The
+ * results go to one temporary plane that is swapped in, the same plane
+ * serving each colorband in turn.
+ *
+ * @param[in][out] vars - the picture, freed if a plane can not be
+ *						allocated
+ * @param[in]      kernel - the kernel
+ * @param[in]      border - what is read past the edges, a fill past the
+ *						max_value is taken as the max_value
+ *
+ *****************************************************************************/
+template <class T>
+void convolve( basic_image<T> &vars, const convolve_kernel &kernel,
+	const stencil_border &border )
+{
+	int top = min(vars.max_value, sample_traits<T>::largest);
+	vector<basic_plane<T> *> bands;
+
+	stencil_border edges = border;
+	edges.fill = min(border.fill, top);
+
+	packed_split( vars );
+	if (vars.grey.data != nullptr)
+		bands.push_back(&vars.grey);
+	else
+	{
+		bands.push_back(&vars.red);
+		bands.push_back(&vars.green);
+		bands.push_back(&vars.blue);
+	}
+
+	basic_plane<T> cpy_array = d2array<T>(vars.rows, vars.cols);
+	if (cpy_array.data == nullptr)
+	{
+		allocation_error( vars, "memory or allocation error convolve" );
+		return;
+	}
+
+	for (basic_plane<T> *band : bands)
+	{
+		convolve_plane( *band, cpy_array, kernel, top, edges );
+		swap(*band, cpy_array);
+	}
+	d2array_delet( cpy_array );
+}
+
+
+/*******************************************************************************
+ *                         Sample types
+ ******************************************************************************/
+#define CONVOLVE_FUNCTIONS(T) \
+	template void convolve( basic_image<T> &, const convolve_kernel &, \
+		const stencil_border & ); \
+	template void convolve_plane( const basic_plane<T> &, basic_plane<T> &, \
+		const convolve_kernel &, int, const stencil_border & );
+
+CONVOLVE_FUNCTIONS(pixel)
+CONVOLVE_FUNCTIONS(wide_pixel)
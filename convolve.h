@@ -0,0 +1,46 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief this file contains the convolution -k runs: any integer kernel,
+ * given on the command line or in a file, as two passes when it splits
+ * into a column and a row, with the fast fourier transform when it is
+ * large, and weighing the pixels under it otherwise.  It should be
+ * included with convolve.cpp.
+ ****************************************************************************/
+#ifndef  __CONVOLVE__H__
+#define __CONVOLVE__H__
+
+#include "function.h"
+
+
+/*!
+ * @brief the ways a convolution can be done, picked by convolve_method
+ */
+enum convolve_path
+{
+	CONVOLVE_DIRECT,		/*!< every weight times the pixels under it */
+	CONVOLVE_SEPARABLE,		/*!< a pass along the rows, then down */
+	CONVOLVE_FFT			/*!< multiplied in the frequency domain */
+};
+
+
+/*******************************************************************************
+ *                         Function Prototypes
+ ******************************************************************************/
+bool kernel_parse( const string &text, convolve_kernel &kernel );
+bool kernel_read( const string &spec, convolve_kernel &kernel );
+bool kernel_valid( const convolve_kernel &kernel );
+string kernel_text( const convolve_kernel &kernel );
+bool kernel_split( const convolve_kernel &kernel, vector<int> &across,
+	vector<int> &down );
+convolve_path convolve_method( const convolve_kernel &kernel, int top );
+
+template <class T>
+void convolve( basic_image<T> &vars, const convolve_kernel &kernel,
+	const stencil_border &border );
+template <class T>
+void convolve_plane( const basic_plane<T> &src, basic_plane<T> &dst,
+	const convolve_kernel &kernel, int top, const stencil_border &border );
+
+
+#endif
@@ -0,0 +1,554 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief The library interface: loading a picture from memory or a file
+ * descriptor, running the options on it, and writing it to memory.  It
+ * goes through the same fill, option, and output routines as prog1, read
+ * from and written to memory by async_reader and async_writer.
+ ****************************************************************************/
+#include "editor.h"
+#include "pipeline.h"
+#include "convolve.h"
+
+//file descriptors are only read where the system has them
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_FD 1
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+
+/*!
+ * @brief lets read_in_header read a header straight out of memory
+ */
+class memory_buffer : public streambuf
+{
+public:
+	/*! @brief reads size bytes at data, which are never changed */
+	memory_buffer( const char *data, size_t size )
+	{
+		char *start = const_cast<char *>(data);
+		setg(start, start, start + size);
+	}
+
+protected:
+	/*! @brief moves the read position, which is all tellg needs */
+	pos_type seekoff( off_type off, ios_base::seekdir dir,
+		ios_base::openmode which ) override
+	{
+		char *base = (dir == ios_base::beg) ? eback() :
+			(dir == ios_base::end) ? egptr() : gptr();
+
+		if (!(which & ios_base::in) || base + off < eback() ||
+			base + off > egptr())
+			return pos_type(off_type(-1));
+
+		setg(eback(), base + off, egptr());
+		return pos_type(gptr() - eback());
+	}
+
+	/*! @brief moves the read position to pos */
+	pos_type seekpos( pos_type pos, ios_base::openmode which ) override
+	{
+		return seekoff(off_type(pos), ios_base::beg, which);
+	}
+};
+
+/*!
+ * @brief makes colorbands that can not be allocated throw bad_alloc on
+ *				this thread for as long as it lives, see allocation_error
+ */
+struct throw_on_failure
+{
+	throw_on_failure() { allocation_throws( true ); }
+	~throw_on_failure() { allocation_throws( false ); }
+};
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * frees the picture
+ *
+ *****************************************************************************/
+edit_image::~edit_image()
+{
+	clear();
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * takes the picture of another edit_image, leaving that one empty
+ *
+ * @param[in][out] other - the picture taken
+ *
+ *****************************************************************************/
+edit_image::edit_image( edit_image &&other )
+{
+	*this = move(other);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * frees this picture and takes the picture of another edit_image, leaving
+ * that one empty
+ *
+ * @param[in][out] other - the picture taken
+ *
+ * @returns this edit_image
+ *
+ *****************************************************************************/
+edit_image &edit_image::operator=( edit_image &&other )
+{
+	if (this == &other)
+		return *this;
+
+	clear();
+	wide = other.wide;
+	narrow = other.narrow;
+	broad = other.broad;
+
+	//the planes belong to this one now
+	other.narrow = image();
+	other.broad = wide_image();
+	other.wide = false;
+	return *this;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * frees the picture, if one is loaded
+ *
+ *****************************************************************************/
+void edit_image::clear()
+{
+	all_array_delete( narrow );
+	all_array_delete( broad );
+	narrow = image();
+	broad = wide_image();
+	wide = false;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * loads a whole P2, P3, P5, or P6 picture from memory, replacing the one
+ * loaded before.  A body shorter than the header says leaves the rest of
+ * the picture black, the same as a short file.
+ *
+ * @param[in]      data - the picture, header and all
+ * @param[in]      size - bytes at data
+ *
+ * @returns EDIT_OK the picture is loaded
+ * @returns EDIT_BAD_ARGUMENT no data was given
+ * @returns EDIT_BAD_HEADER the header is not a picture the editor reads
+ * @returns EDIT_NO_MEMORY the colorbands could not be allocated
+ *
+ *****************************************************************************/
+edit_status edit_image::load( const void *data, size_t size )
+{
+	clear();
+	if (data == nullptr)
+		return EDIT_BAD_ARGUMENT;
+
+	memory_buffer buffer( (const char *) data, size );
+	istream in(&buffer);
+	picture_header head;
+
+	read_in_header( head, in );
+	if (in.fail())
+		return EDIT_BAD_HEADER;
+
+	if (!header_valid( head ))
+		return EDIT_BAD_HEADER;
+
+	//a header that ends the data leaves no samples
+	size_t offset = size;
+	if (!in.eof())
+		offset = size_t(in.tellg());
+
+	const char *body = (const char *) data + offset;
+
+	wide = (head.max_value > sample_traits<pixel>::largest);
+	if (wide)
+		return fill( broad, head, body, size - offset );
+	return fill( narrow, head, body, size - offset );
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * loads a picture from an open file descriptor, reading it to the end.  It
+ * can be a file, a pipe, or a socket; it is left open.
+ *
+ * @param[in]      fd - the file descriptor
+ *
+ * @returns EDIT_OK the picture is loaded
+ * @returns EDIT_READ_ERROR the descriptor could not be read
+ * @returns the errors of load
+ *
+ *****************************************************************************/
+edit_status edit_image::load_fd( int fd )
+{
+	clear();
+
+#ifdef HAVE_FD
+	vector<char> data;
+	size_t used = 0;
+
+	try
+	{
+		while (true)
+		{
+			if (data.size() - used < ASYNC_CHUNK)
+				data.resize(used + ASYNC_CHUNK);
+
+			ssize_t got = read(fd, data.data() + used, data.size() - used);
+			if (got < 0 && errno == EINTR)
+				continue;
+			if (got < 0)
+				return EDIT_READ_ERROR;
+			if (got == 0)
+				break;
+			used += size_t(got);
+		}
+	}
+	catch (const bad_alloc &)
+	{
+		return EDIT_NO_MEMORY;
+	}
+
+	return load( data.data(), used );
+#else
+	(void) fd;
+	return EDIT_READ_ERROR;
+#endif
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * allocates the packed array or the colorbands and fills them from the
+ * samples after the header
+ *
+ * @param[out]     vars - the picture
+ * @param[in]      head - its header
+ * @param[in]      body - the samples
+ * @param[in]      size - bytes at body
+ *
+ * @returns EDIT_OK the picture is loaded
+ * @returns EDIT_NO_MEMORY the colorbands could not be allocated
+ *
+ *****************************************************************************/
+template <class T>
+edit_status edit_image::fill( basic_image<T> &vars,
+	const picture_header &head, const char *body, size_t size )
+{
+	static_cast<picture_header &>(vars) = head;
+
+	//the options are not known yet, so colour is kept the way the file
+		//holds it; turning it grey later still works on packed pixels
+	if (picture_layout( head, vector<pipeline_stage>() ) == LAYOUT_PACKED)
+	{
+		vars.packed = d2array<T>(vars.rows, vars.cols * 3);
+		if (vars.packed.data == nullptr)
+		{
+			clear();
+			return EDIT_NO_MEMORY;
+		}
+	}
+	else
+	{
+		vars.red = d2array<T>(vars.rows, vars.cols);
+		vars.green = d2array<T>(vars.rows, vars.cols);
+		vars.blue = d2array<T>(vars.rows, vars.cols);
+	}
+
+	if (vars.packed.data == nullptr && (vars.red.data == nullptr ||
+		vars.green.data == nullptr || vars.blue.data == nullptr))
+	{
+		clear();
+		return EDIT_NO_MEMORY;
+	}
+
+	try
+	{
+		async_reader file;
+		file.open_memory( body, size );
+
+		if (vars.magic_number == string("P2") ||
+			vars.magic_number == string("P3"))
+			ascii_body( vars, file, GREY_LEGACY );
+		else
+			binary_body( vars, file, GREY_LEGACY );
+	}
+	catch (const bad_alloc &)
+	{
+		clear();
+		return EDIT_NO_MEMORY;
+	}
+
+	return EDIT_OK;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs the options on the picture in the order given, the same way prog1
+ * runs them
+ *
+ * @param[in]      stages - the options
+ *
+ * @returns EDIT_OK the options ran
+ * @returns EDIT_BAD_ARGUMENT no picture is loaded or an option is out of
+ *						range
+ * @returns EDIT_NO_MEMORY a colorband could not be allocated, the picture
+ *						may be partly edited
+ *
+ *****************************************************************************/
+edit_status edit_image::apply( const vector<pipeline_stage> &stages )
+{
+	if (!loaded() || !stages_valid( stages ))
+		return EDIT_BAD_ARGUMENT;
+
+	try
+	{
+		throw_on_failure guard;
+
+		if (wide)
+			run_pipeline( broad, stages );
+		else
+			run_pipeline( narrow, stages );
+	}
+	catch (const bad_alloc &)
+	{
+		return EDIT_NO_MEMORY;
+	}
+
+	return EDIT_OK;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs options written the way prog1 takes them, such as "-b 20 -s -c"
+ *
+ * @param[in]      options - the options
+ *
+ * @returns EDIT_BAD_ARGUMENT the options could not be read
+ * @returns the results of apply
+ *
+ *****************************************************************************/
+edit_status edit_image::apply( const string &options )
+{
+	vector<pipeline_stage> stages;
+	vector<string> words;
+	vector<char *> argv;
+	string word;
+
+	istringstream in(options);
+	while (in >> word)
+		words.push_back(word);
+
+	//parse_pipeline looks for the options between the program name and
+		//-o[ab] basename image.ppm
+	static const char *ends[] = { "prog1", "-ob", "out", "in.ppm" };
+	argv.push_back(const_cast<char *>(ends[0]));
+	for (string &item : words)
+		argv.push_back(&item[0]);
+	for (int k = 1; k < 4; k++)
+		argv.push_back(const_cast<char *>(ends[k]));
+
+	if (!parse_pipeline( int(argv.size()), argv.data(), stages ))
+		return EDIT_BAD_ARGUMENT;
+
+	return apply( stages );
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * writes the picture as a file would hold it: P3 or P6 for colour, P2 or
+ * P5 once it is grey
+ *
+ * @param[in]      ascii - writes an ascii picture rather than binary
+ * @param[out]     out - the picture, header and all
+ *
+ * @returns EDIT_OK the picture was written
+ * @returns EDIT_BAD_ARGUMENT no picture is loaded
+ * @returns EDIT_NO_MEMORY out could not grow to hold it
+ *
+ *****************************************************************************/
+edit_status edit_image::encode( bool ascii, vector<char> &out )
+{
+	out.clear();
+	if (!loaded())
+		return EDIT_BAD_ARGUMENT;
+
+	if (wide)
+		return write( broad, ascii, out );
+	return write( narrow, ascii, out );
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * writes the header and samples of a picture to memory, the way fileOutput
+ * writes them to a file
+ *
+ * @param[in][out] vars - the picture, given the magic number written
+ * @param[in]      ascii - writes an ascii picture rather than binary
+ * @param[out]     out - the picture, header and all
+ *
+ * @returns EDIT_OK the picture was written
+ * @returns EDIT_NO_MEMORY out could not grow to hold it
+ *
+ *****************************************************************************/
+template <class T>
+edit_status edit_image::write( basic_image<T> &vars, bool ascii,
+	vector<char> &out )
+{
+	bool grey = (vars.grey.data != nullptr);
+	ostringstream header;
+
+	if (ascii)
+		vars.magic_number = grey ? string("P2") : string("P3");
+	else
+		vars.magic_number = grey ? string("P5") : string("P6");
+
+	try
+	{
+		async_writer fout;
+		fout.open_memory( out );
+
+		read_out_header( vars, header );
+		fout.write( header.str() );
+		if (ascii)
+			ascii_out( vars, fout );
+		else
+			binary_out( vars, fout );
+		fout.close();
+	}
+	catch (const bad_alloc &)
+	{
+		out.clear();
+		return EDIT_NO_MEMORY;
+	}
+
+	return EDIT_OK;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * checks options made by a program rather than read by parse_pipeline
+ * against the same limits
+ *
+ * @param[in]      stages - the options
+ *
+ * @returns true every option is in range
+ * @returns false an option is not
+ *
+ *****************************************************************************/
+bool stages_valid( const vector<pipeline_stage> &stages )
+{
+	for (const pipeline_stage &stage : stages)
+	{
+		if (stage.border.mode < BORDER_KEEP ||
+			stage.border.mode > BORDER_CONSTANT || stage.border.fill < 0 ||
+			stage.border.fill > sample_traits<wide_pixel>::largest)
+			return false;
+
+		switch (stage.kind)
+		{
+		case STAGE_NEGATE:
+		case STAGE_SHARPEN:
+		case STAGE_CONTRAST:
+			break;
+
+		case STAGE_BRIGHTEN:
+			if (stage.value > 256 || stage.value < -256)
+				return false;
+			break;
+
+		case STAGE_SMOOTH:
+			if (stage.value < 1 || stage.value > MAX_RADIUS)
+				return false;
+			break;
+
+		case STAGE_GREYSCALE:
+			if (stage.value != GREY_LEGACY && stage.value != GREY_BT601 &&
+				stage.value != GREY_BT709)
+				return false;
+			break;
+
+		case STAGE_EQUALIZE:
+			if (stage.value < 1 || stage.value > MAX_CLIP)
+				return false;
+			break;
+
+		case STAGE_RESAMPLE:
+			if (stage.value != RESAMPLE_BILINEAR &&
+				stage.value != RESAMPLE_BICUBIC &&
+				stage.value != RESAMPLE_LANCZOS)
+				return false;
+			if (stage.cols < 1 || stage.cols > MAX_SIDE || stage.rows < 1 ||
+				stage.rows > MAX_SIDE)
+				return false;
+			break;
+
+		case STAGE_CONVOLVE:
+			if (!stage.kernel || !kernel_valid( *stage.kernel ))
+				return false;
+			break;
+
+		default:
+			return false;
+		}
+	}
+	return true;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives a printable explanation of a status
+ *
+ * @param[in]      status - the status
+ *
+ * @returns the explanation
+ *
+ *****************************************************************************/
+const char *edit_message( edit_status status )
+{
+	switch (status)
+	{
+	case EDIT_OK:
+		return "ok";
+	case EDIT_BAD_ARGUMENT:
+		return "bad argument or no picture loaded";
+	case EDIT_BAD_HEADER:
+		return "not a P2, P3, P5, or P6 picture";
+	case EDIT_NO_MEMORY:
+		return "memory or allocation error";
+	case EDIT_READ_ERROR:
+		return "error reading file";
+	}
+	return "unknown status";
+}
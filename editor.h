@@ -0,0 +1,96 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief this file contains the library interface to the picture editor,
+ * for programs that link it in instead of running prog1.  A picture is
+ * loaded from memory or an open file descriptor, the options are run on
+ * it, and it is written back out to memory, with every error given back
+ * as an edit_status rather than ending the program.  Different pictures
+ * may be edited on different threads at the same time.  It should be
+ * included with editor.cpp.
+ ****************************************************************************/
+#ifndef  __EDITOR__H__
+#define __EDITOR__H__
+
+#include "function.h"
+
+
+/*!
+ * @brief what an edit_image call gives back
+ */
+enum edit_status
+{
+	EDIT_OK = 0,				/*!< it worked */
+	EDIT_BAD_ARGUMENT = -1,		/*!< no data, no picture loaded, or an
+										option that is not allowed */
+	EDIT_BAD_HEADER = -2,		/*!< not a P2, P3, P5, or P6 picture, or
+										its sizes are out of range */
+	EDIT_NO_MEMORY = -3,		/*!< a colorband could not be allocated */
+	EDIT_READ_ERROR = -4		/*!< the file descriptor could not be read */
+};
+
+
+/*!
+ * @brief a picture held in memory by a program using the editor
+ *
+ * @details the picture keeps byte samples or, for a max_value past 255,
+ *				2 byte samples, the same way prog1 does.  A picture is only
+ *				used by one thread at a time, but any number of them can be
+ *				edited at once; their options take turns on the shared
+ *				thread pool.
+ */
+class edit_image
+{
+public:
+	edit_image() = default;
+	~edit_image();
+	edit_image( edit_image &&other );
+	edit_image &operator=( edit_image &&other );
+	edit_image( const edit_image & ) = delete;
+	edit_image &operator=( const edit_image & ) = delete;
+
+	edit_status load( const void *data, size_t size );
+	edit_status load_fd( int fd );
+	edit_status apply( const vector<pipeline_stage> &stages );
+	edit_status apply( const string &options );
+	edit_status encode( bool ascii, vector<char> &out );
+	void clear();
+
+	/*! @brief tells if a picture is loaded */
+	bool loaded() const { return header().rows > 0; }
+	/*! @brief rows in the picture */
+	int rows() const { return header().rows; }
+	/*! @brief columns in the picture */
+	int cols() const { return header().cols; }
+	/*! @brief the picture's max_value */
+	int max_value() const { return header().max_value; }
+	/*! @brief tells if the options have made the picture grey */
+	bool grey() const
+		{ return wide ? broad.grey.data != nullptr :
+			narrow.grey.data != nullptr; }
+
+private:
+	/*! @brief the header of whichever picture is in use */
+	const picture_header &header() const
+		{ return wide ? (const picture_header &) broad : narrow; }
+
+	template <class T>
+	edit_status fill( basic_image<T> &vars, const picture_header &head,
+		const char *body, size_t size );
+	template <class T>
+	edit_status write( basic_image<T> &vars, bool ascii, vector<char> &out );
+
+	bool wide = false;		/*!< the picture has 2 byte samples */
+	image narrow;			/*!< the picture, byte samples */
+	wide_image broad;		/*!< the picture, 2 byte samples */
+};
+
+
+/*******************************************************************************
+ *                         Function Prototypes
+ ******************************************************************************/
+const char *edit_message( edit_status status );
+bool stages_valid( const vector<pipeline_stage> &stages );
+
+
+#endif
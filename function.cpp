@@ -4,6 +4,91 @@
  * @brief All Input, Output, Allocation, and picture option functions.
  ****************************************************************************/
 #include "function.h"
+#include "kernels.h"
+#include "threadpool.h"
+#include "pipeline.h"
+#include "stats.h"
+#include "cache.h"
+#include "convolve.h"
+
+#include <filesystem>
+
+//memory mapping is only used where the system offers it
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+//amount of file data the ascii reader parses from each refill
+static const size_t FILL_BLOCK = size_t(1) << 20;
+
+//bytes kept past the parse point so a number never straddles a refill
+static const size_t ASCII_SLACK = 64;
+
+//zero bytes kept after the data so numbers can be read 4 bytes at a time
+static const size_t ASCII_PAD = 8;
+
+//numbers are read 4 digits at a time where the byte order allows it
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) \
+	|| defined(_M_IX86) || defined(_M_X64) || defined(_M_ARM64)
+#define ASCII_SWAR 1
+#endif
+
+//planes d2array_delet keeps for d2array to hand out again, see plane_recycle.
+	//They are kept as byte planes whatever samples they held
+static deque<plane> recycled;
+static atomic<size_t> recycle_limit(0);
+static mutex recycle_lock;
+
+//allocation_error throws instead of exiting on threads the library runs on
+static thread_local bool allocation_throw = false;
+
+//character classes for the ascii reader
+enum { CH_OTHER = 0, CH_SPACE = 1, CH_DIGIT = 2, CH_HASH = 3 };
+
+/*!
+ * @brief sorts every byte into a class so the reader needs one lookup per
+ *				character instead of a chain of tests
+ */
+struct ascii_table
+{
+	unsigned char type[256];	/*!< class of each character */
+
+	ascii_table()
+	{
+		for (int c = 0; c < 256; c++)
+			type[c] = isspace(c) ? CH_SPACE : isdigit(c) ? CH_DIGIT :
+				(c == '#') ? CH_HASH : CH_OTHER;
+	}
+};
+static const ascii_table ascii_class;
+
+/*!
+ * @brief the text ascii_out writes for every possible sample, so numbers
+ *				are copied out instead of divided down digit by digit
+ */
+struct sample_text
+{
+	char text[256][4];			/*!< digits then a newline */
+	unsigned char len[256];		/*!< used characters of each entry */
+
+	sample_text()
+	{
+		for (int v = 0; v < 256; v++)
+		{
+			string digits = to_string(v) + '\n';
+
+			memset(text[v], 0, 4);
+			memcpy(text[v], digits.data(), digits.size());
+			len[v] = (unsigned char) digits.size();
+		}
+	}
+};
+static const sample_text ascii_text;
 
 
 /**************************************************************************//** 
@@ -23,23 +108,17 @@
  * @param[out]	   vars.max_value - the maximum pixel value
  * 
  *****************************************************************************/
-void read_in_header(image& vars, ifstream& fin)
+void read_in_header(picture_header& vars, istream& fin)
 {
 	//reads in first string
 	fin >> vars.magic_number;
 
-	//ignors the \n so fin.peek can check for #
-	fin.ignore();
-
-	//Looks for # which determines a comment
-	if(fin.peek() == '#')
-	{
-		getline(fin, vars.comment, '\n');
-	}
-
-	//reads in the rest of the header
+	//reads in the rest of the header, comments may sit between any of it
+	header_skip(vars, fin);
 	fin >> vars.cols;
+	header_skip(vars, fin);
 	fin >> vars.rows;
+	header_skip(vars, fin);
 	fin >> vars.max_value;
 
 	//ignores the last \n found in the header for binary
@@ -49,6 +128,8 @@ void read_in_header(image& vars, ifstream& fin)
 	//cout << vars.magic_number << " " << vars.rows << " " << vars.cols
 	//	<< " " << vars.max_value << endl;
 
+	if (stats_enabled() && fin.tellg() > 0)
+		stats_read( uint64_t(fin.tellg()) );
 
 	return;
 }
@@ -57,49 +138,125 @@ void read_in_header(image& vars, ifstream& fin)
  * @author Johnathan Ackerman
  * 
  * @par Description: 
- * This array allocates a 2 demensional array and checks to make sure that
- * all parts of the array are allocated properly
+ * skips the whitespace between two header values.  Any # comments found
+ * are saved in vars.comment, one line each.
+ * 
+ * @param[in]      fin - File opened in main
+ * @param[out]     vars.comment - String that preserves the comment of the
+							picture
+ * 
+ *****************************************************************************/
+void header_skip(picture_header& vars, istream& fin)
+{
+	//holds one comment line
+	string line;
+
+	while (fin)
+	{
+		int c = fin.peek();
+
+		if (c != EOF && isspace(c))
+			fin.get();
+		else if (c == '#')
+		{
+			getline(fin, line, '\n');
+			if (!vars.comment.empty())
+				vars.comment += '\n';
+			vars.comment += line;
+		}
+		else
+			return;
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * checks that a header read by read_in_header is a picture that can be
+ * loaded: a known magic number, sizes above 0, and a max_value that fits
+ * 2 bytes
+ *
+ * @param[in]      vars - the header
+ *
+ * @returns true the header is usable
+ * @returns false it is not
+ *
+ *****************************************************************************/
+bool header_valid( const picture_header &vars )
+{
+	return (vars.magic_number == string("P2") ||
+		vars.magic_number == string("P3") ||
+		vars.magic_number == string("P5") ||
+		vars.magic_number == string("P6")) && vars.rows > 0 &&
+		vars.cols > 0 && vars.max_value > 0 &&
+		vars.max_value <= sample_traits<wide_pixel>::largest;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * This function allocates a 2 demensional array as one aligned block. Each
+ * row is padded out to a multiple of PLANE_ALIGN bytes so every row starts
+ * on a cache line, and the whole band is a single allocation instead of one
+ * per row.  T is the sample type.
  * 
  * @param[in]      rows - determins the row size of arrays
  * @param[in]      cols - determins the column size of arrays
  * 
  * @returns this_array program ran successful.
- * @returns nullptr the program fail or there was an error.  
+ * @returns this_array.data == nullptr the program fail or there was an error.
  * 
  *****************************************************************************/
-pixel **d2array (int rows, int cols)
+template <class T>
+basic_plane<T> d2array (int rows, int cols)
 {
-	//loop variables
-	int i = 0;
-	int j = 0;
-	
 	//makes sure the array is initialized to nullptr
-	pixel **this_array = nullptr;
+	basic_plane<T> this_array;
 
-	//allocates memory
-	this_array = new (nothrow) pixel * [rows];
+	//rounds each row up to the alignment boundary
+	int step = PLANE_ALIGN / int(sizeof(T));
+	int stride = (cols + step - 1) / step * step;
 
-	//checks if memory was allocated
-	if (this_array == nullptr)
-		return nullptr;
+	//refuses sizes that are negative or can not be addressed
+	if (rows < 0 || cols < 0 || stride < cols || stride > INT_MAX /
+		int(sizeof(T)))
+		return this_array;
 
-	//loops through and allocated the second part
-	for (i=0; i < rows; i++)
+	//hands back a kept plane of the same size if there is one
+	if (recycle_limit > 0)
 	{
-		this_array[i] = new (nothrow) pixel [cols];
+		lock_guard<mutex> hold(recycle_lock);
 
-		//delets all allocated memory if an error occured
-		if (this_array[i] == nullptr)
+		for (auto kept = recycled.begin(); kept != recycled.end(); ++kept)
 		{
-			for (j=0; j < rows; j++)
+			if (kept->rows == rows && kept->cols == cols * int(sizeof(T)))
 			{
-				delete [] this_array[j];
+				this_array.data = (T *) kept->data;
+				this_array.rows = rows;
+				this_array.cols = cols;
+				this_array.stride = stride;
+				recycled.erase(kept);
+				stats_plane( size_t(rows) * stride * sizeof(T), true );
+				return this_array;
 			}
-			delete [] this_array;
-			this_array = nullptr;
-			return nullptr;
 		}
 	}
+
+	//allocates memory
+	this_array.data = new (align_val_t(PLANE_ALIGN), nothrow)
+		T [size_t(rows) * stride];
+
+	//checks if memory was allocated
+	if (this_array.data == nullptr)
+		return this_array;
+
+	this_array.rows = rows;
+	this_array.cols = cols;
+	this_array.stride = stride;
+	stats_plane( size_t(rows) * stride * sizeof(T), false );
+
 	return this_array;
 }
 
@@ -107,115 +264,75 @@ pixel **d2array (int rows, int cols)
  * @author Johnathan Ackerman
  * 
  * @par Description: 
- * uses 2dallocate to allocate and error check all arrays needed for program
+ * uses 2dallocate to allocate and error check the colorband arrays.  The
+ * greyscale array is made by greyscale when an option needs it.
  * 
  * @param[in]      fin - passes in open file to be closed if there is an error
- * @param[in]      checker- a temporary hold for the option given from the
- *							command line
  * @param[out]	   vars.red - allocated color band
  * @param[out]	   vars.green - allocated color band
  * @param[out]	   vars.blue - allocated color band
- * @param[out]	   vars.grey - allocated color band
  * 
  * 
  *****************************************************************************/
-void array_maker(image &vars, ifstream &fin, string checker)
+template <class T>
+void array_maker(basic_image<T> &vars, ifstream &fin)
 {
 	// dynamicaly creates the red green and blue arrays
-	vars.red = d2array(vars.rows, vars.cols);
+	vars.red = d2array<T>(vars.rows, vars.cols);
 
-	//checks for allocation errors and closes program
-	if (vars.red == nullptr)
+	//checks for allocation errors, see allocation_error
+	if (vars.red.data == nullptr)
 	{
-		cout << "memory or allocation error red";
 		fin.close();
-		all_array_delete( vars);
-		exit(0);
+		allocation_error( vars, "memory or allocation error red" );
 	}
 
-	vars.green = d2array(vars.rows, vars.cols);
+	vars.green = d2array<T>(vars.rows, vars.cols);
 
-	if (vars.green == nullptr)
+	if (vars.green.data == nullptr)
 	{
-		cout << "memory or allocation error green";
 		fin.close();
-		all_array_delete( vars );
-		exit(0);
+		allocation_error( vars, "memory or allocation error green" );
 	}
 
 
-	vars.blue = d2array(vars.rows, vars.cols);
+	vars.blue = d2array<T>(vars.rows, vars.cols);
 
 
-	if (vars.blue == nullptr)
+	if (vars.blue.data == nullptr)
 	{
-		cout << "memory or allocation error blue";
 		fin.close();
-		all_array_delete( vars );
-		exit(0);
+		allocation_error( vars, "memory or allocation error blue" );
 	}
 
-	// allocates a greyscale array if the picture is to be outputted in grey
-						//scale
-	if (checker == string("-g") || checker == string("-c") )
-	{
-		vars.grey = d2array(vars.rows, vars.cols);
-		if (vars.grey == nullptr)
-		{
-			cout << "memory or allocation error grey";
-			all_array_delete( vars );
-			fin.close();
-			exit(0);
-		}
-	}
-	else vars.grey = nullptr;
+	vars.grey = basic_plane<T>();
 
 	return;
 }
 
-
 /**************************************************************************//** 
  * @author Johnathan Ackerman
  * 
  * @par Description: 
- * fills the clorband arrays from an ascii picture file
+ * allocates and error checks only the greyscale array, for options that
+ * start by turning the picture grey.  The colorbands are never made; the
+ * rows are turned grey as they are read.
  * 
- * @param[in]		   fin - File opened in main
- * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
- * @param[in]		   vars.cols - Amount of cols of pixels per colorband
- * @param[in][out]	   vars.red - allocated color band
- * @param[in][out]	   vars.green - allocated color band
- * @param[in][out]	   vars.blue - allocated color band
+ * @param[in]      fin - passes in open file to be closed if there is an error
+ * @param[out]	   vars.grey - allocated color band
  * 
  *****************************************************************************/
-void ascii_fill( image &vars, ifstream &fin )
+template <class T>
+void grey_maker(basic_image<T> &vars, ifstream &fin)
 {
-	//temporary hold for read in data
-	int r = 0;
-	int g = 0;
-	int b = 0;
-
-	//loop variables
-	int i = 0;
-	int j = 0;
+	vars.grey = d2array<T>(vars.rows, vars.cols);
 
-	//fill loop
-	for( i = 0; i < vars.rows; i++ )
+	if (vars.grey.data == nullptr)
 	{
-		for( j = 0; j < vars.cols; j++)
-		{
-			//uses temp to fill because fin works well with ints
-			fin >> r;
-			fin >> g;
-			fin >> b;
-
-			//type casts to pixel to fill array
-			vars.red[i][j] = (pixel)r;
-			vars.green[i][j] = (pixel)g;
-			vars.blue[i][j] = (pixel)b;
-		}
+		fin.close();
+		allocation_error( vars, "memory or allocation error grey" );
 	}
-	
+
 	return;
 }
 
@@ -223,341 +340,2183 @@ void ascii_fill( image &vars, ifstream &fin )
  * @author Johnathan Ackerman
  * 
  * @par Description: 
- * fills the clorband arrays from an binary picture file
+ * allocates and error checks the packed rgb array, for pictures kept as
+ * rgb triples.  The rows are stored the way the file holds them, and the
+ * colorbands are never made.
  * 
- * @param[in]		   fin - File opened in main
- * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
- * @param[in]		   vars.cols - Amount of cols of pixels per colorband
- * @param[in][out]	   vars.red - allocated color band
- * @param[in][out]	   vars.green - allocated color band
- * @param[in][out]	   vars.blue - allocated color band
+ * @param[in]      fin - passes in open file to be closed if there is an error
+ * @param[out]	   vars.packed - allocated rgb array, cols * 3 wide
  * 
  *****************************************************************************/
-void binary_fill( image &vars, ifstream &fin )
+template <class T>
+void packed_maker(basic_image<T> &vars, ifstream &fin)
 {
+	vars.packed = d2array<T>(vars.rows, vars.cols * 3);
 
-	//loop variables
-	int i = 0;
-	int j = 0;
-
-	//fill loops
-	for( i = 0; i < vars.rows; i++ )
+	if (vars.packed.data == nullptr)
 	{
-		for( j = 0; j < vars.cols; j++ )
-		{
-			fin.read((char*) &vars.red[i][j], sizeof(pixel));
-			//fin.ignore(); <-- attempt at fixing bugs early on
-			fin.read((char*) &vars.green[i][j], sizeof(pixel));
-			//fin.ignore();
-			fin.read((char*) &vars.blue[i][j], sizeof(pixel));
-			//fin.ignore();
-		}
+		fin.close();
+		allocation_error( vars, "memory or allocation error packed" );
 	}
-	//zipps up file
-	fin.close();
+
+	vars.grey = basic_plane<T>();
 
 	return;
 }
 
+
 /**************************************************************************//** 
  * @author Johnathan Ackerman
  * 
  * @par Description: 
- * clears all allocated array data
+ * fills the clorband arrays from an ascii picture file.  The samples are
+ * read ahead through an async_reader while the ones before are parsed.
  * 
- * @param[in]		   vars.rows - Amount of cols of pixels per colorband
+ * @param[in]		   fin - File opened in main
+ * @param[in]		   name - name of the file fin has open
+ * @param[in]		   weights - greyscale weights, if only vars.grey was
+								made
+ * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
+ * @param[in]		   vars.cols - Amount of cols of pixels per colorband
  * @param[in][out]	   vars.red - allocated color band
  * @param[in][out]	   vars.green - allocated color band
  * @param[in][out]	   vars.blue - allocated color band
- * @param[in][out]	   vars.grey - allocated color band
+ * 
+ * @returns 0 the pixels were read
+ * @returns -1 the file could not be opened or read
  * 
  *****************************************************************************/
-void all_array_delete( image &vars)
+template <class T>
+int ascii_fill( basic_image<T> &vars, ifstream &fin, const char *name,
+	grey_weights weights )
 {
-	//deletes all allocated memory
-	d2array_delet(vars.rows, vars.red);
-	d2array_delet(vars.rows, vars.blue);
-	d2array_delet(vars.rows, vars.green);
-
-	//checks if gray has been used
-	if (vars.grey != nullptr)
-		d2array_delet(vars.rows, vars.grey);
+	async_reader file;
+	if (!body_open( file, fin, name ))
+	{
+		cout << "Error opening file" << endl;
+		return -1;
+	}
 
-	return;
+	ascii_body( vars, file, weights );
+	if (file.error())
+	{
+		cout << "Error reading file" << endl;
+		return -1;
+	}
+	return 0;
 }
 
-/**************************************************************************//** 
- * @author Johnny Ackerman
- * 
- * @par Description: 
- * A detailed description of the function.  It can
- * extend to multiple lines
- * 
- * @param[in]		   rows - Amount of cols of pixels per colorband
- * @param[in][out]	   this_array - passed in colorband array
- * 
- *****************************************************************************/	
-void d2array_delet( int rows, pixel **this_array)
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * fills the clorband arrays from the samples of an ascii picture, the file
+ * or memory already open in file just past the header
+ *
+ * @param[in][out]	   file - the samples
+ * @param[in]		   weights - greyscale weights, if only vars.grey was
+								made
+ * @param[in][out]	   vars - the picture, arrays already made
+ *
+ *****************************************************************************/
+template <class T>
+void ascii_body( basic_image<T> &vars, async_reader &file,
+	grey_weights weights )
 {
 	//loop variable
-	int j = 0;
+	int i = 0;
+
+	//P2 files hold one band, P3 files hold rgb triples
+	int channels = (vars.magic_number == string("P2")) ? 1 : 3;
+	size_t row_values = size_t(vars.cols) * channels;
+
+	//one row of samples in file order
+	vector<T> row(row_values);
 
-	//deletes array starting with furthest allocation
-	for (j=0; j < rows; j++)
+	ascii_reader in;
+	ascii_open(in, file);
+
+	//fill loop
+	for( i = 0; i < vars.rows; i++ )
 	{
-		delete [] this_array[j];
-	}
-	delete [] this_array;
+		size_t got = ascii_read(in, row.data(), row_values);
 
-	//sets array back to nullptr
-	this_array = nullptr;
+		//a short file leaves the rest of the picture black
+		if (got < row_values)
+			memset(row.data() + got, 0, (row_values - got) * sizeof(T));
 
+		fill_row( vars, i, row.data(), channels, weights );
+	}
+	
 	return;
 }
 
-
 /**************************************************************************//** 
  * @author Johnathan Ackerman
  * 
  * @par Description: 
- * out puts all the header information to the top of the file
- * 
- * @param[in]      fin - File opened in main
- * @param[out]     vars.magic_number - string containing the File number that
-							determines what kind of picture the file contains
- * @param[out]     vars.rows - Amount of rows of pixels per colorband
- * @param[out]     vars.cols - Amount of cols of pixels per colorband
- * @param[out]     vars.comment - String that preserves the comment of the
-							picture
- * @param[out]	   vars.max_value - the maximum pixel value
+ * finds the lowest set bit, and the number of set bits above the highest
+ * clear bit, of a 64 bit mask
  * 
  *****************************************************************************/
-void read_out_header(image& vars, ofstream &fout)
-{	
-	//writes header to file
-	fout << vars.magic_number << '\n';
-	fout << vars.comment << '\n';
-	fout << vars.cols << ' ' << vars.rows << '\n';
-	fout << vars.max_value << '\n';
+static inline int low_bit( uint64_t mask )
+{
+#if defined(_MSC_VER)
+	unsigned long bit;
+	_BitScanForward64(&bit, mask);
+	return int(bit);
+#else
+	return __builtin_ctzll(mask);
+#endif
+}
 
-	return;
+static inline int top_ones( uint64_t mask )
+{
+	if (~mask == 0)
+		return 64;
+#if defined(_MSC_VER)
+	unsigned long bit;
+	_BitScanReverse64(&bit, ~mask);
+	return 63 - int(bit);
+#else
+	return __builtin_clzll(~mask);
+#endif
 }
 
 /**************************************************************************//** 
- * @author Johnny Ackerman
+ * @author Johnathan Ackerman
  * 
  * @par Description: 
- * out puts ascii picture file data
+ * turns len digits into their value.  Up to three digits, which is nearly
+ * every sample, are combined from one 4 byte load with a multiplier row
+ * picked by the length, so there is no loop and no branch per digit.
  * 
- * @param[in]		   fout - out put File opened in main
- * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
- * @param[in]		   vars.cols - Amount of cols of pixels per colorband
- * @param[in]		   vars.red - allocated color band
- * @param[in]		   vars.green - allocated color band
- * @param[in]		   vars.blue - allocated color band
- * @param[in]		   vars.grey - allocated color band
- * @param[in]		   vars.magic_number - determines picture type
+ * @param[in]		   p - first digit
+ * @param[in]		   len - amount of digits, at least 4 bytes are readable
+ * 
+ * @returns the value, saturated at the largest int like fin >> did
  * 
  *****************************************************************************/
-void ascii_out( image &vars, ofstream &fout )
+static inline unsigned ascii_value( const char *p, int len )
 {
-	//loop variables
-	int i = 0;
-	int j = 0;
+	//loop variable
+	int k = 0;
 
-	//checks for greyscale
-	if ( vars.magic_number == string("P2"))
+	unsigned value = 0;
+
+#ifdef ASCII_SWAR
+	//multipliers for the first three digits by number length
+	static const unsigned scale[4][3] =
+		{ { 0, 0, 0 }, { 1, 0, 0 }, { 10, 1, 0 }, { 100, 10, 1 } };
+
+	if (len <= 3)
 	{
-		//outputs greyscale
-		for( i = 0; i < vars.rows; i++ )
-		{
-			for( j = 0; j < vars.cols; j++)
-			{
-				//typecasts to int to ensure fout works correctly
-				fout << int (vars.grey[i][j]) << '\n';
-			}
-		}
+		uint32_t word;
+		memcpy(&word, p, 4);
+
+		uint32_t x = word ^ 0x30303030u;
+		const unsigned *m = scale[len];
+
+		return (x & 0xff) * m[0] + ((x >> 8) & 0xff) * m[1] +
+			((x >> 16) & 0xff) * m[2];
 	}
-	else
+#endif
+
+	//long numbers go a digit at a time
+	for (k = 0; k < len; k++)
 	{
-		//outputs other colorbands
-		for( i = 0; i < vars.rows; i++ )
-		{
-			for( j = 0; j < vars.cols; j++)
-			{
-				//typecasts to int to ensure fout works correctly
-				fout << int(vars.red[i][j]) << '\n';
-				fout << int(vars.green[i][j]) << '\n';
-				fout << int(vars.blue[i][j]) << '\n';
-			}
-		}
+		value = value * 10 + unsigned(p[k] - '0');
+		if (value > 0x7fffffffu)
+			value = 0x7fffffffu;
 	}
-
-	return;
+	return value;
 }
 
 /**************************************************************************//** 
- * @author Johnny Ackerman
+ * @author Johnathan Ackerman
  * 
  * @par Description: 
- * out puts binary picture file data
+ * parses the number that starts at p and moves p past it
  * 
- * @param[in]		   fout - out put File opened in main
- * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
- * @param[in]		   vars.cols - Amount of cols of pixels per colorband
- * @param[in]		   vars.red - allocated color band
- * @param[in]		   vars.green - allocated color band
- * @param[in]		   vars.blue - allocated color band
- * @param[in]		   vars.grey - allocated color band
- * @param[in]		   vars.magic_number - magic number that determines
-									picture type
+ * @param[in][out]	   p - first digit, left just past the number
+ * @param[in]		   stop - end of the valid bytes
+ * 
+ * @returns the value of the number
  * 
  *****************************************************************************/
-void binary_out( image &vars, ofstream &fout)
+static inline unsigned ascii_number( const char *&p, const char *stop )
 {
-	//loop variables
-	int i = 0;
-	int j = 0;
+	const char *start = p;
 
-	//checks for greyscale
-	if ( vars.magic_number == string("P5"))
-	{
-		//outputs grey 2D array
-		for( i = 0; i < vars.rows; i++ )
-		{
-			for( j = 0; j < vars.cols; j++)
-			{
-				fout.write( (char*) &vars.grey[i][j], sizeof(pixel));
-			}
-		}
-	}
-	else
-	{
-		//out puts colorband 2D arrays
-		for( i = 0; i < vars.rows; i++ )
-		{
-			for( j = 0; j < vars.cols; j++)
-			{
-				fout.write( (char*) &vars.red[i][j], sizeof(pixel));
-				//fout << '\n'; <-- trying to find error with other options
-				fout.write( (char*) &vars.green[i][j], sizeof(pixel));
-				//fout << '\n';
-				fout.write( (char*) &vars.blue[i][j], sizeof(pixel));
-				//fout << '\n';
-			}
-		}
-	}
+	while (p < stop && unsigned(*p - '0') < 10)
+		p++;
 
-	return;
+	return ascii_value(start, int(p - start));
 }
 
 /**************************************************************************//** 
  * @author Johnathan Ackerman
  * 
  * @par Description: 
- * Negates the image
+ * parses every number in a 64 byte block that holds only digits and
+ * whitespace.  The block is classified with vector compares, so where each
+ * number starts and how long it is are known before any are parsed and
+ * the parses do not wait on each other.  A number running off the end of
+ * the block is left for the next block.
  * 
- * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
- * @param[in]		   vars.cols - Amount of cols of pixels per colorband
- * @param[in]		   vars.max_value - maximum pixel value
- * @param[in][out]	   vars.red - allocated color band
- * @param[in][out]	   vars.green - allocated color band
- * @param[in][out]	   vars.blue - allocated color band
+ * @param[in]		   p - start of the block, on a number or whitespace
+ * @param[out]		   out - receives the samples
+ * @param[in][out]	   n - samples stored in out so far
+ * @param[in]		   count - samples wanted
+ * 
+ * @returns bytes used, 0 if the block needs the character by character path
  * 
  *****************************************************************************/
-void negate( image &vars )
+template <class T>
+static inline int ascii_block( const char *p, T *out, size_t &n,
+	size_t count )
 {
-	//loop variables
-	int i = 0;
-	int j = 0;
+	uint64_t digits;
+	uint64_t spaces;
 
-	//loops though and changes all pixels
-	for( i = 0; i < vars.rows; i++ )
+	scan_classes(p, digits, spaces);
+
+	//comments or stray characters go the slow way
+	if ((digits | spaces) != ~uint64_t(0))
+		return 0;
+
+	//a number touching the last byte may go on into the next block
+	int used = 64 - top_ones(digits);
+	if (used == 0)
+		return 0;
+
+	uint64_t starts = digits & ~(digits << 1);
+	if (used < 64)
+		starts &= (uint64_t(1) << used) - 1;
+
+	//kept local since stores through out could otherwise alias it
+	size_t got = n;
+
+	while (starts != 0)
 	{
-		for( j = 0; j < vars.cols; j++)
+		if (got == count)
 		{
-			//type casts 255 to pixel to ensure the currect data
-			vars.red[i][j] = (pixel)vars.max_value - vars.red[i][j];
-			vars.green[i][j] = (pixel)vars.max_value - vars.green[i][j];
-			vars.blue[i][j] = (pixel)vars.max_value - vars.blue[i][j];
+			n = got;
+			return low_bit(starts);
 		}
+
+		int s = low_bit(starts);
+		int len = low_bit(~(digits >> s));
+
+		out[got++] = T(ascii_value(p + s, len));
+		starts &= starts - 1;
 	}
-	return;
+	n = got;
+	return used;
 }
 
 /**************************************************************************//** 
  * @author Johnathan Ackerman
  * 
  * @par Description: 
- * changes image brightness
+ * gets an ascii_reader ready to read samples from an open file
  * 
- * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
- * @param[in]		   vars.cols - Amount of cols of pixels per colorband
- * @ param[in]		   vars.max_value - maximum pixel value
- * @param[in]		   value - value from command line that affects brightness
- * @param[in][out]	   vars.red - allocated color band
- * @param[in][out]	   vars.green - allocated color band
- * @param[in][out]	   vars.blue - allocated color band
+ * @param[in]		   file - the file, reading from just past the header
+ * @param[out]		   in - the reader
  * 
  *****************************************************************************/
-void brighten( image &vars, int value)
+void ascii_open( ascii_reader &in, async_reader &file )
 {
-	//loop variables
-	int i = 0;
+	in = ascii_reader();
+	in.file = &file;
+	in.buffer.resize(FILL_BLOCK + ASCII_PAD);
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * moves the unread bytes to the front of the buffer and fills the rest
+ * from the file
+ * 
+ * @param[in][out]	   in - the reader
+ * 
+ *****************************************************************************/
+static void ascii_refill( ascii_reader &in )
+{
+	size_t left = in.end - in.pos;
+	size_t room = in.buffer.size() - ASCII_PAD - left;
+
+	memmove(in.buffer.data(), in.buffer.data() + in.pos, left);
+	in.pos = 0;
+	in.end = left;
+
+	size_t got = in.file->read(in.buffer.data() + left, room);
+	in.end += got;
+
+	if (got < room)
+		in.done = true;
+
+	//zeros past the data stop every scan without a bounds test
+	memset(in.buffer.data() + in.end, 0, ASCII_PAD);
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * reads up to count samples.  Numbers are parsed straight from the buffer
+ * with a table lookup per character and no stream or locale calls.  Values
+ * are cut down to a sample the same way the old fin >> int then cast did.
+ * 
+ * @param[in][out]	   in - the reader
+ * @param[out]		   out - receives the samples
+ * @param[in]		   count - amount of samples wanted
+ * 
+ * @returns the amount of samples read, less than count at the end of the
+ *			file or at something that is not a number
+ * 
+ *****************************************************************************/
+template <class T>
+size_t ascii_read( ascii_reader &in, T *out, size_t count )
+{
+	size_t n = 0;
+	const unsigned char *type = ascii_class.type;
+
+	while (n < count)
+	{
+		//keeps enough bytes ahead that no number is cut in half
+		if (in.end - in.pos <= ASCII_SLACK && !in.done)
+			ascii_refill(in);
+
+		const char *base = in.buffer.data();
+		const char *p = base + in.pos;
+		const char *stop = base + in.end;
+		const char *safe = in.done ? stop : stop - ASCII_SLACK;
+
+		//finishes a comment that ran past the last chunk
+		if (in.in_comment)
+		{
+			const char *nl = (const char *) memchr(p, '\n', stop - p);
+			in.in_comment = (nl == nullptr);
+			p = in.in_comment ? stop : nl + 1;
+		}
+
+		while (n < count && p < safe)
+		{
+			//whole blocks of plain numbers are parsed together
+			if (p + 64 <= stop)
+			{
+				int used = ascii_block(p, out, n, count);
+				if (used > 0)
+				{
+					p += used;
+					continue;
+				}
+			}
+
+			unsigned char t = type[(unsigned char) *p];
+
+			if (t == CH_DIGIT)
+			{
+				out[n++] = T(ascii_number(p, stop));
+
+				//nearly always a single space or newline follows
+				while (type[(unsigned char) *p] == CH_SPACE)
+					p++;
+			}
+			else if (t == CH_SPACE)
+				p++;
+			else if (t == CH_HASH)
+			{
+				const char *nl = (const char *) memchr(p, '\n', stop - p);
+				if (nl == nullptr)
+				{
+					//the rest of the comment is in the next chunk
+					in.in_comment = true;
+					p = stop;
+					break;
+				}
+				p = nl + 1;
+			}
+			else
+			{
+				//anything else ends the samples
+				in.pos = p - base;
+				return n;
+			}
+		}
+		in.pos = p - base;
+
+		//stops at the end of the file
+		if (in.done && in.pos >= in.end)
+			break;
+	}
+	return n;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * fills the clorband arrays from an binary picture file.  The next blocks
+ * are read ahead through an async_reader while this one is spread out.
+ * 2 byte samples are stored most significant byte first.
+ * 
+ * @param[in]		   fin - File opened in main
+ * @param[in]		   name - name of the file fin has open
+ * @param[in]		   weights - greyscale weights, if only vars.grey was
+								made
+ * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
+ * @param[in]		   vars.cols - Amount of cols of pixels per colorband
+ * @param[in][out]	   vars.red - allocated color band
+ * @param[in][out]	   vars.green - allocated color band
+ * @param[in][out]	   vars.blue - allocated color band
+ * 
+ * @returns 0 the pixels were read
+ * @returns -1 the file could not be opened or read
+ * 
+ *****************************************************************************/
+template <class T>
+int binary_fill( basic_image<T> &vars, ifstream &fin, const char *name,
+	grey_weights weights )
+{
+	async_reader file;
+	if (!body_open( file, fin, name ))
+	{
+		cout << "Error opening file" << endl;
+		return -1;
+	}
+
+	binary_body( vars, file, weights );
+
+	//zipps up file
+	fin.close();
+
+	if (file.error())
+	{
+		cout << "Error reading file" << endl;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * fills the clorband arrays from the samples of a binary picture, the file
+ * or memory already open in file just past the header
+ *
+ * @param[in][out]	   file - the samples
+ * @param[in]		   weights - greyscale weights, if only vars.grey was
+								made
+ * @param[in][out]	   vars - the picture, arrays already made
+ *
+ *****************************************************************************/
+template <class T>
+void binary_body( basic_image<T> &vars, async_reader &file,
+	grey_weights weights )
+{
+	//loop variable
+	int i = 0;
+
+	//P5 files hold one band, P6 files hold rgb triples
+	int channels = (vars.magic_number == string("P5")) ? 1 : 3;
+	size_t row_values = size_t(vars.cols) * channels;
+
+	//holds a row that is split between two chunks, and a row of 2 byte
+		//samples turned around
+	vector<pixel> spare;
+	vector<T> row;
+
+	//fill loop
+	for( i = 0; i < vars.rows; i++ )
+	{
+		//spreads each row out into the colorbands
+		const T *src = body_samples( file, spare, row, row_values );
+
+		fill_row( vars, i, src, channels, weights );
+	}
+
+	return;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * stores one row read from a file.  Rgb triples are copied as they are
+ * into a packed picture and split into the colorbands of a planar one,
+ * and a grey row is copied into all three colours, or the row is turned
+ * grey straight away when only the greyscale array was made.
+ * 
+ * @param[in][out]	   vars - the picture
+ * @param[in]		   row - row number
+ * @param[in]		   src - the samples of the row in file order
+ * @param[in]		   channels - 3 for rgb triples, 1 for grey
+ * @param[in]		   weights - greyscale weights
+ * 
+ *****************************************************************************/
+template <class T>
+void fill_row( basic_image<T> &vars, int row, const T *src, int channels,
+	grey_weights weights )
+{
+	if (vars.packed.data != nullptr)
+	{
+		if (channels == 3)
+			memcpy(vars.packed[row], src, vars.packed.cols * sizeof(T));
+		else
+			merge_rgb(src, src, src, vars.packed[row], vars.cols);
+	}
+	else if (vars.red.data == nullptr)
+	{
+		if (channels == 3)
+			grey_packed(src, vars.grey[row], vars.cols, weights);
+		else
+			grey_row(src, src, src, vars.grey[row], vars.cols, weights);
+	}
+	else if (channels == 3)
+		split_rgb(src, vars.red[row], vars.green[row], vars.blue[row],
+			vars.cols);
+	else
+	{
+		memcpy(vars.red[row], src, vars.cols * sizeof(T));
+		memcpy(vars.green[row], src, vars.cols * sizeof(T));
+		memcpy(vars.blue[row], src, vars.cols * sizeof(T));
+	}
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * opens the file again for reading ahead, starting where fin stopped
+ * reading the header
+ * 
+ * @param[out]		   file - the reader
+ * @param[in]		   fin - File opened in main, just past the header
+ * @param[in]		   name - name of the file fin has open
+ * 
+ * @returns true the reader is open
+ * @returns false the file could not be opened again
+ * 
+ *****************************************************************************/
+bool body_open( async_reader &file, ifstream &fin, const char *name )
+{
+	streamoff offset = fin.tellg();
+
+	if (offset < 0)
+		return false;
+	return file.open( name, uint64_t(offset) );
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * gives the next row of binary samples.  A row that has arrived whole is
+ * used straight from the reader; one split between chunks, or cut off by
+ * the end of the file, is copied into spare, a short one padded with black.
+ * 
+ * @param[in][out]	   file - the reader
+ * @param[in][out]	   spare - room for a row that has to be copied
+ * @param[in]		   row_bytes - bytes in a row
+ * 
+ * @returns the row, good until the next call
+ * 
+ *****************************************************************************/
+const pixel *body_row( async_reader &file, vector<pixel> &spare,
+	size_t row_bytes )
+{
+	size_t ready = 0;
+	const char *src = file.peek( ready );
+
+	if (ready >= row_bytes)
+	{
+		file.skip( row_bytes );
+		return (const pixel *) src;
+	}
+
+	spare.resize(row_bytes);
+	size_t got = file.read((char*) spare.data(), row_bytes);
+	if (got < row_bytes)
+		memset(spare.data() + got, 0, row_bytes - got);
+
+	return spare.data();
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * gives the next row of binary samples the way body_row does, turned into
+ * samples in memory.  Byte samples are used as they are; 2 byte samples
+ * are turned around into row.
+ * 
+ * @param[in][out]	   file - the reader
+ * @param[in][out]	   spare - room for a row that has to be copied
+ * @param[in][out]	   row - room for a row of 2 byte samples
+ * @param[in]		   count - samples in a row
+ * 
+ * @returns the row, good until the next call
+ * 
+ *****************************************************************************/
+template <class T>
+const T *body_samples( async_reader &file, vector<pixel> &spare,
+	vector<T> &row, size_t count )
+{
+	const pixel *src = body_row( file, spare, count * sizeof(T) );
+
+	if constexpr (sizeof(T) == 1)
+		return src;
+
+	row.resize(count);
+	read_samples(src, row.data(), int(count));
+	return row.data();
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * reads the pixels of a picture whose header has been read, in the
+ * layout picture_layout picks.  Binary rgb of byte samples that only
+ * meets tables is mapped where the system allows it.  Options that start
+ * by turning the picture grey only get the greyscale array, filled as the
+ * rows are read; otherwise the packed array or the colorbands are made
+ * and filled.
+ * 
+ * @param[in][out]	   vars - the picture, its header already read
+ * @param[in]		   fin - the file, at the first sample
+ * @param[in]		   name - name of the file, for mapping it
+ * @param[in]		   stages - the options that will be run
+ * 
+ * @returns 0 the pixels were read
+ * @returns -1 the magic number is not a known picture type, or the file
+ *				could not be read, the arrays are freed
+ * 
+ *****************************************************************************/
+template <class T>
+int picture_fill( basic_image<T> &vars, ifstream &fin, const char *name,
+	const vector<pipeline_stage> &stages )
+{
+	//maps binary pixels when the options are only tables
+	if constexpr (sizeof(T) == 1)
+	{
+		if ( vars.magic_number == string("P6") && packed_option( stages ) &&
+			packed_fill( vars, fin, name ) )
+			return 0;
+	}
+
+	//makes arrays to store the pixel data
+	grey_weights weights = GREY_LEGACY;
+	if (grey_first( stages, weights ))
+		grey_maker( vars, fin );
+	else if (picture_layout( vars, stages ) == LAYOUT_PACKED)
+		packed_maker( vars, fin );
+	else
+		array_maker( vars, fin );
+
+	//checks if ascii picture type
+	int result = -1;
+	if ( vars.magic_number == string("P3") ||
+		vars.magic_number == string("P2") )
+		result = ascii_fill( vars, fin, name, weights );
+	//checks if binary picture type
+	else if ( vars.magic_number == string("P6") ||
+		vars.magic_number == string("P5") )
+		result = binary_fill(vars, fin, name, weights );
+	//checks if magic number was read in correctly
+	else
+		cout << "Error with magic number" << endl;
+
+	//cleans up before returning
+	if (result != 0)
+	{
+		all_array_delete( vars);
+		fin.close();
+	}
+	return result;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * tells if every option is a table, so a P6 picture can be changed where
+ * packed_fill maps it and is best not streamed
+ * 
+ * @param[in]		   stages - the options given on the command line
+ * 
+ * @returns true the options are all tables
+ * @returns false an option is not a table
+ * 
+ *****************************************************************************/
+bool packed_option( const vector<pipeline_stage> &stages )
+{
+	for (const pipeline_stage &stage : stages)
+		if (stage.kind != STAGE_NEGATE && stage.kind != STAGE_BRIGHTEN)
+			return false;
+
+	return true;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * picks the layout a picture is loaded in, the one with the fewest
+ * shuffles for the options.  A colour file holds rgb triples, so keeping
+ * them packed skips splitting them on the way in and merging them on the
+ * way out, as long as every option is as quick on packed pixels.  A grey
+ * file is one band, which the planar layout holds without copying it
+ * three ways.
+ * 
+ * @param[in]		   vars - the picture header
+ * @param[in]		   stages - the options given on the command line
+ * 
+ * @returns LAYOUT_PACKED the picture is kept as rgb triples
+ * @returns LAYOUT_PLANAR the picture is kept as colorbands
+ * 
+ *****************************************************************************/
+pixel_layout picture_layout( const picture_header &vars,
+	const vector<pipeline_stage> &stages )
+{
+	if (vars.magic_number != string("P3") &&
+		vars.magic_number != string("P6"))
+		return LAYOUT_PLANAR;
+
+	for (const pipeline_stage &stage : stages)
+		if (!packed_stage( stage.kind ))
+			return LAYOUT_PLANAR;
+
+	return LAYOUT_PACKED;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * tells if an option runs as quickly on a packed picture as on colorbands.
+ * Tables and stencils work on rgb triples as they are.  Turning the
+ * picture grey works on either, but packed triples are split again each
+ * time the colours are read, twice for a contrast, where the colorbands
+ * were split once as the file was read.  A resample or a convolution
+ * makes new colorbands, so splitting the triples as they are read costs
+ * nothing extra.
+ * 
+ * @param[in]		   kind - the option
+ * 
+ * @returns true the option is as quick packed
+ * @returns false the option is quicker on colorbands
+ * 
+ *****************************************************************************/
+bool packed_stage( stage_kind kind )
+{
+	switch (kind)
+	{
+	case STAGE_NEGATE:
+	case STAGE_BRIGHTEN:
+	case STAGE_SHARPEN:
+	case STAGE_SMOOTH:
+		return true;
+
+	case STAGE_GREYSCALE:
+	case STAGE_CONTRAST:
+	case STAGE_EQUALIZE:
+	case STAGE_RESAMPLE:
+	case STAGE_CONVOLVE:
+		return false;
+	}
+	return false;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * tells if the first option turns the picture grey, so the colorbands are
+ * never needed
+ * 
+ * @param[in]		   stages - the options given on the command line
+ * @param[out]		   weights - the weights the picture is turned grey with
+ * 
+ * @returns true the picture can be turned grey as it is read
+ * @returns false an option needs the colorbands first
+ * 
+ *****************************************************************************/
+bool grey_first( const vector<pipeline_stage> &stages,
+	grey_weights &weights )
+{
+	weights = GREY_LEGACY;
+	if (stages.empty())
+		return false;
+
+	if (stages[0].kind == STAGE_GREYSCALE)
+		weights = grey_weights(stages[0].value);
+
+	return stages[0].kind == STAGE_GREYSCALE ||
+		stages[0].kind == STAGE_CONTRAST || stages[0].kind == STAGE_EQUALIZE;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * tells if the picture written to basename, with either ending, would be
+ * the file input.  Opening the output truncates it, so the input has to
+ * be read whole first rather than mapped or streamed.
+ *
+ * @param[in]      input - name of the picture file
+ * @param[in]      basename - output name without its ending
+ *
+ * @returns true the output is the input
+ * @returns false they are different files, or the output does not exist
+ *
+ *****************************************************************************/
+bool output_is_input( const char *input, const string &basename )
+{
+	error_code failure;
+
+	if (basename.empty())
+		return false;
+	for (const char *ending : { ".ppm", ".pgm" })
+		if (std::filesystem::equivalent( input, basename + ending, failure ))
+			return true;
+	return false;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * loads a P6 picture without splitting it into colorbands.  Where the system
+ * allows it the file is memory mapped copy on write and vars.packed points
+ * straight into the mapping, so nothing is copied at all.  Otherwise, or
+ * when the output will be written over the file, the body is read into one
+ * packed plane.
+ * 
+ * @param[in]		   fin - File opened in main, just past the header
+ * @param[in]		   name - name of the file fin has open
+ * @param[in]		   vars.fileName - output basename, if already known
+ * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
+ * @param[in]		   vars.cols - Amount of cols of pixels per colorband
+ * @param[out]		   vars.packed - the picture as rgb triples
+ * @param[out]		   vars.mapping - the mapped file, if it was mapped
+ * 
+ * @returns true the picture was loaded
+ * @returns false nothing was loaded and the colorbands must be used
+ * 
+ *****************************************************************************/
+bool packed_fill( image &vars, ifstream &fin, const char *name )
+{
+	//loop variable
+	int i = 0;
+
+	size_t row_bytes = size_t(vars.cols) * 3;
+	streamoff offset = fin.tellg();
+
+	if (vars.magic_number != string("P6") || offset < 0 ||
+		int(row_bytes / 3) != vars.cols)
+		return false;
+
+#ifdef HAVE_MMAP
+	//a picture written over itself is truncated while still mapped, so
+		//it is read into memory instead
+	int fd = output_is_input( name, vars.fileName ) ? -1 :
+		open(name, O_RDONLY);
+	if (fd >= 0)
+	{
+		struct stat info;
+		void *base = MAP_FAILED;
+
+		//only maps files that really hold the whole picture
+		if (fstat(fd, &info) == 0 && size_t(info.st_size) >=
+			size_t(offset) + row_bytes * vars.rows && info.st_size > 0)
+			base = mmap(nullptr, size_t(info.st_size), PROT_READ | PROT_WRITE,
+				MAP_PRIVATE, fd, 0);
+		close(fd);
+
+		if (base != MAP_FAILED)
+		{
+			madvise(base, size_t(info.st_size), MADV_SEQUENTIAL);
+
+			vars.mapping = base;
+			vars.mapping_size = size_t(info.st_size);
+			stats_read( uint64_t(info.st_size - offset) );
+			vars.packed.data = (pixel *) base + offset;
+			vars.packed.rows = vars.rows;
+			vars.packed.cols = int(row_bytes);
+			vars.packed.stride = int(row_bytes);
+
+			fin.close();
+			return true;
+		}
+	}
+#endif
+
+	//reads the body into a packed plane when mapping is not possible
+	async_reader file;
+	if (!body_open( file, fin, name ))
+		return false;
+
+	vars.packed = d2array(vars.rows, int(row_bytes));
+	if (vars.packed.data == nullptr)
+		return false;
+
+	for( i = 0; i < vars.rows; i++ )
+	{
+		size_t got = file.read((char*) vars.packed[i], row_bytes);
+
+		//a short file leaves the rest of the picture black
+		if (got < row_bytes)
+			memset(vars.packed[i] + got, 0, row_bytes - got);
+	}
+
+	//a failed read is left to the sample path, which reports it
+	if (file.error())
+	{
+		d2array_delet( vars.packed );
+		return false;
+	}
+	fin.close();
+
+	return true;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * clears all allocated array data
+ * 
+ * @param[in]		   vars.rows - Amount of cols of pixels per colorband
+ * @param[in][out]	   vars.red - allocated color band
+ * @param[in][out]	   vars.green - allocated color band
+ * @param[in][out]	   vars.blue - allocated color band
+ * @param[in][out]	   vars.grey - allocated color band
+ * 
+ *****************************************************************************/
+template <class T>
+void all_array_delete( basic_image<T> &vars)
+{
+	//deletes all allocated memory
+	d2array_delet(vars.red);
+	d2array_delet(vars.blue);
+	d2array_delet(vars.green);
+
+	//checks if gray has been used
+	if (vars.grey.data != nullptr)
+		d2array_delet(vars.grey);
+
+	//releases packed pixels, which may be a view into the mapped file
+#ifdef HAVE_MMAP
+	if (vars.mapping != nullptr)
+	{
+		munmap(vars.mapping, vars.mapping_size);
+		vars.mapping = nullptr;
+		vars.mapping_size = 0;
+		vars.packed = basic_plane<T>();
+	}
+#endif
+	d2array_delet(vars.packed);
+
+	return;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * splits a packed picture into colorbands for the options that make new
+ * planes and read each colour on its own, and releases the packed pixels.
+ * A picture already in colorbands is left alone.
+ *
+ * @param[in][out] vars - the picture, freed if a colorband can not be
+ *						allocated
+ *
+ *****************************************************************************/
+template <class T>
+void packed_split( basic_image<T> &vars )
+{
+	if (vars.packed.data == nullptr || vars.grey.data != nullptr)
+		return;
+
+	vars.red = d2array<T>(vars.rows, vars.cols);
+	vars.green = d2array<T>(vars.rows, vars.cols);
+	vars.blue = d2array<T>(vars.rows, vars.cols);
+	if (vars.red.data == nullptr || vars.green.data == nullptr ||
+		vars.blue.data == nullptr)
+	{
+		allocation_error( vars, "memory or allocation error" );
+		return;
+	}
+
+	parallel_rows( vars.rows, vars.cols * 3 * int(sizeof(T)),
+		[&] (int first, int last)
+	{
+		//loop variable
+		int i = 0;
+
+		for (i = first; i < last; i++)
+			split_rgb(vars.packed[i], vars.red[i], vars.green[i],
+				vars.blue[i], vars.cols);
+	});
+
+	//the packed pixels may be a view into the mapped file
+	basic_image<T> packed;
+	packed.packed = vars.packed;
+	packed.mapping = vars.mapping;
+	packed.mapping_size = vars.mapping_size;
+	vars.packed = basic_plane<T>();
+	vars.mapping = nullptr;
+	vars.mapping_size = 0;
+	all_array_delete( packed );
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * handles a colorband that could not be allocated while the options run.
+ * The program prints the message, cleans up, and exits.  A thread running
+ * for the library, see allocation_throws, throws bad_alloc instead and
+ * leaves the picture to its owner.
+ *
+ * @param[in][out] vars - the picture being edited
+ * @param[in]      message - what could not be allocated
+ *
+ *****************************************************************************/
+template <class T>
+void allocation_error( basic_image<T> &vars, const char *message )
+{
+	if (allocation_throw)
+		throw bad_alloc();
+
+	cout << message;
+	all_array_delete( vars );
+	exit(0);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * makes allocation_error throw instead of exit on the calling thread
+ *
+ * @param[in]      on - throw bad_alloc from now on
+ *
+ *****************************************************************************/
+void allocation_throws( bool on )
+{
+	allocation_throw = on;
+}
+
+/**************************************************************************//** 
+ * @author Johnny Ackerman
+ * 
+ * @par Description: 
+ * frees the single block held by a colorband and resets it to empty so it
+ * is safe to delete twice.  While plane_recycle is on the block is kept
+ * for reuse instead.
+ * 
+ * @param[in][out]	   this_array - passed in colorband array
+ * 
+ *****************************************************************************/	
+template <class T>
+void d2array_delet( basic_plane<T> &this_array)
+{
+	//the block freed, if it is not kept
+	void *block = this_array.data;
+
+	if (block != nullptr)
+		stats_free( size_t(this_array.rows) * this_array.stride * sizeof(T) );
+
+	//keeps the plane for the next picture of the same size, letting the
+		//oldest kept plane go when there are too many
+	if (this_array.data != nullptr && recycle_limit > 0)
+	{
+		plane kept;
+		kept.data = (pixel *) this_array.data;
+		kept.rows = this_array.rows;
+		kept.cols = this_array.cols * int(sizeof(T));
+		kept.stride = this_array.stride * int(sizeof(T));
+
+		lock_guard<mutex> hold(recycle_lock);
+
+		recycled.push_back(kept);
+		block = nullptr;
+		if (recycled.size() > recycle_limit)
+		{
+			block = recycled.front().data;
+			recycled.pop_front();
+		}
+	}
+
+	//frees the whole band in one call
+	if (block != nullptr)
+		operator delete[] (block, align_val_t(PLANE_ALIGN));
+
+	//sets array back to nullptr
+	this_array = basic_plane<T>();
+
+	return;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * sets how many freed planes d2array_delet keeps so d2array can hand them
+ * out again, which saves allocating and faulting in fresh memory when many
+ * pictures of one size go through in a row.  0 turns keeping off and frees
+ * the planes being kept.
+ * 
+ * @param[in]      count - most planes to keep
+ * 
+ *****************************************************************************/
+void plane_recycle( size_t count )
+{
+	lock_guard<mutex> hold(recycle_lock);
+
+	recycle_limit = count;
+	while (recycled.size() > recycle_limit)
+	{
+		operator delete[] (recycled.front().data, align_val_t(PLANE_ALIGN));
+		recycled.pop_front();
+	}
+}
+
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * out puts all the header information to the top of the file
+ * 
+ * @param[in]      fin - File opened in main
+ * @param[out]     vars.magic_number - string containing the File number that
+							determines what kind of picture the file contains
+ * @param[out]     vars.rows - Amount of rows of pixels per colorband
+ * @param[out]     vars.cols - Amount of cols of pixels per colorband
+ * @param[out]     vars.comment - String that preserves the comment of the
+							picture
+ * @param[out]	   vars.max_value - the maximum pixel value
+ * 
+ *****************************************************************************/
+void read_out_header(picture_header& vars, ostream &fout)
+{	
+	//writes header to file
+	fout << vars.magic_number << '\n';
+	fout << vars.comment << '\n';
+	fout << vars.cols << ' ' << vars.rows << '\n';
+	fout << vars.max_value << '\n';
+
+	return;
+}
+
+/**************************************************************************//** 
+ * @author Johnny Ackerman
+ * 
+ * @par Description: 
+ * out puts ascii picture file data.  Rows are formatted straight into the
+ * writer's chunks, which are written out while the next ones are filled.
+ * 
+ * @param[in]		   fout - out put File opened in main
+ * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
+ * @param[in]		   vars.cols - Amount of cols of pixels per colorband
+ * @param[in]		   vars.red - allocated color band
+ * @param[in]		   vars.green - allocated color band
+ * @param[in]		   vars.blue - allocated color band
+ * @param[in]		   vars.grey - allocated color band
+ * @param[in]		   vars.magic_number - determines picture type
+ * 
+ *****************************************************************************/
+template <class T>
+void ascii_out( basic_image<T> &vars, async_writer &fout )
+{
+	//loop variable
+	int i = 0;
+
+	//checks for greyscale
+	bool grey = ( vars.magic_number == string("P2"));
+	bool packed = ( vars.packed.data != nullptr && !grey );
+	size_t row_values = size_t(vars.cols) * (grey ? 1 : 3);
+
+	//colorbands are packed into this row before they are formatted
+	vector<T> row(grey || packed ? 0 : row_values);
+
+	for( i = 0; i < vars.rows; i++ )
+	{
+		const T *src = nullptr;
+
+		if (grey)
+			src = vars.grey[i];
+		else if (packed)
+			src = vars.packed[i];
+		else
+		{
+			merge_rgb(vars.red[i], vars.green[i], vars.blue[i], row.data(),
+				vars.cols);
+			src = row.data();
+		}
+
+		//every sample has at most so many characters, formatted in place
+		char *text = fout.reserve(row_values * sample_traits<T>::digits);
+		fout.commit(ascii_format(src, row_values, text) - text);
+	}
+
+	return;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * turns samples into text, one per line.  Each sample below 256 copies 4
+ * bytes from the sample_text table and moves ahead by its real length;
+ * larger 2 byte samples are written out digit by digit.
+ * 
+ * @param[in]		   src - samples to format
+ * @param[in]		   count - amount of samples
+ * @param[out]		   dst - receives the text, room for
+ *							sample_traits<T>::digits bytes a sample
+ * 
+ * @returns the end of the text written
+ * 
+ *****************************************************************************/
+template <class T>
+char *ascii_format( const T *src, size_t count, char *dst )
+{
+	//loop variables
+	size_t j = 0;
+	int k = 0;
+
+	for( j = 0; j < count; j++ )
+	{
+		unsigned value = src[j];
+
+		if (sizeof(T) == 1 || value < 256)
+		{
+			memcpy(dst, ascii_text.text[value], 4);
+			dst += ascii_text.len[value];
+			continue;
+		}
+
+		//at least 3 digits, at most 5
+		int len = value < 1000 ? 3 : value < 10000 ? 4 : 5;
+		for( k = len - 1; k >= 0; k-- )
+		{
+			dst[k] = char('0' + value % 10);
+			value /= 10;
+		}
+		dst[len] = '\n';
+		dst += len + 1;
+	}
+	return dst;
+}
+
+/**************************************************************************//** 
+ * @author Johnny Ackerman
+ * 
+ * @par Description: 
+ * out puts binary picture file data.  Rows are packed straight into the
+ * writer's chunks, which are written out while the next ones are filled.
+ * 2 byte samples go out most significant byte first.
+ * 
+ * @param[in]		   fout - out put File opened in main
+ * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
+ * @param[in]		   vars.cols - Amount of cols of pixels per colorband
+ * @param[in]		   vars.red - allocated color band
+ * @param[in]		   vars.green - allocated color band
+ * @param[in]		   vars.blue - allocated color band
+ * @param[in]		   vars.grey - allocated color band
+ * @param[in]		   vars.magic_number - magic number that determines
+									picture type
+ * 
+ *****************************************************************************/
+template <class T>
+void binary_out( basic_image<T> &vars, async_writer &fout)
+{
+	//loop variable
+	int i = 0;
+
+	//checks for greyscale
+	bool grey = ( vars.magic_number == string("P5"));
+	size_t row_values = size_t(vars.cols) * (grey ? 1 : 3);
+	size_t row_bytes = row_values * sizeof(T);
+
+	//2 byte colorbands are packed into this row before they are turned
+		//around
+	vector<T> row(sizeof(T) == 1 || grey ? 0 : row_values);
+
+	//packed rgb is already in file order
+	if ( sizeof(T) == 1 && vars.packed.data != nullptr && !grey )
+	{
+		//a plane without padding goes out in one write
+		if (vars.packed.stride == vars.packed.cols)
+			fout.write( (char*) vars.packed.data,
+				size_t(vars.rows) * vars.packed.cols);
+		else
+			for( i = 0; i < vars.rows; i++ )
+				fout.write( (char*) vars.packed[i], vars.packed.cols);
+		return;
+	}
+
+	//each row is packed straight into the writer's chunk
+	for( i = 0; i < vars.rows; i++ )
+	{
+		pixel *dst = (pixel*) fout.reserve(row_bytes);
+
+		if (grey)
+			write_samples(vars.grey[i], dst, int(row_values));
+		else if (vars.packed.data != nullptr)
+			write_samples(vars.packed[i], dst, int(row_values));
+		else if (sizeof(T) == 1)
+			merge_rgb(vars.red[i], vars.green[i], vars.blue[i], (T*) dst,
+				vars.cols);
+		else
+		{
+			merge_rgb(vars.red[i], vars.green[i], vars.blue[i], row.data(),
+				vars.cols);
+			write_samples(row.data(), dst, int(row_values));
+		}
+
+		fout.commit(row_bytes);
+	}
+
+	return;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * makes the table that leaves every pixel as it is
+ * 
+ * @returns the identity table
+ * 
+ *****************************************************************************/
+template <class T>
+basic_lut<T> lut_identity()
+{
+	//loop variable
+	int i = 0;
+
+	basic_lut<T> lut;
+
+	for( i = 0; i < sample_traits<T>::values; i++ )
+		lut.table[i] = T(i);
+
+	return lut;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * makes the negate table, max - value
+ * 
+ * @param[in]		   max - maximum pixel value
+ * 
+ * @returns the negate table
+ * 
+ *****************************************************************************/
+template <class T>
+basic_lut<T> lut_negate( T max )
+{
+	//loop variable
+	int i = 0;
+
+	basic_lut<T> lut;
+
+	for( i = 0; i < sample_traits<T>::values; i++ )
+		lut.table[i] = T(max - i);
+
+	return lut;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * makes the brighten table, value added and kept within 0 - max_value
+ * 
+ * @param[in]		   value - value from command line that affects brightness
+ * @param[in]		   max_value - maximum pixel value
+ * 
+ * @returns the brighten table
+ * 
+ *****************************************************************************/
+template <class T>
+basic_lut<T> lut_brighten( int value, int max_value )
+{
+	//loop variable
+	int i = 0;
+
+	//temporary hold for brighten data
+	int temporary = 0;
+
+	basic_lut<T> lut;
+
+	for( i = 0; i < sample_traits<T>::values; i++ )
+	{
+		temporary = i + value;
+		if(temporary > max_value)
+			temporary = max_value;
+		if(temporary < 0)
+			temporary = 0;
+		lut.table[i] = T(temporary);
+	}
+
+	return lut;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * makes the contrast table that stretches low - high out to 0 - top.
+ * Values outside low - high do not appear in the picture and are clamped.
+ * A flat picture has nothing to stretch and comes out black, as it always
+ * has.
+ * 
+ * @param[in]		   low - smallest value in the picture
+ * @param[in]		   high - largest value in the picture
+ * @param[in]		   top - value high is stretched to, the max_value
+ * 
+ * @returns the contrast table
+ * 
+ *****************************************************************************/
+template <class T>
+basic_lut<T> lut_stretch( int low, int high, int top )
+{
+	//loop variable
+	int i = 0;
+
+	basic_lut<T> lut;
+
+	//sets scale value
+	double scale = double(top) / (high - low);
+
+	for( i = 0; i < sample_traits<T>::values; i++ )
+	{
+		if (i < low)
+			lut.table[i] = 0;
+		else if (i > high)
+			lut.table[i] = T(top);
+		else if (high == low)
+			lut.table[i] = 0;
+		else
+			lut.table[i] = T(scale * ( i - low ) + .5);
+	}
+
+	return lut;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * joins two tables into one that does first and then second
+ * 
+ * @param[in]		   first - table run first
+ * @param[in]		   second - table run on the results of first
+ * 
+ * @returns the joined table
+ * 
+ *****************************************************************************/
+template <class T>
+basic_lut<T> lut_then( const basic_lut<T> &first,
+	const basic_lut<T> &second )
+{
+	//loop variable
+	int i = 0;
+
+	basic_lut<T> lut;
+
+	for( i = 0; i < sample_traits<T>::values; i++ )
+		lut.table[i] = second.table[first.table[i]];
+
+	return lut;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * runs a table over every colorband, or the packed rgb plane
+ * 
+ * @param[in][out]	   vars.red - allocated color band
+ * @param[in][out]	   vars.green - allocated color band
+ * @param[in][out]	   vars.blue - allocated color band
+ * @param[in][out]	   vars.packed - packed rgb, used instead when allocated
+ * @param[in]		   lut - table to run
+ * 
+ *****************************************************************************/
+template <class T>
+void point_op( basic_image<T> &vars, const basic_lut<T> &lut )
+{
+	//packed pixels are changed all at once, the same as one wide band
+	if (vars.packed.data != nullptr)
+		lut_apply( vars.packed, lut );
+	else
+	{
+		lut_apply( vars.red, lut );
+		lut_apply( vars.green, lut );
+		lut_apply( vars.blue, lut );
+	}
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * replaces every pixel of one band with its entry in the table
+ * 
+ * @param[in][out]	   this_array - band to change
+ * @param[in]		   lut - table to run
+ * 
+ *****************************************************************************/
+template <class T>
+void lut_apply( basic_plane<T> &this_array, const basic_lut<T> &lut )
+{
+	//loops though and changes all pixels, a band of rows per task
+	parallel_rows( this_array.rows, this_array.cols * int(sizeof(T)),
+		[&] (int first, int last)
+	{
+		//loop variable
+		int i = 0;
+
+		for( i = first; i < last; i++ )
+			lut_row( lut.table, this_array[i], this_array[i],
+				this_array.cols );
+	});
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * Negates the image
+ * 
+ * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
+ * @param[in]		   vars.cols - Amount of cols of pixels per colorband
+ * @param[in]		   vars.max_value - maximum pixel value
+ * @param[in][out]	   vars.red - allocated color band
+ * @param[in][out]	   vars.green - allocated color band
+ * @param[in][out]	   vars.blue - allocated color band
+ * 
+ *****************************************************************************/
+template <class T>
+void negate( basic_image<T> &vars )
+{
+	//type casts the max_value to a sample to ensure the currect data
+	T max = (T)vars.max_value;
+
+	point_op( vars, lut_negate( max ) );
+	return;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * Negates one colorband, or the packed rgb plane
+ * 
+ * @param[in]		   max - maximum pixel value
+ * @param[in][out]	   this_array - band to negate
+ * 
+ *****************************************************************************/
+template <class T>
+void negate_band( basic_plane<T> &this_array, T max )
+{
+	lut_apply( this_array, lut_negate( max ) );
+	return;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * changes image brightness
+ * 
+ * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
+ * @param[in]		   vars.cols - Amount of cols of pixels per colorband
+ * @ param[in]		   vars.max_value - maximum pixel value
+ * @param[in]		   value - value from command line that affects brightness
+ * @param[in][out]	   vars.red - allocated color band
+ * @param[in][out]	   vars.green - allocated color band
+ * @param[in][out]	   vars.blue - allocated color band
+ * 
+ *****************************************************************************/
+template <class T>
+void brighten( basic_image<T> &vars, int value)
+{
+	point_op( vars, lut_brighten<T>( value, vars.max_value ) );
+
+	return;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * changes image brightness
+ * 
+ * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
+ * @param[in]		   vars.cols - Amount of cols of pixels per colorband
+ * @ param[in]		   vars.max_value - maximum pixel value
+ * @param[in]		   value - value from command line that affects brightness
+ * @param[in][out]	   this_array - colorband array passed in
+ * 
+ *****************************************************************************/
+template <class T>
+void brighten_formula( basic_plane<T> &this_array, basic_image<T> &vars,
+	int value )
+{
+	lut_apply( this_array, lut_brighten<T>( value, vars.max_value ) );
+
+	return;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * turns one row of the colour picture grey, reading the packed rgb
+ * triples or the three colorbands, whichever the picture is kept in
+ * 
+ * @param[in]		   vars - the colour picture
+ * @param[in]		   row - row number
+ * @param[out]		   grey - receives vars.cols grey pixels
+ * @param[in]		   weights - how much each colorband counts
+ * 
+ *****************************************************************************/
+template <class T>
+void colour_to_grey( const basic_image<T> &vars, int row, T *grey,
+	grey_weights weights )
+{
+	if (vars.packed.data != nullptr)
+		grey_packed( vars.packed[row], grey, vars.cols, weights );
+	else
+		grey_row( vars.red[row], vars.green[row], vars.blue[row], grey,
+			vars.cols, weights );
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * Changes image to greyscale
+ * 
+ * @param[in]		   weights - how much each colorband counts
+ * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
+ * @param[in]		   vars.cols - Amount of cols of pixels per colorband
+ * @param[in]		   vars.min - minimum value of greyscale array used in
+								contrast equation
+ * @param[in]		   vars.max - maximum value of greyscale array used in
+								contrast equation
+ * @param[in][out]	   vars.red - allocated color band
+ * @param[in][out]	   vars.green - allocated color band
+ * @param[in][out]	   vars.blue - allocated color band
+ * @param[in]		   vars.packed - packed rgb, used instead when allocated
+ * @param[in][out]	   vars.grey - allocated color band
+ * 
+ *****************************************************************************/
+template <class T>
+void greyscale(basic_image<T> &vars, grey_weights weights)
+{
+	//allocates the greyscale array if the options did not ask for it first
+	if (vars.grey.data == nullptr)
+	{
+		vars.grey = d2array<T>(vars.rows, vars.cols);
+		if (vars.grey.data == nullptr)
+			allocation_error( vars, "memory or allocation error grey" );
+	}
+
+	//loops though and sets the greyscale data, a band of rows per task
+	parallel_rows( vars.rows, vars.cols * int(sizeof(T)),
+		[&] (int first, int last)
+	{
+		//loop varaible
+		int i = 0;
+
+		for( i = first; i < last; i++ )
+			colour_to_grey( vars, i, vars.grey[i], weights );
+	});
+	return;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * Changes image to greyscale and contrasts it in one go.  The range is
+ * found from grey rows made in a small buffer, then the rows are made
+ * again and stretched before they are stored, so the greyscale array is
+ * only ever written stretched.
+ * 
+ * @param[in]		   weights - how much each colorband counts
+ * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
+ * @param[in]		   vars.cols - Amount of cols of pixels per colorband
+ * @param[out]		   vars.min - minimum value of the greyscale
+ * @param[out]		   vars.max - maximum value of the greyscale
+ * @param[in]		   vars.red - allocated color band
+ * @param[in]		   vars.green - allocated color band
+ * @param[in]		   vars.blue - allocated color band
+ * @param[in]		   vars.packed - packed rgb, used instead when allocated
+ * @param[out]		   vars.grey - allocated color band
+ * 
+ *****************************************************************************/
+template <class T>
+void grey_contrast( basic_image<T> &vars, grey_weights weights )
+{
+	//guards the min and max while bands merge their results
+	mutex merge;
+
+	vars.min = sample_traits<T>::largest;
+	vars.max = 0;
+	parallel_rows( vars.rows, vars.cols * int(sizeof(T)),
+		[&] (int first, int last)
+	{
+		//loop variable
+		int i = 0;
+
+		//one grey row, kept by each thread between bands
+		thread_local vector<T> row;
+
+		//min and max of this band alone
+		int low = sample_traits<T>::largest;
+		int high = 0;
+
+		row.resize(vars.cols);
+		for( i = first; i < last; i++ )
+		{
+			colour_to_grey( vars, i, row.data(), weights );
+			range_row( row.data(), vars.cols, low, high );
+		}
+
+		lock_guard<mutex> hold(merge);
+		vars.min = min(vars.min, low);
+		vars.max = max(vars.max, high);
+	});
+
+	if (vars.grey.data == nullptr)
+	{
+		vars.grey = d2array<T>(vars.rows, vars.cols);
+		if (vars.grey.data == nullptr)
+			allocation_error( vars, "memory or allocation error grey" );
+	}
+
+	basic_lut<T> stretch = lut_stretch<T>( vars.min, vars.max,
+		vars.max_value );
+	parallel_rows( vars.rows, vars.cols * int(sizeof(T)),
+		[&] (int first, int last)
+	{
+		//loop variable
+		int i = 0;
+
+		for( i = first; i < last; i++ )
+		{
+			colour_to_grey( vars, i, vars.grey[i], weights );
+			lut_row( stretch.table, vars.grey[i], vars.grey[i], vars.cols );
+		}
+	});
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * Sharpens the image
+ * 
+ * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
+ * @param[in]		   vars.cols - Amount of cols of pixels per colorband
+ * @param[in][out]	   vars.red - allocated color band
+ * @param[in][out]	   vars.green - allocated color band
+ * @param[in][out]	   vars.blue - allocated color band
+ * 
+ *****************************************************************************/
+template <class T>
+void sharpen( basic_image<T> &vars )
+{
+	pipeline_stage stage;
+	stage.kind = STAGE_SHARPEN;
+
+	run_pipeline( vars, vector<pipeline_stage>(1, stage) );
+	return;
+}
+
+/**************************************************************************//** 
+ * @author Johnny Ackerman
+ * 
+ * @par Description: 
+ * does the sharpen formula for the first and last pixel of a row, whose
+ * left or right neighbour is past the edge and is read the way border
+ * says
+ * 
+ * @param[in]      up - row above
+ * @param[in]      mid - row being sharpened
+ * @param[in]      down - row below
+ * @param[out]     out - receives the first and last pixel
+ * @param[in]      cols - amount of samples in a row
+ * @param[in]      top - largest value a pixel may have, the max_value
+ * @param[in]      border - what is read past the edges
+ * 
+ *****************************************************************************/
+template <pixel_layout LAYOUT, class T>
+static void sharpen_edges( const T *up, const T *mid, const T *down, T *out,
+	int cols, int top, const stencil_border &border )
+{
+	//loop variables
+	int x = 0;
+	int c = 0;
+
+	int width = cols / LAYOUT;
+
+	for (x = 0; x < width; x += max(width - 1, 1))
+	{
+		int left = border_index( x - 1, width, border.mode );
+		int right = border_index( x + 1, width, border.mode );
+
+		for (c = 0; c < LAYOUT; c++)
+		{
+			int j = x * LAYOUT + c;
+			int ans = 5 * mid[j] - up[j] - down[j] -
+				(left < 0 ? border.fill : mid[left * LAYOUT + c]) -
+				(right < 0 ? border.fill : mid[right * LAYOUT + c]);
+
+			out[j] = T(ans < 0 ? 0 : ans > top ? top : ans);
+		}
+	}
+}
+
+/**************************************************************************//** 
+ * @author Johnny Ackerman
+ * 
+ * @par Description: 
+ * does the sharpen formula, 5e - b - d - f - h kept within 0 - top, for
+ * rows first to last - 1.  With BORDER_KEEP the edge rows and columns
+ * have no full neighbourhood and keep the value they had; otherwise the
+ * neighbours past the edge are read the way border says.  Either way a
+ * row is sharpened a whole row at a time and only its two edge pixels,
+ * and the first and last row's neighbours, are looked at apart from it.
+ * LAYOUT says how far apart the pixels of one colour are, so packed rgb
+ * rows are sharpened as they are.
+ * 
+ * @param[in]      in - rows to read, first - 1 to last, or any row for
+ *						BORDER_WRAP
+ * @param[out]     out - receives rows first to last - 1
+ * @param[in]      first - first row written
+ * @param[in]      last - one past the last row written
+ * @param[in]      rows - amount of rows in the picture
+ * @param[in]      cols - amount of samples in a row
+ * @param[in]      top - largest value a pixel may have, the max_value
+ * @param[in]      border - what is read past the edges
+ * 
+ *****************************************************************************/
+template <pixel_layout LAYOUT, class T>
+void sharpen_rows( basic_window<T> in, basic_window<T> out, int first,
+	int last, int rows, int cols, int top, const stencil_border &border )
+{
+	//looping varialbe
+	int i;
+
+	//a row of the fill, read above the first row and below the last
+	vector<T> fill;
+	if (border.mode == BORDER_CONSTANT && (first == 0 || last == rows))
+		fill.assign(cols, T(border.fill));
+
+	for( i = first; i < last; i++ )
+	{
+		if (border.mode == BORDER_KEEP)
+		{
+			if (i == 0 || i == rows - 1)
+			{
+				memcpy(out[i], in[i], cols * sizeof(T));
+				continue;
+			}
+
+			//a whole row at a time, then the two edge pixels
+			sharpen_row<LAYOUT>( in[i-1], in[i], in[i+1], out[i], cols,
+				top );
+			memcpy(out[i], in[i], LAYOUT * sizeof(T));
+			memcpy(out[i] + cols - LAYOUT, in[i] + cols - LAYOUT,
+				LAYOUT * sizeof(T));
+			continue;
+		}
+
+		const T *up = border_row( in, i - 1, rows, border.mode,
+			fill.data() );
+		const T *down = border_row( in, i + 1, rows, border.mode,
+			fill.data() );
+
+		sharpen_row<LAYOUT>( up, in[i], down, out[i], cols, top );
+		sharpen_edges<LAYOUT>( up, in[i], down, out[i], cols, top, border );
+	}
+}
+
+/**************************************************************************//** 
+ * @author Johnny Ackerman
+ * 
+ * @par Description: 
+ * Smooths the image by averaging every pixel with the square of pixels
+ * within radius of it.  Pixels closer than radius to an edge are left
+ * as they were.
+ * 
+ * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
+ * @param[in]		   vars.cols - Amount of cols of pixels per colorband
+ * @param[in]		   radius - reach of the average, 1 is the 3x3 square
+ * @param[in][out]	   vars.red - allocated color band
+ * @param[in][out]	   vars.green - allocated color band
+ * @param[in][out]	   vars.blue - allocated color band
+ * 
+ *****************************************************************************/
+template <class T>
+void smooth( basic_image<T> &vars, int radius )
+{	
+	pipeline_stage stage;
+	stage.kind = STAGE_SMOOTH;
+	stage.value = radius;
+
+	run_pipeline( vars, vector<pipeline_stage>(1, stage) );
+	return;
+}
+
+/**************************************************************************//** 
+ * @author Johnny Ackerman
+ * 
+ * @par Description: 
+ * does the smooth formula for the samples of a row before left and from
+ * right on, whose boxes reach past the sides.  Each box sum adds up the
+ * column sums the way border says, a column past the edge with
+ * BORDER_CONSTANT being width fills.
+ * 
+ * @param[in]      column - sums of the box's rows for each sample
+ * @param[in]      radius - reach of the average
+ * @param[in]      divide - rounding for the box size
+ * @param[out]     out - receives the samples
+ * @param[in]      cols - amount of samples in a row
+ * @param[in]      left - first sample whose box is inside the row
+ * @param[in]      right - one past the last one
+ * @param[in]      border - what is read past the edges
+ * 
+ *****************************************************************************/
+template <pixel_layout LAYOUT, class T>
+static void smooth_edges( const typename sample_traits<T>::column_sum
+	*column, int radius, const box_divider &divide, T *out, int cols,
+	int left, int right, const stencil_border &border )
+{
+	//loop variables
 	int j = 0;
+	int k = 0;
+
+	int width = cols / LAYOUT;
+	uint32_t outside = uint32_t(border.fill) * (2 * radius + 1);
+
+	for (j = 0; j < cols; j = (j + 1 == left) ? max(right, left) : j + 1)
+	{
+		int x = j / LAYOUT;
+		int c = j % LAYOUT;
+		uint32_t sum = 0;
+
+		for (k = x - radius; k <= x + radius; k++)
+		{
+			int place = border_index( k, width, border.mode );
+			sum += (place < 0) ? outside : column[place * LAYOUT + c];
+		}
+		out[j] = box_average<T>( sum, divide );
+	}
+}
+
+/**************************************************************************//** 
+ * @author Johnny Ackerman
+ * 
+ * @par Description: 
+ * does the smooth formula for rows first to last - 1.  The box is split
+ * into a column pass and a row pass with running sums, so each pixel costs
+ * the same no matter the radius: the column sums slide down one row by
+ * adding the row entering the box and taking away the row leaving it, and
+ * each box sum across a row is the difference of two running totals of
+ * those column sums.  The sum is rounded to the nearest average with a
+ * multiply and a shift instead of a divide, giving exactly what
+ * (sum / 9.0) + .5 gave for radius 1.  With BORDER_KEEP pixels closer
+ * than radius to an edge keep the value they had.  Otherwise the rows
+ * within radius of the top and bottom add up their column sums from the
+ * rows border picks, and the samples within radius of the sides add up
+ * their box from the column sums border picks, so only the edges pay for
+ * the border.  The running totals skip LAYOUT samples at a time, one
+ * total per colour, so packed rgb rows are smoothed as they are.
+ * 
+ * @param[in]      in - rows to read, first - radius to last + radius - 1,
+ *						or any row for BORDER_WRAP
+ * @param[out]     out - receives rows first to last - 1
+ * @param[in]      first - first row written
+ * @param[in]      last - one past the last row written
+ * @param[in]      rows - amount of rows in the picture
+ * @param[in]      cols - amount of samples in a row
+ * @param[in]      radius - reach of the average
+ * @param[in]      border - what is read past the edges
+ * 
+ *****************************************************************************/
+template <pixel_layout LAYOUT, class T>
+void smooth_rows( basic_window<T> in, basic_window<T> out, int first,
+	int last, int rows, int cols, int radius, const stencil_border &border )
+{
+	//loop variables
+	int i = 0;
+	int k = 0;
+
+	int width = 2 * radius + 1;
+	bool keep = (border.mode == BORDER_KEEP);
+
+	//samples of the edge columns of one side
+	int edge = radius * LAYOUT;
+
+	//samples whose box is inside the row, none if the row is narrower
+		//than a box
+	int left = edge;
+	int right = cols - edge;
+	if (cols < width * LAYOUT)
+		left = right = cols;
+
+	//rows that get a full box, none if the picture is smaller than one
+	int top = max(first, radius);
+	int bottom = min(last, rows - radius);
+	if ((keep && left == right) || top > bottom)
+		top = bottom = last;
+
+	//edge rows keep their values
+	if (keep)
+	{
+		for( i = first; i < last; i++ )
+			if (i < top || i >= bottom)
+				memcpy(out[i], in[i], cols * sizeof(T));
+
+		if (top >= bottom)
+			return;
+	}
+
+	//rounds sum / (width * width) to the nearest whole number
+	box_divider divide = make_divider(uint32_t(width) * width,
+		sample_traits<T>::largest);
 
+	//sum of the width pixels above and below each column, at most
+		//255 * 255 times the largest sample so it fits column_sum
+	vector<typename sample_traits<T>::column_sum> column(cols, 0);
 
-	brighten_formula( vars.red, vars, value );
-	brighten_formula( vars.green, vars, value );
-	brighten_formula( vars.blue, vars, value );
+	//running totals of the column sums of each colour across the row.
+		//They wrap for 2 byte samples but a box sum, their difference,
+		//always fits
+	vector<uint32_t> prefix(cols + LAYOUT, 0);
 
-	return;
+	//a row of the fill, read above the first row and below the last
+	vector<T> fill;
+	if (border.mode == BORDER_CONSTANT && (top > first || bottom < last))
+		fill.assign(cols, T(border.fill));
+
+	for( i = first; i < last; i++ )
+	{
+		if (i < top || i >= bottom)
+		{
+			if (keep)
+				continue;
+
+			//the box reaches past the top or bottom, so its rows are the
+				//ones border picks
+			fill_n(column.begin(), cols, 0);
+			for( k = i - radius; k <= i + radius; k++ )
+				column_add<T>( column.data(), border_row( in, k, rows,
+					border.mode, fill.data() ), nullptr, cols );
+		}
+		else if (i == top)
+		{
+			//starts the column sums with the full box for the first row
+			fill_n(column.begin(), cols, 0);
+			for( k = top - radius; k <= top + radius; k++ )
+				column_add<T>( column.data(), in[k], nullptr, cols );
+		}
+		else
+		{
+			//slides the column sums down a row
+			column_add<T>( column.data(), in[i + radius],
+				in[i - radius - 1], cols );
+		}
+
+		//any box sum across the row is then the difference of two
+			//running totals
+		if (left < right)
+		{
+			prefix_row<LAYOUT, T>( column.data(), prefix.data(), cols );
+			box_row<LAYOUT>( prefix.data(), radius, divide, out[i], left,
+				right );
+		}
+
+		//edge columns keep their values or read past the sides
+		if (keep)
+		{
+			memcpy(out[i], in[i], edge * sizeof(T));
+			memcpy(out[i] + cols - edge, in[i] + cols - edge,
+				edge * sizeof(T));
+		}
+		else
+			smooth_edges<LAYOUT, T>( column.data(), radius, divide, out[i],
+				cols, left, right, border );
+	}
 }
 
 /**************************************************************************//** 
- * @author Johnathan Ackerman
+ * @author Johnny Ackerman
  * 
  * @par Description: 
- * changes image brightness
+ * finds the multiply and shift that round sum / count to the nearest
+ * whole number for every sum a box of count pixels can have.  With
+ * x = 2 * sum + count and d = 2 * count the answer is x / d rounded down,
+ * and for x below 2^bits the multiplier ceil(2^(bits + l) / d), l the
+ * bits needed for d, gives exactly that after a shift by bits + l.  The
+ * vector kernels need x and the multiplier to fit 32 bits; when they do
+ * not, which only happens for large boxes of 2 byte samples, multiply is
+ * left 0 and the sum divided the slow way.
  * 
- * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
- * @param[in]		   vars.cols - Amount of cols of pixels per colorband
- * @ param[in]		   vars.max_value - maximum pixel value
- * @param[in]		   value - value from command line that affects brightness
- * @param[in][out]	   this_array - colorband array passed in
+ * @param[in]      count - pixels in the box, an odd number
+ * @param[in]      top - largest sample in the box
+ * 
+ * @returns the divider
  * 
  *****************************************************************************/
-void brighten_formula( pixel **this_array, image &vars, int value )
+box_divider make_divider( uint32_t count, int top )
 {
-	//loop variables
-	int i = 0;
-	int j = 0;
+	box_divider divide;
 
-	//temporary hold for brighten data
-	int temporary = 0;
+	uint64_t d = 2 * uint64_t(count);
+	uint64_t largest = 2 * uint64_t(count) * uint64_t(top) + count;
 
-	//for loop that changes every pixel
-	for( i = 0; i < vars.rows; i++ )
-	{
-		for( j = 0; j < vars.cols; j++)
-		{
-			temporary = (this_array[i][j] + (value));
-			if(temporary > (vars.max_value))
-				temporary = (vars.max_value);
-			if(temporary < (0))
-				temporary = (0);
-			this_array[i][j] = (pixel)temporary;
-		}
-	}
+	int bits = 0;
+	while ((uint64_t(1) << bits) <= largest)
+		bits++;
 
-	return;
+	int l = 0;
+	while ((uint64_t(1) << l) < d)
+		l++;
+
+	divide.count = count;
+	divide.shift = bits + l;
+	divide.multiply = ((uint64_t(1) << divide.shift) + d - 1) / d;
+
+	if (bits > 32 || divide.multiply > UINT32_MAX)
+		divide.multiply = 0;
+
+	return divide;
 }
 
 /**************************************************************************//** 
  * @author Johnathan Ackerman
  * 
  * @par Description: 
- * Changes image to greyscale
+ * Contrasts the greyscale image
  * 
  * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
  * @param[in]		   vars.cols - Amount of cols of pixels per colorband
@@ -565,274 +2524,350 @@ void brighten_formula( pixel **this_array, image &vars, int value )
 								contrast equation
  * @param[in]		   vars.max - maximum value of greyscale array used in
 								contrast equation
- * @param[in][out]	   vars.red - allocated color band
- * @param[in][out]	   vars.green - allocated color band
- * @param[in][out]	   vars.blue - allocated color band
  * @param[in][out]	   vars.grey - allocated color band
  * 
  *****************************************************************************/
-void greyscale(image &vars)
+template <class T>
+void contrast(basic_image<T> &vars)
 {
-	//loop varaibles
-	int i = 0;
-	int j = 0;
+	contrast_range( vars );
 
-	//loops though and sets the greyscale data
-	for( i = 0; i < vars.rows; i++ )
-	{
-		for( j = 0; j < vars.cols; j++)
-		{
-			vars.grey[i][j] = pixel( int(.3 * double(vars.red[i][j]) + .6 *
-				double(vars.green[i][j]) + .1 * double(vars.green[i][j])));
-		}
-	}
-	return;
+	//contrast formula, scale * ( grey - min ) + .5, as one table
+	lut_apply( vars.grey, lut_stretch<T>( vars.min, vars.max,
+		vars.max_value ) );
 }
 
 /**************************************************************************//** 
  * @author Johnathan Ackerman
  * 
  * @par Description: 
- * Sharpens the image
+ * finds the smallest and largest value in the greyscale image
  * 
- * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
- * @param[in]		   vars.cols - Amount of cols of pixels per colorband
- * @param[in][out]	   vars.red - allocated color band
- * @param[in][out]	   vars.green - allocated color band
- * @param[in][out]	   vars.blue - allocated color band
+ * @param[in]		   vars.grey - allocated color band
+ * @param[out]		   vars.min - minimum value of greyscale array
+ * @param[out]		   vars.max - maximum value of greyscale array
  * 
  *****************************************************************************/
-void sharpen( image &vars )
+template <class T>
+void contrast_range(basic_image<T> &vars)
 {
-	//loop variables
-	int i = 0;
-	int j = 0;
+	basic_window<T> grey;
+	grey.data = vars.grey.data;
+	grey.stride = vars.grey.stride;
 
-	//creates temporary array
-	pixel **cpy_array;
-	cpy_array = d2array(vars.rows, vars.cols);
+	//min and max saved for contrast equation
+	vars.min = sample_traits<T>::largest;
+	vars.max = 0;
+	window_range( grey, 0, vars.rows, vars.cols, vars.min, vars.max );
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * widens low - high to take in rows first to last - 1 of a greyscale band.
+ * Each band of rows finds its own range with vector min and max, and the
+ * bands merge their results at the end.
+ * 
+ * @param[in]		   grey - the greyscale rows
+ * @param[in]		   first - first row to look at
+ * @param[in]		   last - one past the last row to look at
+ * @param[in]		   cols - Amount of cols of pixels per row
+ * @param[in][out]	   low - smallest value seen so far
+ * @param[in][out]	   high - largest value seen so far
+ * 
+ *****************************************************************************/
+template <class T>
+void window_range( basic_window<T> grey, int first, int last, int cols,
+	int &low, int &high )
+{
+	//guards the min and max while bands merge their results
+	mutex merge;
 
-	//checks if array was made
-	if (cpy_array == nullptr)
+	parallel_rows( last - first, cols * int(sizeof(T)),
+		[&] (int top, int bottom)
 	{
-		//deallocates all memory
-		cout << "memory or allocation error";
-		all_array_delete( vars);
-		exit(0);
-	}
+		//loop variable
+		int i;
 
-	//runs smoothing formula
-	sub_trac( vars.red, vars.rows, vars.cols, cpy_array);
-	sub_trac( vars.green, vars.rows, vars.cols, cpy_array);
-	sub_trac( vars.blue, vars.rows, vars.cols, cpy_array);
+		//min and max of this band alone
+		int band_low = sample_traits<T>::largest;
+		int band_high = 0;
 
-	//deallocates temporary array
-	d2array_delet( vars.rows, cpy_array);
-	
-	return;
+		for( i = first + top; i < first + bottom; i++ )
+			range_row( grey[i], cols, band_low, band_high );
+
+		lock_guard<mutex> hold(merge);
+		low = min(low, band_low);
+		high = max(high, band_high);
+	});
 }
 
 /**************************************************************************//** 
- * @author Johnny Ackerman
+ * @author Johnathan Ackerman
  * 
  * @par Description: 
- * does the sharpen formula to any array pased into the function
+ * gives the first row or column of a tile
+ * 
+ * @param[in]		   tile - number of the tile, tiles for the far edge
+ * @param[in]		   tiles - amount of tiles
+ * @param[in]		   total - rows or columns in the picture
  * 
- * @param[in]      rows - amount of rows in array
- * @param[in]      cols - amount of rows in array
- * @param[in]	   cpy_array - a temporary array to stop data from being
-							affected
- * @param[in,out]  this_array - passed in colorband that will be changed
+ * @returns the first row or column
  * 
  *****************************************************************************/
-void sub_trac( pixel **&this_array, int rows, int cols, pixel **&cpy_array)
+static inline int tile_edge( int tile, int tiles, int total )
 {
-	//looping varialbes
-	int i;
-	int j;
-	int b, d, e, f, h;
+	return int((long long) tile * total / tiles);
+}
 
-	//temporary holding value
-	int ans = 0;
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * finds the two tile centers a row or column sits between and how far it
+ * is from the first toward the second.  Past the outer centers only the
+ * outer tile is used.
+ * 
+ * @param[in]		   pos - the row or column
+ * @param[in]		   tiles - amount of tiles
+ * @param[in]		   total - rows or columns in the picture
+ * @param[out]		   first - tile before pos, the other is first + 1
+ * @param[out]		   weight - share of the other tile, out of 256
+ * 
+ *****************************************************************************/
+static void tile_blend( int pos, int tiles, int total, int &first,
+	int &weight )
+{
+	//loop variable
+	int t = 0;
 
-	
+	//centers are kept doubled so they stay whole numbers
+	int twice = 2 * pos;
 
-	//computes data storing into the cpy_array as to not affect other data
-	for( i = 1; i < rows-1; i++ )
+	first = 0;
+	weight = 0;
+	for (t = 0; t + 1 < tiles; t++)
 	{
-		for( j = 1; j < cols-1; j++)
-		{
-			// turns the edge pixels to 0 as to not affect the formula
-			
-			//sharpening formula
-				b = this_array[i-1][j];
-				d = this_array[i][j-1];
-				e = this_array[i][j];
-				f = this_array[i][j+1];
-				h = this_array[i+1][j];
-				ans = ((5 * e) - b - d - f - h);
+		int here = tile_edge(t, tiles, total) +
+			tile_edge(t + 1, tiles, total) - 1;
+		int next = tile_edge(t + 1, tiles, total) +
+			tile_edge(t + 2, tiles, total) - 1;
 
-				//makes sure no variables are out of bounds
-				if( ans > 255 )
-					ans = 255;
-				if( ans < 0 )
-					ans = 0;
+		if (twice < here)
+			return;
 
-				cpy_array[i][j] = pixel(ans);
-			
+		first = t;
+		if (twice < next)
+		{
+			weight = ((twice - here) * 256 + (next - here) / 2) /
+				(next - here);
+			return;
 		}
 	}
-	//puts copied data back into colorband array
-	
-	swap(this_array, cpy_array);
-	return;
+	first = tiles - 1;
 }
 
 /**************************************************************************//** 
- * @author Johnny Ackerman
+ * @author Johnathan Ackerman
  * 
  * @par Description: 
- * does the smooth formula to any array pased into the function
+ * cuts a picture into tiles for adaptive equalization and clears their
+ * counts.  Small pictures get fewer tiles so none is empty.
  * 
- * @param[in]      rows - amount of rows in array
- * @param[in]      cols - amount of rows in array
- * @param[in,out]  this_array - passed in colorband that will be changed
+ * @param[out]		   grid - the tiles
+ * @param[in]		   rows - Amount of rows of pixels
+ * @param[in]		   cols - Amount of cols of pixels
+ * @param[in]		   top - largest value, the max_value
  * 
  *****************************************************************************/
-void smooth( pixel **&this_array, image vars)
-{	
-	//looping variable
-	int I = 0;
-	int J = 0;
+template <class T>
+void tile_setup( tile_grid<T> &grid, int rows, int cols, int top )
+{
+	//loop variable
+	int j = 0;
 
-	//creates temporary array
-	pixel **cpy_array;
-	cpy_array = d2array(vars.rows, vars.cols);
-	if (cpy_array == nullptr)
-	{
-		cout << "memory or allocation error";
-		all_array_delete( vars);
-		exit(0);
-	}
+	grid.rows = rows;
+	grid.cols = cols;
+	grid.across = max(1, min(EQUALIZE_TILES, cols));
+	grid.down = max(1, min(EQUALIZE_TILES, rows));
+	grid.top = min(top, sample_traits<T>::largest);
 
-	//initializes diffrent possitions in the array for the formula
-	double a = 0; //unsigned long to typecast the rest
-							//to unsigned long to avoid loss of data
-	pixel b, c, d, f, g, h, i, j;
+	size_t tiles = size_t(grid.across) * grid.down;
+	grid.counts.assign(tiles * (grid.top + 1), 0);
+	grid.tables.assign(tiles * sample_traits<T>::values, T(0));
 
-	//holds final answer before puting into array
-	double ans = 0;
+	grid.left.resize(max(cols, 0));
+	grid.weight.resize(max(cols, 0));
+	for (j = 0; j < cols; j++)
+		tile_blend( j, grid.across, cols, grid.left[j], grid.weight[j] );
+}
 
-	//fills cpy_array with this_array data
-	for( I = 0; I < vars.rows; I++ )
-	{
-		for( J = 0; J < vars.cols; J++)
-		{
-			cpy_array[I][J] = this_array[I][J];
-		}
-	}
-	
-	//loops though the entire array to change every pixel
-	for( I = 1; I < vars.rows -1; I++ )
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * adds rows first to last - 1 of a greyscale band to the counts of the
+ * tiles they fall in.  Every tile counts on its own thread, so no two
+ * threads touch the same counts.
+ * 
+ * @param[in][out]	   grid - the tiles
+ * @param[in]		   grey - the greyscale rows
+ * @param[in]		   first - first row to count
+ * @param[in]		   last - one past the last row to count
+ * 
+ *****************************************************************************/
+template <class T>
+void tile_count( tile_grid<T> &grid, basic_window<T> grey, int first,
+	int last )
+{
+	int bins = grid.top + 1;
+
+	shared_pool().run( grid.across * grid.down, [&] (int tile)
 	{
-		for( J = 1; J < vars.cols -1; J++)
+		//loop variables
+		int i;
+		int j;
+
+		int down = tile / grid.across;
+		int across = tile % grid.across;
+		int top = max(first, tile_edge(down, grid.down, grid.rows));
+		int bottom = min(last, tile_edge(down + 1, grid.down, grid.rows));
+		int left = tile_edge(across, grid.across, grid.cols);
+		int right = tile_edge(across + 1, grid.across, grid.cols);
+		uint32_t *counts = grid.counts.data() + size_t(tile) * bins;
+
+		for (i = top; i < bottom; i++)
 		{
-			//changes edge pixels to 0 to avoid breaking the formula
-			if( (I == 0) || (J == 0) || (I == vars.rows-1) || (J == vars.cols-1))
-				this_array[I][J] = (0);
+			const T *row = grey[i];
 
-			//smoothing formula
-			else
-			{
-				//sets all points to their determined variable
-				a = cpy_array[I-1][J-1];
-				b = cpy_array[I-1][J];
-				c = cpy_array[I-1][J+1];
-				d = cpy_array[I][J-1];
-				j = cpy_array[I][J];
-				f = cpy_array[I][J+1];
-				g = cpy_array[I+1][J-1];
-				h = cpy_array[I+1][J];
-				i = cpy_array[I+1][J+1];
-
-				//actual formula
-				ans = ((a + b + c + d + j + f + g + h + i) / 9.0) + .5;
-
-			//makes sure the answer doesn't go above the maximum pixel value
-	//			while( ans > vars.max_value )
-		//			ans = ans - vars.max_value;
-				if( ans > 255 )
-					ans = 255;
-				if( ans < 0 )
-					ans = 0;
-				//stores answer in temporary array so that the rest of the
-					//data isn't effected
-				this_array[I][J] = pixel(ans);
-			}
+			//values past max_value are counted as max_value
+			for (j = left; j < right; j++)
+				counts[min(int(row[j]), grid.top)]++;
 		}
-	}
-	
-
-	//checked if the loop was run correctly
-	//cout << "ending loop vals " << I << " " << J << " ";
-
-	//deletes temporary array
-	d2array_delet( vars.rows,  cpy_array);
-
-	return;
+	});
 }
 
-
 /**************************************************************************//** 
  * @author Johnathan Ackerman
  * 
  * @par Description: 
- * Contrasts the greyscale image
+ * turns the counts of each tile into its equalizing table.  Counts past
+ * clip times the average are cut down and what was cut is handed back to
+ * every value evenly, which keeps flat areas from being stretched into
+ * noise.  The table then maps each value to how many pixels of the tile
+ * are at or below it, scaled to 0 - top.  The counts are worked with times
+ * the number of values, so the average is a whole number even for 2 byte
+ * samples, where most values are never seen.
  * 
- * @param[in]  	       vars.rows - Amount of rows of pixels per colorband
- * @param[in]		   vars.cols - Amount of cols of pixels per colorband
- * @param[in]		   vars.min - minimum value of greyscale array used in
-								contrast equation
- * @param[in]		   vars.max - maximum value of greyscale array used in
-								contrast equation
- * @param[in][out]	   vars.grey - allocated color band
+ * @param[in][out]	   grid - the tiles, gets their tables
+ * @param[in]		   clip - largest count as a multiple of the average
  * 
  *****************************************************************************/
-void contrast(image &vars)
+template <class T>
+void tile_tables( tile_grid<T> &grid, int clip )
 {
-	//loop variables
-	int i;
-	int j;
+	int bins = grid.top + 1;
 
-	//min and max saved for contrast equation
-	vars.min = 255;
-	vars.max = 0;
-	for( i = 0; i < vars.rows; i++ )
+	shared_pool().run( grid.across * grid.down, [&] (int tile)
 	{
-		for( j = 0; j < vars.cols; j++)
+		//loop variable
+		int v;
+
+		int down = tile / grid.across;
+		int across = tile % grid.across;
+		const uint32_t *counts = grid.counts.data() + size_t(tile) * bins;
+		T *table = grid.tables.data() + size_t(tile) *
+			sample_traits<T>::values;
+
+		uint64_t pixels = uint64_t
+			(tile_edge(down + 1, grid.down, grid.rows) -
+			tile_edge(down, grid.down, grid.rows)) *
+			(tile_edge(across + 1, grid.across, grid.cols) -
+			tile_edge(across, grid.across, grid.cols));
+		uint64_t total = pixels * bins;
+		uint64_t limit = uint64_t(clip) * pixels;
+		uint64_t excess = 0;
+
+		for (v = 0; v < bins; v++)
+			if (uint64_t(counts[v]) * bins > limit)
+				excess += uint64_t(counts[v]) * bins - limit;
+
+		//the cut counts go back evenly, the rest one at a time spread out
+		uint64_t each = excess / bins;
+		uint64_t rest = excess % bins;
+		uint64_t step = rest ? max(uint64_t(bins) / rest, uint64_t(1)) :
+			uint64_t(bins);
+
+		uint64_t sum = 0;
+		for (v = 0; v < bins; v++)
 		{
-			//keeps track of greyscale min and max
-			if ( vars.min > (int)vars.grey[i][j])
-				vars.min = (int)vars.grey[i][j];
-			if (vars.max < (int)vars.grey[i][j] )
-				vars.max = (int)vars.grey[i][j];
+			sum += min(uint64_t(counts[v]) * bins, limit) + each;
+			if (v % step == 0 && v / step < rest)
+				sum++;
+			table[v] = T((sum * grid.top + total / 2) / total);
 		}
-	}
-
+		for ( ; v < sample_traits<T>::values; v++)
+			table[v] = T(grid.top);
+	});
+}
 
-	//initilizes scale
-	double scale = 0;
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * equalizes rows first to last - 1 of a greyscale band.  Each pixel is
+ * looked up in the tables of the four tile centers around it and the four
+ * results are blended by how close it is to each center, in fixed point.
+ * 
+ * @param[in]		   grid - the tiles and their tables
+ * @param[in]		   in - rows to read
+ * @param[out]		   out - receives the equalized rows
+ * @param[in]		   first - first row to make
+ * @param[in]		   last - one past the last row to make
+ * 
+ *****************************************************************************/
+template <class T>
+void equalize_rows( const tile_grid<T> &grid, basic_window<T> in,
+	basic_window<T> out, int first, int last )
+{
+	//loop variables
+	int i = 0;
+	int j = 0;
 
-	//sets scale value
-	scale = 255.0 / (vars.max - vars.min);
+	const size_t values = sample_traits<T>::values;
 
-	//loops though all pixels in the greyscale array
-	for( i = 0; i < vars.rows; i++ )
+	for (i = first; i < last; i++)
 	{
-		for( j = 0; j < vars.cols; j++)
+		int up = 0;
+		int share = 0;
+
+		tile_blend( i, grid.down, grid.rows, up, share );
+
+		uint32_t below_weight = uint32_t(share);
+		uint32_t above_weight = 256 - below_weight;
+		const T *above = grid.tables.data() + size_t(up) * grid.across *
+			values;
+		const T *below = grid.tables.data() + size_t(min(up + 1,
+			grid.down - 1)) * grid.across * values;
+		const T *src = in[i];
+		T *dst = out[i];
+
+		for (j = 0; j < grid.cols; j++)
 		{
-			//contrast formula
-			vars.grey[i][j] = pixel(scale * ( vars.grey [i][j] - vars.min ) + .5);
+			size_t left = size_t(grid.left[j]) * values + src[j];
+			size_t right = size_t(min(grid.left[j] + 1, grid.across - 1)) *
+				values + src[j];
+			uint32_t right_weight = uint32_t(grid.weight[j]);
+			uint32_t left_weight = 256 - right_weight;
+
+			//at most 65535 * 65536, so it fits 32 bits
+			uint32_t a = above[left] * left_weight +
+				above[right] * right_weight;
+			uint32_t b = below[left] * left_weight +
+				below[right] * right_weight;
+
+			dst[j] = T((a * above_weight + b * below_weight + 32768) >> 16);
 		}
 	}
 }
@@ -846,175 +2881,386 @@ void contrast(image &vars)
  *****************************************************************************/
 void commandStatement()
 {
-	cout << "Usage: prog1.exe [option] -o[ab] basename image.ppm" << endl;
+	cout << "Usage: prog1.exe [-j N] [-l] [-m N] [--stats[=json]] [--cache "
+		"folder [--cache-size MB]] [option ...] -o[ab] basename image.ppm"
+		<< endl;
+	cout << "-j N = run the options on N threads, one per processor if not "
+		"given" << endl;
+	cout << "-l = streaming mode, edits the picture a band of rows at a time "
+		"for pictures too large for memory" << endl;
+	cout << "-m N = also writes N smaller levels of the edited picture, each "
+		"half the size of the one before down to 1 by 1, as basename_1 and "
+		"on; not with -l" << endl;
+	cout << "--stats = prints the time, bytes, and memory each stage took "
+		"when done, as json lines with --stats=json" << endl;
+	cout << "--cache folder = keeps the edited pictures in folder and copies "
+		"them from it when the same picture is edited the same way again, "
+		"removing the ones used longest ago past --cache-size megabytes, "
+		<< CACHE_MEGABYTES << " if not given" << endl;
 	cout << "[option] The option changes the picture depending on the " <<
 		" option code: (-n) = Negate, (-b #) = Brighten, (-p) = Sharpen" <<
-		", (-s) = smooth, (-g) = Greyscale, and (-c) = Contrast." << endl;
+		", (-s [#]) = smooth over a radius of 1 or #, (-g [601|709]) = " <<
+		"Greyscale with the old weights or BT.601 or BT.709 ones, " <<
+		"(-c) = Contrast, (-e [#]) = adaptive equalize by tiles, counts "
+		"clipped at 3 or # times the average, and (-r cols rows "
+		"[bilinear|bicubic|lanczos]) = resample to cols by rows, Lanczos "
+		"if no filter is given, and (-k kernel) = convolve with a kernel "
+		"such as 1,2,1;2,4,2;1,2,1/16, rows split by ; and the divisor "
+		"after /, or @file holding one; -r and -k not with -l.  Several "
+		"options run in the order given, for example -b 20 -s -p -c."
+		<< endl;
+	cout << "--border keep|clamp|mirror|wrap|constant [#] = what the -p, -s, "
+		"and -k after it read past the edges: the edges keep their values "
+		"if not given, or the edge pixel repeats, the picture reflects or "
+		"repeats, or every pixel past the edge is # or 0; wrap not with -l"
+		<< endl;
 	cout << "-o[ab] = the option to output ascii or binary" << endl;
 	cout << "basename = the new name for the file" << endl;
-	cout << "image.ppm = the name of the file given to the program" << endl;
+	cout << "image.ppm = the name of the file given to the program, or "
+		"@list.txt or a pattern such as \"in/*.ppm\" to edit many pictures, "
+		"basename is then the folder they are written to" << endl;
 }
 
 /**************************************************************************//** 
  * @author Johnathan Ackerman
  * 
  * @par Description: 
- * outputs the file in binary or ascii
+ * outputs the file in binary or ascii, cleaning up and exiting the program
+ * if it can not be written
  * 
  * @param[in]  	       checker - used to test different commandline aurguments
  * @param[in]		   vars - structure of variables passed to inner functions
- * @param[in]		   argv - commandline aurgments that checker uses
  * 
  *****************************************************************************/
-void fileOutput( string &checker, image &vars, char *argv[])
+template <class T>
+void fileOutput( string &checker, basic_image<T> &vars )
 {
-	std::ofstream fout;
+	int result = picture_write( checker, vars );
 
+	if (result == 0)
+		return;
 
-	//-oa value means output in ascii
-	if( checker == string("-oa") )
-	{
-
-		//opens ascii output file
-		fout.open(vars.fileName);
-		if (!fout)
-		{
-			//cleans up and exits
-			cout << "Error opening output file";
-			all_array_delete( vars );
-			exit(-1);
-		}
-		
-		//sets magic number for picture type
-		vars.magic_number = string("P3");
+	//shows the usage if an output file was undetected
+	if (result == -2)
+		commandStatement();
 
-		//sets checker to picture option
-		checker = argv[1];
+	//cleans up and exits
+	all_array_delete( vars );
+	exit(result);
+}
 
-		//resets magic_number to a greyscale number if needed
-		if ( checker == string("-g") || checker == string("-c") )
-			vars.magic_number = string("P2");
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * writes the picture to vars.fileName in binary or ascii, P3/P6 for colour
+ * and P2/P5 once it is grey.  Nothing is freed, so a batch can count a
+ * picture that could not be written and go on to the next.
+ * 
+ * @param[in]  	       checker - -oa or -ob
+ * @param[in]		   vars - the picture, its magic_number set to the
+ *						format written
+ * 
+ * @returns 0 the picture was written
+ * @returns -1 the file could not be opened or written
+ * @returns -2 checker is not an output option
+ * 
+ *****************************************************************************/
+template <class T>
+int picture_write( const string &checker, basic_image<T> &vars )
+{
+	async_writer fout;
 
-		//reads out all data
-		read_out_header(vars, fout);
-		ascii_out( vars, fout);
-	}
+	//the header is formatted first, then written ahead of the pixels
+	ostringstream header;
 
-	//looks for binaray output option
-	else if( checker == string("-ob") )
-	{
-		//opens output file in binary
-		fout.open(vars.fileName, ios::out | ios::binary);
-		if (!fout)
-		{
-			//cleans up and exits if failed
-			cout << "Error opening output file";
-			all_array_delete( vars );
-			exit(-1);
-		}
+	bool ascii = (checker == string("-oa"));
+	bool grey = (vars.grey.data != nullptr);
 
-		//sets magic_number to binary file
-		vars.magic_number = string("P6");
+	if (!ascii && checker != string("-ob"))
+		return -2;
 
-		//sets checker to option
-		checker = argv[1];
+	//opens output file
+	fout.open(vars.fileName.c_str());
+	if (!fout.is_open())
+	{
+		cout << "Error opening output file " << vars.fileName << endl;
+		return -1;
+	}
 
-		//sets magic number to binary greyscale if needed
-		if ( checker == string("-g") || checker == string("-c") )
-			vars.magic_number = string("P5");
+	//sets magic number for picture type, a greyscale one if needed
+	if (ascii)
+		vars.magic_number = grey ? string("P2") : string("P3");
+	else
+		vars.magic_number = grey ? string("P5") : string("P6");
 
-		//reads out all data
-		read_out_header(vars, fout);
-		binary_out( vars, fout );
-	}
+	//reads out all data
+	read_out_header(vars, header);
+	fout.write(header.str());
+	if (ascii)
+		ascii_out( vars, fout );
 	else
+		binary_out( vars, fout );
+
+	//closes output file once every write has finished
+	if (!fout.close())
 	{
-		//cleans up and exits if an output file was undetected
-		commandStatement();
-		all_array_delete( vars );
-		exit(-2);
+		cout << "Error writing output file " << vars.fileName << endl;
+		return -1;
 	}
-
-	//closes output file
-	fout.close();
+	return 0;
 }
 
-void runOption( string &checker, image &vars, char *argv[], int argc, int &val)
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * reads the options between the program name and -o[ab] into a list of
+ * stages.  -b takes a value, -s takes a radius only when the next
+ * aurgument is a number.  --border is not a stage of its own, it sets the
+ * border of the -p, -s, and -k after it.
+ * 
+ * @param[in]		   argc - amount of aurguments in argv
+ * @param[in]		   argv - commandline aurguments
+ * @param[out]		   stages - the options in the order given
+ * 
+ * @returns true every option was understood
+ * @returns false an option was unknown or its value out of range
+ * 
+ *****************************************************************************/
+bool parse_pipeline( int argc, char *argv[], vector<pipeline_stage> &stages )
 {
-	//checks if file ending needs to be changed for greyscale options
-	checker = argv[1];
-	if (checker == string("-g") || checker == string("-c"))
-		vars.fileName = vars.fileName.append(".pgm");
-	else
-		vars.fileName = vars.fileName.append(".ppm");
+	//loop variable
+	int k = 0;
 
-	//checks for options
-	if (argc == 5)
-	{
-		//sets checker to commandline option
-		checker = argv[1];
+	//options sit before -o[ab] basename image.ppm
+	int end = argc - 3;
 
-		
+	string checker = "";
 
-		//checked if option loop was entered
-		//cout << "an option was detected";
-	
-		//determines what option to run
-		if (checker == string("-n"))
-			negate( vars );
-		else if (checker == string("-p"))
-			sharpen( vars );
-		else if (checker == string("-s"))
+	//border of the stencils, until --border gives another
+	stencil_border border;
+
+	stages.clear();
+	for (k = 1; k < end; k++)
+	{
+		pipeline_stage stage;
+		checker = argv[k];
+
+		if (checker == string("--border") && k + 1 < end)
 		{
-			smooth ( vars.red, vars );
-			smooth ( vars.blue, vars );
-			smooth ( vars.green, vars );
+			//the border names, in border_mode order
+			const char *names[] = { "keep", "clamp", "mirror", "wrap",
+				"constant" };
+			string name = argv[++k];
+
+			border = stencil_border();
+			while (border.mode <= BORDER_CONSTANT &&
+				name != names[border.mode])
+				border.mode = border_mode(border.mode + 1);
+			if (border.mode > BORDER_CONSTANT)
+				return false;
+
+			//a constant border can be given its fill
+			if (border.mode == BORDER_CONSTANT && k + 1 < end &&
+				isdigit((unsigned char) argv[k + 1][0]))
+			{
+				border.fill = atoi(argv[++k]);
+				if (border.fill > sample_traits<wide_pixel>::largest)
+					return false;
+			}
+			continue;
 		}
+		else if (checker == string("-n"))
+			stage.kind = STAGE_NEGATE;
+		else if (checker == string("-p"))
+			stage.kind = STAGE_SHARPEN;
 		else if (checker == string("-g"))
 		{
-			greyscale( vars);
-
+			//greyscale can be given a weight set
+			stage.kind = STAGE_GREYSCALE;
+			stage.value = GREY_LEGACY;
+			if (k + 1 < end && isdigit((unsigned char) argv[k + 1][0]))
+			{
+				stage.value = atoi(argv[++k]);
+				if (stage.value != GREY_BT601 && stage.value != GREY_BT709)
+					return false;
+			}
 		}
 		else if (checker == string("-c"))
+			stage.kind = STAGE_CONTRAST;
+		else if (checker == string("-b") && k + 1 < end)
 		{
-			greyscale(vars);
-			contrast( vars);
+			//checks the brightness value
+			stage.kind = STAGE_BRIGHTEN;
+			stage.value = atoi(argv[++k]);
+			if (stage.value > 256 || stage.value < -256)
+				return false;
 		}
-		else
+		else if (checker == string("-e"))
 		{
-			//cleans up program if invalid option
-			commandStatement();
-			all_array_delete( vars);
-			exit(-2);
+			//equalize can be given a clip limit
+			stage.kind = STAGE_EQUALIZE;
+			stage.value = EQUALIZE_CLIP;
+			if (k + 1 < end && isdigit((unsigned char) argv[k + 1][0]))
+			{
+				stage.value = atoi(argv[++k]);
+				if (stage.value < 1 || stage.value > MAX_CLIP)
+					return false;
+			}
 		}
-	}
-
-	//looks at command aurgements
-	if (argc == 6)
-	{
-		checker = argv[1];
-
-		//checks actual value
-		//cout << "this is the value   " << value << " ";
-
-		//checks actual aurgment
-		if (checker != string("-b"))
+		else if (checker == string("-r") && k + 2 < end)
 		{
-			//cleans up and exits
-			commandStatement();
-			all_array_delete( vars );
-			exit(-2);
+			//resample takes the new size and can be given a filter
+			stage.kind = STAGE_RESAMPLE;
+			stage.value = RESAMPLE_LANCZOS;
+			stage.cols = atoi(argv[++k]);
+			stage.rows = atoi(argv[++k]);
+			if (stage.cols < 1 || stage.cols > MAX_SIDE || stage.rows < 1 ||
+				stage.rows > MAX_SIDE)
+				return false;
+
+			string name = (k + 1 < end) ? string(argv[k + 1]) : string("");
+			if (name == string("bilinear") || name == string("bicubic") ||
+				name == string("lanczos"))
+			{
+				stage.value = (name == string("bilinear")) ?
+					RESAMPLE_BILINEAR : (name == string("bicubic")) ?
+					RESAMPLE_BICUBIC : RESAMPLE_LANCZOS;
+				k++;
+			}
 		}
-
-		//checks the brightness value
-		if (val > 256 || val < -256)
+		else if (checker == string("-k") && k + 1 < end)
+		{
+			//convolve reads its kernel from the argument or a file
+			shared_ptr<convolve_kernel> kernel(new convolve_kernel);
+			stage.kind = STAGE_CONVOLVE;
+			if (!kernel_read( argv[++k], *kernel ))
+				return false;
+			stage.kernel = kernel;
+		}
+		else if (checker == string("-s"))
 		{
-			//cleans up and exits
-			commandStatement();
-			all_array_delete( vars );
-			exit(-2);
+			//smooth can be given a radius
+			stage.kind = STAGE_SMOOTH;
+			stage.value = 1;
+			if (k + 1 < end && isdigit((unsigned char) argv[k + 1][0]))
+			{
+				stage.value = atoi(argv[++k]);
+				if (stage.value < 1 || stage.value > MAX_RADIUS)
+					return false;
+			}
 		}
-		//runs brightness
-		brighten(vars, val);
+		else
+			return false;
+
+		if (stage.kind == STAGE_SHARPEN || stage.kind == STAGE_SMOOTH ||
+			stage.kind == STAGE_CONVOLVE)
+			stage.border = border;
+		stages.push_back(stage);
 	}
-}
\ No newline at end of file
+	return true;
+}
+
+/**************************************************************************//** 
+ * @author Johnathan Ackerman
+ * 
+ * @par Description: 
+ * runs the options given on the command line and names the output file
+ * for the kind of picture that comes out
+ * 
+ * @param[in][out]	   vars - the picture, vars.fileName gets its ending
+ * @param[in]		   stages - the options in the order given
+ * 
+ *****************************************************************************/
+template <class T>
+void runOption( basic_image<T> &vars, const vector<pipeline_stage> &stages )
+{
+	run_pipeline( vars, stages );
+
+	//checks if file ending needs to be changed for greyscale options
+	if (vars.grey.data != nullptr)
+		vars.fileName = vars.fileName.append(".pgm");
+	else
+		vars.fileName = vars.fileName.append(".ppm");
+}
+
+
+/*******************************************************************************
+ *                         Sample types
+ ******************************************************************************/
+//every function that holds or changes samples is made for both sample types
+#define SAMPLE_FUNCTIONS(T) \
+	template basic_plane<T> d2array<T>( int, int ); \
+	template void array_maker( basic_image<T> &, ifstream & ); \
+	template void grey_maker( basic_image<T> &, ifstream & ); \
+	template void packed_maker( basic_image<T> &, ifstream & ); \
+	template void all_array_delete( basic_image<T> & ); \
+	template void d2array_delet( basic_plane<T> & ); \
+	template int ascii_fill( basic_image<T> &, ifstream &, const char *, \
+		grey_weights ); \
+	template size_t ascii_read( ascii_reader &, T *, size_t ); \
+	template int binary_fill( basic_image<T> &, ifstream &, const char *, \
+		grey_weights ); \
+	template void ascii_body( basic_image<T> &, async_reader &, \
+		grey_weights ); \
+	template void binary_body( basic_image<T> &, async_reader &, \
+		grey_weights ); \
+	template void allocation_error( basic_image<T> &, const char * ); \
+	template void packed_split( basic_image<T> & ); \
+	template void fill_row( basic_image<T> &, int, const T *, int, \
+		grey_weights ); \
+	template const T *body_samples( async_reader &, vector<pixel> &, \
+		vector<T> &, size_t ); \
+	template int picture_fill( basic_image<T> &, ifstream &, const char *, \
+		const vector<pipeline_stage> & ); \
+	template void ascii_out( basic_image<T> &, async_writer & ); \
+	template char *ascii_format( const T *, size_t, char * ); \
+	template void binary_out( basic_image<T> &, async_writer & ); \
+	template basic_lut<T> lut_identity<T>(); \
+	template basic_lut<T> lut_negate( T ); \
+	template basic_lut<T> lut_brighten<T>( int, int ); \
+	template basic_lut<T> lut_stretch<T>( int, int, int ); \
+	template basic_lut<T> lut_then( const basic_lut<T> &, \
+		const basic_lut<T> & ); \
+	template void point_op( basic_image<T> &, const basic_lut<T> & ); \
+	template void lut_apply( basic_plane<T> &, const basic_lut<T> & ); \
+	template void negate( basic_image<T> & ); \
+	template void negate_band( basic_plane<T> &, T ); \
+	template void brighten( basic_image<T> &, int ); \
+	template void brighten_formula( basic_plane<T> &, basic_image<T> &, \
+		int ); \
+	template void colour_to_grey( const basic_image<T> &, int, T *, \
+		grey_weights ); \
+	template void greyscale( basic_image<T> &, grey_weights ); \
+	template void grey_contrast( basic_image<T> &, grey_weights ); \
+	template void contrast( basic_image<T> & ); \
+	template void contrast_range( basic_image<T> & ); \
+	template void window_range( basic_window<T>, int, int, int, int &, \
+		int & ); \
+	template void tile_setup( tile_grid<T> &, int, int, int ); \
+	template void tile_count( tile_grid<T> &, basic_window<T>, int, int ); \
+	template void tile_tables( tile_grid<T> &, int ); \
+	template void equalize_rows( const tile_grid<T> &, basic_window<T>, \
+		basic_window<T>, int, int ); \
+	template void sharpen( basic_image<T> & ); \
+	template void sharpen_rows<LAYOUT_PLANAR>( basic_window<T>, \
+		basic_window<T>, int, int, int, int, int, \
+		const stencil_border & ); \
+	template void sharpen_rows<LAYOUT_PACKED>( basic_window<T>, \
+		basic_window<T>, int, int, int, int, int, \
+		const stencil_border & ); \
+	template void smooth( basic_image<T> &, int ); \
+	template void smooth_rows<LAYOUT_PLANAR>( basic_window<T>, \
+		basic_window<T>, int, int, int, int, int, \
+		const stencil_border & ); \
+	template void smooth_rows<LAYOUT_PACKED>( basic_window<T>, \
+		basic_window<T>, int, int, int, int, int, \
+		const stencil_border & ); \
+	template void fileOutput( string &, basic_image<T> & ); \
+	template int picture_write( const string &, basic_image<T> & ); \
+	template void runOption( basic_image<T> &, \
+		const vector<pipeline_stage> & );
+
+SAMPLE_FUNCTIONS(pixel)
+SAMPLE_FUNCTIONS(wide_pixel)
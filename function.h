@@ -10,47 +10,431 @@
 #include <cctype>
 #include <cstring>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <sstream>
+#include <climits>
+#include <cstdlib>
+#include <memory>
 
 
 using namespace std;
 
 
+#include "asyncio.h"
+
+
 #ifndef  __FUNCTION__H__
 #define __FUNCTION__H__
 
 
 typedef unsigned char pixel; //defines the type for all arrays
 
+typedef uint16_t wide_pixel; //samples of pictures with a max_value past 255
+
+const int PLANE_ALIGN = 64; //every row of a plane starts on this boundary
+
+const int MAX_RADIUS = 127; //largest smooth radius, keeps column sums 16 bit
+
+const int EQUALIZE_TILES = 8; //tiles each way adaptive equalization cuts
+
+const int EQUALIZE_CLIP = 3; //clip limit -e uses when none is given
+
+const int MAX_CLIP = 255; //largest clip limit -e takes
+
+const int MAX_SIDE = 65535; //largest width or height -r makes
+
+const int RESAMPLE_BITS = 14; //fraction bits of the resample weights
+
+const int RESAMPLE_EXTRA = 6; //fraction bits kept between the resample
+	//passes
+
+const int MAX_KERNEL = 2 * MAX_RADIUS + 1; //widest or tallest kernel -k takes
+
+const int MAX_KERNEL_WEIGHT = 32767; //largest sum of the sizes of a kernel's
+	//weights, keeps every sum of weighted samples 32 bit
+
 
 /*!
- * @brief holds the header information and pixel arrays for
- *				the program
+ * @brief what the code needs to know about one sample type
+ *
+ * @details pictures with a max_value up to 255 keep one byte a sample and
+ *				the rest two.  Everything that holds or changes samples is
+ *				a template on the sample type, and these are the only two
+ *				it is made for.
+ */
+template <class T>
+struct sample_traits;
+
+/*! @brief one byte samples, max_value up to 255 */
+template <>
+struct sample_traits<pixel>
+{
+	typedef uint16_t column_sum;	/*!< holds MAX_RADIUS * 2 + 1 samples */
+	typedef int16_t filtered;		/*!< a sample after the first resample
+											pass, RESAMPLE_EXTRA bits more */
+	static constexpr int largest = 255;		/*!< largest sample */
+	static constexpr int values = 256;		/*!< amount of sample values */
+	static constexpr int digits = 4;		/*!< ascii characters, newline too */
+};
+
+/*! @brief two byte samples, max_value up to 65535 */
+template <>
+struct sample_traits<wide_pixel>
+{
+	typedef uint32_t column_sum;	/*!< holds MAX_RADIUS * 2 + 1 samples */
+	typedef int32_t filtered;		/*!< a sample after the first resample
+											pass, RESAMPLE_EXTRA bits more */
+	static constexpr int largest = 65535;	/*!< largest sample */
+	static constexpr int values = 65536;	/*!< amount of sample values */
+	static constexpr int digits = 6;		/*!< ascii characters, newline too */
+};
+
+
+/*!
+ * @brief one colorband held in a single aligned block of memory
+ *
+ * @details rows are stored back to back, each padded out to stride samples
+ *				so that every row starts on a PLANE_ALIGN byte boundary.
+ *				vars.red[i][j] still works through operator[]
+ */
+template <class T>
+struct basic_plane
+{
+	T *data = nullptr;		/*!< start of the aligned sample block */
+	int rows = 0;			/*!< holds the number of rows */
+	int cols = 0;			/*!< holds the number of used samples per row */
+	int stride = 0;			/*!< holds the distance between rows in samples */
+
+	/*! @brief returns the start of row number row */
+	T *operator[]( int row ) { return data + size_t(row) * stride; }
+	/*! @brief returns the start of row number row */
+	const T *operator[]( int row ) const
+		{ return data + size_t(row) * stride; }
+};
+
+typedef basic_plane<pixel> plane;			//a colorband of byte samples
+typedef basic_plane<wide_pixel> wide_plane;	//a colorband of 2 byte samples
+
+
+/*!
+ * @brief how the colours of a picture are kept in memory
+ *
+ * @details the value is the distance in samples from a pixel to the next
+ *				one of the same colour.  The stencils are made for each
+ *				layout, so a packed row is worked on as it is without
+ *				being split into colorbands.
+ */
+enum pixel_layout
+{
+	LAYOUT_PLANAR = 1,	/*!< one plane per colour, or the grey plane */
+	LAYOUT_PACKED = 3	/*!< rgb triples side by side, as a P3 or P6 file
+								holds them */
+};
+
+
+/*!
+ * @brief holds the header information of a picture
  *
  * @details values are passed using vars.<value>
  */
-struct image
+struct picture_header
 {
 	//all ints found in header
-	int rows;		/*!< holds the number of rows */
-	int cols;		/*!< holds the number of columns */
-	int max_value;  /*!< holds the maximum pixel value */
+	int rows = 0;		/*!< holds the number of rows */
+	int cols = 0;		/*!< holds the number of columns */
+	int max_value = 0;  /*!< holds the maximum pixel value */
 
 
 	//values held for contrast
-	int min;		/*!< holds the minimum greyscale value */
-	int max;		/*!< holds the maximum greyscale value */
+	int min = 0;		/*!< holds the minimum greyscale value */
+	int max = 0;		/*!< holds the maximum greyscale value */
 
 	string fileName; /*!< holds the filename from the commandline */
 
 	string magic_number;/*!< holds the value that determines the type of 
 								picture */
 	string comment; /*!< holds the pictures comment */
+};
+
+/*! @brief gives the pixels a header says the picture holds */
+inline uint64_t picture_pixels( const picture_header &vars )
+	{ return uint64_t(max(vars.rows, 0)) * uint64_t(max(vars.cols, 0)); }
+
 
+/*!
+ * @brief holds the header information and pixel arrays for
+ *				the program
+ *
+ * @details values are passed using vars.<value>.  The header is read
+ *				first into an image, and a picture whose max_value needs
+ *				two bytes a sample copies it into a wide_image instead.
+ */
+template <class T>
+struct basic_image : picture_header
+{
 	//all colorband arrays
-	pixel **red;	/*!< holds the red pixel array */
-	pixel **green;  /*!< holds the green pixel array */
-	pixel **blue;   /*!< holds the blue pixel array */
-	pixel **grey;   /*!< holds the grey pixel array */
+	basic_plane<T> red;		/*!< holds the red pixel array */
+	basic_plane<T> green;	/*!< holds the green pixel array */
+	basic_plane<T> blue;	/*!< holds the blue pixel array */
+	basic_plane<T> grey;	/*!< holds the grey pixel array */
+
+	//packed rgb, used instead of the colorbands when picture_layout picks it
+	basic_plane<T> packed;	/*!< holds rgb triples side by side, cols * 3
+									wide */
+	void *mapping = nullptr;	/*!< start of the mapped file, if any */
+	size_t mapping_size = 0;	/*!< length of the mapped file */
+};
+
+typedef basic_image<pixel> image;			//a picture of byte samples
+typedef basic_image<wide_pixel> wide_image;	//a picture of 2 byte samples
+
+
+
+/*!
+ * @brief rows of a plane, or of a band buffer that only holds rows first
+ *				and on, reached by their row number in the picture
+ */
+template <class T>
+struct basic_window
+{
+	T *data = nullptr;		/*!< start of row first */
+	int first = 0;			/*!< picture row number of data */
+	int stride = 0;			/*!< distance between rows in samples */
+
+	/*! @brief returns the start of picture row row */
+	T *operator[]( int row ) const
+		{ return data + ptrdiff_t(row - first) * stride; }
+};
+
+typedef basic_window<pixel> row_window;		//rows of byte samples
+
+/*!
+ * @brief the options that can be chained on the command line
+ */
+enum stage_kind
+{
+	STAGE_NEGATE,		/*!< -n */
+	STAGE_BRIGHTEN,		/*!< -b #, value is the amount */
+	STAGE_SHARPEN,		/*!< -p */
+	STAGE_SMOOTH,		/*!< -s [#], value is the radius */
+	STAGE_GREYSCALE,	/*!< -g [601|709], value is the grey_weights */
+	STAGE_CONTRAST,		/*!< -c, greyscale first if needed */
+	STAGE_EQUALIZE,		/*!< -e [#], value is the clip limit, greyscale
+								first if needed */
+	STAGE_RESAMPLE,		/*!< -r cols rows [filter], value is the
+								resample_filter */
+	STAGE_CONVOLVE		/*!< -k kernel, kernel holds it */
+};
+
+/*!
+ * @brief the colour weights greyscale can use, numbered the way -g takes
+ *				them
+ */
+enum grey_weights
+{
+	GREY_LEGACY = 0,	/*!< .3 red + .6 green + .1 green, as always */
+	GREY_BT601 = 601,	/*!< .299 red + .587 green + .114 blue */
+	GREY_BT709 = 709	/*!< .2126 red + .7152 green + .0722 blue */
+};
+
+/*!
+ * @brief the filters -r can resample with, named the way it takes them
+ */
+enum resample_filter
+{
+	RESAMPLE_BILINEAR = 0,	/*!< bilinear, a tent 1 pixel out */
+	RESAMPLE_BICUBIC = 1,	/*!< Keys cubic with a = -.5, 2 pixels out */
+	RESAMPLE_LANCZOS = 2	/*!< Lanczos with 3 lobes, 3 pixels out */
+};
+
+/*!
+ * @brief what sharpen, smooth, and convolve read past the edges of the
+ *				picture, named the way --border takes them
+ */
+enum border_mode
+{
+	BORDER_KEEP = 0,		/*!< pixels without a full neighbourhood keep
+									their values, as always */
+	BORDER_CLAMP = 1,		/*!< the edge pixel carries on, aaa|abcd */
+	BORDER_MIRROR = 2,		/*!< reflected about the edge pixel, dcb|abcd */
+	BORDER_WRAP = 3,		/*!< the far edge carries on, bcd|abcd */
+	BORDER_CONSTANT = 4		/*!< every pixel past the edge is the fill */
+};
+
+/*!
+ * @brief the border a stencil is run with
+ */
+struct stencil_border
+{
+	border_mode mode = BORDER_KEEP;	/*!< what is read past the edges */
+	int fill = 0;					/*!< value past the edges, for
+											BORDER_CONSTANT */
+};
+
+/*!
+ * @brief an integer kernel -k convolves the picture with
+ *
+ * @details a pixel becomes the sum of the weights times the pixels under
+ *				them, the kernel centered on the pixel, divided by divisor
+ *				to the nearest whole number and kept between 0 and the
+ *				max_value
+ */
+struct convolve_kernel
+{
+	int rows = 0;			/*!< height, an odd number */
+	int cols = 0;			/*!< width, an odd number */
+	vector<int> weights;	/*!< rows * cols weights, row by row */
+	int divisor = 1;		/*!< what the sums are divided by */
+};
+
+/*!
+ * @brief one option of the pipeline, run in command line order
+ */
+struct pipeline_stage
+{
+	stage_kind kind;	/*!< which option */
+	int value = 0;		/*!< brighten amount, smooth radius, clip limit,
+								grey_weights, or resample_filter */
+	int cols = 0;		/*!< new width, for STAGE_RESAMPLE */
+	int rows = 0;		/*!< new height, for STAGE_RESAMPLE */
+	shared_ptr<const convolve_kernel> kernel;	/*!< the kernel, for
+														STAGE_CONVOLVE */
+	stencil_border border;	/*!< edges of STAGE_SHARPEN, STAGE_SMOOTH, and
+									STAGE_CONVOLVE */
+};
+
+/*!
+ * @brief rounds a box sum to the average of its pixels with a multiply and
+ *				a shift, see make_divider
+ */
+struct box_divider
+{
+	uint32_t count = 1;		/*!< pixels in the box */
+	uint64_t multiply = 0;	/*!< reciprocal of 2 * count, scaled up, 0 when
+									the product would not fit 64 bits */
+	int shift = 0;			/*!< amount the product is scaled down */
+};
+
+/*!
+ * @brief gives the rounded average of a box, the same as
+ *				int(sum / double(count) + .5)
+ */
+template <class T>
+inline T box_average( uint32_t sum, const box_divider &divide )
+{
+	uint64_t x = 2 * uint64_t(sum) + divide.count;
+
+	//large boxes of 2 byte samples are divided the slow way
+	if (divide.multiply == 0)
+		return T(x / (2 * uint64_t(divide.count)));
+
+	return T((x * divide.multiply) >> divide.shift);
+}
+
+/*!
+ * @brief gives the pixel, 0 to count - 1, that place reads with mode.
+ *				Places past an edge give -1 for BORDER_CONSTANT, and a
+ *				mirror or wrap bigger than the picture goes around again.
+ */
+inline int border_index( int place, int count, border_mode mode )
+{
+	//the period of a mirror, there and back
+	int period = 2 * (count - 1);
+
+	if (place >= 0 && place < count)
+		return place;
+
+	switch (mode)
+	{
+	case BORDER_CONSTANT:
+		return -1;
+
+	case BORDER_WRAP:
+		place %= count;
+		return place < 0 ? place + count : place;
+
+	case BORDER_MIRROR:
+		if (period == 0)
+			return 0;
+		place = abs(place) % period;
+		return place < count ? place : period - place;
+
+	default:
+		return place < 0 ? 0 : count - 1;
+	}
+}
+
+/*!
+ * @brief gives the row a stencil reads for row of a picture rows tall,
+ *				fill when it is past an edge with BORDER_CONSTANT
+ */
+template <class T>
+inline const T *border_row( basic_window<T> in, int row, int rows,
+	border_mode mode, const T *fill )
+{
+	int place = border_index( row, rows, mode );
+	return place < 0 ? fill : in[place];
+}
+
+/*!
+ * @brief a point operation, one new value for each possible sample value
+ *
+ * @details negate, brighten, and the contrast stretch only look at one
+ *				pixel at a time, so each one is a table.  Two tables in a
+ *				row are the same as one table, see lut_then, so a chain of
+ *				them is still a single pass over the picture.
+ */
+template <class T>
+struct basic_lut
+{
+	T table[sample_traits<T>::values];	/*!< new value for each old value */
+	T pad = 0;		/*!< lets vector loads of the last entry read 4 bytes */
+};
+
+typedef basic_lut<pixel> point_lut;		//a table for byte samples
+
+/*!
+ * @brief the tiles of adaptive equalization and the table each one made
+ *
+ * @details the greyscale picture is cut into up to EQUALIZE_TILES tiles
+ *				each way.  Every tile counts its own values and makes a
+ *				clipped equalizing table from them, and every pixel blends
+ *				the tables of the four tile centers around it.
+ */
+template <class T>
+struct tile_grid
+{
+	int rows = 0;				/*!< rows in the picture */
+	int cols = 0;				/*!< columns in the picture */
+	int across = 0;				/*!< tiles in a row of tiles */
+	int down = 0;				/*!< rows of tiles */
+	int top = 0;				/*!< largest value a table gives */
+	vector<uint32_t> counts;	/*!< top + 1 counts for each tile */
+	vector<T> tables;			/*!< values entries for each tile */
+	vector<int> left;			/*!< tile left of each column's center */
+	vector<int> weight;			/*!< share of the tile right of it, out
+										of 256 */
+};
+
+/*!
+ * @brief block buffered reader for the samples of an ascii picture
+ *
+ * @details pulls large chunks from the file and parses the numbers out of
+ *				memory, skipping whitespace and # comments wherever they
+ *				appear
+ */
+struct ascii_reader
+{
+	async_reader *file = nullptr;	/*!< file the samples come from */
+	vector<char> buffer;		/*!< chunk of the file being parsed */
+	size_t pos = 0;				/*!< next unread byte in buffer */
+	size_t end = 0;				/*!< one past the last valid byte */
+	bool done = false;			/*!< the file has no more data */
+	bool in_comment = false;	/*!< a comment runs past the chunk */
 };
 
 
@@ -58,39 +442,151 @@ struct image
 /*******************************************************************************
  *                         Function Prototypes
  ******************************************************************************/
-void read_in_header(image& vars, ifstream &fin);
+void read_in_header(picture_header& vars, istream &fin);
+void header_skip(picture_header& vars, istream &fin);
+bool header_valid( const picture_header &vars );
+
+template <class T>
+void array_maker(basic_image<T>& vars, ifstream &fin);
+template <class T>
+void grey_maker(basic_image<T>& vars, ifstream &fin);
+template <class T>
+void packed_maker(basic_image<T>& vars, ifstream &fin);
+template <class T = pixel>
+basic_plane<T> d2array (int rows, int cols);
+
+template <class T>
+void all_array_delete( basic_image<T>& vars);
+template <class T>
+void allocation_error( basic_image<T> &vars, const char *message );
+template <class T>
+void packed_split( basic_image<T> &vars );
+void allocation_throws( bool on );
+template <class T>
+void d2array_delet( basic_plane<T> &this_array);
+void plane_recycle( size_t count );
 
-void array_maker(image& vars, ifstream &fin, string checker);
-pixel **d2array (int rows, int cols);
+template <class T>
+int ascii_fill( basic_image<T>& vars, ifstream &fin, const char *name,
+	grey_weights weights );
+void ascii_open( ascii_reader &in, async_reader &file );
+template <class T>
+size_t ascii_read( ascii_reader &in, T *out, size_t count );
+template <class T>
+int binary_fill( basic_image<T>& vars, ifstream &fin, const char *name,
+	grey_weights weights );
+template <class T>
+void ascii_body( basic_image<T>& vars, async_reader &file,
+	grey_weights weights );
+template <class T>
+void binary_body( basic_image<T>& vars, async_reader &file,
+	grey_weights weights );
+template <class T>
+void fill_row( basic_image<T>& vars, int row, const T *src, int channels,
+	grey_weights weights );
+bool body_open( async_reader &file, ifstream &fin, const char *name );
+const pixel *body_row( async_reader &file, vector<pixel> &spare,
+	size_t row_bytes );
+template <class T>
+const T *body_samples( async_reader &file, vector<pixel> &spare,
+	vector<T> &row, size_t count );
+template <class T>
+int picture_fill( basic_image<T> &vars, ifstream &fin, const char *name,
+	const vector<pipeline_stage> &stages );
+bool packed_option( const vector<pipeline_stage> &stages );
+pixel_layout picture_layout( const picture_header &vars,
+	const vector<pipeline_stage> &stages );
+bool packed_stage( stage_kind kind );
+bool packed_fill( image& vars, ifstream &fin, const char *name );
+bool output_is_input( const char *input, const string &basename );
 
-void all_array_delete( image& vars);
-void d2array_delet( int rows, pixel **this_array);
+void read_out_header(picture_header& vars, ostream &fout);
+template <class T>
+void ascii_out( basic_image<T> &vars, async_writer &fout);
+template <class T>
+char *ascii_format( const T *src, size_t count, char *dst );
+template <class T>
+void binary_out( basic_image<T> &vars, async_writer &fout);
 
-void ascii_fill( image& vars, ifstream &fin);
-void binary_fill( image& vars, ifstream &fin);
+template <class T>
+basic_lut<T> lut_identity();
+template <class T>
+basic_lut<T> lut_negate( T max );
+template <class T>
+basic_lut<T> lut_brighten( int value, int max_value );
+template <class T>
+basic_lut<T> lut_stretch( int low, int high, int top );
+template <class T>
+basic_lut<T> lut_then( const basic_lut<T> &first,
+	const basic_lut<T> &second );
+template <class T>
+void point_op( basic_image<T> &vars, const basic_lut<T> &lut );
+template <class T>
+void lut_apply( basic_plane<T> &this_array, const basic_lut<T> &lut );
 
-void read_out_header(image& vars, ofstream &fout);
-void ascii_out( image &vars, ofstream &fout);
-void binary_out( image &vars, ofstream &fout);
+template <class T>
+void negate( basic_image<T> &vars );
+template <class T>
+void negate_band( basic_plane<T> &this_array, T max );
 
-void negate( image &vars );
+template <class T>
+void brighten( basic_image<T> &vars, int value);
+template <class T>
+void brighten_formula( basic_plane<T> &this_array, basic_image<T> &vars,
+	int value );
 
-void brighten( image &vars, int value);
-void brighten_formula( pixel **this_array, image &vars, int value );
+template <class T>
+void colour_to_grey( const basic_image<T> &vars, int row, T *grey,
+	grey_weights weights );
+template <class T>
+void greyscale(basic_image<T> &vars, grey_weights weights);
+template <class T>
+void grey_contrast( basic_image<T> &vars, grey_weights weights );
+bool grey_first( const vector<pipeline_stage> &stages,
+	grey_weights &weights );
+template <class T>
+void contrast(basic_image<T> &vars);
+template <class T>
+void contrast_range(basic_image<T> &vars);
+template <class T>
+void window_range( basic_window<T> grey, int first, int last, int cols,
+	int &low, int &high );
 
-void greyscale(image &vars);
-void contrast(image &vars);
+template <class T>
+void tile_setup( tile_grid<T> &grid, int rows, int cols, int top );
+template <class T>
+void tile_count( tile_grid<T> &grid, basic_window<T> grey, int first,
+	int last );
+template <class T>
+void tile_tables( tile_grid<T> &grid, int clip );
+template <class T>
+void equalize_rows( const tile_grid<T> &grid, basic_window<T> in,
+	basic_window<T> out, int first, int last );
 
-void sharpen( image &vars );
-void sub_trac( pixel **&this_array, int rows, int cols, pixel **&cpy_array);
+template <class T>
+void sharpen( basic_image<T> &vars );
+template <pixel_layout LAYOUT, class T>
+void sharpen_rows( basic_window<T> in, basic_window<T> out, int first,
+	int last, int rows, int cols, int top, const stencil_border &border );
 
-void smooth( pixel **&this_array, image vars);
+template <class T>
+void smooth( basic_image<T> &vars, int radius );
+template <pixel_layout LAYOUT, class T>
+void smooth_rows( basic_window<T> in, basic_window<T> out, int first,
+	int last, int rows, int cols, int radius,
+	const stencil_border &border );
+box_divider make_divider( uint32_t count, int largest );
 
 void commandStatement();
-void fileOutput( string &checker, image &vars, char *argv[]);
-void runOption( string &checker, image &vars, char *argv[], int argc, int &val);
+bool parse_pipeline( int argc, char *argv[], vector<pipeline_stage> &stages );
+template <class T>
+void fileOutput( string &checker, basic_image<T> &vars );
+template <class T>
+int picture_write( const string &checker, basic_image<T> &vars );
+template <class T>
+void runOption( basic_image<T> &vars, const vector<pipeline_stage> &stages );
 
-//void add_up ( pixel **this_array, image vars,  pixel **cpy_array );
+//void add_up ( plane &this_array, image vars,  plane &cpy_array );
 
 
 
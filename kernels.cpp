@@ -0,0 +1,3118 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief Vectorized row kernels and the cpu detection used to choose
+ * between the AVX2, SSE4.1, and plain versions at run time.
+ ****************************************************************************/
+#include <atomic>
+
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+	defined(_M_IX86)
+#define KERNEL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+//lets one file hold every instruction set without special build flags
+#if defined(KERNEL_X86) && (defined(__GNUC__) || defined(__clang__))
+#define KERNEL_TARGET(x) __attribute__((target(x)))
+#else
+#define KERNEL_TARGET(x)
+#endif
+
+//2 byte samples are swapped as bytes where memory holds them low byte first
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) \
+	|| defined(_M_IX86) || defined(_M_X64) || defined(_M_ARM64)
+#define LITTLE_HOST 1
+#else
+#define LITTLE_HOST 0
+#endif
+
+
+//level picked the first time a kernel runs, -1 means not picked yet.  Any
+	//thread may be the first, so it is atomic
+static atomic<int> active_level(-1);
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * asks the processor which instruction sets it supports
+ *
+ * @returns the fastest simd_level this machine can run
+ *
+ *****************************************************************************/
+simd_level simd_detect()
+{
+#if defined(KERNEL_X86) && (defined(__GNUC__) || defined(__clang__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return SIMD_AVX2;
+	if (__builtin_cpu_supports("sse4.1"))
+		return SIMD_SSE41;
+#elif defined(KERNEL_X86) && defined(_MSC_VER)
+	int info[4];
+
+	__cpuid(info, 1);
+	bool sse41 = (info[2] & (1 << 19)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0 && (info[2] & (1 << 27)) != 0;
+
+	//avx2 also needs the operating system to save the ymm registers
+	if (avx && (_xgetbv(0) & 6) == 6)
+	{
+		__cpuidex(info, 7, 0);
+		if (info[1] & (1 << 5))
+			return SIMD_AVX2;
+	}
+	if (sse41)
+		return SIMD_SSE41;
+#endif
+	return SIMD_SCALAR;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * returns the instruction set the kernels are currently using
+ *
+ * @returns the active simd_level
+ *
+ *****************************************************************************/
+simd_level simd_active()
+{
+	if (active_level < 0)
+		active_level = simd_detect();
+
+	return simd_level(active_level.load());
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * limits the kernels to an instruction set, mainly so the vector versions
+ * can be checked against the plain ones.  Asking for more than the machine
+ * supports gives the best it does support.
+ *
+ * @param[in]      level - highest instruction set to use
+ *
+ *****************************************************************************/
+void simd_force( simd_level level )
+{
+	simd_level best = simd_detect();
+
+	active_level = (level > best) ? best : level;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives a printable name for an instruction set
+ *
+ * @param[in]      level - the instruction set
+ *
+ * @returns the name of the level
+ *
+ *****************************************************************************/
+const char *simd_name( simd_level level )
+{
+	if (level == SIMD_AVX2)
+		return "avx2";
+	if (level == SIMD_SSE41)
+		return "sse4.1";
+	return "scalar";
+}
+
+
+/*******************************************************************************
+ *                         RGB de-interleave
+ ******************************************************************************/
+#ifdef KERNEL_X86
+//pshufb masks that pull one colour out of each of three 16 byte blocks of
+	//packed rgb, -1 leaves a zero so the three results can be or'ed together
+alignas(16) static const signed char split_masks[3][3][16] =
+{
+	{	//red
+		{ 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1 },
+		{ -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13 }
+	},
+	{	//green
+		{ 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1 },
+		{ -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14 }
+	},
+	{	//blue
+		{ 2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ -1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1 },
+		{ -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15 }
+	}
+};
+
+/*!
+ * @brief the pshufb masks for 2 byte samples, which move byte pairs
+ *				instead of bytes, worked out once at start up
+ */
+struct wide_shuffles
+{
+	alignas(16) signed char split[3][3][16];	/*!< [colour][block] */
+	alignas(16) signed char merge[3][3][16];	/*!< [block][colour] */
+	alignas(16) signed char swap[16];			/*!< swaps each byte pair */
+
+	wide_shuffles()
+	{
+		for (int k = 0; k < 3; k++)
+			for (int c = 0; c < 3; c++)
+				for (int i = 0; i < 16; i++)
+				{
+					//byte i of colour c comes from sample 3 * (i / 2) + c
+					int from = 2 * (3 * (i / 2) + c) + i % 2;
+					split[c][k][i] = (from / 16 == k) ? from % 16 : -1;
+
+					//byte i of block k is part of sample s of the triples
+					int s = (16 * k + i) / 2;
+					merge[k][c][i] = (s % 3 == c) ? 2 * (s / 3) + i % 2 : -1;
+				}
+
+		for (int i = 0; i < 16; i++)
+			swap[i] = (signed char) (i ^ 1);
+	}
+};
+static const wide_shuffles wide_masks;
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE4.1 version of split_rgb, 16 bytes of each colour per pass
+ *
+ *****************************************************************************/
+template <class T>
+KERNEL_TARGET("sse4.1")
+static int split_rgb_sse41( const T *src, T *red, T *green, T *blue,
+	int count, const signed char (*masks)[3][16] )
+{
+	//samples in one 16 byte block
+	const int lanes = 16 / sizeof(T);
+
+	int j = 0;
+	__m128i m[3][3];
+
+	for (int c = 0; c < 3; c++)
+		for (int k = 0; k < 3; k++)
+			m[c][k] = _mm_load_si128((const __m128i *) masks[c][k]);
+
+	for (j = 0; j + lanes <= count; j += lanes)
+	{
+		const T *in = src + 3 * j;
+		__m128i a = _mm_loadu_si128((const __m128i *) in);
+		__m128i b = _mm_loadu_si128((const __m128i *) (in + lanes));
+		__m128i c = _mm_loadu_si128((const __m128i *) (in + 2 * lanes));
+		T *out[3] = { red, green, blue };
+
+		for (int k = 0; k < 3; k++)
+		{
+			__m128i v = _mm_or_si128(_mm_or_si128(
+				_mm_shuffle_epi8(a, m[k][0]), _mm_shuffle_epi8(b, m[k][1])),
+				_mm_shuffle_epi8(c, m[k][2]));
+			_mm_storeu_si128((__m128i *) (out[k] + j), v);
+		}
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of split_rgb, 32 bytes of each colour per pass.  pshufb only
+ * works inside each 128 bit half, so the two halves are loaded from blocks
+ * 48 bytes apart and run the same masks as the SSE4.1 version.
+ *
+ *****************************************************************************/
+template <class T>
+KERNEL_TARGET("avx2")
+static int split_rgb_avx2( const T *src, T *red, T *green, T *blue,
+	int count, const signed char (*masks)[3][16] )
+{
+	//samples in one 16 byte block
+	const int lanes = 16 / sizeof(T);
+
+	int j = 0;
+	__m256i m[3][3];
+
+	for (int c = 0; c < 3; c++)
+		for (int k = 0; k < 3; k++)
+			m[c][k] = _mm256_broadcastsi128_si256(
+				_mm_load_si128((const __m128i *) masks[c][k]));
+
+	for (j = 0; j + 2 * lanes <= count; j += 2 * lanes)
+	{
+		const T *in = src + 3 * j;
+		__m256i a = _mm256_loadu2_m128i((const __m128i *) (in + 3 * lanes),
+			(const __m128i *) in);
+		__m256i b = _mm256_loadu2_m128i((const __m128i *) (in + 4 * lanes),
+			(const __m128i *) (in + lanes));
+		__m256i c = _mm256_loadu2_m128i((const __m128i *) (in + 5 * lanes),
+			(const __m128i *) (in + 2 * lanes));
+		T *out[3] = { red, green, blue };
+
+		for (int k = 0; k < 3; k++)
+		{
+			__m256i v = _mm256_or_si256(_mm256_or_si256(
+				_mm256_shuffle_epi8(a, m[k][0]),
+				_mm256_shuffle_epi8(b, m[k][1])),
+				_mm256_shuffle_epi8(c, m[k][2]));
+			_mm256_storeu_si256((__m256i *) (out[k] + j), v);
+		}
+	}
+	return j;
+}
+#endif
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * splits a run of packed rgb pixels into the three colorbands
+ *
+ * @param[in]      src - count packed rgb pixels
+ * @param[out]     red - receives count red values
+ * @param[out]     green - receives count green values
+ * @param[out]     blue - receives count blue values
+ * @param[in]      count - amount of pixels to split
+ *
+ *****************************************************************************/
+template <class T>
+void split_rgb( const T *src, T *red, T *green, T *blue, int count )
+{
+	int j = 0;
+
+#ifdef KERNEL_X86
+	const signed char (*masks)[3][16] = (sizeof(T) == 1) ? split_masks :
+		wide_masks.split;
+
+	if (simd_active() >= SIMD_AVX2)
+		j = split_rgb_avx2(src, red, green, blue, count, masks);
+	else if (simd_active() >= SIMD_SSE41)
+		j = split_rgb_sse41(src, red, green, blue, count, masks);
+#endif
+
+	//finishes whatever the vector loop left over
+	for ( ; j < count; j++)
+	{
+		red[j] = src[3 * j];
+		green[j] = src[3 * j + 1];
+		blue[j] = src[3 * j + 2];
+	}
+}
+
+template void split_rgb( const pixel *, pixel *, pixel *, pixel *, int );
+template void split_rgb( const wide_pixel *, wide_pixel *, wide_pixel *,
+	wide_pixel *, int );
+
+
+/*******************************************************************************
+ *                         RGB re-interleave
+ ******************************************************************************/
+#ifdef KERNEL_X86
+//pshufb masks that place each colour into one of three 16 byte blocks of
+	//packed rgb, indexed [block][colour]
+alignas(16) static const signed char merge_masks[3][3][16] =
+{
+	{	//bytes 0 - 15
+		{ 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5 },
+		{ -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1 },
+		{ -1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1 }
+	},
+	{	//bytes 16 - 31
+		{ -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1 },
+		{ 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10 },
+		{ -1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1 }
+	},
+	{	//bytes 32 - 47
+		{ -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1 },
+		{ -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1 },
+		{ 10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15 }
+	}
+};
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE4.1 version of merge_rgb, 16 bytes of each colour per pass
+ *
+ *****************************************************************************/
+template <class T>
+KERNEL_TARGET("sse4.1")
+static int merge_rgb_sse41( const T *red, const T *green, const T *blue,
+	T *dst, int count, const signed char (*masks)[3][16] )
+{
+	//samples in one 16 byte block
+	const int lanes = 16 / sizeof(T);
+
+	int j = 0;
+	__m128i m[3][3];
+
+	for (int o = 0; o < 3; o++)
+		for (int c = 0; c < 3; c++)
+			m[o][c] = _mm_load_si128((const __m128i *) masks[o][c]);
+
+	for (j = 0; j + lanes <= count; j += lanes)
+	{
+		__m128i r = _mm_loadu_si128((const __m128i *) (red + j));
+		__m128i g = _mm_loadu_si128((const __m128i *) (green + j));
+		__m128i b = _mm_loadu_si128((const __m128i *) (blue + j));
+
+		for (int o = 0; o < 3; o++)
+		{
+			__m128i v = _mm_or_si128(_mm_or_si128(
+				_mm_shuffle_epi8(r, m[o][0]), _mm_shuffle_epi8(g, m[o][1])),
+				_mm_shuffle_epi8(b, m[o][2]));
+			_mm_storeu_si128((__m128i *) (dst + 3 * j + lanes * o), v);
+		}
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of merge_rgb, 32 bytes of each colour per pass.  Each 128
+ * bit half builds the packed bytes for its own pixels, so the halves are
+ * stored 48 bytes apart.
+ *
+ *****************************************************************************/
+template <class T>
+KERNEL_TARGET("avx2")
+static int merge_rgb_avx2( const T *red, const T *green, const T *blue,
+	T *dst, int count, const signed char (*masks)[3][16] )
+{
+	//samples in one 16 byte block
+	const int lanes = 16 / sizeof(T);
+
+	int j = 0;
+	__m256i m[3][3];
+
+	for (int o = 0; o < 3; o++)
+		for (int c = 0; c < 3; c++)
+			m[o][c] = _mm256_broadcastsi128_si256(
+				_mm_load_si128((const __m128i *) masks[o][c]));
+
+	for (j = 0; j + 2 * lanes <= count; j += 2 * lanes)
+	{
+		__m256i r = _mm256_loadu_si256((const __m256i *) (red + j));
+		__m256i g = _mm256_loadu_si256((const __m256i *) (green + j));
+		__m256i b = _mm256_loadu_si256((const __m256i *) (blue + j));
+		T *out = dst + 3 * j;
+
+		for (int o = 0; o < 3; o++)
+		{
+			__m256i v = _mm256_or_si256(_mm256_or_si256(
+				_mm256_shuffle_epi8(r, m[o][0]),
+				_mm256_shuffle_epi8(g, m[o][1])),
+				_mm256_shuffle_epi8(b, m[o][2]));
+			_mm256_storeu2_m128i((__m128i *) (out + 3 * lanes + lanes * o),
+				(__m128i *) (out + lanes * o), v);
+		}
+	}
+	return j;
+}
+#endif
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * packs three colorbands back into rgb triples, the order a P6 file uses
+ *
+ * @param[in]      red - count red values
+ * @param[in]      green - count green values
+ * @param[in]      blue - count blue values
+ * @param[out]     dst - receives count packed rgb pixels
+ * @param[in]      count - amount of pixels to pack
+ *
+ *****************************************************************************/
+template <class T>
+void merge_rgb( const T *red, const T *green, const T *blue, T *dst,
+	int count )
+{
+	int j = 0;
+
+#ifdef KERNEL_X86
+	const signed char (*masks)[3][16] = (sizeof(T) == 1) ? merge_masks :
+		wide_masks.merge;
+
+	if (simd_active() >= SIMD_AVX2)
+		j = merge_rgb_avx2(red, green, blue, dst, count, masks);
+	else if (simd_active() >= SIMD_SSE41)
+		j = merge_rgb_sse41(red, green, blue, dst, count, masks);
+#endif
+
+	//finishes whatever the vector loop left over
+	for ( ; j < count; j++)
+	{
+		dst[3 * j] = red[j];
+		dst[3 * j + 1] = green[j];
+		dst[3 * j + 2] = blue[j];
+	}
+}
+
+template void merge_rgb( const pixel *, const pixel *, const pixel *,
+	pixel *, int );
+template void merge_rgb( const wide_pixel *, const wide_pixel *,
+	const wide_pixel *, wide_pixel *, int );
+
+
+/*******************************************************************************
+ *                         Sample byte order
+ ******************************************************************************/
+#ifdef KERNEL_X86
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE4.1 version of swap_samples, 8 samples per pass
+ *
+ *****************************************************************************/
+KERNEL_TARGET("sse4.1")
+static int swap_samples_sse41( const pixel *src, pixel *dst, int count )
+{
+	int j = 0;
+	const __m128i swap = _mm_load_si128((const __m128i *) wide_masks.swap);
+
+	for ( ; j + 8 <= count; j += 8)
+		_mm_storeu_si128((__m128i *) (dst + 2 * j), _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *) (src + 2 * j)), swap));
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of swap_samples, 16 samples per pass
+ *
+ *****************************************************************************/
+KERNEL_TARGET("avx2")
+static int swap_samples_avx2( const pixel *src, pixel *dst, int count )
+{
+	int j = 0;
+	const __m256i swap = _mm256_broadcastsi128_si256(
+		_mm_load_si128((const __m128i *) wide_masks.swap));
+
+	for ( ; j + 16 <= count; j += 16)
+		_mm256_storeu_si256((__m256i *) (dst + 2 * j), _mm256_shuffle_epi8(
+			_mm256_loadu_si256((const __m256i *) (src + 2 * j)), swap));
+	return j;
+}
+#endif
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * swaps the two bytes of every 2 byte sample, which turns the most
+ * significant byte first order of a Netpbm file into the order of this
+ * machine and back
+ *
+ * @param[in]      src - count samples, 2 bytes each
+ * @param[out]     dst - receives the swapped samples
+ * @param[in]      count - amount of samples
+ *
+ *****************************************************************************/
+static void swap_samples( const pixel *src, pixel *dst, int count )
+{
+	int j = 0;
+
+#ifdef KERNEL_X86
+	if (simd_active() >= SIMD_AVX2)
+		j = swap_samples_avx2(src, dst, count);
+	else if (simd_active() >= SIMD_SSE41)
+		j = swap_samples_sse41(src, dst, count);
+#endif
+
+	//finishes whatever the vector loop left over
+	for ( ; j < count; j++)
+	{
+		pixel high = src[2 * j];
+
+		dst[2 * j] = src[2 * j + 1];
+		dst[2 * j + 1] = high;
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * turns samples as a binary file stores them into samples in memory.  A
+ * byte sample is copied, a 2 byte sample comes most significant byte first.
+ *
+ * @param[in]      src - count samples in file order
+ * @param[out]     dst - receives the samples
+ * @param[in]      count - amount of samples
+ *
+ *****************************************************************************/
+template <class T>
+void read_samples( const pixel *src, T *dst, int count )
+{
+	//loop variable
+	int j = 0;
+
+	if constexpr (sizeof(T) == 1)
+		memcpy(dst, src, count);
+	else if (LITTLE_HOST)
+		swap_samples(src, (pixel *) dst, count);
+	else
+		for ( ; j < count; j++)
+			dst[j] = T((src[2 * j] << 8) | src[2 * j + 1]);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * turns samples in memory into samples as a binary file stores them, see
+ * read_samples
+ *
+ * @param[in]      src - count samples
+ * @param[out]     dst - receives the samples in file order
+ * @param[in]      count - amount of samples
+ *
+ *****************************************************************************/
+template <class T>
+void write_samples( const T *src, pixel *dst, int count )
+{
+	//loop variable
+	int j = 0;
+
+	if constexpr (sizeof(T) == 1)
+		memcpy(dst, src, count);
+	else if (LITTLE_HOST)
+		swap_samples((const pixel *) src, dst, count);
+	else
+		for ( ; j < count; j++)
+		{
+			dst[2 * j] = pixel(src[j] >> 8);
+			dst[2 * j + 1] = pixel(src[j]);
+		}
+}
+
+template void read_samples( const pixel *, pixel *, int );
+template void read_samples( const pixel *, wide_pixel *, int );
+template void write_samples( const pixel *, pixel *, int );
+template void write_samples( const wide_pixel *, pixel *, int );
+
+
+/*******************************************************************************
+ *                         Sharpen stencil
+ ******************************************************************************/
+#ifdef KERNEL_X86
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE4.1 version of sharpen_row, 16 pixels per pass.  The pixels are
+ * widened to 16 bits, where 5e - b - d - f - h always fits, and the pack
+ * back to bytes saturates to 0 - 255, which leaves only top to clamp to.
+ *
+ *****************************************************************************/
+template <int STEP>
+KERNEL_TARGET("sse4.1")
+static int sharpen_row_sse41( const pixel *up, const pixel *mid,
+	const pixel *down, pixel *out, int cols, int top )
+{
+	int j = STEP;
+	const __m128i limit = _mm_set1_epi8(char(top));
+
+	for ( ; j + 16 <= cols - STEP; j += 16)
+	{
+		__m128i b = _mm_loadu_si128((const __m128i *) (up + j));
+		__m128i d = _mm_loadu_si128((const __m128i *) (mid + j - STEP));
+		__m128i e = _mm_loadu_si128((const __m128i *) (mid + j));
+		__m128i f = _mm_loadu_si128((const __m128i *) (mid + j + STEP));
+		__m128i h = _mm_loadu_si128((const __m128i *) (down + j));
+		__m128i half[2];
+
+		for (int k = 0; k < 2; k++)
+		{
+			__m128i e16 = _mm_cvtepu8_epi16(e);
+			__m128i ans = _mm_add_epi16(_mm_slli_epi16(e16, 2), e16);
+
+			ans = _mm_sub_epi16(ans, _mm_cvtepu8_epi16(b));
+			ans = _mm_sub_epi16(ans, _mm_cvtepu8_epi16(d));
+			ans = _mm_sub_epi16(ans, _mm_cvtepu8_epi16(f));
+			ans = _mm_sub_epi16(ans, _mm_cvtepu8_epi16(h));
+			half[k] = ans;
+
+			//moves the upper 8 pixels down for the second half
+			b = _mm_srli_si128(b, 8);
+			d = _mm_srli_si128(d, 8);
+			e = _mm_srli_si128(e, 8);
+			f = _mm_srli_si128(f, 8);
+			h = _mm_srli_si128(h, 8);
+		}
+		_mm_storeu_si128((__m128i *) (out + j),
+			_mm_min_epu8(_mm_packus_epi16(half[0], half[1]), limit));
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE4.1 version of sharpen_row for 2 byte samples, 8 pixels per pass.  The
+ * formula is done in 32 bits and the pack back saturates to 0 - 65535.
+ *
+ *****************************************************************************/
+template <int STEP>
+KERNEL_TARGET("sse4.1")
+static int sharpen_row_sse41( const wide_pixel *up, const wide_pixel *mid,
+	const wide_pixel *down, wide_pixel *out, int cols, int top )
+{
+	int j = STEP;
+	const __m128i limit = _mm_set1_epi16(short(top));
+
+	for ( ; j + 8 <= cols - STEP; j += 8)
+	{
+		__m128i b = _mm_loadu_si128((const __m128i *) (up + j));
+		__m128i d = _mm_loadu_si128((const __m128i *) (mid + j - STEP));
+		__m128i e = _mm_loadu_si128((const __m128i *) (mid + j));
+		__m128i f = _mm_loadu_si128((const __m128i *) (mid + j + STEP));
+		__m128i h = _mm_loadu_si128((const __m128i *) (down + j));
+		__m128i half[2];
+
+		for (int k = 0; k < 2; k++)
+		{
+			__m128i e32 = _mm_cvtepu16_epi32(e);
+			__m128i ans = _mm_add_epi32(_mm_slli_epi32(e32, 2), e32);
+
+			ans = _mm_sub_epi32(ans, _mm_cvtepu16_epi32(b));
+			ans = _mm_sub_epi32(ans, _mm_cvtepu16_epi32(d));
+			ans = _mm_sub_epi32(ans, _mm_cvtepu16_epi32(f));
+			ans = _mm_sub_epi32(ans, _mm_cvtepu16_epi32(h));
+			half[k] = ans;
+
+			//moves the upper 4 pixels down for the second half
+			b = _mm_srli_si128(b, 8);
+			d = _mm_srli_si128(d, 8);
+			e = _mm_srli_si128(e, 8);
+			f = _mm_srli_si128(f, 8);
+			h = _mm_srli_si128(h, 8);
+		}
+		_mm_storeu_si128((__m128i *) (out + j),
+			_mm_min_epu16(_mm_packus_epi32(half[0], half[1]), limit));
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * widens the low (HIGH = 0) or high (HIGH = 1) 16 bytes of v to 16 bit
+ * values, or for 2 byte samples to 32 bit values
+ *
+ *****************************************************************************/
+template <int HIGH>
+KERNEL_TARGET("avx2")
+static inline __m256i widen_avx2( __m256i v )
+{
+	return _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, HIGH));
+}
+
+template <int HIGH>
+KERNEL_TARGET("avx2")
+static inline __m256i widen_wide_avx2( __m256i v )
+{
+	return _mm256_cvtepu16_epi32(_mm256_extracti128_si256(v, HIGH));
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * sharpen formula for the low or high 16 pixels of the loaded vectors, or
+ * the low or high 8 of 2 byte samples
+ *
+ *****************************************************************************/
+template <int HIGH>
+KERNEL_TARGET("avx2")
+static inline __m256i sharpen_half_avx2( __m256i b, __m256i d, __m256i e,
+	__m256i f, __m256i h )
+{
+	__m256i e16 = widen_avx2<HIGH>(e);
+	__m256i ans = _mm256_add_epi16(_mm256_slli_epi16(e16, 2), e16);
+
+	ans = _mm256_sub_epi16(ans, widen_avx2<HIGH>(b));
+	ans = _mm256_sub_epi16(ans, widen_avx2<HIGH>(d));
+	ans = _mm256_sub_epi16(ans, widen_avx2<HIGH>(f));
+	return _mm256_sub_epi16(ans, widen_avx2<HIGH>(h));
+}
+
+template <int HIGH>
+KERNEL_TARGET("avx2")
+static inline __m256i sharpen_wide_avx2( __m256i b, __m256i d, __m256i e,
+	__m256i f, __m256i h )
+{
+	__m256i e32 = widen_wide_avx2<HIGH>(e);
+	__m256i ans = _mm256_add_epi32(_mm256_slli_epi32(e32, 2), e32);
+
+	ans = _mm256_sub_epi32(ans, widen_wide_avx2<HIGH>(b));
+	ans = _mm256_sub_epi32(ans, widen_wide_avx2<HIGH>(d));
+	ans = _mm256_sub_epi32(ans, widen_wide_avx2<HIGH>(f));
+	return _mm256_sub_epi32(ans, widen_wide_avx2<HIGH>(h));
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of sharpen_row, 32 pixels per pass
+ *
+ *****************************************************************************/
+template <int STEP>
+KERNEL_TARGET("avx2")
+static int sharpen_row_avx2( const pixel *up, const pixel *mid,
+	const pixel *down, pixel *out, int cols, int top )
+{
+	int j = STEP;
+	const __m256i limit = _mm256_set1_epi8(char(top));
+
+	for ( ; j + 32 <= cols - STEP; j += 32)
+	{
+		__m256i b = _mm256_loadu_si256((const __m256i *) (up + j));
+		__m256i d = _mm256_loadu_si256((const __m256i *) (mid + j - STEP));
+		__m256i e = _mm256_loadu_si256((const __m256i *) (mid + j));
+		__m256i f = _mm256_loadu_si256((const __m256i *) (mid + j + STEP));
+		__m256i h = _mm256_loadu_si256((const __m256i *) (down + j));
+
+		//the pack works per 128 bit half, the permute puts them in order
+		__m256i packed = _mm256_packus_epi16(
+			sharpen_half_avx2<0>(b, d, e, f, h),
+			sharpen_half_avx2<1>(b, d, e, f, h));
+		_mm256_storeu_si256((__m256i *) (out + j), _mm256_min_epu8(
+			_mm256_permute4x64_epi64(packed, 0xD8), limit));
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of sharpen_row for 2 byte samples, 16 pixels per pass
+ *
+ *****************************************************************************/
+template <int STEP>
+KERNEL_TARGET("avx2")
+static int sharpen_row_avx2( const wide_pixel *up, const wide_pixel *mid,
+	const wide_pixel *down, wide_pixel *out, int cols, int top )
+{
+	int j = STEP;
+	const __m256i limit = _mm256_set1_epi16(short(top));
+
+	for ( ; j + 16 <= cols - STEP; j += 16)
+	{
+		__m256i b = _mm256_loadu_si256((const __m256i *) (up + j));
+		__m256i d = _mm256_loadu_si256((const __m256i *) (mid + j - STEP));
+		__m256i e = _mm256_loadu_si256((const __m256i *) (mid + j));
+		__m256i f = _mm256_loadu_si256((const __m256i *) (mid + j + STEP));
+		__m256i h = _mm256_loadu_si256((const __m256i *) (down + j));
+
+		//the pack works per 128 bit half, the permute puts them in order
+		__m256i packed = _mm256_packus_epi32(
+			sharpen_wide_avx2<0>(b, d, e, f, h),
+			sharpen_wide_avx2<1>(b, d, e, f, h));
+		_mm256_storeu_si256((__m256i *) (out + j), _mm256_min_epu16(
+			_mm256_permute4x64_epi64(packed, 0xD8), limit));
+	}
+	return j;
+}
+#endif
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs the sharpen formula 5e - b - d - f - h, clamped to 0 - top, across
+ * one row but its first and last pixel.  The left and right neighbours d
+ * and f are LAYOUT samples away, so a packed row is sharpened a colour at
+ * a time without being split.
+ *
+ * @param[in]      up - row above
+ * @param[in]      mid - row being sharpened
+ * @param[in]      down - row below
+ * @param[out]     out - receives samples LAYOUT to cols - LAYOUT - 1
+ * @param[in]      cols - samples in the rows
+ * @param[in]      top - largest value a pixel may have, the max_value
+ *
+ *****************************************************************************/
+template <pixel_layout LAYOUT, class T>
+void sharpen_row( const T *up, const T *mid, const T *down, T *out,
+	int cols, int top )
+{
+	int j = LAYOUT;
+
+#ifdef KERNEL_X86
+	if (simd_active() >= SIMD_AVX2)
+		j = sharpen_row_avx2<LAYOUT>(up, mid, down, out, cols, top);
+	else if (simd_active() >= SIMD_SSE41)
+		j = sharpen_row_sse41<LAYOUT>(up, mid, down, out, cols, top);
+#endif
+
+	//finishes whatever the vector loop left over
+	for ( ; j < cols - LAYOUT; j++)
+	{
+		int ans = 5 * mid[j] - up[j] - mid[j - LAYOUT] - mid[j + LAYOUT] -
+			down[j];
+
+		out[j] = T(ans < 0 ? 0 : ans > top ? top : ans);
+	}
+}
+
+template void sharpen_row<LAYOUT_PLANAR>( const pixel *, const pixel *,
+	const pixel *, pixel *, int, int );
+template void sharpen_row<LAYOUT_PLANAR>( const wide_pixel *,
+	const wide_pixel *, const wide_pixel *, wide_pixel *, int, int );
+template void sharpen_row<LAYOUT_PACKED>( const pixel *, const pixel *,
+	const pixel *, pixel *, int, int );
+template void sharpen_row<LAYOUT_PACKED>( const wide_pixel *,
+	const wide_pixel *, const wide_pixel *, wide_pixel *, int, int );
+
+
+/*******************************************************************************
+ *                         Box filter
+ ******************************************************************************/
+#ifdef KERNEL_X86
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE4.1 version of column_add, 16 columns per pass
+ *
+ *****************************************************************************/
+KERNEL_TARGET("sse4.1")
+static int column_add_sse41( uint16_t *column, const pixel *enter,
+	const pixel *leave, int count )
+{
+	int j = 0;
+
+	for ( ; j + 16 <= count; j += 16)
+	{
+		__m128i in = _mm_loadu_si128((const __m128i *) (enter + j));
+		__m128i out = leave ? _mm_loadu_si128((const __m128i *) (leave + j))
+			: _mm_setzero_si128();
+		__m128i *sum = (__m128i *) (column + j);
+
+		__m128i low = _mm_add_epi16(_mm_loadu_si128(sum),
+			_mm_cvtepu8_epi16(in));
+		__m128i high = _mm_add_epi16(_mm_loadu_si128(sum + 1),
+			_mm_cvtepu8_epi16(_mm_srli_si128(in, 8)));
+
+		low = _mm_sub_epi16(low, _mm_cvtepu8_epi16(out));
+		high = _mm_sub_epi16(high, _mm_cvtepu8_epi16(_mm_srli_si128(out, 8)));
+
+		_mm_storeu_si128(sum, low);
+		_mm_storeu_si128(sum + 1, high);
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE4.1 version of column_add for 2 byte samples, 8 columns per pass
+ *
+ *****************************************************************************/
+KERNEL_TARGET("sse4.1")
+static int column_add_sse41( uint32_t *column, const wide_pixel *enter,
+	const wide_pixel *leave, int count )
+{
+	int j = 0;
+
+	for ( ; j + 8 <= count; j += 8)
+	{
+		__m128i in = _mm_loadu_si128((const __m128i *) (enter + j));
+		__m128i out = leave ? _mm_loadu_si128((const __m128i *) (leave + j))
+			: _mm_setzero_si128();
+		__m128i *sum = (__m128i *) (column + j);
+
+		__m128i low = _mm_add_epi32(_mm_loadu_si128(sum),
+			_mm_cvtepu16_epi32(in));
+		__m128i high = _mm_add_epi32(_mm_loadu_si128(sum + 1),
+			_mm_cvtepu16_epi32(_mm_srli_si128(in, 8)));
+
+		low = _mm_sub_epi32(low, _mm_cvtepu16_epi32(out));
+		high = _mm_sub_epi32(high,
+			_mm_cvtepu16_epi32(_mm_srli_si128(out, 8)));
+
+		_mm_storeu_si128(sum, low);
+		_mm_storeu_si128(sum + 1, high);
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of column_add, 32 columns per pass
+ *
+ *****************************************************************************/
+KERNEL_TARGET("avx2")
+static int column_add_avx2( uint16_t *column, const pixel *enter,
+	const pixel *leave, int count )
+{
+	int j = 0;
+
+	for ( ; j + 32 <= count; j += 32)
+	{
+		__m256i in = _mm256_loadu_si256((const __m256i *) (enter + j));
+		__m256i out = leave ?
+			_mm256_loadu_si256((const __m256i *) (leave + j)) :
+			_mm256_setzero_si256();
+		__m256i *sum = (__m256i *) (column + j);
+
+		__m256i low = _mm256_add_epi16(_mm256_loadu_si256(sum),
+			widen_avx2<0>(in));
+		__m256i high = _mm256_add_epi16(_mm256_loadu_si256(sum + 1),
+			widen_avx2<1>(in));
+
+		low = _mm256_sub_epi16(low, widen_avx2<0>(out));
+		high = _mm256_sub_epi16(high, widen_avx2<1>(out));
+
+		_mm256_storeu_si256(sum, low);
+		_mm256_storeu_si256(sum + 1, high);
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of column_add for 2 byte samples, 16 columns per pass
+ *
+ *****************************************************************************/
+KERNEL_TARGET("avx2")
+static int column_add_avx2( uint32_t *column, const wide_pixel *enter,
+	const wide_pixel *leave, int count )
+{
+	int j = 0;
+
+	for ( ; j + 16 <= count; j += 16)
+	{
+		__m256i in = _mm256_loadu_si256((const __m256i *) (enter + j));
+		__m256i out = leave ?
+			_mm256_loadu_si256((const __m256i *) (leave + j)) :
+			_mm256_setzero_si256();
+		__m256i *sum = (__m256i *) (column + j);
+
+		__m256i low = _mm256_add_epi32(_mm256_loadu_si256(sum),
+			widen_wide_avx2<0>(in));
+		__m256i high = _mm256_add_epi32(_mm256_loadu_si256(sum + 1),
+			widen_wide_avx2<1>(in));
+
+		low = _mm256_sub_epi32(low, widen_wide_avx2<0>(out));
+		high = _mm256_sub_epi32(high, widen_wide_avx2<1>(out));
+
+		_mm256_storeu_si256(sum, low);
+		_mm256_storeu_si256(sum + 1, high);
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * widens 4 column sums to 32 bits, or loads them when they already are
+ *
+ *****************************************************************************/
+KERNEL_TARGET("sse4.1")
+static inline __m128i column_load_sse41( const uint16_t *column )
+{
+	return _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *) column));
+}
+
+KERNEL_TARGET("sse4.1")
+static inline __m128i column_load_sse41( const uint32_t *column )
+{
+	return _mm_loadu_si128((const __m128i *) column);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE4.1 version of prefix_row, 4 sums per pass.  Each vector adds itself
+ * moved up STEP lanes and then 2 * STEP lanes, which gives the running
+ * totals within it, and then the last total of each colour from the
+ * vector before.
+ *
+ *****************************************************************************/
+template <int STEP, class S>
+KERNEL_TARGET("sse4.1")
+static int prefix_row_sse41( const S *column, uint32_t *prefix, int count )
+{
+	int j = 0;
+
+	//lanes of the vector before that end each colour, 3 1 2 3 for packed
+	const int carry = (STEP == 1) ? 0xFF : (1 | 2 << 2 | 3 << 4 | 1 << 6);
+	__m128i total = _mm_setzero_si128();
+
+	for ( ; j + 4 <= count; j += 4)
+	{
+		__m128i x = column_load_sse41(column + j);
+
+		x = _mm_add_epi32(x, _mm_slli_si128(x, 4 * STEP));
+		if (STEP == 1)
+			x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+		x = _mm_add_epi32(x, total);
+
+		_mm_storeu_si128((__m128i *) (prefix + j + STEP), x);
+		total = _mm_shuffle_epi32(x, carry);
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * widens 8 column sums to 32 bits, or loads them when they already are
+ *
+ *****************************************************************************/
+KERNEL_TARGET("avx2")
+static inline __m256i column_load_avx2( const uint16_t *column )
+{
+	return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) column));
+}
+
+KERNEL_TARGET("avx2")
+static inline __m256i column_load_avx2( const uint32_t *column )
+{
+	return _mm256_loadu_si256((const __m256i *) column);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of prefix_row, 8 sums per pass.  Lanes are moved up across
+ * the two halves with a permute, the lanes below the move cleared.
+ *
+ *****************************************************************************/
+template <int STEP, class S>
+KERNEL_TARGET("avx2")
+static int prefix_row_avx2( const S *column, uint32_t *prefix, int count )
+{
+	int j = 0;
+
+	//lane each lane takes when moved up by s, and the lanes that keep it
+	__m256i from[3];
+	__m256i keep[3];
+	int moves = 0;
+	for (int s = STEP; s < 8; s *= 2, moves++)
+	{
+		alignas(32) int index[8];
+		alignas(32) int mask[8];
+
+		for (int k = 0; k < 8; k++)
+		{
+			index[k] = (k >= s) ? k - s : 0;
+			mask[k] = (k >= s) ? -1 : 0;
+		}
+		from[moves] = _mm256_load_si256((const __m256i *) index);
+		keep[moves] = _mm256_load_si256((const __m256i *) mask);
+	}
+
+	//lanes of the vector before that end each colour
+	const __m256i carry = (STEP == 1) ? _mm256_set1_epi32(7) :
+		_mm256_setr_epi32(5, 6, 7, 5, 6, 7, 5, 6);
+	__m256i total = _mm256_setzero_si256();
+
+	for ( ; j + 8 <= count; j += 8)
+	{
+		__m256i x = column_load_avx2(column + j);
+
+		for (int m = 0; m < moves; m++)
+			x = _mm256_add_epi32(x, _mm256_and_si256(keep[m],
+				_mm256_permutevar8x32_epi32(x, from[m])));
+		x = _mm256_add_epi32(x, total);
+
+		_mm256_storeu_si256((__m256i *) (prefix + j + STEP), x);
+		total = _mm256_permutevar8x32_epi32(x, carry);
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE4.1 version of box_row, 16 pixels per pass.  The rounding multiply
+ * needs 64 bit products, so even and odd lanes are multiplied separately
+ * and put back together before packing down to samples.
+ *
+ *****************************************************************************/
+template <int STEP, class T>
+KERNEL_TARGET("sse4.1")
+static int box_row_sse41( const uint32_t *prefix, int radius,
+	const box_divider &divide, T *out, int first, int last )
+{
+	int j = first;
+
+	const __m128i count = _mm_set1_epi32(int(divide.count));
+	const __m128i multiply = _mm_set1_epi64x((long long) divide.multiply);
+	const __m128i shift = _mm_cvtsi32_si128(divide.shift);
+
+	//the box reaches radius pixels, STEP samples apart, each way
+	const uint32_t *ahead = prefix + (radius + 1) * STEP;
+	const uint32_t *behind = prefix - radius * STEP;
+
+	for ( ; j + 16 <= last; j += 16)
+	{
+		__m128i q[4];
+
+		for (int k = 0; k < 4; k++)
+		{
+			__m128i sum = _mm_sub_epi32(
+				_mm_loadu_si128((const __m128i *) (ahead + j + 4 * k)),
+				_mm_loadu_si128((const __m128i *) (behind + j + 4 * k)));
+			__m128i x = _mm_add_epi32(_mm_slli_epi32(sum, 1), count);
+
+			__m128i even = _mm_srl_epi64(_mm_mul_epu32(x, multiply), shift);
+			__m128i odd = _mm_srl_epi64(_mm_mul_epu32(_mm_srli_epi64(x, 32),
+				multiply), shift);
+			q[k] = _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+		}
+
+		if constexpr (sizeof(T) == 1)
+		{
+			__m128i words = _mm_packus_epi16(_mm_packus_epi32(q[0], q[1]),
+				_mm_packus_epi32(q[2], q[3]));
+			_mm_storeu_si128((__m128i *) (out + j), words);
+		}
+		else
+		{
+			_mm_storeu_si128((__m128i *) (out + j),
+				_mm_packus_epi32(q[0], q[1]));
+			_mm_storeu_si128((__m128i *) (out + j + 8),
+				_mm_packus_epi32(q[2], q[3]));
+		}
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of box_row, 16 pixels per pass
+ *
+ *****************************************************************************/
+template <int STEP, class T>
+KERNEL_TARGET("avx2")
+static int box_row_avx2( const uint32_t *prefix, int radius,
+	const box_divider &divide, T *out, int first, int last )
+{
+	int j = first;
+
+	const __m256i count = _mm256_set1_epi32(int(divide.count));
+	const __m256i multiply = _mm256_set1_epi64x((long long) divide.multiply);
+	const __m128i shift = _mm_cvtsi32_si128(divide.shift);
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	//the box reaches radius pixels, STEP samples apart, each way
+	const uint32_t *ahead = prefix + (radius + 1) * STEP;
+	const uint32_t *behind = prefix - radius * STEP;
+
+	for ( ; j + 16 <= last; j += 16)
+	{
+		__m256i q[2];
+
+		for (int k = 0; k < 2; k++)
+		{
+			__m256i sum = _mm256_sub_epi32(
+				_mm256_loadu_si256((const __m256i *) (ahead + j + 8 * k)),
+				_mm256_loadu_si256((const __m256i *) (behind + j + 8 * k)));
+			__m256i x = _mm256_add_epi32(_mm256_slli_epi32(sum, 1), count);
+
+			__m256i even = _mm256_srl_epi64(_mm256_mul_epu32(x, multiply),
+				shift);
+			__m256i odd = _mm256_srl_epi64(_mm256_mul_epu32(
+				_mm256_srli_epi64(x, 32), multiply), shift);
+			q[k] = _mm256_or_si256(even, _mm256_slli_epi64(odd, 32));
+		}
+
+		//the packs work per 128 bit half, the permutes put them in order
+		__m256i words = _mm256_packus_epi32(q[0], q[1]);
+		if constexpr (sizeof(T) == 1)
+		{
+			__m256i bytes = _mm256_packus_epi16(words, words);
+			bytes = _mm256_permutevar8x32_epi32(bytes, order);
+			_mm_storeu_si128((__m128i *) (out + j),
+				_mm256_castsi256_si128(bytes));
+		}
+		else
+			_mm256_storeu_si256((__m256i *) (out + j),
+				_mm256_permute4x64_epi64(words, 0xD8));
+	}
+	return j;
+}
+#endif
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * adds a row of pixels to a row of column sums and takes another row away
+ *
+ * @param[in][out] column - the sums
+ * @param[in]      enter - row to add
+ * @param[in]      leave - row to take away, nullptr for none
+ * @param[in]      count - amount of columns
+ *
+ *****************************************************************************/
+template <class T>
+void column_add( typename sample_traits<T>::column_sum *column,
+	const T *enter, const T *leave, int count )
+{
+	int j = 0;
+
+#ifdef KERNEL_X86
+	if (simd_active() >= SIMD_AVX2)
+		j = column_add_avx2(column, enter, leave, count);
+	else if (simd_active() >= SIMD_SSE41)
+		j = column_add_sse41(column, enter, leave, count);
+#endif
+
+	//finishes whatever the vector loop left over
+	for ( ; j < count; j++)
+		column[j] = typename sample_traits<T>::column_sum(column[j] +
+			enter[j] - (leave ? leave[j] : 0));
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * makes the running totals of a row of column sums, one total for each
+ * colour, so prefix[j + LAYOUT] is the sum of column[j] and every column
+ * before it LAYOUT samples apart.  The first LAYOUT totals are left 0.
+ *
+ * @param[in]      column - the column sums
+ * @param[out]     prefix - receives count + LAYOUT totals
+ * @param[in]      count - amount of columns, a whole number of pixels
+ *
+ *****************************************************************************/
+template <pixel_layout LAYOUT, class T>
+void prefix_row( const typename sample_traits<T>::column_sum *column,
+	uint32_t *prefix, int count )
+{
+	int j = 0;
+
+#ifdef KERNEL_X86
+	if (simd_active() >= SIMD_AVX2)
+		j = prefix_row_avx2<LAYOUT>(column, prefix, count);
+	else if (simd_active() >= SIMD_SSE41)
+		j = prefix_row_sse41<LAYOUT>(column, prefix, count);
+#endif
+
+	//finishes whatever the vector loop left over
+	for ( ; j < count; j++)
+		prefix[j + LAYOUT] = prefix[j] + column[j];
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * writes the rounded box average for samples first to last - 1 of a row.
+ * The pixels of a box are LAYOUT samples apart, so the box sum for sample
+ * j is prefix[j + (radius + 1) * LAYOUT] - prefix[j - radius * LAYOUT],
+ * and every output is independent and a whole vector is done at once.
+ * Boxes whose divider has no multiply are left to the plain loop.
+ *
+ * @param[in]      prefix - running totals of the column sums, prefix[k]
+ *						is the sum of the columns before k of the same
+ *						colour
+ * @param[in]      radius - reach of the box
+ * @param[in]      divide - rounding for the box size
+ * @param[out]     out - receives the averages
+ * @param[in]      first - first column written
+ * @param[in]      last - one past the last column written
+ *
+ *****************************************************************************/
+template <pixel_layout LAYOUT, class T>
+void box_row( const uint32_t *prefix, int radius, const box_divider &divide,
+	T *out, int first, int last )
+{
+	int j = first;
+
+#ifdef KERNEL_X86
+	//a box divided the slow way has no vector version
+	if (divide.multiply != 0 && simd_active() >= SIMD_AVX2)
+		j = box_row_avx2<LAYOUT>(prefix, radius, divide, out, first, last);
+	else if (divide.multiply != 0 && simd_active() >= SIMD_SSE41)
+		j = box_row_sse41<LAYOUT>(prefix, radius, divide, out, first, last);
+#endif
+
+	//finishes whatever the vector loop left over
+	for ( ; j < last; j++)
+		out[j] = box_average<T>(prefix[j + (radius + 1) * LAYOUT] -
+			prefix[j - radius * LAYOUT], divide);
+}
+
+template void column_add<pixel>( uint16_t *, const pixel *, const pixel *,
+	int );
+template void column_add<wide_pixel>( uint32_t *, const wide_pixel *,
+	const wide_pixel *, int );
+template void prefix_row<LAYOUT_PLANAR, pixel>( const uint16_t *,
+	uint32_t *, int );
+template void prefix_row<LAYOUT_PLANAR, wide_pixel>( const uint32_t *,
+	uint32_t *, int );
+template void prefix_row<LAYOUT_PACKED, pixel>( const uint16_t *,
+	uint32_t *, int );
+template void prefix_row<LAYOUT_PACKED, wide_pixel>( const uint32_t *,
+	uint32_t *, int );
+template void box_row<LAYOUT_PLANAR>( const uint32_t *, int,
+	const box_divider &, pixel *, int, int );
+template void box_row<LAYOUT_PLANAR>( const uint32_t *, int,
+	const box_divider &, wide_pixel *, int, int );
+template void box_row<LAYOUT_PACKED>( const uint32_t *, int,
+	const box_divider &, pixel *, int, int );
+template void box_row<LAYOUT_PACKED>( const uint32_t *, int,
+	const box_divider &, wide_pixel *, int, int );
+
+
+/*******************************************************************************
+ *                         Lookup tables
+ ******************************************************************************/
+#ifdef KERNEL_X86
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE4.1 version of lut_row, 16 pixels per pass.  pshufb can only look up
+ * 16 entries, so the table is walked as 16 rows of 16.  For row k the high
+ * four bits of each pixel are xor'ed with k, which leaves them zero only
+ * for the pixels in that row, and a saturating add of 0x70 then sets the
+ * top bit of every other pixel so pshufb gives zero for them.  Or'ing the
+ * 16 lookups together leaves each pixel's own entry.  The lookups do not
+ * depend on each other, so two running results keep the chain short.
+ *
+ *****************************************************************************/
+KERNEL_TARGET("sse4.1")
+static int lut_row_sse41( const pixel *table, const pixel *src, pixel *dst,
+	int count )
+{
+	__m128i rows[16];
+	__m128i high[16];
+	const __m128i spread = _mm_set1_epi8(0x70);
+	int j = 0;
+	int k = 0;
+
+	for (k = 0; k < 16; k++)
+	{
+		rows[k] = _mm_loadu_si128((const __m128i *) (table + 16 * k));
+		high[k] = _mm_set1_epi8(char(k << 4));
+	}
+
+	for ( ; j + 16 <= count; j += 16)
+	{
+		__m128i value = _mm_loadu_si128((const __m128i *) (src + j));
+		__m128i even = _mm_setzero_si128();
+		__m128i odd = _mm_setzero_si128();
+
+		for (k = 0; k < 16; k += 2)
+		{
+			even = _mm_or_si128(even, _mm_shuffle_epi8(rows[k],
+				_mm_adds_epu8(_mm_xor_si128(value, high[k]), spread)));
+			odd = _mm_or_si128(odd, _mm_shuffle_epi8(rows[k + 1],
+				_mm_adds_epu8(_mm_xor_si128(value, high[k + 1]), spread)));
+		}
+		_mm_storeu_si128((__m128i *) (dst + j), _mm_or_si128(even, odd));
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of lut_row, 32 pixels per pass.  vpshufb looks up within
+ * each 128 bit half, so every table row is copied into both halves.
+ *
+ *****************************************************************************/
+KERNEL_TARGET("avx2")
+static int lut_row_avx2( const pixel *table, const pixel *src, pixel *dst,
+	int count )
+{
+	__m256i rows[16];
+	__m256i high[16];
+	const __m256i spread = _mm256_set1_epi8(0x70);
+	int j = 0;
+	int k = 0;
+
+	for (k = 0; k < 16; k++)
+	{
+		rows[k] = _mm256_broadcastsi128_si256(
+			_mm_loadu_si128((const __m128i *) (table + 16 * k)));
+		high[k] = _mm256_set1_epi8(char(k << 4));
+	}
+
+	for ( ; j + 32 <= count; j += 32)
+	{
+		__m256i value = _mm256_loadu_si256((const __m256i *) (src + j));
+		__m256i even = _mm256_setzero_si256();
+		__m256i odd = _mm256_setzero_si256();
+
+		for (k = 0; k < 16; k += 2)
+		{
+			even = _mm256_or_si256(even, _mm256_shuffle_epi8(rows[k],
+				_mm256_adds_epu8(_mm256_xor_si256(value, high[k]), spread)));
+			odd = _mm256_or_si256(odd, _mm256_shuffle_epi8(rows[k + 1],
+				_mm256_adds_epu8(_mm256_xor_si256(value, high[k + 1]),
+				spread)));
+		}
+		_mm256_storeu_si256((__m256i *) (dst + j),
+			_mm256_or_si256(even, odd));
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of lut_row for 2 byte samples, 16 pixels per pass.  A table
+ * of 65536 entries is too large for shuffles, so the entries are gathered
+ * 4 bytes at a time and the upper 2 bytes, the next entry, dropped.  The
+ * table's pad entry keeps the gather of the last entry inside it.
+ *
+ *****************************************************************************/
+KERNEL_TARGET("avx2")
+static int lut_row_avx2( const wide_pixel *table, const wide_pixel *src,
+	wide_pixel *dst, int count )
+{
+	const __m256i low = _mm256_set1_epi32(0xffff);
+	const int *base = (const int *) table;
+	int j = 0;
+
+	for ( ; j + 16 <= count; j += 16)
+	{
+		__m256i first = _mm256_cvtepu16_epi32(
+			_mm_loadu_si128((const __m128i *) (src + j)));
+		__m256i second = _mm256_cvtepu16_epi32(
+			_mm_loadu_si128((const __m128i *) (src + j + 8)));
+
+		first = _mm256_and_si256(_mm256_i32gather_epi32(base, first, 2), low);
+		second = _mm256_and_si256(_mm256_i32gather_epi32(base, second, 2),
+			low);
+
+		//the pack works per 128 bit half, the permute puts them in order
+		_mm256_storeu_si256((__m256i *) (dst + j), _mm256_permute4x64_epi64(
+			_mm256_packus_epi32(first, second), 0xD8));
+	}
+	return j;
+}
+#endif
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * replaces every pixel with its entry in a table of every sample value.
+ * src and dst may be the same row.  2 byte samples have no SSE4.1 version;
+ * the plain loop does as well as 16 byte shuffles would.
+ *
+ * @param[in]      table - the table, see basic_lut
+ * @param[in]      src - pixels to look up
+ * @param[out]     dst - receives the looked up pixels
+ * @param[in]      count - amount of pixels
+ *
+ *****************************************************************************/
+template <class T>
+void lut_row( const T *table, const T *src, T *dst, int count )
+{
+	int j = 0;
+
+#ifdef KERNEL_X86
+	if (simd_active() >= SIMD_AVX2)
+		j = lut_row_avx2(table, src, dst, count);
+	else if constexpr (sizeof(T) == 1)
+	{
+		if (simd_active() >= SIMD_SSE41)
+			j = lut_row_sse41(table, src, dst, count);
+	}
+#endif
+
+	//finishes whatever the vector loop left over
+	for ( ; j < count; j++)
+		dst[j] = table[src[j]];
+}
+
+template void lut_row( const pixel *, const pixel *, pixel *, int );
+template void lut_row( const wide_pixel *, const wide_pixel *, wide_pixel *,
+	int );
+
+
+/*******************************************************************************
+ *                         Value range
+ ******************************************************************************/
+#ifdef KERNEL_X86
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE4.1 version of range_row, 64 bytes per pass.  Four running minimums
+ * and maximums keep the chains short; they are folded together at the end.
+ *
+ *****************************************************************************/
+template <class T>
+KERNEL_TARGET("sse4.1")
+static int range_row_sse41( const T *src, int count, int &low, int &high )
+{
+	const int lanes = 16 / sizeof(T);
+	__m128i least[4];
+	__m128i most[4];
+	int j = 0;
+	int k = 0;
+
+	if (count < 4 * lanes)
+		return 0;
+
+	for (k = 0; k < 4; k++)
+		least[k] = most[k] = _mm_loadu_si128((const __m128i *) src);
+
+	for ( ; j + 4 * lanes <= count; j += 4 * lanes)
+	{
+		for (k = 0; k < 4; k++)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i *) (src + j +
+				k * lanes));
+
+			if constexpr (sizeof(T) == 1)
+			{
+				least[k] = _mm_min_epu8(least[k], v);
+				most[k] = _mm_max_epu8(most[k], v);
+			}
+			else
+			{
+				least[k] = _mm_min_epu16(least[k], v);
+				most[k] = _mm_max_epu16(most[k], v);
+			}
+		}
+	}
+
+	T lows[4 * 16 / sizeof(T)];
+	T highs[4 * 16 / sizeof(T)];
+	for (k = 0; k < 4; k++)
+	{
+		_mm_storeu_si128((__m128i *) (lows + k * lanes), least[k]);
+		_mm_storeu_si128((__m128i *) (highs + k * lanes), most[k]);
+	}
+	for (k = 0; k < 4 * lanes; k++)
+	{
+		low = min(low, int(lows[k]));
+		high = max(high, int(highs[k]));
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of range_row, 128 bytes per pass
+ *
+ *****************************************************************************/
+template <class T>
+KERNEL_TARGET("avx2")
+static int range_row_avx2( const T *src, int count, int &low, int &high )
+{
+	const int lanes = 32 / sizeof(T);
+	__m256i least[4];
+	__m256i most[4];
+	int j = 0;
+	int k = 0;
+
+	if (count < 4 * lanes)
+		return 0;
+
+	for (k = 0; k < 4; k++)
+		least[k] = most[k] = _mm256_loadu_si256((const __m256i *) src);
+
+	for ( ; j + 4 * lanes <= count; j += 4 * lanes)
+	{
+		for (k = 0; k < 4; k++)
+		{
+			__m256i v = _mm256_loadu_si256((const __m256i *) (src + j +
+				k * lanes));
+
+			if constexpr (sizeof(T) == 1)
+			{
+				least[k] = _mm256_min_epu8(least[k], v);
+				most[k] = _mm256_max_epu8(most[k], v);
+			}
+			else
+			{
+				least[k] = _mm256_min_epu16(least[k], v);
+				most[k] = _mm256_max_epu16(most[k], v);
+			}
+		}
+	}
+
+	T lows[4 * 32 / sizeof(T)];
+	T highs[4 * 32 / sizeof(T)];
+	for (k = 0; k < 4; k++)
+	{
+		_mm256_storeu_si256((__m256i *) (lows + k * lanes), least[k]);
+		_mm256_storeu_si256((__m256i *) (highs + k * lanes), most[k]);
+	}
+	for (k = 0; k < 4 * lanes; k++)
+	{
+		low = min(low, int(lows[k]));
+		high = max(high, int(highs[k]));
+	}
+	return j;
+}
+#endif
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * widens low - high to take in every pixel of a row.  The caller starts
+ * them at largest and 0, or at the range of the rows before.
+ *
+ * @param[in]      src - pixels to look at
+ * @param[in]      count - amount of pixels
+ * @param[in][out] low - smallest value seen so far
+ * @param[in][out] high - largest value seen so far
+ *
+ *****************************************************************************/
+template <class T>
+void range_row( const T *src, int count, int &low, int &high )
+{
+	int j = 0;
+
+#ifdef KERNEL_X86
+	if (simd_active() >= SIMD_AVX2)
+		j = range_row_avx2(src, count, low, high);
+	else if (simd_active() >= SIMD_SSE41)
+		j = range_row_sse41(src, count, low, high);
+#endif
+
+	//finishes whatever the vector loop left over
+	for ( ; j < count; j++)
+	{
+		low = min(low, int(src[j]));
+		high = max(high, int(src[j]));
+	}
+}
+
+template void range_row( const pixel *, int, int &, int & );
+template void range_row( const wide_pixel *, int, int &, int & );
+
+
+/*******************************************************************************
+ *                         Greyscale
+ ******************************************************************************/
+//BT.601 and BT.709 weights out of 1 << GREY_SHIFT, adding up to exactly that
+	//so white stays white
+static const int GREY_SHIFT = 15;
+static const int GREY_ROUND = 1 << (GREY_SHIFT - 1);
+
+/*!
+ * @brief the fixed point weights of one weight set
+ */
+struct grey_fixed
+{
+	int red;	/*!< red weight */
+	int green;	/*!< green weight */
+	int blue;	/*!< blue weight */
+};
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives the fixed point weights of BT.601 or BT.709
+ *
+ * @param[in]      weights - GREY_BT601 or GREY_BT709
+ *
+ * @returns the weights
+ *
+ *****************************************************************************/
+static grey_fixed grey_scale( grey_weights weights )
+{
+	if (weights == GREY_BT709)
+		return grey_fixed { 6966, 23436, 2366 };
+	return grey_fixed { 9798, 19235, 3735 };
+}
+
+#ifdef KERNEL_X86
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE4.1 version of the fixed point greyscale, 16 pixels per pass.  Red and
+ * green are paired up, and blue with a 1 that picks up the rounding, so two
+ * pmaddwd give each pixel's whole sum.
+ *
+ *****************************************************************************/
+KERNEL_TARGET("sse4.1")
+static int grey_row_sse41( const pixel *red, const pixel *green,
+	const pixel *blue, pixel *grey, int count, grey_fixed w )
+{
+	const __m128i red_green = _mm_set1_epi32((w.green << 16) | w.red);
+	const __m128i blue_round = _mm_set1_epi32((GREY_ROUND << 16) | w.blue);
+	const __m128i one = _mm_set1_epi16(1);
+	int j = 0;
+	int k = 0;
+
+	for ( ; j + 16 <= count; j += 16)
+	{
+		__m128i r = _mm_loadu_si128((const __m128i *) (red + j));
+		__m128i g = _mm_loadu_si128((const __m128i *) (green + j));
+		__m128i b = _mm_loadu_si128((const __m128i *) (blue + j));
+		__m128i half[2];
+
+		for (k = 0; k < 2; k++)
+		{
+			__m128i r16 = _mm_cvtepu8_epi16(r);
+			__m128i g16 = _mm_cvtepu8_epi16(g);
+			__m128i b16 = _mm_cvtepu8_epi16(b);
+
+			__m128i low = _mm_add_epi32(
+				_mm_madd_epi16(_mm_unpacklo_epi16(r16, g16), red_green),
+				_mm_madd_epi16(_mm_unpacklo_epi16(b16, one), blue_round));
+			__m128i high = _mm_add_epi32(
+				_mm_madd_epi16(_mm_unpackhi_epi16(r16, g16), red_green),
+				_mm_madd_epi16(_mm_unpackhi_epi16(b16, one), blue_round));
+
+			half[k] = _mm_packs_epi32(_mm_srli_epi32(low, GREY_SHIFT),
+				_mm_srli_epi32(high, GREY_SHIFT));
+
+			r = _mm_srli_si128(r, 8);
+			g = _mm_srli_si128(g, 8);
+			b = _mm_srli_si128(b, 8);
+		}
+		_mm_storeu_si128((__m128i *) (grey + j),
+			_mm_packus_epi16(half[0], half[1]));
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE4.1 version of the fixed point greyscale for 2 byte samples, 8 pixels
+ * per pass.  The samples do not fit pmaddwd, so they are widened and
+ * multiplied as 32 bits.
+ *
+ *****************************************************************************/
+KERNEL_TARGET("sse4.1")
+static int grey_row_sse41( const wide_pixel *red, const wide_pixel *green,
+	const wide_pixel *blue, wide_pixel *grey, int count, grey_fixed w )
+{
+	const __m128i red_weight = _mm_set1_epi32(w.red);
+	const __m128i green_weight = _mm_set1_epi32(w.green);
+	const __m128i blue_weight = _mm_set1_epi32(w.blue);
+	const __m128i round = _mm_set1_epi32(GREY_ROUND);
+	int j = 0;
+	int k = 0;
+
+	for ( ; j + 8 <= count; j += 8)
+	{
+		__m128i half[2];
+
+		for (k = 0; k < 2; k++)
+		{
+			__m128i r = _mm_cvtepu16_epi32(
+				_mm_loadl_epi64((const __m128i *) (red + j + 4 * k)));
+			__m128i g = _mm_cvtepu16_epi32(
+				_mm_loadl_epi64((const __m128i *) (green + j + 4 * k)));
+			__m128i b = _mm_cvtepu16_epi32(
+				_mm_loadl_epi64((const __m128i *) (blue + j + 4 * k)));
+
+			__m128i sum = _mm_add_epi32(_mm_mullo_epi32(r, red_weight),
+				_mm_mullo_epi32(g, green_weight));
+			sum = _mm_add_epi32(sum, _mm_mullo_epi32(b, blue_weight));
+			half[k] = _mm_srli_epi32(_mm_add_epi32(sum, round), GREY_SHIFT);
+		}
+		_mm_storeu_si128((__m128i *) (grey + j),
+			_mm_packus_epi32(half[0], half[1]));
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of the fixed point greyscale, 32 pixels per pass.  The
+ * unpacks and packs both work per 128 bit half, so each 16 pixels come
+ * back in order and only the last pack needs a permute.
+ *
+ *****************************************************************************/
+KERNEL_TARGET("avx2")
+static int grey_row_avx2( const pixel *red, const pixel *green,
+	const pixel *blue, pixel *grey, int count, grey_fixed w )
+{
+	const __m256i red_green = _mm256_set1_epi32((w.green << 16) | w.red);
+	const __m256i blue_round = _mm256_set1_epi32((GREY_ROUND << 16) |
+		w.blue);
+	const __m256i one = _mm256_set1_epi16(1);
+	int j = 0;
+	int k = 0;
+
+	for ( ; j + 32 <= count; j += 32)
+	{
+		__m256i half[2];
+
+		for (k = 0; k < 2; k++)
+		{
+			__m256i r = _mm256_cvtepu8_epi16(
+				_mm_loadu_si128((const __m128i *) (red + j + 16 * k)));
+			__m256i g = _mm256_cvtepu8_epi16(
+				_mm_loadu_si128((const __m128i *) (green + j + 16 * k)));
+			__m256i b = _mm256_cvtepu8_epi16(
+				_mm_loadu_si128((const __m128i *) (blue + j + 16 * k)));
+
+			__m256i low = _mm256_add_epi32(
+				_mm256_madd_epi16(_mm256_unpacklo_epi16(r, g), red_green),
+				_mm256_madd_epi16(_mm256_unpacklo_epi16(b, one),
+				blue_round));
+			__m256i high = _mm256_add_epi32(
+				_mm256_madd_epi16(_mm256_unpackhi_epi16(r, g), red_green),
+				_mm256_madd_epi16(_mm256_unpackhi_epi16(b, one),
+				blue_round));
+
+			half[k] = _mm256_packs_epi32(
+				_mm256_srli_epi32(low, GREY_SHIFT),
+				_mm256_srli_epi32(high, GREY_SHIFT));
+		}
+		_mm256_storeu_si256((__m256i *) (grey + j), _mm256_permute4x64_epi64(
+			_mm256_packus_epi16(half[0], half[1]), 0xD8));
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of the fixed point greyscale for 2 byte samples, 16 pixels
+ * per pass
+ *
+ *****************************************************************************/
+KERNEL_TARGET("avx2")
+static int grey_row_avx2( const wide_pixel *red, const wide_pixel *green,
+	const wide_pixel *blue, wide_pixel *grey, int count, grey_fixed w )
+{
+	const __m256i red_weight = _mm256_set1_epi32(w.red);
+	const __m256i green_weight = _mm256_set1_epi32(w.green);
+	const __m256i blue_weight = _mm256_set1_epi32(w.blue);
+	const __m256i round = _mm256_set1_epi32(GREY_ROUND);
+	int j = 0;
+	int k = 0;
+
+	for ( ; j + 16 <= count; j += 16)
+	{
+		__m256i half[2];
+
+		for (k = 0; k < 2; k++)
+		{
+			__m256i r = _mm256_cvtepu16_epi32(
+				_mm_loadu_si128((const __m128i *) (red + j + 8 * k)));
+			__m256i g = _mm256_cvtepu16_epi32(
+				_mm_loadu_si128((const __m128i *) (green + j + 8 * k)));
+			__m256i b = _mm256_cvtepu16_epi32(
+				_mm_loadu_si128((const __m128i *) (blue + j + 8 * k)));
+
+			__m256i sum = _mm256_add_epi32(_mm256_mullo_epi32(r, red_weight),
+				_mm256_mullo_epi32(g, green_weight));
+			sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(b, blue_weight));
+			half[k] = _mm256_srli_epi32(_mm256_add_epi32(sum, round),
+				GREY_SHIFT);
+		}
+		_mm256_storeu_si256((__m256i *) (grey + j), _mm256_permute4x64_epi64(
+			_mm256_packus_epi32(half[0], half[1]), 0xD8));
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of the legacy greyscale, 16 pixels per pass.  It does the
+ * same double multiplies and adds in the same order as the plain loop, so
+ * every pixel comes out the same, rounding quirks and all.
+ *
+ *****************************************************************************/
+template <class T>
+KERNEL_TARGET("avx2")
+static int grey_legacy_avx2( const T *red, const T *green, T *grey,
+	int count )
+{
+	const __m256d red_weight = _mm256_set1_pd(.3);
+	const __m256d green_weight = _mm256_set1_pd(.6);
+	const __m256d extra_weight = _mm256_set1_pd(.1);
+	int j = 0;
+	int k = 0;
+
+	for ( ; j + 16 <= count; j += 16)
+	{
+		__m128i part[4];
+
+		for (k = 0; k < 4; k++)
+		{
+			__m128i r;
+			__m128i g;
+
+			if constexpr (sizeof(T) == 1)
+			{
+				int four[2];
+
+				memcpy(&four[0], red + j + 4 * k, 4);
+				memcpy(&four[1], green + j + 4 * k, 4);
+				r = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(four[0]));
+				g = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(four[1]));
+			}
+			else
+			{
+				r = _mm_cvtepu16_epi32(
+					_mm_loadl_epi64((const __m128i *) (red + j + 4 * k)));
+				g = _mm_cvtepu16_epi32(
+					_mm_loadl_epi64((const __m128i *) (green + j + 4 * k)));
+			}
+
+			__m256d rd = _mm256_cvtepi32_pd(r);
+			__m256d gd = _mm256_cvtepi32_pd(g);
+			__m256d sum = _mm256_add_pd(_mm256_mul_pd(red_weight, rd),
+				_mm256_mul_pd(green_weight, gd));
+			sum = _mm256_add_pd(sum, _mm256_mul_pd(extra_weight, gd));
+			part[k] = _mm256_cvttpd_epi32(sum);
+		}
+
+		__m128i low = _mm_packus_epi32(part[0], part[1]);
+		__m128i high = _mm_packus_epi32(part[2], part[3]);
+		if constexpr (sizeof(T) == 1)
+			_mm_storeu_si128((__m128i *) (grey + j),
+				_mm_packus_epi16(low, high));
+		else
+		{
+			_mm_storeu_si128((__m128i *) (grey + j), low);
+			_mm_storeu_si128((__m128i *) (grey + j + 8), high);
+		}
+	}
+	return j;
+}
+#endif
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * the greyscale formula for one row.  BT.601 and BT.709 are worked in
+ * fixed point.  The legacy weights, .3 red + .6 green + .1 green, are
+ * worked in double the way they always were, since the doubles round
+ * some sums that should be whole numbers down by one and pictures made
+ * before should not change; they never read blue.
+ *
+ * @param[in]      red - red pixels of the row
+ * @param[in]      green - green pixels of the row
+ * @param[in]      blue - blue pixels of the row
+ * @param[out]     grey - receives the greyscale pixels
+ * @param[in]      count - amount of pixels in the row
+ * @param[in]      weights - the weight set
+ *
+ *****************************************************************************/
+template <class T>
+void grey_row( const T *red, const T *green, const T *blue, T *grey,
+	int count, grey_weights weights )
+{
+	int j = 0;
+
+	if (weights == GREY_LEGACY)
+	{
+#ifdef KERNEL_X86
+		if (simd_active() >= SIMD_AVX2)
+			j = grey_legacy_avx2(red, green, grey, count);
+#endif
+		for ( ; j < count; j++)
+			grey[j] = T( int(.3 * double(red[j]) + .6 *
+				double(green[j]) + .1 * double(green[j])));
+		return;
+	}
+
+	grey_fixed w = grey_scale(weights);
+
+#ifdef KERNEL_X86
+	if (simd_active() >= SIMD_AVX2)
+		j = grey_row_avx2(red, green, blue, grey, count, w);
+	else if (simd_active() >= SIMD_SSE41)
+		j = grey_row_sse41(red, green, blue, grey, count, w);
+#endif
+
+	//finishes whatever the vector loop left over
+	for ( ; j < count; j++)
+		grey[j] = T((uint32_t(red[j]) * w.red + uint32_t(green[j]) * w.green +
+			uint32_t(blue[j]) * w.blue + GREY_ROUND) >> GREY_SHIFT);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * the greyscale formula for one row of rgb triples as a P6 file holds
+ * them.  Pieces of the row are split into colorbands small enough to stay
+ * in cache and turned grey from there, so the picture is only read once.
+ *
+ * @param[in]      src - count rgb triples
+ * @param[out]     grey - receives the greyscale pixels
+ * @param[in]      count - amount of pixels in the row
+ * @param[in]      weights - the weight set
+ *
+ *****************************************************************************/
+template <class T>
+void grey_packed( const T *src, T *grey, int count, grey_weights weights )
+{
+	//loop variable
+	int j = 0;
+
+	const int piece = 1024;
+	T red[piece];
+	T green[piece];
+	T blue[piece];
+
+	for (j = 0; j < count; j += piece)
+	{
+		int n = min(piece, count - j);
+
+		split_rgb(src + 3 * size_t(j), red, green, blue, n);
+		grey_row(red, green, blue, grey + j, n, weights);
+	}
+}
+
+template void grey_row( const pixel *, const pixel *, const pixel *, pixel *,
+	int, grey_weights );
+template void grey_row( const wide_pixel *, const wide_pixel *,
+	const wide_pixel *, wide_pixel *, int, grey_weights );
+template void grey_packed( const pixel *, pixel *, int, grey_weights );
+template void grey_packed( const wide_pixel *, wide_pixel *, int,
+	grey_weights );
+
+
+/*******************************************************************************
+ *                         2x2 average
+ ******************************************************************************/
+#ifdef KERNEL_X86
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE4.1 version of half_row, 16 pixels out per pass.  pmaddubsw against
+ * ones adds each pair of bytes side by side into 16 bits, the two rows'
+ * sums are added, and the total is rounded, shifted down, and packed.
+ *
+ *****************************************************************************/
+KERNEL_TARGET("sse4.1")
+static int half_row_sse41( const pixel *top, const pixel *bottom,
+	pixel *out, int count )
+{
+	const __m128i ones = _mm_set1_epi8(1);
+	const __m128i round = _mm_set1_epi16(2);
+	int j = 0;
+
+	for ( ; j + 16 <= count; j += 16)
+	{
+		__m128i sum[2];
+
+		for (int k = 0; k < 2; k++)
+		{
+			__m128i up = _mm_loadu_si128((const __m128i *) (top + 2 * j +
+				16 * k));
+			__m128i down = _mm_loadu_si128((const __m128i *) (bottom +
+				2 * j + 16 * k));
+
+			sum[k] = _mm_add_epi16(_mm_maddubs_epi16(up, ones),
+				_mm_maddubs_epi16(down, ones));
+			sum[k] = _mm_srli_epi16(_mm_add_epi16(sum[k], round), 2);
+		}
+		_mm_storeu_si128((__m128i *) (out + j),
+			_mm_packus_epi16(sum[0], sum[1]));
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE4.1 version of half_row for 2 byte samples, 8 pixels out per pass.
+ * Each pair side by side shares a 32 bit lane, so the lane's low half
+ * plus its high half is their sum.
+ *
+ *****************************************************************************/
+KERNEL_TARGET("sse4.1")
+static int half_row_sse41( const wide_pixel *top, const wide_pixel *bottom,
+	wide_pixel *out, int count )
+{
+	const __m128i low = _mm_set1_epi32(0xffff);
+	const __m128i round = _mm_set1_epi32(2);
+	int j = 0;
+
+	for ( ; j + 8 <= count; j += 8)
+	{
+		__m128i sum[2];
+
+		for (int k = 0; k < 2; k++)
+		{
+			__m128i up = _mm_loadu_si128((const __m128i *) (top + 2 * j +
+				8 * k));
+			__m128i down = _mm_loadu_si128((const __m128i *) (bottom +
+				2 * j + 8 * k));
+
+			sum[k] = _mm_add_epi32(
+				_mm_add_epi32(_mm_and_si128(up, low), _mm_srli_epi32(up, 16)),
+				_mm_add_epi32(_mm_and_si128(down, low),
+				_mm_srli_epi32(down, 16)));
+			sum[k] = _mm_srli_epi32(_mm_add_epi32(sum[k], round), 2);
+		}
+		_mm_storeu_si128((__m128i *) (out + j),
+			_mm_packus_epi32(sum[0], sum[1]));
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of half_row, 32 pixels out per pass
+ *
+ *****************************************************************************/
+KERNEL_TARGET("avx2")
+static int half_row_avx2( const pixel *top, const pixel *bottom,
+	pixel *out, int count )
+{
+	const __m256i ones = _mm256_set1_epi8(1);
+	const __m256i round = _mm256_set1_epi16(2);
+	int j = 0;
+
+	for ( ; j + 32 <= count; j += 32)
+	{
+		__m256i sum[2];
+
+		for (int k = 0; k < 2; k++)
+		{
+			__m256i up = _mm256_loadu_si256((const __m256i *) (top + 2 * j +
+				32 * k));
+			__m256i down = _mm256_loadu_si256((const __m256i *) (bottom +
+				2 * j + 32 * k));
+
+			sum[k] = _mm256_add_epi16(_mm256_maddubs_epi16(up, ones),
+				_mm256_maddubs_epi16(down, ones));
+			sum[k] = _mm256_srli_epi16(_mm256_add_epi16(sum[k], round), 2);
+		}
+
+		//the pack works per 128 bit half, the permute puts them in order
+		_mm256_storeu_si256((__m256i *) (out + j), _mm256_permute4x64_epi64(
+			_mm256_packus_epi16(sum[0], sum[1]), 0xD8));
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of half_row for 2 byte samples, 16 pixels out per pass
+ *
+ *****************************************************************************/
+KERNEL_TARGET("avx2")
+static int half_row_avx2( const wide_pixel *top, const wide_pixel *bottom,
+	wide_pixel *out, int count )
+{
+	const __m256i low = _mm256_set1_epi32(0xffff);
+	const __m256i round = _mm256_set1_epi32(2);
+	int j = 0;
+
+	for ( ; j + 16 <= count; j += 16)
+	{
+		__m256i sum[2];
+
+		for (int k = 0; k < 2; k++)
+		{
+			__m256i up = _mm256_loadu_si256((const __m256i *) (top + 2 * j +
+				16 * k));
+			__m256i down = _mm256_loadu_si256((const __m256i *) (bottom +
+				2 * j + 16 * k));
+
+			sum[k] = _mm256_add_epi32(_mm256_add_epi32(
+				_mm256_and_si256(up, low), _mm256_srli_epi32(up, 16)),
+				_mm256_add_epi32(_mm256_and_si256(down, low),
+				_mm256_srli_epi32(down, 16)));
+			sum[k] = _mm256_srli_epi32(_mm256_add_epi32(sum[k], round), 2);
+		}
+		_mm256_storeu_si256((__m256i *) (out + j), _mm256_permute4x64_epi64(
+			_mm256_packus_epi32(sum[0], sum[1]), 0xD8));
+	}
+	return j;
+}
+#endif
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * halves a pair of rows both ways: each pixel out is the rounded average
+ * of the 2 by 2 block of pixels under it, so pixel j comes from pixels
+ * 2j and 2j + 1 of top and of bottom.  top and bottom may be the same row
+ * for a picture one row high.
+ *
+ * @param[in]      top - the upper row, 2 * count pixels
+ * @param[in]      bottom - the lower row, 2 * count pixels
+ * @param[out]     out - receives count pixels
+ * @param[in]      count - amount of pixels out
+ *
+ *****************************************************************************/
+template <class T>
+void half_row( const T *top, const T *bottom, T *out, int count )
+{
+	int j = 0;
+
+#ifdef KERNEL_X86
+	if (simd_active() >= SIMD_AVX2)
+		j = half_row_avx2(top, bottom, out, count);
+	else if (simd_active() >= SIMD_SSE41)
+		j = half_row_sse41(top, bottom, out, count);
+#endif
+
+	//finishes whatever the vector loop left over
+	for ( ; j < count; j++)
+		out[j] = T((uint32_t(top[2 * j]) + top[2 * j + 1] + bottom[2 * j] +
+			bottom[2 * j + 1] + 2) >> 2);
+}
+
+template void half_row( const pixel *, const pixel *, pixel *, int );
+template void half_row( const wide_pixel *, const wide_pixel *,
+	wide_pixel *, int );
+
+
+/*******************************************************************************
+ *                         Resample
+ ******************************************************************************/
+#ifdef KERNEL_X86
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * loads 4 bytes from p as the low 4 words of a vector
+ *
+ *****************************************************************************/
+KERNEL_TARGET("sse4.1")
+static inline __m128i load_four( const pixel *p )
+{
+	int32_t word;
+
+	memcpy(&word, p, sizeof(word));
+	return _mm_cvtepu8_epi16(_mm_cvtsi32_si128(word));
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * puts 4 bytes for pixel j and 4 for pixel j + 1 side by side as words,
+ * the samples at tap t of each one's window
+ *
+ *****************************************************************************/
+KERNEL_TARGET("sse4.1")
+static inline __m128i window_pair( const pixel *src, const int *first, int j,
+	int t )
+{
+	return _mm_unpacklo_epi64(load_four(src + first[j] + t),
+		load_four(src + first[j + 1] + t));
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * puts 4 weights of pixel j and 4 of pixel j + 1 side by side, from tap t
+ *
+ *****************************************************************************/
+KERNEL_TARGET("sse4.1")
+static inline __m128i weight_pair( const int16_t *weights, int taps, int j,
+	int t )
+{
+	return _mm_unpacklo_epi64(
+		_mm_loadl_epi64((const __m128i *) (weights + size_t(j) * taps + t)),
+		_mm_loadl_epi64((const __m128i *) (weights + size_t(j + 1) * taps +
+		t)));
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE4.1 version of filter_row, 4 pixels out per pass, for taps a multiple
+ * of 4.  pmaddwd multiplies 4 taps of two pixels at once into pairs of
+ * sums, and phaddd joins the pairs of four pixels into one sum each.
+ *
+ *****************************************************************************/
+KERNEL_TARGET("sse4.1")
+static int filter_row_sse41( const pixel *src, int16_t *out,
+	const int *first, const int16_t *weights, int taps, int count )
+{
+	const int shift = RESAMPLE_BITS - RESAMPLE_EXTRA;
+	const __m128i round = _mm_set1_epi32(1 << (shift - 1));
+	int j = 0;
+
+	if (taps % 4 != 0)
+		return 0;
+
+	for ( ; j + 4 <= count; j += 4)
+	{
+		__m128i sum = _mm_setzero_si128();
+
+		for (int t = 0; t < taps; t += 4)
+		{
+			__m128i near = _mm_madd_epi16(window_pair(src, first, j, t),
+				weight_pair(weights, taps, j, t));
+			__m128i far = _mm_madd_epi16(window_pair(src, first, j + 2, t),
+				weight_pair(weights, taps, j + 2, t));
+
+			sum = _mm_add_epi32(sum, _mm_hadd_epi32(near, far));
+		}
+		sum = _mm_srai_epi32(_mm_add_epi32(sum, round), shift);
+		_mm_storel_epi64((__m128i *) (out + j), _mm_packs_epi32(sum, sum));
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of filter_row, 8 pixels out per pass.  Pixels j to j + 3
+ * take the low half of each register and j + 4 to j + 7 the high half,
+ * which is how phaddd keeps them.
+ *
+ *****************************************************************************/
+KERNEL_TARGET("avx2")
+static int filter_row_avx2( const pixel *src, int16_t *out,
+	const int *first, const int16_t *weights, int taps, int count )
+{
+	const int shift = RESAMPLE_BITS - RESAMPLE_EXTRA;
+	const __m256i round = _mm256_set1_epi32(1 << (shift - 1));
+	int j = 0;
+
+	if (taps % 4 != 0)
+		return 0;
+
+	for ( ; j + 8 <= count; j += 8)
+	{
+		__m256i sum = _mm256_setzero_si256();
+
+		for (int t = 0; t < taps; t += 4)
+		{
+			__m256i near = _mm256_inserti128_si256(_mm256_castsi128_si256(
+				window_pair(src, first, j, t)),
+				window_pair(src, first, j + 4, t), 1);
+			__m256i far = _mm256_inserti128_si256(_mm256_castsi128_si256(
+				window_pair(src, first, j + 2, t)),
+				window_pair(src, first, j + 6, t), 1);
+			__m256i near_weights = _mm256_inserti128_si256(
+				_mm256_castsi128_si256(weight_pair(weights, taps, j, t)),
+				weight_pair(weights, taps, j + 4, t), 1);
+			__m256i far_weights = _mm256_inserti128_si256(
+				_mm256_castsi128_si256(weight_pair(weights, taps, j + 2, t)),
+				weight_pair(weights, taps, j + 6, t), 1);
+
+			sum = _mm256_add_epi32(sum, _mm256_hadd_epi32(
+				_mm256_madd_epi16(near, near_weights),
+				_mm256_madd_epi16(far, far_weights)));
+		}
+		sum = _mm256_srai_epi32(_mm256_add_epi32(sum, round), shift);
+
+		//each half holds its 4 words twice, the permute takes one of each
+		_mm_storeu_si128((__m128i *) (out + j), _mm256_castsi256_si128(
+			_mm256_permute4x64_epi64(_mm256_packs_epi32(sum, sum), 0x08)));
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE4.1 version of blend_rows, 16 pixels out per pass.  Two rows are
+ * interleaved word by word so one pmaddwd against the pair of their
+ * weights adds both into 32 bit sums; an odd last row is paired with
+ * zeros.
+ *
+ *****************************************************************************/
+KERNEL_TARGET("sse4.1")
+static int blend_rows_sse41( const int16_t *const *rows,
+	const int16_t *weights, int taps, pixel *out, int count, int top )
+{
+	const int shift = RESAMPLE_BITS + RESAMPLE_EXTRA;
+	const __m128i round = _mm_set1_epi32(1 << (shift - 1));
+	const __m128i most = _mm_set1_epi8(char(top));
+	int j = 0;
+
+	for ( ; j + 16 <= count; j += 16)
+	{
+		__m128i sum[4];
+		int t = 0;
+
+		for (int k = 0; k < 4; k++)
+			sum[k] = round;
+
+		for ( ; t < taps; t += 2)
+		{
+			bool pair = (t + 1 < taps);
+			__m128i both = _mm_set1_epi32(int32_t(uint16_t(weights[t])) |
+				(pair ? int32_t(uint32_t(uint16_t(weights[t + 1])) << 16) :
+				0));
+
+			for (int k = 0; k < 2; k++)
+			{
+				__m128i up = _mm_loadu_si128((const __m128i *) (rows[t] + j +
+					8 * k));
+				__m128i down = pair ? _mm_loadu_si128((const __m128i *)
+					(rows[t + 1] + j + 8 * k)) : _mm_setzero_si128();
+
+				sum[2 * k] = _mm_add_epi32(sum[2 * k], _mm_madd_epi16(
+					_mm_unpacklo_epi16(up, down), both));
+				sum[2 * k + 1] = _mm_add_epi32(sum[2 * k + 1], _mm_madd_epi16(
+					_mm_unpackhi_epi16(up, down), both));
+			}
+		}
+
+		for (int k = 0; k < 4; k++)
+			sum[k] = _mm_srai_epi32(sum[k], shift);
+		__m128i result = _mm_packus_epi16(_mm_packs_epi32(sum[0], sum[1]),
+			_mm_packs_epi32(sum[2], sum[3]));
+		_mm_storeu_si128((__m128i *) (out + j), _mm_min_epu8(result, most));
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of blend_rows, 32 pixels out per pass.  The unpacks and the
+ * first pack both work per 128 bit half, so they undo each other; the
+ * last pack is put in order by a permute.
+ *
+ *****************************************************************************/
+KERNEL_TARGET("avx2")
+static int blend_rows_avx2( const int16_t *const *rows,
+	const int16_t *weights, int taps, pixel *out, int count, int top )
+{
+	const int shift = RESAMPLE_BITS + RESAMPLE_EXTRA;
+	const __m256i round = _mm256_set1_epi32(1 << (shift - 1));
+	const __m256i most = _mm256_set1_epi8(char(top));
+	int j = 0;
+
+	for ( ; j + 32 <= count; j += 32)
+	{
+		__m256i sum[4];
+		int t = 0;
+
+		for (int k = 0; k < 4; k++)
+			sum[k] = round;
+
+		for ( ; t < taps; t += 2)
+		{
+			bool pair = (t + 1 < taps);
+			__m256i both = _mm256_set1_epi32(int32_t(uint16_t(weights[t])) |
+				(pair ? int32_t(uint32_t(uint16_t(weights[t + 1])) << 16) :
+				0));
+
+			for (int k = 0; k < 2; k++)
+			{
+				__m256i up = _mm256_loadu_si256((const __m256i *) (rows[t] +
+					j + 16 * k));
+				__m256i down = pair ? _mm256_loadu_si256((const __m256i *)
+					(rows[t + 1] + j + 16 * k)) : _mm256_setzero_si256();
+
+				sum[2 * k] = _mm256_add_epi32(sum[2 * k], _mm256_madd_epi16(
+					_mm256_unpacklo_epi16(up, down), both));
+				sum[2 * k + 1] = _mm256_add_epi32(sum[2 * k + 1],
+					_mm256_madd_epi16(_mm256_unpackhi_epi16(up, down), both));
+			}
+		}
+
+		for (int k = 0; k < 4; k++)
+			sum[k] = _mm256_srai_epi32(sum[k], shift);
+		__m256i result = _mm256_permute4x64_epi64(_mm256_packus_epi16(
+			_mm256_packs_epi32(sum[0], sum[1]),
+			_mm256_packs_epi32(sum[2], sum[3])), 0xD8);
+		_mm256_storeu_si256((__m256i *) (out + j),
+			_mm256_min_epu8(result, most));
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * 2 byte samples times their weights need 64 bit sums in the second pass,
+ * so they have no vector versions
+ *
+ *****************************************************************************/
+static int filter_row_sse41( const wide_pixel *, int32_t *, const int *,
+	const int16_t *, int, int )
+{
+	return 0;
+}
+
+static int filter_row_avx2( const wide_pixel *, int32_t *, const int *,
+	const int16_t *, int, int )
+{
+	return 0;
+}
+
+static int blend_rows_sse41( const int32_t *const *, const int16_t *, int,
+	wide_pixel *, int, int )
+{
+	return 0;
+}
+
+static int blend_rows_avx2( const int32_t *const *, const int16_t *, int,
+	wide_pixel *, int, int )
+{
+	return 0;
+}
+#endif
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * the first resample pass over one row.  Pixel j out is the sum of the
+ * taps samples from first[j] on times pixel j's weights, kept with
+ * RESAMPLE_EXTRA more fraction bits than a sample.  The vector versions
+ * take taps that are a multiple of 4.
+ *
+ * @param[in]      src - the source row
+ * @param[out]     out - receives count filtered samples
+ * @param[in]      first - first sample of each pixel's window
+ * @param[in]      weights - taps weights for each pixel, RESAMPLE_BITS
+ *						fraction bits
+ * @param[in]      taps - weights a pixel has
+ * @param[in]      count - amount of pixels out
+ *
+ *****************************************************************************/
+template <class T>
+void filter_row( const T *src, typename sample_traits<T>::filtered *out,
+	const int *first, const int16_t *weights, int taps, int count )
+{
+	typedef typename sample_traits<T>::filtered filtered;
+	const int shift = RESAMPLE_BITS - RESAMPLE_EXTRA;
+	int j = 0;
+
+#ifdef KERNEL_X86
+	if (simd_active() >= SIMD_AVX2)
+		j = filter_row_avx2(src, out, first, weights, taps, count);
+	else if (simd_active() >= SIMD_SSE41)
+		j = filter_row_sse41(src, out, first, weights, taps, count);
+#endif
+
+	//finishes whatever the vector loop left over
+	for ( ; j < count; j++)
+	{
+		const T *window = src + first[j];
+		const int16_t *weight = weights + size_t(j) * taps;
+		int64_t sum = 0;
+
+		for (int t = 0; t < taps; t++)
+			sum += int64_t(window[t]) * weight[t];
+		out[j] = filtered((sum + (1 << (shift - 1))) >> shift);
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * the second resample pass, making one row out from the filtered rows
+ * under it.  Each pixel is the sum of the rows times their weights,
+ * rounded back to a sample and held between 0 and top.
+ *
+ * @param[in]      rows - the taps filtered rows the row out reads
+ * @param[in]      weights - a weight for each of them, RESAMPLE_BITS
+ *						fraction bits
+ * @param[in]      taps - amount of rows
+ * @param[out]     out - receives count pixels
+ * @param[in]      count - amount of pixels out
+ * @param[in]      top - largest value a pixel may take
+ *
+ *****************************************************************************/
+template <class T>
+void blend_rows( const typename sample_traits<T>::filtered *const *rows,
+	const int16_t *weights, int taps, T *out, int count, int top )
+{
+	const int shift = RESAMPLE_BITS + RESAMPLE_EXTRA;
+	int j = 0;
+
+#ifdef KERNEL_X86
+	if (simd_active() >= SIMD_AVX2)
+		j = blend_rows_avx2(rows, weights, taps, out, count, top);
+	else if (simd_active() >= SIMD_SSE41)
+		j = blend_rows_sse41(rows, weights, taps, out, count, top);
+#endif
+
+	//finishes whatever the vector loop left over
+	for ( ; j < count; j++)
+	{
+		int64_t sum = int64_t(1) << (shift - 1);
+
+		for (int t = 0; t < taps; t++)
+			sum += int64_t(rows[t][j]) * weights[t];
+		sum >>= shift;
+		out[j] = T(min(int64_t(top), max(int64_t(0), sum)));
+	}
+}
+
+template void filter_row( const pixel *, int16_t *, const int *,
+	const int16_t *, int, int );
+template void filter_row( const wide_pixel *, int32_t *, const int *,
+	const int16_t *, int, int );
+template void blend_rows( const int16_t *const *, const int16_t *, int,
+	pixel *, int, int );
+template void blend_rows( const int32_t *const *, const int16_t *, int,
+	wide_pixel *, int, int );
+
+
+/*******************************************************************************
+ *                         Convolution
+ ******************************************************************************/
+#ifdef KERNEL_X86
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * loads 16 samples from p as two vectors of words
+ *
+ *****************************************************************************/
+KERNEL_TARGET("sse4.1")
+static inline void load_words_sse41( const pixel *p, __m128i &low,
+	__m128i &high )
+{
+	__m128i bytes = _mm_loadu_si128((const __m128i *) p);
+
+	low = _mm_cvtepu8_epi16(bytes);
+	high = _mm_cvtepu8_epi16(_mm_srli_si128(bytes, 8));
+}
+
+KERNEL_TARGET("sse4.1")
+static inline void load_words_sse41( const int16_t *p, __m128i &low,
+	__m128i &high )
+{
+	low = _mm_loadu_si128((const __m128i *) p);
+	high = _mm_loadu_si128((const __m128i *) (p + 8));
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * stores the sums of 16 pixels, as they are or packed to words
+ *
+ *****************************************************************************/
+KERNEL_TARGET("sse4.1")
+static inline void store_sums_sse41( int32_t *out, const __m128i *sum )
+{
+	for (int k = 0; k < 4; k++)
+		_mm_storeu_si128((__m128i *) (out + 4 * k), sum[k]);
+}
+
+KERNEL_TARGET("sse4.1")
+static inline void store_sums_sse41( int16_t *out, const __m128i *sum )
+{
+	_mm_storeu_si128((__m128i *) out, _mm_packs_epi32(sum[0], sum[1]));
+	_mm_storeu_si128((__m128i *) (out + 8), _mm_packs_epi32(sum[2], sum[3]));
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE4.1 version of weigh_row, 16 pixels out per pass.  Two taps are
+ * interleaved word by word so one pmaddwd against the pair of their
+ * weights adds both into 32 bit sums; an odd last tap is paired with
+ * zeros.
+ *
+ *****************************************************************************/
+template <class S, class D>
+KERNEL_TARGET("sse4.1")
+static int weigh_row_sse41( const S *const *taps, const int16_t *weights,
+	int count, D *sum, int width )
+{
+	int j = 0;
+
+	for ( ; j + 16 <= width; j += 16)
+	{
+		__m128i total[4];
+
+		for (int k = 0; k < 4; k++)
+			total[k] = _mm_setzero_si128();
+
+		for (int t = 0; t < count; t += 2)
+		{
+			bool pair = (t + 1 < count);
+			__m128i both = _mm_set1_epi32(int32_t(uint16_t(weights[t])) |
+				(pair ? int32_t(uint32_t(uint16_t(weights[t + 1])) << 16) :
+				0));
+			__m128i near[2];
+			__m128i far[2];
+
+			load_words_sse41(taps[t] + j, near[0], near[1]);
+			far[0] = far[1] = _mm_setzero_si128();
+			if (pair)
+				load_words_sse41(taps[t + 1] + j, far[0], far[1]);
+
+			for (int k = 0; k < 2; k++)
+			{
+				total[2 * k] = _mm_add_epi32(total[2 * k], _mm_madd_epi16(
+					_mm_unpacklo_epi16(near[k], far[k]), both));
+				total[2 * k + 1] = _mm_add_epi32(total[2 * k + 1],
+					_mm_madd_epi16(_mm_unpackhi_epi16(near[k], far[k]),
+					both));
+			}
+		}
+		store_sums_sse41(sum + j, total);
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * loads 32 samples from p as two vectors of words
+ *
+ *****************************************************************************/
+KERNEL_TARGET("avx2")
+static inline void load_words_avx2( const pixel *p, __m256i &low,
+	__m256i &high )
+{
+	__m256i bytes = _mm256_loadu_si256((const __m256i *) p);
+
+	low = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes));
+	high = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1));
+}
+
+KERNEL_TARGET("avx2")
+static inline void load_words_avx2( const int16_t *p, __m256i &low,
+	__m256i &high )
+{
+	low = _mm256_loadu_si256((const __m256i *) p);
+	high = _mm256_loadu_si256((const __m256i *) (p + 16));
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * stores the sums of 32 pixels.  The unpacks left each pair of sums with
+ * its 128 bit halves 8 pixels apart, which the permutes put back in
+ * order; packing to words works per half, so it undoes them by itself.
+ *
+ *****************************************************************************/
+KERNEL_TARGET("avx2")
+static inline void store_sums_avx2( int32_t *out, const __m256i *sum )
+{
+	for (int k = 0; k < 2; k++)
+	{
+		_mm256_storeu_si256((__m256i *) (out + 16 * k),
+			_mm256_permute2x128_si256(sum[2 * k], sum[2 * k + 1], 0x20));
+		_mm256_storeu_si256((__m256i *) (out + 16 * k + 8),
+			_mm256_permute2x128_si256(sum[2 * k], sum[2 * k + 1], 0x31));
+	}
+}
+
+KERNEL_TARGET("avx2")
+static inline void store_sums_avx2( int16_t *out, const __m256i *sum )
+{
+	_mm256_storeu_si256((__m256i *) out, _mm256_packs_epi32(sum[0], sum[1]));
+	_mm256_storeu_si256((__m256i *) (out + 16),
+		_mm256_packs_epi32(sum[2], sum[3]));
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of weigh_row, 32 pixels out per pass
+ *
+ *****************************************************************************/
+template <class S, class D>
+KERNEL_TARGET("avx2")
+static int weigh_row_avx2( const S *const *taps, const int16_t *weights,
+	int count, D *sum, int width )
+{
+	int j = 0;
+
+	for ( ; j + 32 <= width; j += 32)
+	{
+		__m256i total[4];
+
+		for (int k = 0; k < 4; k++)
+			total[k] = _mm256_setzero_si256();
+
+		for (int t = 0; t < count; t += 2)
+		{
+			bool pair = (t + 1 < count);
+			__m256i both = _mm256_set1_epi32(int32_t(uint16_t(weights[t])) |
+				(pair ? int32_t(uint32_t(uint16_t(weights[t + 1])) << 16) :
+				0));
+			__m256i near[2];
+			__m256i far[2];
+
+			load_words_avx2(taps[t] + j, near[0], near[1]);
+			far[0] = far[1] = _mm256_setzero_si256();
+			if (pair)
+				load_words_avx2(taps[t + 1] + j, far[0], far[1]);
+
+			for (int k = 0; k < 2; k++)
+			{
+				total[2 * k] = _mm256_add_epi32(total[2 * k],
+					_mm256_madd_epi16(_mm256_unpacklo_epi16(near[k], far[k]),
+					both));
+				total[2 * k + 1] = _mm256_add_epi32(total[2 * k + 1],
+					_mm256_madd_epi16(_mm256_unpackhi_epi16(near[k], far[k]),
+					both));
+			}
+		}
+		store_sums_avx2(sum + j, total);
+	}
+	return j;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * 2 byte samples and 32 bit sums do not fit the signed words pmaddwd
+ * takes, so they have no vector versions
+ *
+ *****************************************************************************/
+static int weigh_row_sse41( const wide_pixel *const *, const int16_t *, int,
+	int32_t *, int )
+{
+	return 0;
+}
+
+static int weigh_row_sse41( const int32_t *const *, const int16_t *, int,
+	int32_t *, int )
+{
+	return 0;
+}
+
+static int weigh_row_avx2( const wide_pixel *const *, const int16_t *, int,
+	int32_t *, int )
+{
+	return 0;
+}
+
+static int weigh_row_avx2( const int32_t *const *, const int16_t *, int,
+	int32_t *, int )
+{
+	return 0;
+}
+#endif
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * adds up weighted rows: sum[j] is each tap's sample j times its weight.
+ * A tap is a row, or a row moved along by a kernel column, so the same
+ * loop serves every row of a kernel at once or one row of it at a time.
+ * The sums must fit D, which the kernel's limits make sure of.
+ *
+ * @param[in]      taps - where each tap's samples start
+ * @param[in]      weights - the weight of each tap
+ * @param[in]      count - amount of taps
+ * @param[out]     sum - receives width sums
+ * @param[in]      width - amount of pixels
+ *
+ *****************************************************************************/
+template <class S, class D>
+void weigh_row( const S *const *taps, const int16_t *weights, int count,
+	D *sum, int width )
+{
+	int j = 0;
+
+#ifdef KERNEL_X86
+	if (simd_active() >= SIMD_AVX2)
+		j = weigh_row_avx2(taps, weights, count, sum, width);
+	else if (simd_active() >= SIMD_SSE41)
+		j = weigh_row_sse41(taps, weights, count, sum, width);
+#endif
+
+	//finishes whatever the vector loop left over
+	for ( ; j < width; j++)
+	{
+		int32_t total = 0;
+
+		for (int t = 0; t < count; t++)
+			total += int32_t(taps[t][j]) * weights[t];
+		sum[j] = D(total);
+	}
+}
+
+template void weigh_row( const pixel *const *, const int16_t *, int,
+	int32_t *, int );
+template void weigh_row( const pixel *const *, const int16_t *, int,
+	int16_t *, int );
+template void weigh_row( const int16_t *const *, const int16_t *, int,
+	int32_t *, int );
+template void weigh_row( const wide_pixel *const *, const int16_t *, int,
+	int32_t *, int );
+template void weigh_row( const int32_t *const *, const int16_t *, int,
+	int32_t *, int );
+
+
+/*******************************************************************************
+ *                         ASCII character classes
+ ******************************************************************************/
+#ifdef KERNEL_X86
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * SSE version of scan_classes, 16 bytes per compare
+ *
+ *****************************************************************************/
+KERNEL_TARGET("sse4.1")
+static void scan_classes_sse41( const char *text, uint64_t &digits,
+	uint64_t &spaces )
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i char0 = _mm_set1_epi8('0');
+	const __m128i nine = _mm_set1_epi8(9);
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i four = _mm_set1_epi8(4);
+	const __m128i blank = _mm_set1_epi8(' ');
+
+	digits = 0;
+	spaces = 0;
+	for (int k = 0; k < 4; k++)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *) (text + 16 * k));
+
+		//unsigned v - '0' <= 9 is a digit, v - '\t' <= 4 or ' ' is a space
+		__m128i d = _mm_cmpeq_epi8(_mm_subs_epu8(
+			_mm_sub_epi8(v, char0), nine), zero);
+		__m128i w = _mm_or_si128(_mm_cmpeq_epi8(v, blank),
+			_mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8(v, tab), four), zero));
+
+		digits |= uint64_t(uint16_t(_mm_movemask_epi8(d))) << (16 * k);
+		spaces |= uint64_t(uint16_t(_mm_movemask_epi8(w))) << (16 * k);
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * AVX2 version of scan_classes, 32 bytes per compare
+ *
+ *****************************************************************************/
+KERNEL_TARGET("avx2")
+static void scan_classes_avx2( const char *text, uint64_t &digits,
+	uint64_t &spaces )
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i char0 = _mm256_set1_epi8('0');
+	const __m256i nine = _mm256_set1_epi8(9);
+	const __m256i tab = _mm256_set1_epi8('\t');
+	const __m256i four = _mm256_set1_epi8(4);
+	const __m256i blank = _mm256_set1_epi8(' ');
+
+	digits = 0;
+	spaces = 0;
+	for (int k = 0; k < 2; k++)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i *) (text + 32 * k));
+
+		__m256i d = _mm256_cmpeq_epi8(_mm256_subs_epu8(
+			_mm256_sub_epi8(v, char0), nine), zero);
+		__m256i w = _mm256_or_si256(_mm256_cmpeq_epi8(v, blank),
+			_mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_sub_epi8(v, tab), four),
+			zero));
+
+		digits |= uint64_t(uint32_t(_mm256_movemask_epi8(d))) << (32 * k);
+		spaces |= uint64_t(uint32_t(_mm256_movemask_epi8(w))) << (32 * k);
+	}
+}
+#endif
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * sorts 64 bytes of ascii picture data into digits and whitespace, one bit
+ * per byte with the first byte in bit 0
+ *
+ * @param[in]      text - 64 readable bytes
+ * @param[out]     digits - bit set for every '0' to '9'
+ * @param[out]     spaces - bit set for every whitespace character
+ *
+ *****************************************************************************/
+void scan_classes( const char *text, uint64_t &digits, uint64_t &spaces )
+{
+#ifdef KERNEL_X86
+	if (simd_active() >= SIMD_AVX2)
+	{
+		scan_classes_avx2(text, digits, spaces);
+		return;
+	}
+	if (simd_active() >= SIMD_SSE41)
+	{
+		scan_classes_sse41(text, digits, spaces);
+		return;
+	}
+#endif
+
+	digits = 0;
+	spaces = 0;
+	for (int k = 0; k < 64; k++)
+	{
+		unsigned char c = (unsigned char) text[k];
+
+		if (unsigned(c - '0') <= 9)
+			digits |= uint64_t(1) << k;
+		if (c == ' ' || unsigned(c - '\t') <= 4)
+			spaces |= uint64_t(1) << k;
+	}
+}
@@ -0,0 +1,88 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief this file contains the row kernels that have hand vectorized
+ * versions and the cpu detection that picks between them.  Each kernel is
+ * made for byte and for 2 byte samples.  It should be included with
+ * kernels.cpp.
+ ****************************************************************************/
+#ifndef  __KERNELS__H__
+#define __KERNELS__H__
+
+#include "function.h"
+
+
+/*!
+ * @brief instruction sets the kernels know how to use, from slowest to
+ *				fastest
+ */
+enum simd_level
+{
+	SIMD_SCALAR = 0,	/*!< plain c++ loops, works everywhere */
+	SIMD_SSE41 = 1,		/*!< 16 pixels at a time with SSE4.1 */
+	SIMD_AVX2 = 2		/*!< 32 pixels at a time with AVX2 */
+};
+
+
+/*******************************************************************************
+ *                         Function Prototypes
+ ******************************************************************************/
+simd_level simd_detect();
+simd_level simd_active();
+void simd_force( simd_level level );
+const char *simd_name( simd_level level );
+
+template <class T>
+void split_rgb( const T *src, T *red, T *green, T *blue, int count );
+
+template <class T>
+void merge_rgb( const T *red, const T *green, const T *blue, T *dst,
+	int count );
+
+template <class T>
+void read_samples( const pixel *src, T *dst, int count );
+template <class T>
+void write_samples( const T *src, pixel *dst, int count );
+
+template <pixel_layout LAYOUT, class T>
+void sharpen_row( const T *up, const T *mid, const T *down, T *out,
+	int cols, int top );
+template <class T>
+void column_add( typename sample_traits<T>::column_sum *column,
+	const T *enter, const T *leave, int count );
+template <pixel_layout LAYOUT, class T>
+void prefix_row( const typename sample_traits<T>::column_sum *column,
+	uint32_t *prefix, int count );
+template <pixel_layout LAYOUT, class T>
+void box_row( const uint32_t *prefix, int radius, const box_divider &divide,
+	T *out, int first, int last );
+
+template <class T>
+void lut_row( const T *table, const T *src, T *dst, int count );
+template <class T>
+void range_row( const T *src, int count, int &low, int &high );
+
+template <class T>
+void grey_row( const T *red, const T *green, const T *blue, T *grey,
+	int count, grey_weights weights );
+template <class T>
+void grey_packed( const T *src, T *grey, int count, grey_weights weights );
+
+template <class T>
+void half_row( const T *top, const T *bottom, T *out, int count );
+
+template <class T>
+void filter_row( const T *src, typename sample_traits<T>::filtered *out,
+	const int *first, const int16_t *weights, int taps, int count );
+template <class T>
+void blend_rows( const typename sample_traits<T>::filtered *const *rows,
+	const int16_t *weights, int taps, T *out, int count, int top );
+
+template <class S, class D>
+void weigh_row( const S *const *taps, const int16_t *weights, int count,
+	D *sum, int width );
+
+void scan_classes( const char *text, uint64_t &digits, uint64_t &spaces );
+
+
+#endif
@@ -0,0 +1,437 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief The pipeline that runs the command line options in order.  Tables
+ * next to each other become one table, and tables and stencils next to
+ * each other run together band by band, so the picture passes through
+ * memory once for the whole run instead of once per option.
+ ****************************************************************************/
+#include "pipeline.h"
+#include "kernels.h"
+#include "resample.h"
+#include "convolve.h"
+#include "threadpool.h"
+
+
+//most rows of a stencil's reach a later stencil may make the bands before
+	//it redo, past this it gets a pass of its own
+static const int FUSE_HALO = 8;
+
+//bands are at least this many times the rows the stencils reach, so the
+	//rows redone or summed again at every band stay cheap
+static const int HALO_BANDS = 8;
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs the options in the order given.  Negate and brighten become tables,
+ * sharpen and smooth become stencils, and both are gathered into steps
+ * that run as one pass.  Greyscale, the range search of contrast, and the
+ * tile counts of equalize need the whole picture finished first, so the
+ * gathered steps are run before them; the contrast stretch and the
+ * equalizing blend are steps that join the ones after them.  A picture
+ * turned grey as it was read starts out grey, and a contrast right after
+ * the colorbands are turned grey is done in the same pass.  A resample
+ * makes new planes of another size and a convolution picks its own way
+ * through the picture, so they also run the gathered steps first.
+ *
+ * @param[in][out]     vars - the picture
+ * @param[in]          stages - the options in the order given
+ *
+ *****************************************************************************/
+template <class T>
+void run_pipeline( basic_image<T> &vars,
+	const vector<pipeline_stage> &stages )
+{
+	//loop variable
+	size_t s = 0;
+
+	//steps gathered so far, and whether they work on the greyscale band
+	vector<fused_step<T>> steps;
+	bool grey = (vars.grey.data != nullptr);
+
+	//largest value a stencil may give
+	int top = min(vars.max_value, sample_traits<T>::largest);
+
+	for (s = 0; s < stages.size(); s++)
+	{
+		const pipeline_stage &stage = stages[s];
+		grey_weights weights = (stage.kind == STAGE_GREYSCALE) ?
+			grey_weights(stage.value) : GREY_LEGACY;
+
+		switch (stage.kind)
+		{
+		case STAGE_NEGATE:
+			add_table( steps, lut_negate( T(vars.max_value) ) );
+			break;
+
+		case STAGE_BRIGHTEN:
+			add_table( steps, lut_brighten<T>( stage.value,
+				vars.max_value ) );
+			break;
+
+		case STAGE_SHARPEN:
+		case STAGE_SMOOTH:
+			//a stencil that would make the bands redo too much, or that
+				//wraps, starts over
+			if (!add_stencil( steps, stage.kind,
+				stage.kind == STAGE_SMOOTH ? stage.value : 1, top,
+				stage.border ))
+			{
+				run_steps( vars, grey, steps );
+				steps.clear();
+				add_stencil( steps, stage.kind,
+					stage.kind == STAGE_SMOOTH ? stage.value : 1, top,
+					stage.border );
+			}
+			break;
+
+		case STAGE_GREYSCALE:
+		case STAGE_CONTRAST:
+		case STAGE_EQUALIZE:
+			run_steps( vars, grey, steps );
+			steps.clear();
+
+			//the grey band is only written once it is stretched
+			if (!grey && (stage.kind == STAGE_CONTRAST ||
+				(stage.kind == STAGE_GREYSCALE && s + 1 < stages.size() &&
+				stages[s + 1].kind == STAGE_CONTRAST)))
+			{
+				grey_contrast( vars, weights );
+				grey = true;
+				if (stage.kind == STAGE_GREYSCALE)
+					s++;
+				break;
+			}
+
+			if (!grey)
+				greyscale( vars, weights );
+			grey = true;
+
+			if (stage.kind == STAGE_CONTRAST)
+			{
+				contrast_range( vars );
+				add_table( steps, lut_stretch<T>( vars.min, vars.max,
+					vars.max_value ) );
+			}
+			else if (stage.kind == STAGE_EQUALIZE)
+			{
+				shared_ptr<tile_grid<T>> grid(new tile_grid<T>);
+				basic_window<T> rows;
+				rows.data = vars.grey.data;
+				rows.stride = vars.grey.stride;
+
+				tile_setup( *grid, vars.rows, vars.cols, vars.max_value );
+				tile_count( *grid, rows, 0, vars.rows );
+				tile_tables( *grid, stage.value );
+				add_equalize<T>( steps, grid );
+			}
+			break;
+
+		case STAGE_RESAMPLE:
+			run_steps( vars, grey, steps );
+			steps.clear();
+			resample( vars, stage.cols, stage.rows,
+				resample_filter(stage.value) );
+			break;
+
+		case STAGE_CONVOLVE:
+			run_steps( vars, grey, steps );
+			steps.clear();
+			convolve( vars, *stage.kernel, stage.border );
+			break;
+		}
+	}
+
+	run_steps( vars, grey, steps );
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * adds a table to the end of the steps, joining it to the table already
+ * there if the last step is one
+ *
+ * @param[in][out]     steps - the gathered steps
+ * @param[in]          lut - table to add
+ *
+ *****************************************************************************/
+template <class T>
+void add_table( vector<fused_step<T>> &steps, const basic_lut<T> &lut )
+{
+	if (!steps.empty() && steps.back().table)
+	{
+		steps.back().lut = lut_then( steps.back().lut, lut );
+		return;
+	}
+
+	steps.emplace_back();
+	steps.back().table = true;
+	steps.back().lut = lut;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * adds a stencil to the end of the steps.  Every stencil after the first
+ * makes each band redo its reach of rows in the steps before it, so a
+ * stencil is only added while that stays within FUSE_HALO rows.  A
+ * stencil that wraps reads rows from the far edge, which only the picture
+ * itself holds and not the rows a band made, so it has to be the first
+ * step.  A fill past top is taken as top.
+ *
+ * @param[in][out]     steps - the gathered steps
+ * @param[in]          kind - STAGE_SHARPEN or STAGE_SMOOTH
+ * @param[in]          radius - rows the stencil reads above and below
+ * @param[in]          top - largest value the stencil may give
+ * @param[in]          border - what the stencil reads past the edges
+ *
+ * @returns true the stencil was added
+ * @returns false the stencil needs a pass of its own
+ *
+ *****************************************************************************/
+template <class T>
+bool add_stencil( vector<fused_step<T>> &steps, stage_kind kind,
+	int radius, int top, const stencil_border &border )
+{
+	//rows redone so far, and whether there is a stencil to redo at all
+	int halo = 0;
+	bool stencil = false;
+
+	for (const fused_step<T> &step : steps)
+	{
+		if (!step.table)
+		{
+			if (stencil)
+				halo += step.radius;
+			stencil = true;
+		}
+	}
+
+	if (stencil && halo + radius > FUSE_HALO)
+		return false;
+	if (border.mode == BORDER_WRAP && !steps.empty())
+		return false;
+
+	steps.emplace_back();
+	steps.back().table = false;
+	steps.back().kind = kind;
+	steps.back().radius = radius;
+	steps.back().top = top;
+	steps.back().border = border;
+	steps.back().border.fill = min(border.fill, top);
+	return true;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * adds the equalizing blend to the end of the steps.  It reads no rows
+ * above or below, so it never makes the bands redo any.
+ *
+ * @param[in][out]     steps - the gathered steps
+ * @param[in]          grid - the tiles with their tables made
+ *
+ *****************************************************************************/
+template <class T>
+void add_equalize( vector<fused_step<T>> &steps,
+	const shared_ptr<const tile_grid<T>> &grid )
+{
+	steps.emplace_back();
+	steps.back().table = false;
+	steps.back().kind = STAGE_EQUALIZE;
+	steps.back().grid = grid;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs the gathered steps over the picture.  Tables alone are changed in
+ * place.  With a stencil every band reads rows its neighbours also read,
+ * so the results go to one temporary array that is swapped in, the same
+ * array serving each colorband in turn.  Packed rgb is one band whose
+ * stencils are made for the packed layout.
+ *
+ * @param[in][out]     vars - the picture
+ * @param[in]          grey - the steps work on the greyscale band
+ * @param[in]          steps - the gathered steps
+ *
+ *****************************************************************************/
+template <class T>
+void run_steps( basic_image<T> &vars, bool grey,
+	const vector<fused_step<T>> &steps )
+{
+	//rows above and below a band the stencils read, which the bands redo
+		//or a smooth sums again at the top of each band
+	int reach = 0;
+	bool stencil = false;
+
+	//bands the steps run over
+	vector<basic_plane<T> *> bands;
+
+	if (steps.empty())
+		return;
+
+	if (grey)
+		bands.push_back(&vars.grey);
+	else if (vars.packed.data != nullptr)
+		bands.push_back(&vars.packed);
+	else
+	{
+		bands.push_back(&vars.red);
+		bands.push_back(&vars.green);
+		bands.push_back(&vars.blue);
+	}
+
+	for (const fused_step<T> &step : steps)
+	{
+		if (!step.table)
+		{
+			reach += step.radius;
+			stencil = true;
+		}
+	}
+
+	//a single table runs in place
+	if (!stencil)
+	{
+		for (basic_plane<T> *band : bands)
+			lut_apply( *band, steps[0].lut );
+		return;
+	}
+
+	//creates temporary array, shared by all the bands
+	basic_plane<T> cpy_array;
+	cpy_array = d2array<T>(bands[0]->rows, bands[0]->cols);
+	if (cpy_array.data == nullptr)
+		allocation_error( vars, "memory or allocation error" );
+
+	for (basic_plane<T> *band : bands)
+	{
+		if (band == &vars.packed)
+			run_fused<LAYOUT_PACKED>( *band, cpy_array, steps, reach );
+		else
+			run_fused<LAYOUT_PLANAR>( *band, cpy_array, steps, reach );
+		swap(*band, cpy_array);
+	}
+
+	//deletes temporary array
+	d2array_delet( cpy_array);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs all the steps over one colorband a band of rows at a time.  Working
+ * back from the band's rows, each step is given the rows the step after it
+ * reads; those are made from this_array into a small buffer that stays in
+ * cache, and only the last step writes to cpy_array.  The stencils are the
+ * ones made for LAYOUT.
+ *
+ * @param[in]          this_array - colorband to read
+ * @param[out]         cpy_array - receives the finished colorband
+ * @param[in]          steps - the gathered steps
+ * @param[in]          reach - rows above and below a band the steps read,
+ *						bands are kept several times taller
+ *
+ *****************************************************************************/
+template <pixel_layout LAYOUT, class T>
+void run_fused( basic_plane<T> &this_array, basic_plane<T> &cpy_array,
+	const vector<fused_step<T>> &steps, int reach )
+{
+	int rows = this_array.rows;
+	int cols = this_array.cols;
+	int count = int(steps.size());
+
+	parallel_rows( rows, cols * int(sizeof(T)), [&] (int first, int last)
+	{
+		//loop variables
+		int i = 0;
+		int k = 0;
+
+		//rows each step makes, worked out from the last step back
+		vector<int> low(count);
+		vector<int> high(count);
+
+		//two buffers taken in turn, kept by each thread between bands
+		thread_local vector<T> buffers[2];
+
+		low[count - 1] = first;
+		high[count - 1] = last;
+		for (k = count - 1; k > 0; k--)
+		{
+			low[k - 1] = max(0, low[k] - steps[k].radius);
+			high[k - 1] = min(rows, high[k] + steps[k].radius);
+		}
+
+		basic_window<T> src;
+		src.data = this_array.data;
+		src.stride = this_array.stride;
+
+		for (k = 0; k < count; k++)
+		{
+			basic_window<T> dst;
+
+			if (k == count - 1)
+			{
+				dst.data = cpy_array.data;
+				dst.stride = cpy_array.stride;
+			}
+			else
+			{
+				vector<T> &buffer = buffers[k % 2];
+				size_t need = size_t(high[k] - low[k]) * cols;
+
+				if (buffer.size() < need)
+					buffer.resize(need);
+				dst.data = buffer.data();
+				dst.first = low[k];
+				dst.stride = cols;
+			}
+
+			const fused_step<T> &step = steps[k];
+			if (step.table)
+			{
+				for (i = low[k]; i < high[k]; i++)
+					lut_row( step.lut.table, src[i], dst[i], cols );
+			}
+			else if (step.kind == STAGE_SHARPEN)
+				sharpen_rows<LAYOUT>( src, dst, low[k], high[k], rows, cols,
+					step.top, step.border );
+			else if (step.kind == STAGE_EQUALIZE)
+				equalize_rows( *step.grid, src, dst, low[k], high[k] );
+			else
+				smooth_rows<LAYOUT>( src, dst, low[k], high[k], rows, cols,
+					step.radius, step.border );
+
+			src = dst;
+		}
+	}, HALO_BANDS * reach );
+}
+
+
+//the pipeline is made for both sample types
+#define PIPELINE_FUNCTIONS(T) \
+	template void run_pipeline( basic_image<T> &, \
+		const vector<pipeline_stage> & ); \
+	template void add_table( vector<fused_step<T>> &, const basic_lut<T> & ); \
+	template bool add_stencil( vector<fused_step<T>> &, stage_kind, int, \
+		int, const stencil_border & ); \
+	template void add_equalize( vector<fused_step<T>> &, \
+		const shared_ptr<const tile_grid<T>> & ); \
+	template void run_steps( basic_image<T> &, bool, \
+		const vector<fused_step<T>> & ); \
+	template void run_fused<LAYOUT_PLANAR>( basic_plane<T> &, \
+		basic_plane<T> &, const vector<fused_step<T>> &, int ); \
+	template void run_fused<LAYOUT_PACKED>( basic_plane<T> &, \
+		basic_plane<T> &, const vector<fused_step<T>> &, int );
+
+PIPELINE_FUNCTIONS(pixel)
+PIPELINE_FUNCTIONS(wide_pixel)
@@ -0,0 +1,62 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief this file contains the pipeline that runs the options given on
+ * the command line, joining the ones it can into a single pass.  It should
+ * be included with pipeline.cpp.
+ ****************************************************************************/
+#ifndef  __PIPELINE__H__
+#define __PIPELINE__H__
+
+#include <memory>
+
+#include "function.h"
+
+
+/*!
+ * @brief one step of a joined pass, either a table or a stencil
+ *
+ * @details tables next to each other are already joined into one, so a
+ *				pass alternates tables and stencils.  Adaptive equalization
+ *				is a stencil that reads no other rows.
+ */
+template <class T>
+struct fused_step
+{
+	bool table = true;	/*!< true for a table, false for a stencil */
+	stage_kind kind = STAGE_NEGATE;	/*!< STAGE_SHARPEN, STAGE_SMOOTH, or
+											STAGE_EQUALIZE */
+	int radius = 0;		/*!< rows the stencil reads above and below */
+	int top = 0;		/*!< largest value the stencil may give */
+	stencil_border border;	/*!< what the stencil reads past the edges */
+	grey_weights weights = GREY_LEGACY;	/*!< for STAGE_GREYSCALE */
+	basic_lut<T> lut;	/*!< the table, when table is true */
+	shared_ptr<const tile_grid<T>> grid;	/*!< tables of the tiles, for
+													STAGE_EQUALIZE */
+};
+
+
+/*******************************************************************************
+ *                         Function Prototypes
+ ******************************************************************************/
+template <class T>
+void run_pipeline( basic_image<T> &vars,
+	const vector<pipeline_stage> &stages );
+
+template <class T>
+void add_table( vector<fused_step<T>> &steps, const basic_lut<T> &lut );
+template <class T>
+bool add_stencil( vector<fused_step<T>> &steps, stage_kind kind,
+	int radius, int top, const stencil_border &border );
+template <class T>
+void add_equalize( vector<fused_step<T>> &steps,
+	const shared_ptr<const tile_grid<T>> &grid );
+template <class T>
+void run_steps( basic_image<T> &vars, bool grey,
+	const vector<fused_step<T>> &steps );
+template <pixel_layout LAYOUT, class T>
+void run_fused( basic_plane<T> &this_array, basic_plane<T> &cpy_array,
+	const vector<fused_step<T>> &steps, int reach );
+
+
+#endif
@@ -0,0 +1,411 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief The picture pyramid.  Each level is the one before averaged 2 by
+ * 2, rounding sizes down.  The levels are made tile by tile: a tile of the
+ * picture is halved, the half halved again, and so on while it is still in
+ * cache, before the next tile is read, and the tiles run across the thread
+ * pool.  Once a side is down to one pixel the few levels left are made
+ * whole, the last row or column standing in for its missing partner.
+ ****************************************************************************/
+#include "pyramid.h"
+#include "kernels.h"
+#include "threadpool.h"
+#include "stats.h"
+
+
+//levels the tiled pass makes from one source before starting again from
+	//the smallest of them, so a tile and its levels stay in cache
+static const int TILE_LEVELS = 5;
+
+//pixels across a tile of the source, a multiple of 1 << TILE_LEVELS
+static const int TILE_COLS = 256;
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives the colorband number band of a picture, its grey band if it has
+ * one
+ *
+ * @param[in]      vars - the picture
+ * @param[in]      band - 0 red, 1 green, 2 blue
+ *
+ * @returns the colorband
+ *
+ *****************************************************************************/
+template <class T>
+static basic_plane<T> &level_band( basic_image<T> &vars, int band )
+{
+	if (vars.grey.data != nullptr)
+		return vars.grey;
+	return (band == 0) ? vars.red : (band == 1) ? vars.green : vars.blue;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * level_band for a picture that is only read
+ *
+ * @param[in]      vars - the picture
+ * @param[in]      band - 0 red, 1 green, 2 blue
+ *
+ * @returns the colorband
+ *
+ *****************************************************************************/
+template <class T>
+static const basic_plane<T> &level_band( const basic_image<T> &vars,
+	int band )
+{
+	return level_band( const_cast<basic_image<T> &>(vars), band );
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * tells how many levels a pyramid of a picture has, at most levels and
+ * stopping once a level is 1 by 1
+ *
+ * @param[in]      rows - rows in the picture
+ * @param[in]      cols - columns in the picture
+ * @param[in]      levels - levels asked for
+ *
+ * @returns the amount of levels below the picture
+ *
+ *****************************************************************************/
+int pyramid_depth( int rows, int cols, int levels )
+{
+	int count = 0;
+
+	while (count < levels && (rows > 1 || cols > 1))
+	{
+		rows = max(1, rows / 2);
+		cols = max(1, cols / 2);
+		count++;
+	}
+	return count;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * makes rows first to last - 1, columns left to right - 1, of dst from
+ * src, which is twice its size or one row or column high.  A row or
+ * column of src without a partner below or to the right is paired with
+ * itself.
+ *
+ * @param[in]      src - the larger level
+ * @param[out]     dst - the smaller level
+ * @param[in]      first - first row of dst made
+ * @param[in]      last - one past the last row made
+ * @param[in]      left - first column made
+ * @param[in]      right - one past the last column made
+ *
+ *****************************************************************************/
+template <class T>
+void pyramid_half( const basic_plane<T> &src, basic_plane<T> &dst,
+	int first, int last, int left, int right )
+{
+	//loop variable
+	int i = 0;
+
+	for (i = first; i < last; i++)
+	{
+		const T *top = src[2 * i];
+		const T *bottom = src[min(2 * i + 1, src.rows - 1)];
+
+		if (src.cols == 1)
+			dst[i][0] = T((2 * uint32_t(top[0]) + 2 * uint32_t(bottom[0]) +
+				2) >> 2);
+		else
+			half_row(top + 2 * left, bottom + 2 * left, dst[i] + left,
+				right - left);
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * makes the first level of a packed picture for rows first to last - 1,
+ * columns left to right - 1.  Each pair of rows is split into colorbands
+ * a tile wide, which stay in cache, and halved from there.
+ *
+ * @param[in]      src - the packed rgb triples
+ * @param[out]     level - the first level, in colorbands
+ * @param[in]      first - first row made
+ * @param[in]      last - one past the last row made
+ * @param[in]      left - first column made
+ * @param[in]      right - one past the last column made
+ *
+ *****************************************************************************/
+template <class T>
+static void packed_half( const basic_plane<T> &src, basic_image<T> &level,
+	int first, int last, int left, int right )
+{
+	//loop variables
+	int i = 0;
+	int k = 0;
+
+	//a tile of two rows of each colour
+	T split[6][TILE_COLS];
+
+	int count = right - left;
+
+	for (i = first; i < last; i++)
+	{
+		split_rgb(src[2 * i] + 6 * size_t(left), split[0], split[1],
+			split[2], 2 * count);
+		split_rgb(src[2 * i + 1] + 6 * size_t(left), split[3], split[4],
+			split[5], 2 * count);
+		for (k = 0; k < 3; k++)
+			half_row(split[k], split[k + 3], level_band(level, k)[i] + left,
+				count);
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * makes count levels from source, which has at least 2 rows and columns
+ * and so do all but the last of the levels.  Level first is the first
+ * one made, pyramid[first - 1].  The source is cut into tiles
+ * 1 << count rows high and TILE_COLS wide, and each tile makes its part
+ * of every level, which is the same part of the level made whole since
+ * sizes round down.
+ *
+ * @param[in]      source - the picture, or the level before first
+ * @param[in][out] pyramid - the levels, already allocated
+ * @param[in]      first - number of the first level made
+ * @param[in]      count - amount of levels made
+ *
+ *****************************************************************************/
+template <class T>
+void pyramid_tiles( const basic_image<T> &source, vector<basic_image<T>>
+	&pyramid, int first, int count )
+{
+	int height = 1 << count;
+	int strips = (source.rows + height - 1) / height;
+	bool grey = source.grey.data != nullptr;
+	bool packed = !grey && source.packed.data != nullptr;
+	int bands = grey ? 1 : 3;
+
+	parallel_rows( strips, source.cols * height * bands * int(sizeof(T)),
+		[&] (int top, int bottom)
+	{
+		//loop variables
+		int s = 0;
+		int x = 0;
+		int t = 0;
+		int k = 0;
+
+		for (s = top; s < bottom; s++)
+		{
+			int y = s * height;
+			int h = min(height, source.rows - y);
+
+			for (x = 0; x < source.cols; x += TILE_COLS)
+			{
+				int w = min(TILE_COLS, source.cols - x);
+
+				for (t = 1; t <= count; t++)
+				{
+					basic_image<T> &level = pyramid[first + t - 2];
+					const basic_image<T> &from = (t == 1) ? source :
+						pyramid[first + t - 3];
+
+					if (t == 1 && packed)
+					{
+						packed_half( source.packed, level, y >> t,
+							(y + h) >> t, x >> t, (x + w) >> t );
+						continue;
+					}
+					for (k = 0; k < bands; k++)
+						pyramid_half( level_band(from, k), level_band(level, k),
+							y >> t, (y + h) >> t, x >> t, (x + w) >> t );
+				}
+			}
+		}
+	});
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * makes the pyramid of the edited picture, grey if it is grey and in
+ * colorbands otherwise, whether it is held in colorbands or packed.
+ * Levels are made by tiles, TILE_LEVELS at a time, while both sides of
+ * the level before are at least 2, then whole.
+ *
+ * @param[in][out] vars - the picture, freed if a level can not be allocated
+ * @param[in]      levels - levels asked for
+ * @param[out]     pyramid - the levels, smallest last
+ *
+ *****************************************************************************/
+template <class T>
+void pyramid_build( basic_image<T> &vars, int levels,
+	vector<basic_image<T>> &pyramid )
+{
+	//loop variables
+	int l = 0;
+	int k = 0;
+
+	int count = pyramid_depth( vars.rows, vars.cols, levels );
+	bool grey = vars.grey.data != nullptr;
+	int bands = grey ? 1 : 3;
+
+	//levels whose level before is at least 2 by 2
+	int tiled = 0;
+
+	int rows = vars.rows;
+	int cols = vars.cols;
+
+	pyramid.assign(count, basic_image<T>());
+	for (l = 0; l < count; l++)
+	{
+		if (tiled == l && rows >= 2 && cols >= 2)
+			tiled++;
+		rows = max(1, rows / 2);
+		cols = max(1, cols / 2);
+
+		basic_image<T> &level = pyramid[l];
+		static_cast<picture_header &>(level) = vars;
+		level.rows = rows;
+		level.cols = cols;
+
+		bool made = true;
+		if (grey)
+		{
+			level.grey = d2array<T>(rows, cols);
+			made = level.grey.data != nullptr;
+		}
+		else
+		{
+			level.red = d2array<T>(rows, cols);
+			level.green = d2array<T>(rows, cols);
+			level.blue = d2array<T>(rows, cols);
+			made = level.red.data != nullptr &&
+				level.green.data != nullptr && level.blue.data != nullptr;
+		}
+
+		if (!made)
+		{
+			for (basic_image<T> &made_level : pyramid)
+				all_array_delete( made_level );
+			pyramid.clear();
+			allocation_error( vars, "memory or allocation error pyramid" );
+			return;
+		}
+	}
+
+	for (l = 1; l <= tiled; l += TILE_LEVELS)
+		pyramid_tiles( (l == 1) ? vars : pyramid[l - 2], pyramid, l,
+			min(TILE_LEVELS, tiled - l + 1) );
+
+	//the levels past a side of 1 are a row or a column at most
+	for (l = tiled + 1; l <= count; l++)
+	{
+		basic_image<T> &from = (l == 1) ? vars : pyramid[l - 2];
+		basic_image<T> &level = pyramid[l - 1];
+
+		//a packed picture one pixel high or wide is split into colorbands
+		basic_image<T> split;
+		if (l == 1 && !grey && vars.packed.data != nullptr)
+		{
+			static_cast<picture_header &>(split) = vars;
+			split.red = d2array<T>(vars.rows, vars.cols);
+			split.green = d2array<T>(vars.rows, vars.cols);
+			split.blue = d2array<T>(vars.rows, vars.cols);
+			if (split.red.data == nullptr || split.green.data == nullptr ||
+				split.blue.data == nullptr)
+			{
+				all_array_delete( split );
+				for (basic_image<T> &made_level : pyramid)
+					all_array_delete( made_level );
+				pyramid.clear();
+				allocation_error( vars, "memory or allocation error pyramid" );
+				return;
+			}
+			for (k = 0; k < vars.rows; k++)
+				split_rgb(vars.packed[k], split.red[k], split.green[k],
+					split.blue[k], vars.cols);
+		}
+		const basic_image<T> &source = (split.red.data != nullptr) ? split :
+			from;
+
+		for (k = 0; k < bands; k++)
+			pyramid_half( level_band(source, k), level_band(level, k), 0,
+				level.rows, 0, level.cols );
+		all_array_delete( split );
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * makes the pyramid of the edited picture and writes each level in the
+ * format of the picture, level l as basename_l.ppm, or .pgm if grey.  A
+ * level that can not be written stops the rest, and all of them are freed.
+ *
+ * @param[in][out] vars - the edited picture
+ * @param[in]      levels - levels asked for, fewer once a level is 1 by 1
+ * @param[in]      basename - output name of the picture, without its ending
+ * @param[in]      checker - -oa or -ob
+ *
+ * @returns 0 every level was written
+ * @returns -1 a level could not be written
+ *
+ *****************************************************************************/
+template <class T>
+int pyramid_write( basic_image<T> &vars, int levels, const string &basename,
+	string &checker )
+{
+	vector<basic_image<T>> pyramid;
+	bool grey = vars.grey.data != nullptr;
+	int result = 0;
+
+	{
+		stats_stage timer( "pyramid", picture_pixels( vars ) );
+		pyramid_build( vars, levels, pyramid );
+	}
+
+	for (size_t l = 0; l < pyramid.size(); l++)
+	{
+		basic_image<T> &level = pyramid[l];
+
+		if (result == 0)
+		{
+			stats_stage timer( "output", picture_pixels( level ) );
+			level.fileName = basename + '_' + to_string(l + 1) +
+				(grey ? ".pgm" : ".ppm");
+			if (picture_write( checker, level ) != 0)
+				result = -1;
+		}
+		all_array_delete( level );
+	}
+	return result;
+}
+
+
+/*******************************************************************************
+ *                         Sample types
+ ******************************************************************************/
+#define PYRAMID_FUNCTIONS(T) \
+	template void pyramid_build( basic_image<T> &, int, \
+		vector<basic_image<T>> & ); \
+	template int pyramid_write( basic_image<T> &, int, const string &, \
+		string & ); \
+	template void pyramid_tiles( const basic_image<T> &, \
+		vector<basic_image<T>> &, int, int ); \
+	template void pyramid_half( const basic_plane<T> &, basic_plane<T> &, \
+		int, int, int, int );
+
+PYRAMID_FUNCTIONS(pixel)
+PYRAMID_FUNCTIONS(wide_pixel)
@@ -0,0 +1,33 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief this file contains the picture pyramid -m makes: smaller copies
+ * of the edited picture, each half the size of the one before, written
+ * next to it as their own files.  It should be included with pyramid.cpp.
+ ****************************************************************************/
+#ifndef  __PYRAMID__H__
+#define __PYRAMID__H__
+
+#include "function.h"
+
+
+/*******************************************************************************
+ *                         Function Prototypes
+ ******************************************************************************/
+int pyramid_depth( int rows, int cols, int levels );
+
+template <class T>
+void pyramid_build( basic_image<T> &vars, int levels,
+	vector<basic_image<T>> &pyramid );
+template <class T>
+int pyramid_write( basic_image<T> &vars, int levels, const string &basename,
+	string &checker );
+template <class T>
+void pyramid_tiles( const basic_image<T> &source, vector<basic_image<T>>
+	&pyramid, int first, int count );
+template <class T>
+void pyramid_half( const basic_plane<T> &src, basic_plane<T> &dst,
+	int first, int last, int left, int right );
+
+
+#endif
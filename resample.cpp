@@ -0,0 +1,326 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief The resample.  Each side gets a table of the source samples and
+ * fixed point weights every pixel out reads, worked out once.  A band of
+ * rows out is made by filtering the source rows under it across into a
+ * buffer that stays in cache, with a few more bits than a sample, and
+ * then blending those rows down; the bands run across the thread pool.
+ ****************************************************************************/
+#include <cmath>
+
+#include "resample.h"
+#include "kernels.h"
+#include "threadpool.h"
+
+
+//bands hold at least this many times the source rows a pixel reads, so
+	//the filtered rows each band redoes at its top stay cheap
+static const int BAND_TAPS = 4;
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * tells how far from its center a filter reaches, in source pixels when
+ * the picture is not made smaller
+ *
+ * @param[in]      filter - the filter
+ *
+ * @returns the radius of the filter
+ *
+ *****************************************************************************/
+static double filter_radius( resample_filter filter )
+{
+	if (filter == RESAMPLE_BILINEAR)
+		return 1.0;
+	if (filter == RESAMPLE_BICUBIC)
+		return 2.0;
+	return 3.0;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives the weight of a filter a distance x from its center
+ *
+ * @param[in]      filter - the filter
+ * @param[in]      x - the distance, in source pixels
+ *
+ * @returns the weight, before the weights of a pixel are made to add up
+ *			to one
+ *
+ *****************************************************************************/
+static double filter_value( resample_filter filter, double x )
+{
+	const double pi = 3.14159265358979323846;
+
+	//Keys' a, which makes the cubic match a sharp line's slope
+	const double a = -0.5;
+
+	x = fabs(x);
+	if (filter == RESAMPLE_BILINEAR)
+		return (x < 1.0) ? 1.0 - x : 0.0;
+
+	if (filter == RESAMPLE_BICUBIC)
+	{
+		if (x < 1.0)
+			return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+		if (x < 2.0)
+			return ((a * x - 5.0 * a) * x + 8.0 * a) * x - 4.0 * a;
+		return 0.0;
+	}
+
+	if (x == 0.0)
+		return 1.0;
+	if (x >= 3.0)
+		return 0.0;
+	return 3.0 * sin(pi * x) * sin(pi * x / 3.0) / (pi * pi * x * x);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * works out the weights of one side going from from pixels to to.  Pixel
+ * centers line up the way the picture's edges do, and a filter making the
+ * picture smaller is stretched by the same amount so every source pixel
+ * counts.  The weights of each pixel are made to add up to exactly one,
+ * the rounding going to its largest weight, and the windows are all the
+ * same width, rounded up to multiple when the source is that wide.
+ *
+ * @param[out]     axis - the table
+ * @param[in]      from - pixels along the source side
+ * @param[in]      to - pixels along the side made
+ * @param[in]      filter - the filter
+ * @param[in]      multiple - what taps is rounded up to, if it can be
+ *
+ *****************************************************************************/
+void resample_weights( resample_axis &axis, int from, int to,
+	resample_filter filter, int multiple )
+{
+	//loop variables
+	int o = 0;
+	int i = 0;
+
+	const int one = 1 << RESAMPLE_BITS;
+	double scale = double(from) / to;
+	double stretch = max(1.0, scale);
+	double radius = filter_radius( filter ) * stretch;
+
+	//the source samples under each pixel
+	vector<int> low(to);
+	vector<int> high(to);
+	int widest = 1;
+
+	for (o = 0; o < to; o++)
+	{
+		double center = (o + 0.5) * scale;
+
+		low[o] = max(0, int(floor(center - radius)));
+		high[o] = min(from, int(ceil(center + radius)));
+		widest = max(widest, high[o] - low[o]);
+	}
+
+	axis.size = to;
+	axis.taps = widest;
+	if ((widest + multiple - 1) / multiple * multiple <= from)
+		axis.taps = (widest + multiple - 1) / multiple * multiple;
+	axis.first.assign(to, 0);
+	axis.weights.assign(size_t(to) * axis.taps, 0);
+
+	vector<double> raw;
+	for (o = 0; o < to; o++)
+	{
+		double center = (o + 0.5) * scale;
+		double total = 0.0;
+		int sum = 0;
+		int largest = 0;
+
+		raw.assign(high[o] - low[o], 0.0);
+		for (i = low[o]; i < high[o]; i++)
+		{
+			raw[i - low[o]] = filter_value( filter,
+				(i + 0.5 - center) / stretch );
+			total += raw[i - low[o]];
+		}
+
+		//the window slides back inside the source at the far edge
+		axis.first[o] = min(low[o], from - axis.taps);
+		int16_t *weight = &axis.weights[size_t(o) * axis.taps +
+			(low[o] - axis.first[o])];
+
+		for (i = 0; i < high[o] - low[o]; i++)
+		{
+			weight[i] = int16_t(floor(raw[i] / total * one + 0.5));
+			sum += weight[i];
+			if (weight[i] > weight[largest])
+				largest = i;
+		}
+		weight[largest] = int16_t(weight[largest] + one - sum);
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * makes the picture cols by rows.  Each colorband, or the grey band, is
+ * resampled into a new plane and the old ones are freed; a packed
+ * picture is split into colorbands first and stays split.
+ *
+ * @param[in][out] vars - the picture, freed if a plane can not be
+ *						allocated
+ * @param[in]      cols - new width
+ * @param[in]      rows - new height
+ * @param[in]      filter - the filter
+ *
+ *****************************************************************************/
+template <class T>
+void resample( basic_image<T> &vars, int cols, int rows,
+	resample_filter filter )
+{
+	//loop variable
+	int k = 0;
+
+	resample_axis across;
+	resample_axis down;
+
+	int top = min(vars.max_value, sample_traits<T>::largest);
+	bool grey = (vars.grey.data != nullptr);
+	int bands = grey ? 1 : 3;
+
+	if (cols == vars.cols && rows == vars.rows)
+		return;
+
+	resample_weights( across, vars.cols, cols, filter, 4 );
+	resample_weights( down, vars.rows, rows, filter, 1 );
+
+	packed_split( vars );
+
+	//the picture as it was, freed once the new planes are made
+	basic_image<T> old = vars;
+	vars.red = basic_plane<T>();
+	vars.green = basic_plane<T>();
+	vars.blue = basic_plane<T>();
+	vars.grey = basic_plane<T>();
+	vars.packed = basic_plane<T>();
+	vars.mapping = nullptr;
+	vars.mapping_size = 0;
+
+	bool made = true;
+	if (grey)
+	{
+		vars.grey = d2array<T>(rows, cols);
+		made = vars.grey.data != nullptr;
+	}
+	else
+	{
+		vars.red = d2array<T>(rows, cols);
+		vars.green = d2array<T>(rows, cols);
+		vars.blue = d2array<T>(rows, cols);
+		made = vars.red.data != nullptr &&
+			vars.green.data != nullptr && vars.blue.data != nullptr;
+	}
+
+	//hands the old picture back so whoever owns it frees everything
+	if (!made)
+	{
+		all_array_delete( vars );
+		vars = old;
+		allocation_error( vars, "memory or allocation error resample" );
+		return;
+	}
+
+	for (k = 0; k < bands; k++)
+	{
+		const basic_plane<T> &src = grey ? old.grey :
+			(k == 0) ? old.red : (k == 1) ? old.green : old.blue;
+		basic_plane<T> &dst = grey ? vars.grey :
+			(k == 0) ? vars.red : (k == 1) ? vars.green : vars.blue;
+
+		resample_band( src, dst, across, down, top );
+	}
+
+	vars.rows = rows;
+	vars.cols = cols;
+	all_array_delete( old );
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * resamples one colorband into dst, which is already the new size.  Each
+ * band of rows out filters the source rows its windows cover across into
+ * a buffer kept by the thread, then blends each row out from them.
+ *
+ * @param[in]      src - the colorband
+ * @param[out]     dst - receives the resampled colorband
+ * @param[in]      across - the weights along a row
+ * @param[in]      down - the weights along a column
+ * @param[in]      top - largest value a pixel may take
+ *
+ *****************************************************************************/
+template <class T>
+void resample_band( const basic_plane<T> &src, basic_plane<T> &dst,
+	const resample_axis &across, const resample_axis &down, int top )
+{
+	typedef typename sample_traits<T>::filtered filtered;
+
+	int cols = across.size;
+	int taps = down.taps;
+
+	//filtered rows each row out accounts for, to size the bands
+	int share = max(1, (src.rows + dst.rows - 1) / dst.rows);
+	int height = int((int64_t(BAND_TAPS) * taps * dst.rows + src.rows - 1) /
+		src.rows);
+
+	parallel_rows( dst.rows, cols * int(sizeof(filtered)) * share,
+		[&] (int first, int last)
+	{
+		//loop variables
+		int i = 0;
+		int t = 0;
+
+		//filtered rows of the band and the ones each row out reads
+		thread_local vector<filtered> buffer;
+		thread_local vector<const filtered *> window;
+
+		int low = down.first[first];
+		int high = down.first[last - 1] + taps;
+		size_t need = size_t(high - low) * cols;
+
+		if (buffer.size() < need)
+			buffer.resize(need);
+		window.resize(taps);
+
+		for (i = low; i < high; i++)
+			filter_row( src[i], buffer.data() + size_t(i - low) * cols,
+				across.first.data(), across.weights.data(), across.taps,
+				cols );
+
+		for (i = first; i < last; i++)
+		{
+			for (t = 0; t < taps; t++)
+				window[t] = buffer.data() + size_t(down.first[i] + t - low) *
+					cols;
+			blend_rows( window.data(), &down.weights[size_t(i) * taps], taps,
+				dst[i], cols, top );
+		}
+	}, height );
+}
+
+
+/*******************************************************************************
+ *                         Sample types
+ ******************************************************************************/
+#define RESAMPLE_FUNCTIONS(T) \
+	template void resample( basic_image<T> &, int, int, resample_filter ); \
+	template void resample_band( const basic_plane<T> &, basic_plane<T> &, \
+		const resample_axis &, const resample_axis &, int );
+
+RESAMPLE_FUNCTIONS(pixel)
+RESAMPLE_FUNCTIONS(wide_pixel)
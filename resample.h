@@ -0,0 +1,48 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief this file contains the resample -r runs: the picture is made a
+ * new size through a bilinear, bicubic, or Lanczos filter, one side at a
+ * time in fixed point.  It should be included with resample.cpp.
+ ****************************************************************************/
+#ifndef  __RESAMPLE__H__
+#define __RESAMPLE__H__
+
+#include "function.h"
+
+
+/*!
+ * @brief the weights one side of a resample uses, worked out once and
+ *				shared by every row or every column
+ *
+ * @details every pixel out reads taps source samples from first on.  The
+ *				windows are kept inside the source, with zero weights where
+ *				one reaches past the filter, so the kernels never check the
+ *				edges.
+ */
+struct resample_axis
+{
+	int size = 0;				/*!< pixels out */
+	int taps = 0;				/*!< samples each pixel reads */
+	vector<int> first;			/*!< first sample of each pixel's window */
+	vector<int16_t> weights;	/*!< taps weights for each pixel, with
+										RESAMPLE_BITS fraction bits and
+										adding up to exactly one */
+};
+
+
+/*******************************************************************************
+ *                         Function Prototypes
+ ******************************************************************************/
+void resample_weights( resample_axis &axis, int from, int to,
+	resample_filter filter, int multiple );
+
+template <class T>
+void resample( basic_image<T> &vars, int cols, int rows,
+	resample_filter filter );
+template <class T>
+void resample_band( const basic_plane<T> &src, basic_plane<T> &dst,
+	const resample_axis &across, const resample_axis &down, int top );
+
+
+#endif
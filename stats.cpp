@@ -0,0 +1,368 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief the run statistics --stats prints: time and processor time of
+ * each stage, bytes read and written, pixels a second, planes allocated,
+ * the result cache's hits and misses, and the peak memory of the process.
+ ****************************************************************************/
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdlib>
+#include <cstring>
+
+#include "stats.h"
+
+//peak memory is only known where the system reports it
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_RUSAGE 1
+#include <sys/resource.h>
+#endif
+
+
+atomic<bool> stats_active(false);
+
+/*!
+ * @brief what every stage of one name added up to
+ */
+struct stage_totals
+{
+	string name;			/*!< name of the stage */
+	uint64_t calls = 0;		/*!< times it ran */
+	double wall = 0;		/*!< seconds of wall clock */
+	double cpu = 0;			/*!< seconds of processor time, all threads */
+	uint64_t pixels = 0;	/*!< pixels it worked on */
+	uint64_t read = 0;		/*!< bytes read while it ran */
+	uint64_t written = 0;	/*!< bytes written while it ran */
+	uint64_t planes = 0;	/*!< planes handed out while it ran */
+};
+
+//prints json lines instead of a table
+static bool stats_json = false;
+
+//when stats_start was called
+static chrono::steady_clock::time_point stats_started;
+static clock_t stats_started_cpu = 0;
+
+//the totals of each stage, in the order they first ran
+static vector<stage_totals> stats_stages;
+static mutex stats_lock;
+
+//counters the file reader and writer and the plane allocator add to
+static atomic<uint64_t> bytes_read(0);
+static atomic<uint64_t> bytes_written(0);
+static atomic<uint64_t> planes_made(0);
+static atomic<uint64_t> planes_reused(0);
+static atomic<uint64_t> plane_bytes(0);
+static atomic<uint64_t> live_bytes(0);
+static atomic<uint64_t> peak_bytes(0);
+
+//counters the result cache adds to
+static atomic<uint64_t> cache_hits(0);
+static atomic<uint64_t> cache_misses(0);
+static atomic<uint64_t> cache_evicted(0);
+static atomic<uint64_t> cache_evicted_bytes(0);
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * turns the counters and stage timers on and prints the statistics when
+ * the program exits, however it exits
+ *
+ * @param[in]      json - prints a json line per stage instead of a table
+ *
+ *****************************************************************************/
+void stats_start( bool json )
+{
+	if (stats_active.exchange(true))
+		return;
+
+	stats_json = json;
+	stats_started = chrono::steady_clock::now();
+	stats_started_cpu = clock();
+	atexit(stats_report);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * adds bytes read from a file to the count
+ *
+ * @param[in]      bytes - amount read
+ *
+ *****************************************************************************/
+void stats_count_read( uint64_t bytes )
+{
+	bytes_read += bytes;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * adds bytes written to a file to the count
+ *
+ * @param[in]      bytes - amount written
+ *
+ *****************************************************************************/
+void stats_count_written( uint64_t bytes )
+{
+	bytes_written += bytes;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * counts a plane d2array handed out and the memory the planes now hold
+ *
+ * @param[in]      bytes - size of the plane
+ * @param[in]      reused - it was a kept plane rather than a new one
+ *
+ *****************************************************************************/
+void stats_count_plane( size_t bytes, bool reused )
+{
+	planes_made++;
+	if (reused)
+		planes_reused++;
+	plane_bytes += bytes;
+
+	uint64_t live = (live_bytes += bytes);
+	uint64_t peak = peak_bytes.load();
+	while (live > peak && !peak_bytes.compare_exchange_weak(peak, live))
+		;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * counts a plane given back, kept or freed
+ *
+ * @param[in]      bytes - size of the plane
+ *
+ *****************************************************************************/
+void stats_count_free( size_t bytes )
+{
+	live_bytes -= bytes;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * counts a picture looked for in the result cache
+ *
+ * @param[in]      hit - it was found
+ *
+ *****************************************************************************/
+void stats_count_cache( bool hit )
+{
+	if (hit)
+		cache_hits++;
+	else
+		cache_misses++;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * counts a file removed from the result cache to keep it under its limit
+ *
+ * @param[in]      bytes - size of the file
+ *
+ *****************************************************************************/
+void stats_count_evict( uint64_t bytes )
+{
+	cache_evicted++;
+	cache_evicted_bytes += bytes;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * takes the clocks and counters as the stage starts
+ *
+ *****************************************************************************/
+void stats_stage::begin()
+{
+	read = bytes_read.load();
+	written = bytes_written.load();
+	planes = planes_made.load();
+	started_cpu = clock();
+	started = chrono::steady_clock::now();
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * adds what the stage took to the totals of its name
+ *
+ *****************************************************************************/
+void stats_stage::end()
+{
+	double wall = chrono::duration<double>(chrono::steady_clock::now() -
+		started).count();
+	double cpu = double(clock() - started_cpu) / CLOCKS_PER_SEC;
+
+	lock_guard<mutex> hold(stats_lock);
+
+	stage_totals *totals = nullptr;
+	for (stage_totals &stage : stats_stages)
+		if (stage.name == name)
+			totals = &stage;
+	if (totals == nullptr)
+	{
+		stats_stages.push_back(stage_totals());
+		totals = &stats_stages.back();
+		totals->name = name;
+	}
+
+	totals->calls++;
+	totals->wall += wall;
+	totals->cpu += cpu;
+	totals->pixels += pixels;
+	totals->read += bytes_read.load() - read;
+	totals->written += bytes_written.load() - written;
+	totals->planes += planes_made.load() - planes;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives the largest amount of memory the process has held, in kilobytes
+ *
+ * @returns the peak resident set size, 0 where it is not known
+ *
+ *****************************************************************************/
+static uint64_t peak_rss()
+{
+#ifdef HAVE_RUSAGE
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return uint64_t(usage.ru_maxrss) / 1024;
+#else
+	return uint64_t(usage.ru_maxrss);
+#endif
+#else
+	return 0;
+#endif
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * writes one stage as a json line
+ *
+ * @param[in][out] out - where the line goes
+ * @param[in]      stage - the totals of the stage
+ *
+ *****************************************************************************/
+static void stats_line( ostream &out, const stage_totals &stage )
+{
+	out << "{\"stage\": \"" << stage.name << "\", \"calls\": " << stage.calls
+		<< ", \"wall_ms\": " << stage.wall * 1e3
+		<< ", \"cpu_ms\": " << stage.cpu * 1e3
+		<< ", \"bytes_read\": " << stage.read
+		<< ", \"bytes_written\": " << stage.written
+		<< ", \"pixels\": " << stage.pixels
+		<< ", \"pixels_per_second\": "
+		<< ((stage.wall > 0) ? stage.pixels / stage.wall : 0)
+		<< ", \"allocations\": " << stage.planes;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * prints the statistics on standard error, so they stay apart from the
+ * program's own messages.  Each stage gets a json line or a table row,
+ * then a total for the whole run with the memory it used, and the result
+ * cache's counters if it was looked in.
+ *
+ *****************************************************************************/
+void stats_report()
+{
+	if (!stats_enabled())
+		return;
+
+	lock_guard<mutex> hold(stats_lock);
+
+	stage_totals total;
+	total.name = "total";
+	total.calls = 1;
+	total.wall = chrono::duration<double>(chrono::steady_clock::now() -
+		stats_started).count();
+	total.cpu = double(clock() - stats_started_cpu) / CLOCKS_PER_SEC;
+	total.read = bytes_read.load();
+	total.written = bytes_written.load();
+	total.planes = planes_made.load();
+	for (const stage_totals &stage : stats_stages)
+		if (stage.name == string("fill") || stage.name == string("stream"))
+			total.pixels += stage.pixels;
+
+	ostringstream out;
+	out << fixed << setprecision(3);
+
+	if (stats_json)
+	{
+		for (const stage_totals &stage : stats_stages)
+		{
+			stats_line( out, stage );
+			out << "}\n";
+		}
+		stats_line( out, total );
+		out << ", \"planes_reused\": " << planes_reused.load()
+			<< ", \"allocated_bytes\": " << plane_bytes.load()
+			<< ", \"peak_plane_bytes\": " << peak_bytes.load()
+			<< ", \"peak_rss_kb\": " << peak_rss()
+			<< ", \"cache_hits\": " << cache_hits.load()
+			<< ", \"cache_misses\": " << cache_misses.load()
+			<< ", \"cache_evicted\": " << cache_evicted.load()
+			<< ", \"cache_evicted_bytes\": " << cache_evicted_bytes.load()
+			<< "}\n";
+		cerr << out.str();
+		return;
+	}
+
+	out << left << setw(10) << "stage" << right << setw(7) << "calls"
+		<< setw(12) << "wall ms" << setw(12) << "cpu ms" << setw(11)
+		<< "MB read" << setw(11) << "MB written" << setw(12) << "Mpixels/s"
+		<< setw(8) << "planes" << '\n';
+
+	stats_stages.push_back(total);
+	for (const stage_totals &stage : stats_stages)
+	{
+		out << left << setw(10) << stage.name << right << setw(7)
+			<< stage.calls << setw(12) << stage.wall * 1e3 << setw(12)
+			<< stage.cpu * 1e3 << setw(11) << stage.read / 1e6 << setw(11)
+			<< stage.written / 1e6 << setw(12)
+			<< ((stage.wall > 0) ? stage.pixels / stage.wall / 1e6 : 0)
+			<< setw(8) << stage.planes << '\n';
+	}
+	stats_stages.pop_back();
+
+	out << "planes " << planes_made.load() << " (" << planes_reused.load()
+		<< " reused), " << plane_bytes.load() / 1e6 << " MB handed out, "
+		<< peak_bytes.load() / 1e6 << " MB at most at once, peak memory "
+		<< peak_rss() / 1024.0 << " MB\n";
+	if (cache_hits.load() + cache_misses.load() > 0)
+		out << "cache " << cache_hits.load() << " hits, "
+			<< cache_misses.load() << " misses, " << cache_evicted.load()
+			<< " removed (" << cache_evicted_bytes.load() / 1e6 << " MB)\n";
+	cerr << out.str();
+}
@@ -0,0 +1,110 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief this file contains the counters and stage timers --stats turns on.
+ * Each part of a run, such as reading the header, filling the arrays,
+ * running the options, and writing the file, is timed by a stats_stage,
+ * and the file reader and writer, the plane allocator, and the result
+ * cache count what they move.  When --stats is not given every hook is one test of a flag.  It
+ * should be included with stats.cpp.
+ ****************************************************************************/
+#ifndef  __STATS__H__
+#define __STATS__H__
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <cstddef>
+#include <cstdint>
+
+
+using namespace std;
+
+
+//set once --stats is seen, read by every hook
+extern atomic<bool> stats_active;
+
+
+/*******************************************************************************
+ *                         Function Prototypes
+ ******************************************************************************/
+void stats_start( bool json );
+void stats_report();
+void stats_count_read( uint64_t bytes );
+void stats_count_written( uint64_t bytes );
+void stats_count_plane( size_t bytes, bool reused );
+void stats_count_free( size_t bytes );
+void stats_count_cache( bool hit );
+void stats_count_evict( uint64_t bytes );
+
+/*! @brief tells if --stats was given */
+inline bool stats_enabled()
+	{ return stats_active.load(memory_order_relaxed); }
+
+/*! @brief counts bytes read from a file, if --stats was given */
+inline void stats_read( uint64_t bytes )
+	{ if (stats_enabled()) stats_count_read( bytes ); }
+
+/*! @brief counts bytes written to a file, if --stats was given */
+inline void stats_written( uint64_t bytes )
+	{ if (stats_enabled()) stats_count_written( bytes ); }
+
+/*! @brief counts a plane handed out by d2array, if --stats was given */
+inline void stats_plane( size_t bytes, bool reused )
+	{ if (stats_enabled()) stats_count_plane( bytes, reused ); }
+
+/*! @brief counts a plane given back to d2array_delet, if --stats was given */
+inline void stats_free( size_t bytes )
+	{ if (stats_enabled()) stats_count_free( bytes ); }
+
+/*! @brief counts a picture found or not found in the cache, if --stats was
+ *				given */
+inline void stats_cache( bool hit )
+	{ if (stats_enabled()) stats_count_cache( hit ); }
+
+/*! @brief counts a file removed from the cache, if --stats was given */
+inline void stats_evict( uint64_t bytes )
+	{ if (stats_enabled()) stats_count_evict( bytes ); }
+
+
+/*!
+ * @brief times one part of the run from its making to its end
+ *
+ * @details the time, the processor time, and what the counters moved in
+ *				between are added to the totals of the stage's name, so a
+ *				stage run once per picture in batch mode is summed.  With
+ *				stages running at the same time the byte counts of each
+ *				hold what the others moved meanwhile too.
+ */
+class stats_stage
+{
+public:
+	/*! @brief starts timing the stage name over pixels pixels */
+	explicit stats_stage( const char *name, uint64_t pixels = 0 ) :
+		name(name), pixels(pixels), on(stats_enabled())
+		{ if (on) begin(); }
+	/*! @brief adds the stage to the totals */
+	~stats_stage() { if (on) end(); }
+
+	stats_stage( const stats_stage & ) = delete;
+	stats_stage &operator=( const stats_stage & ) = delete;
+
+	/*! @brief sets the pixels the stage works on once they are known */
+	void set_pixels( uint64_t amount ) { pixels = amount; }
+
+private:
+	void begin();
+	void end();
+
+	const char *name;			/*!< name totals are kept under */
+	uint64_t pixels;			/*!< pixels the stage works on */
+	bool on;					/*!< --stats was given when it started */
+	chrono::steady_clock::time_point started;	/*!< wall clock at start */
+	clock_t started_cpu = 0;	/*!< processor time at start */
+	uint64_t read = 0;			/*!< bytes read before it started */
+	uint64_t written = 0;		/*!< bytes written before it started */
+	uint64_t planes = 0;		/*!< planes handed out before it started */
+};
+
+
+#endif
@@ -0,0 +1,740 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief The streaming mode.  The picture is read, changed, and written a
+ * band of rows at a time, each option keeping only the rows its stencil
+ * still needs, so memory grows with the width of the picture and not its
+ * height.
+ ****************************************************************************/
+#include "stream.h"
+#include "kernels.h"
+#include "threadpool.h"
+#include "stats.h"
+
+
+//bytes of one colorband a band of rows should hold
+static const int STREAM_BYTES = 1024 * 1024;
+
+//rows a stencil's share of a band has at least, as a multiple of its reach
+static const int SPLIT_REACH = 8;
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs the options over a picture in streaming mode and writes the result.
+ * The header is read first to learn whether the samples take one byte or
+ * two.
+ *
+ * @param[in][out]     vars - vars.fileName is the output basename
+ * @param[in]          input - name of the picture file
+ * @param[in]          checker - -oa or -ob
+ * @param[in]          stages - the options in the order given
+ *
+ * @returns 0 the picture was written
+ * @returns -1 a file could not be opened or read, or the output is the
+ *				input
+ * @returns -2 the output option was not understood
+ *
+ *****************************************************************************/
+int stream_image( picture_header &vars, const char *input, string checker,
+	const vector<pipeline_stage> &stages )
+{
+	if (checker != string("-oa") && checker != string("-ob"))
+	{
+		commandStatement();
+		return -2;
+	}
+
+	//the output is opened while the picture is still being read
+	if (output_is_input( input, vars.fileName ))
+	{
+		cout << "Error streaming can not write over " << input << endl;
+		return -1;
+	}
+
+	ifstream fin(input, ios::in | ios::binary);
+	if (!fin)
+	{
+		cout << "Error opening file";
+		return -1;
+	}
+	{
+		stats_stage timer( "header" );
+		read_in_header(vars, fin);
+	}
+	fin.close();
+
+	//reading, the options, and writing overlap, so they are timed as one
+	stats_stage timer( "stream", picture_pixels( vars ) );
+
+	bool ascii = (checker == string("-oa"));
+	if (vars.max_value > sample_traits<pixel>::largest)
+		return stream_picture<wide_pixel>( vars, input, ascii, stages );
+	return stream_picture<pixel>( vars, input, ascii, stages );
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * streams a picture of T samples through the options.  Contrast has to
+ * know the range of the whole greyscale picture before it can stretch it,
+ * and equalize the counts of every tile, so each of them adds a pass over
+ * the file that only counts the values reaching it; the last pass writes
+ * the output.
+ *
+ * @param[in][out]     vars - vars.fileName is the output basename
+ * @param[in]          input - name of the picture file
+ * @param[in]          ascii - writes P3/P2 instead of P6/P5
+ * @param[in]          stages - the options in the order given
+ *
+ * @returns 0 the picture was written
+ * @returns -1 a file could not be opened or read
+ *
+ *****************************************************************************/
+template <class T>
+int stream_picture( picture_header &vars, const char *input, bool ascii,
+	const vector<pipeline_stage> &stages )
+{
+	//contrast and equalize steps found by the passes so far
+	vector<fused_step<T>> found;
+	vector<fused_step<T>> steps;
+
+	//options that need a counting pass
+	vector<pipeline_stage> counted;
+	bool grey = false;
+
+	for (const pipeline_stage &stage : stages)
+	{
+		if (stage.kind == STAGE_CONTRAST || stage.kind == STAGE_EQUALIZE)
+			counted.push_back(stage);
+		if (stage.kind == STAGE_GREYSCALE || stage.kind == STAGE_CONTRAST ||
+			stage.kind == STAGE_EQUALIZE)
+			grey = true;
+	}
+
+	//counting passes, one for each contrast or equalize
+	while (found.size() < counted.size())
+	{
+		ifstream fin;
+		stream_source<T> source;
+		const pipeline_stage &stage = counted[found.size()];
+		fused_step<T> step;
+
+		//min and max saved for contrast equation
+		int low = sample_traits<T>::largest;
+		int high = 0;
+		shared_ptr<tile_grid<T>> grid(new tile_grid<T>);
+
+		if (!stream_open( vars, fin, input, source ))
+			return -1;
+
+		if (stage.kind == STAGE_EQUALIZE)
+			tile_setup( *grid, vars.rows, vars.cols, vars.max_value );
+
+		stream_steps( vars, stages, found, steps );
+		stream_pass<T>( vars, source, steps,
+			[&] (const row_band<T> &rows, int first, int last)
+		{
+			if (stage.kind == STAGE_EQUALIZE)
+				tile_count( *grid, band_rows( rows, 0 ), first, last );
+			else
+				window_range( band_rows( rows, 0 ), first, last, rows.cols,
+					low, high );
+		});
+		if (source.file.error())
+		{
+			cout << "Error reading input file";
+			return -1;
+		}
+
+		if (stage.kind == STAGE_EQUALIZE)
+		{
+			tile_tables( *grid, stage.value );
+			step.table = false;
+			step.kind = STAGE_EQUALIZE;
+			step.grid = grid;
+		}
+		else
+			step.lut = lut_stretch<T>( low, high, vars.max_value );
+		found.push_back(step);
+	}
+
+	//the writing pass
+	ifstream fin;
+	async_writer fout;
+	ostringstream header;
+	stream_source<T> source;
+
+	if (!stream_open( vars, fin, input, source ))
+		return -1;
+
+	vars.fileName.append( grey ? ".pgm" : ".ppm" );
+	if (!fout.open( vars.fileName.c_str() ))
+	{
+		cout << "Error opening output file";
+		return -1;
+	}
+
+	//sets magic number for picture type
+	if (ascii)
+		vars.magic_number = grey ? string("P2") : string("P3");
+	else
+		vars.magic_number = grey ? string("P5") : string("P6");
+	read_out_header( vars, header );
+	fout.write( header.str() );
+
+	stream_steps( vars, stages, found, steps );
+	stream_pass<T>( vars, source, steps,
+		[&] (const row_band<T> &rows, int first, int last)
+	{
+		stream_write( fout, ascii, rows, first, last );
+	});
+
+	//the last rows are still being written until close returns
+	if (!fout.close())
+	{
+		cout << "Error writing output file";
+		return -1;
+	}
+	if (source.file.error())
+	{
+		cout << "Error reading input file";
+		return -1;
+	}
+	return 0;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * tells if the options are better run in streaming mode even when it was
+ * not asked for.  With no contrast or equalize the picture is read only
+ * once, so
+ * streaming lets reading, editing, and writing run at the same time.
+ * Options that keep the picture packed are left to packed_fill, and a
+ * resample, a convolution, or a stencil that wraps needs the whole
+ * picture.
+ *
+ * @param[in]          stages - the options in the order given
+ *
+ * @returns true the options make a single pass
+ * @returns false the whole picture is better loaded first
+ *
+ *****************************************************************************/
+bool stream_option( const vector<pipeline_stage> &stages )
+{
+	if (packed_option( stages ))
+		return false;
+
+	for (const pipeline_stage &stage : stages)
+		if (stage.kind == STAGE_CONTRAST || stage.kind == STAGE_EQUALIZE ||
+			stage.kind == STAGE_RESAMPLE || stage.kind == STAGE_CONVOLVE ||
+			stage.border.mode == BORDER_WRAP)
+			return false;
+
+	return true;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * turns the options into steps the way run_pipeline does.  Contrasts and
+ * equalizes that a pass already counted use the step it found; the first
+ * one without a step ends the steps, so the pass counts the values
+ * reaching it.
+ *
+ * @param[in]          vars - the picture header
+ * @param[in]          stages - the options in the order given
+ * @param[in]          found - steps for the first contrasts and equalizes
+ * @param[out]         steps - the steps to run
+ *
+ *****************************************************************************/
+template <class T>
+void stream_steps( const picture_header &vars,
+	const vector<pipeline_stage> &stages,
+	const vector<fused_step<T>> &found, vector<fused_step<T>> &steps )
+{
+	//contrasts and equalizes passed so far
+	size_t counted = 0;
+	bool grey = false;
+
+	steps.clear();
+	for (const pipeline_stage &stage : stages)
+	{
+		fused_step<T> step;
+		step.table = false;
+		step.kind = stage.kind;
+		step.top = min(vars.max_value, sample_traits<T>::largest);
+
+		switch (stage.kind)
+		{
+		case STAGE_NEGATE:
+			add_table( steps, lut_negate( T(vars.max_value) ) );
+			break;
+
+		case STAGE_BRIGHTEN:
+			add_table( steps, lut_brighten<T>( stage.value,
+				vars.max_value ) );
+			break;
+
+		case STAGE_SHARPEN:
+		case STAGE_SMOOTH:
+			//no band redoes rows here, so every stencil joins the pass
+			step.radius = (stage.kind == STAGE_SMOOTH) ? stage.value : 1;
+			step.border = stage.border;
+			step.border.fill = min(stage.border.fill, step.top);
+			steps.push_back(step);
+			break;
+
+		case STAGE_GREYSCALE:
+		case STAGE_CONTRAST:
+		case STAGE_EQUALIZE:
+			if (!grey)
+			{
+				step.kind = STAGE_GREYSCALE;
+				if (stage.kind == STAGE_GREYSCALE)
+					step.weights = grey_weights(stage.value);
+				steps.push_back(step);
+			}
+			grey = true;
+
+			if (stage.kind != STAGE_GREYSCALE)
+			{
+				if (counted == found.size())
+					return;
+				if (found[counted].table)
+					add_table( steps, found[counted].lut );
+				else
+					steps.push_back(found[counted]);
+				counted++;
+			}
+			break;
+
+		case STAGE_RESAMPLE:
+		case STAGE_CONVOLVE:
+			//never streamed, main turns down -r and -k with -l
+			break;
+		}
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * opens the picture and reads its header, then starts reading the samples
+ * ahead so the first rows are ready while the rest are still on their way
+ *
+ * @param[out]         vars - the picture header
+ * @param[out]         fin - reads the header, closed once the samples are
+ *						being read ahead
+ * @param[in]          input - name of the picture file
+ * @param[out]         source - set up to read the samples
+ *
+ * @returns true the file is open and its type known
+ * @returns false the file could not be opened or has an unknown type
+ *
+ *****************************************************************************/
+template <class T>
+bool stream_open( picture_header &vars, ifstream &fin, const char *input,
+	stream_source<T> &source )
+{
+	fin.open(input, ios::in | ios::binary);
+	if (!fin)
+	{
+		cout << "Error opening file";
+		return false;
+	}
+
+	//each pass reads the header again
+	vars.comment.clear();
+	read_in_header(vars, fin);
+
+	if (!body_open( source.file, fin, input ))
+	{
+		cout << "Error opening file";
+		return false;
+	}
+	fin.close();
+
+	if ( vars.magic_number == string("P3") ||
+		vars.magic_number == string("P2") )
+	{
+		source.ascii = true;
+		ascii_open(source.reader, source.file);
+	}
+	else if ( vars.magic_number != string("P6") &&
+		vars.magic_number != string("P5") )
+	{
+		cout << "Error with magic number" << endl;
+		return false;
+	}
+
+	source.channels = ( vars.magic_number == string("P2") ||
+		vars.magic_number == string("P5") ) ? 1 : 3;
+	return true;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * streams the picture through the steps.  Each round asks for the next
+ * band of finished rows; working back from the last step, every step is
+ * asked for the rows the step after it reads, makes only the ones it has
+ * not made yet, and first drops the rows nobody will read again.  The
+ * finished rows are handed to sink.  A greyscale first is done as the rows
+ * are read, so the colorbands are never stored.
+ *
+ * @param[in]          vars - the picture header
+ * @param[in][out]     source - the samples of the picture
+ * @param[in]          steps - the steps to run
+ * @param[in]          sink - receives finished rows first to last - 1
+ *
+ *****************************************************************************/
+template <class T>
+void stream_pass( picture_header &vars, stream_source<T> &source,
+	const vector<fused_step<T>> &steps,
+	const function<void(const row_band<T> &, int, int)> &sink )
+{
+	//loop variable
+	int k = 0;
+
+	if (!steps.empty() && !steps[0].table &&
+		steps[0].kind == STAGE_GREYSCALE)
+	{
+		vector<fused_step<T>> rest(steps.begin() + 1, steps.end());
+
+		source.grey = true;
+		source.weights = steps[0].weights;
+		stream_pass( vars, source, rest, sink );
+		return;
+	}
+
+	int rows = vars.rows;
+	int count = int(steps.size());
+
+	//the rows read from the file, then the rows each step has made
+	vector<row_band<T>> bands(count + 1);
+	vector<int> done(count + 1, 0);
+	vector<int> need(count + 1, 0);
+
+	//rows finished each round, never fewer than the widest stencil reads
+	int height = max(1, STREAM_BYTES / max(vars.cols * int(sizeof(T)), 1));
+
+	bands[0].channels = source.grey ? 1 : 3;
+	for (k = 0; k <= count; k++)
+	{
+		bands[k].cols = vars.cols;
+		if (k > 0)
+		{
+			bands[k].channels = (steps[k - 1].kind == STAGE_GREYSCALE) ?
+				1 : bands[k - 1].channels;
+			height = max(height, 2 * steps[k - 1].radius + 1);
+		}
+	}
+
+	for (int written = 0; written < rows; written = need[count])
+	{
+		need[count] = min(rows, written + height);
+		for (k = count - 1; k >= 0; k--)
+			need[k] = min(rows, need[k + 1] + steps[k].radius);
+
+		//rows the first step still reads, then the new ones
+		band_trim( bands[0], count > 0 ? done[1] - steps[0].radius :
+			written );
+		stream_read( source, bands[0], need[0] - done[0] );
+		done[0] = need[0];
+
+		for (k = 0; k < count; k++)
+		{
+			band_trim( bands[k + 1], k + 1 < count ?
+				done[k + 2] - steps[k + 1].radius : done[k + 1] );
+			stream_step( steps[k], bands[k], bands[k + 1], done[k + 1],
+				need[k + 1], rows );
+			done[k + 1] = need[k + 1];
+		}
+
+		sink( bands[count], written, need[count] );
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * reads the next rows of the picture onto the bottom of a band, spread out
+ * into colorbands or turned grey the way fill_row does.  A grey picture
+ * fills all three the way binary_fill does, and a short file leaves the
+ * rest black.
+ *
+ * @param[in][out]     source - the samples of the picture
+ * @param[in][out]     rows - band the rows are added to
+ * @param[in]          count - amount of rows to read
+ *
+ *****************************************************************************/
+template <class T>
+void stream_read( stream_source<T> &source, row_band<T> &rows, int count )
+{
+	//loop variable
+	int i = 0;
+
+	int cols = rows.cols;
+	size_t row_values = size_t(cols) * source.channels;
+	int start = rows.first + rows.count;
+
+	if (count <= 0)
+		return;
+
+	band_grow( rows, count );
+
+	//ascii samples are parsed in one go, binary rows are used in place
+	if (source.ascii)
+	{
+		size_t want = count * row_values;
+		source.block.resize(want);
+
+		size_t got = ascii_read(source.reader, source.block.data(), want);
+		if (got < want)
+			memset(source.block.data() + got, 0, (want - got) * sizeof(T));
+	}
+
+	basic_window<T> red = band_rows( rows, 0 );
+	basic_window<T> green = band_rows( rows, 1 );
+	basic_window<T> blue = band_rows( rows, 2 );
+
+	for (i = 0; i < count; i++)
+	{
+		const T *src = source.ascii ?
+			source.block.data() + i * row_values :
+			body_samples( source.file, source.spare, source.block,
+				row_values );
+
+		if (source.grey && source.channels == 3)
+			grey_packed(src, red[start + i], cols, source.weights);
+		else if (source.grey)
+			grey_row(src, src, src, red[start + i], cols, source.weights);
+		else if (source.channels == 3)
+			split_rgb(src, red[start + i], green[start + i], blue[start + i],
+				cols);
+		else
+		{
+			memcpy(red[start + i], src, cols * sizeof(T));
+			memcpy(green[start + i], src, cols * sizeof(T));
+			memcpy(blue[start + i], src, cols * sizeof(T));
+		}
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * makes rows first to last - 1 of one step onto the bottom of out, reading
+ * them and their neighbours from in
+ *
+ * @param[in]          step - the step to run
+ * @param[in]          in - rows the step reads
+ * @param[in][out]     out - band the new rows are added to
+ * @param[in]          first - first row made
+ * @param[in]          last - one past the last row made
+ * @param[in]          rows - amount of rows in the picture
+ *
+ *****************************************************************************/
+template <class T>
+void stream_step( const fused_step<T> &step, const row_band<T> &in,
+	row_band<T> &out, int first, int last, int rows )
+{
+	//loop variable
+	int c = 0;
+
+	int cols = in.cols;
+
+	if (last <= first)
+		return;
+	band_grow( out, last - first );
+
+	//greyscale turns three colorbands into one
+	if (step.kind == STAGE_GREYSCALE && !step.table)
+	{
+		basic_window<T> red = band_rows( in, 0 );
+		basic_window<T> green = band_rows( in, 1 );
+		basic_window<T> blue = band_rows( in, 2 );
+		basic_window<T> grey = band_rows( out, 0 );
+
+		parallel_rows( last - first, cols * int(sizeof(T)),
+			[&] (int low, int high)
+		{
+			for (int i = first + low; i < first + high; i++)
+				grey_row( red[i], green[i], blue[i], grey[i], cols,
+					step.weights );
+		});
+		return;
+	}
+
+	for (c = 0; c < out.channels; c++)
+	{
+		basic_window<T> src = band_rows( in, c );
+		basic_window<T> dst = band_rows( out, c );
+
+		parallel_rows( last - first, cols * int(sizeof(T)),
+			[&] (int low, int high)
+		{
+			if (step.table)
+			{
+				for (int i = first + low; i < first + high; i++)
+					lut_row( step.lut.table, src[i], dst[i], cols );
+			}
+			else if (step.kind == STAGE_SHARPEN)
+				sharpen_rows<LAYOUT_PLANAR>( src, dst, first + low,
+					first + high, rows, cols, step.top, step.border );
+			else if (step.kind == STAGE_EQUALIZE)
+				equalize_rows( *step.grid, src, dst, first + low,
+					first + high );
+			else
+				smooth_rows<LAYOUT_PLANAR>( src, dst, first + low,
+					first + high, rows, cols, step.radius, step.border );
+		}, SPLIT_REACH * step.radius );
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * hands finished rows to the output file the way ascii_out and
+ * binary_out write a whole picture.  They are written out while the next
+ * rows are made.
+ *
+ * @param[in][out]     fout - output file, after its header
+ * @param[in]          ascii - writes P3/P2 samples instead of bytes
+ * @param[in]          rows - band holding the finished rows
+ * @param[in]          first - first row written
+ * @param[in]          last - one past the last row written
+ *
+ *****************************************************************************/
+template <class T>
+void stream_write( async_writer &fout, bool ascii, const row_band<T> &rows,
+	int first, int last )
+{
+	//loop variable
+	int i = 0;
+
+	int cols = rows.cols;
+	size_t row_values = size_t(cols) * rows.channels;
+	size_t row_bytes = row_values * sizeof(T);
+
+	basic_window<T> red = band_rows( rows, 0 );
+	basic_window<T> green = band_rows( rows, 1 );
+	basic_window<T> blue = band_rows( rows, 2 );
+
+	//colorbands are packed into file order, as text for ascii.  Binary
+	//byte samples are packed straight into the writer's chunk, 2 byte
+	//samples are turned around into it
+	bool direct = !ascii && sizeof(T) == 1;
+	vector<T> row(direct ? 0 : row_values);
+	for (i = first; i < last; i++)
+	{
+		T *dst = direct ? (T*) fout.reserve(row_bytes) : row.data();
+
+		if (rows.channels == 1)
+			memcpy(dst, red[i], cols * sizeof(T));
+		else
+			merge_rgb(red[i], green[i], blue[i], dst, cols);
+
+		if (!ascii)
+		{
+			if (!direct)
+				write_samples(dst, (pixel*) fout.reserve(row_bytes),
+					int(row_values));
+			fout.commit(row_bytes);
+			continue;
+		}
+
+		//every sample has at most so many characters
+		char *text = fout.reserve(row_values * sample_traits<T>::digits);
+		fout.commit(ascii_format(dst, row_values, text) - text);
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives the rows of one colorband of a band by their picture row number
+ *
+ * @param[in]          rows - the band
+ * @param[in]          channel - 0, 1, or 2 for red, green, or blue
+ *
+ * @returns the rows of the colorband
+ *
+ *****************************************************************************/
+template <class T>
+basic_window<T> band_rows( const row_band<T> &rows, int channel )
+{
+	basic_window<T> window;
+
+	window.data = const_cast<T *>(rows.band[channel].data());
+	window.first = rows.first;
+	window.stride = rows.cols;
+	return window;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * drops the rows above row first from the top of a band
+ *
+ * @param[in][out]     rows - the band
+ * @param[in]          first - first row to keep
+ *
+ *****************************************************************************/
+template <class T>
+void band_trim( row_band<T> &rows, int first )
+{
+	//loop variable
+	int c = 0;
+
+	int drop = min(rows.count, first - rows.first);
+
+	if (drop <= 0)
+		return;
+
+	for (c = 0; c < rows.channels; c++)
+	{
+		T *data = rows.band[c].data();
+
+		memmove(data, data + size_t(drop) * rows.cols,
+			size_t(rows.count - drop) * rows.cols * sizeof(T));
+	}
+	rows.first += drop;
+	rows.count -= drop;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * adds room for count more rows at the bottom of a band
+ *
+ * @param[in][out]     rows - the band
+ * @param[in]          count - amount of rows to add
+ *
+ *****************************************************************************/
+template <class T>
+void band_grow( row_band<T> &rows, int count )
+{
+	//loop variable
+	int c = 0;
+
+	rows.count += count;
+	for (c = 0; c < rows.channels; c++)
+		if (rows.band[c].size() < size_t(rows.count) * rows.cols)
+			rows.band[c].resize(size_t(rows.count) * rows.cols);
+}
@@ -0,0 +1,92 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief this file contains the streaming mode, which edits a picture a
+ * band of rows at a time so it never has to fit in memory whole.  It
+ * should be included with stream.cpp.
+ ****************************************************************************/
+#ifndef  __STREAM__H__
+#define __STREAM__H__
+
+#include <functional>
+
+#include "function.h"
+#include "pipeline.h"
+
+
+/*!
+ * @brief a run of whole rows of one or three colorbands
+ *
+ * @details holds picture rows first to first + count - 1.  Rows are added
+ *				at the bottom and dropped from the top as the picture
+ *				streams through.
+ */
+template <class T>
+struct row_band
+{
+	int first = 0;		/*!< picture row number of the first row held */
+	int count = 0;		/*!< amount of rows held */
+	int cols = 0;		/*!< pixels in a row */
+	int channels = 3;	/*!< 3 for red, green, blue or 1 for grey */
+	vector<T> band[3];	/*!< the rows of each colorband */
+};
+
+/*!
+ * @brief where the rows of the picture come from
+ */
+template <class T>
+struct stream_source
+{
+	async_reader file;			/*!< file read ahead from its header on */
+	bool ascii = false;			/*!< P3 or P2 samples */
+	int channels = 3;			/*!< samples per pixel in the file */
+	ascii_reader reader;		/*!< parser for ascii samples */
+	vector<T> block;			/*!< ascii rows, or a binary row of 2 byte
+										samples turned around */
+	vector<pixel> spare;		/*!< a binary row split between chunks */
+	bool grey = false;			/*!< rows are turned grey as they are read */
+	grey_weights weights = GREY_LEGACY;	/*!< weights they are turned grey
+													with */
+};
+
+
+/*******************************************************************************
+ *                         Function Prototypes
+ ******************************************************************************/
+int stream_image( picture_header &vars, const char *input, string checker,
+	const vector<pipeline_stage> &stages );
+bool stream_option( const vector<pipeline_stage> &stages );
+
+template <class T>
+int stream_picture( picture_header &vars, const char *input, bool ascii,
+	const vector<pipeline_stage> &stages );
+template <class T>
+void stream_steps( const picture_header &vars,
+	const vector<pipeline_stage> &stages,
+	const vector<fused_step<T>> &found, vector<fused_step<T>> &steps );
+template <class T>
+bool stream_open( picture_header &vars, ifstream &fin, const char *input,
+	stream_source<T> &source );
+template <class T>
+void stream_pass( picture_header &vars, stream_source<T> &source,
+	const vector<fused_step<T>> &steps,
+	const function<void(const row_band<T> &, int, int)> &sink );
+
+template <class T>
+void stream_read( stream_source<T> &source, row_band<T> &rows, int count );
+template <class T>
+void stream_step( const fused_step<T> &step, const row_band<T> &in,
+	row_band<T> &out, int first, int last, int rows );
+template <class T>
+void stream_write( async_writer &fout, bool ascii, const row_band<T> &rows,
+	int first, int last );
+
+template <class T>
+basic_window<T> band_rows( const row_band<T> &rows, int channel );
+template <class T>
+void band_trim( row_band<T> &rows, int first );
+template <class T>
+void band_grow( row_band<T> &rows, int count );
+
+
+#endif
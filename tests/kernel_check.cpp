@@ -0,0 +1,609 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief checks that the hand vectorized row kernels give the same bytes as
+ * the plain c++ loops.  Random rows from 3 to 300 pixels wide, and the
+ * boxes of every smooth radius, are run through sharpen_row, column_add,
+ * prefix_row and box_row at each instruction set the cpu has, and any
+ * sample that differs from the scalar answer is a failure.  The point
+ * operation kernels, lut_row, range_row, grey_row and grey_packed, are
+ * swept the same way.
+ *
+ * @par Compiling:
+ * the kernel_check target of CMakeLists.txt, linked with the picture_core
+ * library
+ *
+ * @par Usage:
+   @verbatim
+   kernel_check [seed]
+   @endverbatim
+ ****************************************************************************/
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "../function.h"
+#include "../kernels.h"
+
+
+//narrowest and widest rows tried, in pixels
+static const int CHECK_MIN_WIDTH = 3;
+static const int CHECK_MAX_WIDTH = 300;
+
+//rows of each width tried, different random samples each time
+static const int CHECK_TRIES = 4;
+
+//value the outputs start at, so samples a kernel should not touch are seen
+static const uint32_t CHECK_UNTOUCHED = 0xA5A5A5A5;
+
+
+/*!
+ * @brief the random numbers and failures of one run
+ */
+struct check_state
+{
+	mt19937 random;			/*!< the samples */
+	int failures = 0;		/*!< rows that differed from the scalar loop */
+	int rows = 0;			/*!< rows compared */
+};
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives a random whole number from low to high, both included
+ *
+ * @param[in][out] state - the random numbers
+ * @param[in]      low - smallest answer
+ * @param[in]      high - largest answer
+ *
+ * @returns the number
+ *
+ *****************************************************************************/
+static int check_between( check_state &state, int low, int high )
+{
+	return uniform_int_distribution<int>( low, high )( state.random );
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives count random samples from 0 to top
+ *
+ * @param[in][out] state - the random numbers
+ * @param[in]      count - amount of samples
+ * @param[in]      top - largest sample
+ *
+ * @returns the samples
+ *
+ *****************************************************************************/
+template <class S>
+static vector<S> check_samples( check_state &state, int count, int top )
+{
+	vector<S> samples(count);
+
+	for (S &sample : samples)
+		sample = S(check_between( state, 0, top ));
+	return samples;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives a row of count samples all set to CHECK_UNTOUCHED, cut to the size
+ * of the sample
+ *
+ * @param[in]      count - amount of samples
+ *
+ * @returns the row
+ *
+ *****************************************************************************/
+template <class S>
+static vector<S> check_untouched( int count )
+{
+	return vector<S>( count, S(CHECK_UNTOUCHED) );
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * compares what a kernel wrote at level against the scalar answer and
+ * prints the first sample that differs
+ *
+ * @param[in][out] state - counts the rows and failures
+ * @param[in]      kernel - name of the kernel and its layout and sample
+ * @param[in]      level - instruction set the answer was made with
+ * @param[in]      width - pixels in the row
+ * @param[in]      answer - the samples written
+ * @param[in]      scalar - the samples the plain loop wrote
+ *
+ *****************************************************************************/
+template <class S>
+static void check_same( check_state &state, const string &kernel,
+	simd_level level, int width, const vector<S> &answer,
+	const vector<S> &scalar )
+{
+	size_t j = 0;
+
+	state.rows++;
+	for (j = 0; j < scalar.size(); j++)
+	{
+		if (answer[j] != scalar[j])
+		{
+			cout << kernel << " " << simd_name( level ) << " width " <<
+				width << ": sample " << j << " is " << uint64_t(answer[j]) <<
+				", scalar gave " << uint64_t(scalar[j]) << endl;
+			state.failures++;
+			return;
+		}
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs sharpen_row on random rows of every width at each level, the
+ * outputs outside LAYOUT to cols - LAYOUT having to be left alone too
+ *
+ * @param[in][out] state - the random numbers and failures
+ * @param[in]      levels - instruction sets to compare, scalar first
+ * @param[in]      name - names the layout and sample in messages
+ *
+ *****************************************************************************/
+template <pixel_layout LAYOUT, class T>
+static void check_sharpen( check_state &state,
+	const vector<simd_level> &levels, const string &name )
+{
+	int width = 0;
+	int pass = 0;
+	int top = sample_traits<T>::largest;
+
+	for (width = CHECK_MIN_WIDTH; width <= CHECK_MAX_WIDTH; width++)
+	{
+		for (pass = 0; pass < CHECK_TRIES; pass++)
+		{
+			int cols = width * LAYOUT;
+			vector<T> up = check_samples<T>( state, cols, top );
+			vector<T> mid = check_samples<T>( state, cols, top );
+			vector<T> down = check_samples<T>( state, cols, top );
+			vector<T> scalar;
+
+			for (simd_level level : levels)
+			{
+				vector<T> out = check_untouched<T>( cols );
+
+				simd_force( level );
+				sharpen_row<LAYOUT, T>( up.data(), mid.data(), down.data(),
+					out.data(), cols, top );
+				if (level == SIMD_SCALAR)
+					scalar = out;
+				else
+					check_same( state, "sharpen_row " + name, level, width,
+						out, scalar );
+			}
+		}
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs column_add on random rows of every width at each level, both
+ * sliding a box down, with a row leaving, and starting one, without
+ *
+ * @param[in][out] state - the random numbers and failures
+ * @param[in]      levels - instruction sets to compare, scalar first
+ * @param[in]      name - names the sample in messages
+ *
+ *****************************************************************************/
+template <class T>
+static void check_column( check_state &state,
+	const vector<simd_level> &levels, const string &name )
+{
+	typedef typename sample_traits<T>::column_sum column_sum;
+	int width = 0;
+	int pass = 0;
+	int top = sample_traits<T>::largest;
+
+	for (width = CHECK_MIN_WIDTH; width <= CHECK_MAX_WIDTH; width++)
+	{
+		for (pass = 0; pass < CHECK_TRIES; pass++)
+		{
+			//a box of the widest smooth, with room for the row leaving
+			vector<T> enter = check_samples<T>( state, width, top );
+			vector<T> leave = check_samples<T>( state, width, top );
+			vector<column_sum> start(width);
+			vector<column_sum> scalar;
+			int k = 0;
+
+			for (k = 0; k < width; k++)
+				start[k] = column_sum(leave[k] + uint64_t(check_between(
+					state, 0, 2 * MAX_RADIUS )) * top);
+
+			for (simd_level level : levels)
+			{
+				vector<column_sum> column = start;
+				vector<column_sum> fresh = start;
+
+				simd_force( level );
+				column_add<T>( column.data(), enter.data(), leave.data(),
+					width );
+				column_add<T>( fresh.data(), enter.data(), nullptr, width );
+				column.insert( column.end(), fresh.begin(), fresh.end() );
+				if (level == SIMD_SCALAR)
+					scalar = column;
+				else
+					check_same( state, "column_add " + name, level, width,
+						column, scalar );
+			}
+		}
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives a row of column sums for a box of width rows, each from 0 to width
+ * times the largest sample
+ *
+ * @param[in][out] state - the random numbers
+ * @param[in]      count - amount of sums
+ * @param[in]      width - rows in the box
+ *
+ * @returns the sums
+ *
+ *****************************************************************************/
+template <class T>
+static vector<typename sample_traits<T>::column_sum> check_columns(
+	check_state &state, int count, int width )
+{
+	typedef typename sample_traits<T>::column_sum column_sum;
+	vector<column_sum> column(count);
+
+	for (column_sum &sum : column)
+		sum = column_sum(uniform_int_distribution<uint32_t>( 0,
+			uint32_t(width) * sample_traits<T>::largest )( state.random ));
+	return column;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs prefix_row on random column sums of every width at each level, the
+ * first LAYOUT totals having to stay 0
+ *
+ * @param[in][out] state - the random numbers and failures
+ * @param[in]      levels - instruction sets to compare, scalar first
+ * @param[in]      name - names the layout and sample in messages
+ *
+ *****************************************************************************/
+template <pixel_layout LAYOUT, class T>
+static void check_prefix( check_state &state,
+	const vector<simd_level> &levels, const string &name )
+{
+	int width = 0;
+	int pass = 0;
+
+	for (width = CHECK_MIN_WIDTH; width <= CHECK_MAX_WIDTH; width++)
+	{
+		for (pass = 0; pass < CHECK_TRIES; pass++)
+		{
+			int cols = width * LAYOUT;
+			vector<typename sample_traits<T>::column_sum> column =
+				check_columns<T>( state, cols, 2 * MAX_RADIUS + 1 );
+			vector<uint32_t> scalar;
+
+			for (simd_level level : levels)
+			{
+				vector<uint32_t> prefix = check_untouched<uint32_t>( cols +
+					LAYOUT );
+
+				fill_n(prefix.begin(), LAYOUT, 0);
+				simd_force( level );
+				prefix_row<LAYOUT, T>( column.data(), prefix.data(), cols );
+				if (level == SIMD_SCALAR)
+					scalar = prefix;
+				else
+					check_same( state, "prefix_row " + name, level, width,
+						prefix, scalar );
+			}
+		}
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs box_row for every smooth radius at each level, on rows of random
+ * width from the box's own width up, the way smooth calls it for the
+ * samples whose box is inside the row
+ *
+ * @param[in][out] state - the random numbers and failures
+ * @param[in]      levels - instruction sets to compare, scalar first
+ * @param[in]      name - names the layout and sample in messages
+ *
+ *****************************************************************************/
+template <pixel_layout LAYOUT, class T>
+static void check_box( check_state &state, const vector<simd_level> &levels,
+	const string &name )
+{
+	int radius = 0;
+	int pass = 0;
+
+	for (radius = 1; radius <= MAX_RADIUS; radius++)
+	{
+		int width = 2 * radius + 1;
+		box_divider divide = make_divider( uint32_t(width) * width,
+			sample_traits<T>::largest );
+
+		for (pass = 0; pass < CHECK_TRIES; pass++)
+		{
+			int pixels = check_between( state, max(CHECK_MIN_WIDTH, width),
+				max(CHECK_MAX_WIDTH, width) );
+			int cols = pixels * LAYOUT;
+			int edge = radius * LAYOUT;
+			vector<typename sample_traits<T>::column_sum> column =
+				check_columns<T>( state, cols, width );
+			vector<uint32_t> prefix(cols + LAYOUT, 0);
+			vector<T> scalar;
+
+			//the totals come from the scalar loop, prefix_row is checked
+				//on its own
+			simd_force( SIMD_SCALAR );
+			prefix_row<LAYOUT, T>( column.data(), prefix.data(), cols );
+
+			for (simd_level level : levels)
+			{
+				vector<T> out = check_untouched<T>( cols );
+
+				simd_force( level );
+				box_row<LAYOUT>( prefix.data(), radius, divide, out.data(),
+					edge, cols - edge );
+				if (level == SIMD_SCALAR)
+					scalar = out;
+				else
+					check_same( state, "box_row " + name + " radius " +
+						to_string(radius), level, pixels, out, scalar );
+			}
+		}
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs lut_row on random rows of every width at each level, through one
+ * random table of every value, the pad entry after it included
+ *
+ * @param[in][out] state - the random numbers and failures
+ * @param[in]      levels - instruction sets to compare, scalar first
+ * @param[in]      name - names the sample in messages
+ *
+ *****************************************************************************/
+template <class T>
+static void check_lut( check_state &state, const vector<simd_level> &levels,
+	const string &name )
+{
+	int width = 0;
+	int pass = 0;
+	int top = sample_traits<T>::largest;
+	vector<T> table = check_samples<T>( state,
+		sample_traits<T>::values + 1, top );
+
+	for (width = CHECK_MIN_WIDTH; width <= CHECK_MAX_WIDTH; width++)
+	{
+		for (pass = 0; pass < CHECK_TRIES; pass++)
+		{
+			vector<T> src = check_samples<T>( state, width, top );
+			vector<T> scalar;
+
+			for (simd_level level : levels)
+			{
+				vector<T> out = check_untouched<T>( width );
+
+				simd_force( level );
+				lut_row<T>( table.data(), src.data(), out.data(), width );
+				if (level == SIMD_SCALAR)
+					scalar = out;
+				else
+					check_same( state, "lut_row " + name, level, width, out,
+						scalar );
+			}
+		}
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs range_row on random rows of every width at each level, starting
+ * from a random low and high the way contrast carries them from row to row
+ *
+ * @param[in][out] state - the random numbers and failures
+ * @param[in]      levels - instruction sets to compare, scalar first
+ * @param[in]      name - names the sample in messages
+ *
+ *****************************************************************************/
+template <class T>
+static void check_range( check_state &state,
+	const vector<simd_level> &levels, const string &name )
+{
+	int width = 0;
+	int pass = 0;
+	int top = sample_traits<T>::largest;
+
+	for (width = CHECK_MIN_WIDTH; width <= CHECK_MAX_WIDTH; width++)
+	{
+		for (pass = 0; pass < CHECK_TRIES; pass++)
+		{
+			vector<T> src = check_samples<T>( state, width, top );
+			int start_low = check_between( state, 0, top );
+			int start_high = check_between( state, 0, top );
+			vector<int> scalar;
+
+			for (simd_level level : levels)
+			{
+				int low = start_low;
+				int high = start_high;
+
+				simd_force( level );
+				range_row<T>( src.data(), width, low, high );
+				if (level == SIMD_SCALAR)
+					scalar = { low, high };
+				else
+					check_same( state, "range_row " + name, level, width,
+						vector<int> { low, high }, scalar );
+			}
+		}
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs grey_row on random colorbands, and grey_packed on the same pixels
+ * packed as rgb triplets, for every weight set at each level
+ *
+ * @param[in][out] state - the random numbers and failures
+ * @param[in]      levels - instruction sets to compare, scalar first
+ * @param[in]      name - names the sample in messages
+ *
+ *****************************************************************************/
+template <class T>
+static void check_grey( check_state &state, const vector<simd_level> &levels,
+	const string &name )
+{
+	const grey_weights weight_sets[] = { GREY_LEGACY, GREY_BT601,
+		GREY_BT709 };
+	int width = 0;
+	int pass = 0;
+	int top = sample_traits<T>::largest;
+
+	for (grey_weights weights : weight_sets)
+	{
+		string kind = name + " weights " + to_string(int(weights));
+
+		for (width = CHECK_MIN_WIDTH; width <= CHECK_MAX_WIDTH; width++)
+		{
+			for (pass = 0; pass < CHECK_TRIES; pass++)
+			{
+				vector<T> red = check_samples<T>( state, width, top );
+				vector<T> green = check_samples<T>( state, width, top );
+				vector<T> blue = check_samples<T>( state, width, top );
+				vector<T> packed(3 * width);
+				vector<T> scalar;
+				vector<T> scalar_packed;
+				int k = 0;
+
+				for (k = 0; k < width; k++)
+				{
+					packed[3 * k] = red[k];
+					packed[3 * k + 1] = green[k];
+					packed[3 * k + 2] = blue[k];
+				}
+
+				for (simd_level level : levels)
+				{
+					vector<T> out = check_untouched<T>( width );
+					vector<T> out_packed = check_untouched<T>( width );
+
+					simd_force( level );
+					grey_row<T>( red.data(), green.data(), blue.data(),
+						out.data(), width, weights );
+					grey_packed<T>( packed.data(), out_packed.data(), width,
+						weights );
+					if (level == SIMD_SCALAR)
+					{
+						scalar = out;
+						scalar_packed = out_packed;
+					}
+					else
+					{
+						check_same( state, "grey_row " + kind, level, width,
+							out, scalar );
+						check_same( state, "grey_packed " + kind, level,
+							width, out_packed, scalar_packed );
+					}
+				}
+			}
+		}
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs every kernel check for one sample size
+ *
+ * @param[in][out] state - the random numbers and failures
+ * @param[in]      levels - instruction sets to compare, scalar first
+ * @param[in]      sample - byte or wide, for the messages
+ *
+ *****************************************************************************/
+template <class T>
+static void check_kernels( check_state &state,
+	const vector<simd_level> &levels, const string &sample )
+{
+	check_sharpen<LAYOUT_PLANAR, T>( state, levels, "planar " + sample );
+	check_sharpen<LAYOUT_PACKED, T>( state, levels, "packed " + sample );
+	check_column<T>( state, levels, sample );
+	check_prefix<LAYOUT_PLANAR, T>( state, levels, "planar " + sample );
+	check_prefix<LAYOUT_PACKED, T>( state, levels, "packed " + sample );
+	check_box<LAYOUT_PLANAR, T>( state, levels, "planar " + sample );
+	check_box<LAYOUT_PACKED, T>( state, levels, "packed " + sample );
+	check_lut<T>( state, levels, sample );
+	check_range<T>( state, levels, sample );
+	check_grey<T>( state, levels, sample );
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * compares every vector level the cpu has against the scalar loops.  An
+ * optional seed changes the random rows.
+ *
+ * @param[in]      argc - amount of arguments
+ * @param[in]      argv - the arguments
+ *
+ * @returns 0 every kernel matched
+ * @returns 1 a kernel gave different samples
+ *
+ *****************************************************************************/
+int main( int argc, char *argv[] )
+{
+	check_state state;
+	vector<simd_level> levels;
+	int level = 0;
+
+	state.random.seed( argc > 1 ? unsigned(strtoul(argv[1], nullptr, 10)) :
+		2024u );
+
+	//simd_force can not go past what the cpu has
+	for (level = SIMD_SCALAR; level <= simd_detect(); level++)
+		levels.push_back( simd_level(level) );
+	for (level = simd_detect() + 1; level <= SIMD_AVX2; level++)
+		cout << simd_name( simd_level(level) ) <<
+			" is not on this cpu, not checked" << endl;
+
+	check_kernels<pixel>( state, levels, "byte" );
+	check_kernels<wide_pixel>( state, levels, "wide" );
+	simd_force( simd_detect() );
+
+	cout << state.rows << " rows compared, " << state.failures <<
+		" differed" << endl;
+	return state.failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,1177 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief checks the pictures the options make, not just that they run.
+ * Random pictures of byte and 2 byte samples, colour and grey, are edited
+ * through the edit_image library interface and compared sample for sample
+ * with plain models of -n, -b, -g, -c, -e, -p, -s, -k, -r and every
+ * --border mode.  The
+ * same pictures are then written to files and read back, once with the
+ * helper thread forced in place of io_uring, and their -m pyramid levels
+ * are compared with the model of a level.
+ *
+ * @par Compiling:
+ * the option_check target of CMakeLists.txt, linked with the picture_core
+ * library
+ *
+ * @par Usage:
+   @verbatim
+   option_check [folder]
+   @endverbatim
+ ****************************************************************************/
+#include <cmath>
+#include <random>
+
+#include "../function.h"
+#include "../editor.h"
+#include "../pyramid.h"
+#include "../asyncio.h"
+
+
+/*!
+ * @brief a picture the way the models see it, every sample an int and the
+ *				colours of a pixel side by side
+ */
+struct check_picture
+{
+	int rows = 0;			/*!< rows of pixels */
+	int cols = 0;			/*!< columns of pixels */
+	int top = 0;			/*!< the max_value */
+	int channels = 0;		/*!< 3 for colour, 1 for grey */
+	vector<int> samples;	/*!< rows * cols * channels samples */
+
+	/*! @brief gives colour c of the pixel at row i, column j */
+	int &at( int i, int j, int c )
+		{ return samples[(size_t(i) * cols + j) * channels + c]; }
+	/*! @brief gives colour c of the pixel at row i, column j */
+	int at( int i, int j, int c ) const
+		{ return samples[(size_t(i) * cols + j) * channels + c]; }
+};
+
+
+/*!
+ * @brief the edges the stencil model reads past, as --border set them
+ */
+struct check_border
+{
+	border_mode mode = BORDER_KEEP;		/*!< how the edges are read */
+	int fill = 0;						/*!< sample past the edges for
+												BORDER_CONSTANT */
+};
+
+
+//options run on every picture, each on its own, the way prog1 takes them
+static const char *CHECK_OPTIONS[] =
+{
+	"-n",
+	"-p",
+	"-s 1",
+	"-s 2",
+	"-s 4",
+	"-k 1,2,1;2,4,2;1,2,1",
+	"-k -1,0,1;-2,0,2;-1,0,1/1",
+	"-k 1,2,3,4,3,2,1",
+	"-k 1;4;6;4;1",
+	"-k 2,0,-1;0,3,0;-1,0,2/7",
+	"--border clamp -p",
+	"--border clamp -s 3",
+	"--border clamp -k 1,2,1;2,4,2;1,2,1",
+	"--border mirror -p",
+	"--border mirror -s 3",
+	"--border mirror -k 1,1,1,1,1;1,2,2,2,1;1,1,1,1,1",
+	"--border wrap -p",
+	"--border wrap -s 3",
+	"--border wrap -k 0,1,0;1,-4,1;0,1,0/1",
+	"--border constant -p",
+	"--border constant 77 -s 3",
+	"--border constant 300 -k 1,2,1;2,4,2;1,2,1",
+	"--border mirror -s 2 -p --border constant 128 -s 1 -n",
+	"--border keep -p",
+	"-r 1 1",
+	"-r 50 9 bilinear",
+	"-r 7 31 bicubic",
+	"-r 33 20 lanczos",
+	"-n -r 90 4",
+	"-b 40",
+	"-b -256",
+	"-n -b 100 -n",
+	"-g",
+	"-g 601",
+	"-g 709 -n",
+	"-c",
+	"-b -90 -c",
+	"-s 2 -c",
+	"-g 709 -c",
+	"-c -b 30 -c",
+	"-e",
+	"-e 1",
+	"-e 40",
+	"-s 1 -e 2",
+	"-g 601 -e -n",
+	"-c -e"
+};
+
+//sizes of the random pictures, cols then rows, from smaller than a kernel
+	//to wider than a vector
+static const int CHECK_SIZES[][2] =
+{
+	{ 1, 1 },
+	{ 2, 5 },
+	{ 4, 3 },
+	{ 17, 9 },
+	{ 61, 34 },
+	{ 130, 12 }
+};
+
+//max_values tried, byte and 2 byte samples
+static const int CHECK_TOPS[] = { 255, 200, 1000, 65535 };
+
+//pyramid levels asked for from each picture
+static const int CHECK_LEVELS = 4;
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * makes a picture of random samples, half of them 0 or top so the models'
+ * clamps are reached
+ *
+ * @param[in][out] random - the random numbers
+ * @param[in]      cols - columns of pixels
+ * @param[in]      rows - rows of pixels
+ * @param[in]      top - the max_value
+ * @param[in]      channels - 3 for colour, 1 for grey
+ *
+ * @returns the picture
+ *
+ *****************************************************************************/
+static check_picture check_random( mt19937 &random, int cols, int rows,
+	int top, int channels )
+{
+	check_picture pic;
+	uniform_int_distribution<int> sample( 0, top );
+	uniform_int_distribution<int> coin( 0, 3 );
+
+	pic.rows = rows;
+	pic.cols = cols;
+	pic.top = top;
+	pic.channels = channels;
+	pic.samples.resize(size_t(rows) * cols * channels);
+	for (int &value : pic.samples)
+	{
+		int side = coin( random );
+		value = side == 0 ? 0 : side == 1 ? top : sample( random );
+	}
+	return pic;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * writes a picture as a P5 or P6 file would hold it, 2 byte samples most
+ * significant byte first
+ *
+ * @param[in]      pic - the picture
+ *
+ * @returns the file's bytes
+ *
+ *****************************************************************************/
+static string check_encode( const check_picture &pic )
+{
+	ostringstream out;
+
+	out << (pic.channels == 1 ? "P5" : "P6") << "\n" << pic.cols << " " <<
+		pic.rows << "\n" << pic.top << "\n";
+	for (int value : pic.samples)
+	{
+		if (pic.top > 255)
+			out.put(char(value >> 8));
+		out.put(char(value & 255));
+	}
+	return out.str();
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * reads a P2, P3, P5 or P6 picture back into the model's form
+ *
+ * @param[in]      data - the file's bytes
+ * @param[out]     pic - the picture
+ *
+ * @returns true the picture was read whole
+ * @returns false the bytes are not a picture or are cut short
+ *
+ *****************************************************************************/
+static bool check_decode( const string &data, check_picture &pic )
+{
+	istringstream in(data);
+	string magic;
+	size_t k = 0;
+
+	in >> magic >> pic.cols >> pic.rows >> pic.top;
+	if (!in || magic.size() != 2 || magic[0] != 'P')
+		return false;
+	in.get();
+
+	pic.channels = (magic == "P2" || magic == "P5") ? 1 : 3;
+	pic.samples.assign(size_t(pic.rows) * pic.cols * pic.channels, 0);
+	for (k = 0; k < pic.samples.size(); k++)
+	{
+		if (magic == "P2" || magic == "P3")
+			in >> pic.samples[k];
+		else
+		{
+			int value = in.get();
+			if (pic.top > 255)
+				value = (value << 8) | in.get();
+			pic.samples[k] = value;
+		}
+	}
+	return bool(in);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives the pixel, 0 to count - 1, that place reads past an edge with
+ * mode, or -1 for the fill
+ *
+ * @param[in]      place - row or column read
+ * @param[in]      count - rows or columns in the picture
+ * @param[in]      mode - how the edge is read
+ *
+ * @returns the row or column
+ *
+ *****************************************************************************/
+static int check_index( int place, int count, border_mode mode )
+{
+	int period = 2 * (count - 1);
+
+	if (place >= 0 && place < count)
+		return place;
+	if (mode == BORDER_CONSTANT)
+		return -1;
+	if (mode == BORDER_WRAP)
+		return ((place % count) + count) % count;
+	if (mode == BORDER_MIRROR)
+	{
+		if (count == 1)
+			return 0;
+		place = abs(place) % period;
+		return place < count ? place : period - place;
+	}
+	return place < 0 ? 0 : count - 1;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs a kernel over a picture one pixel at a time.  Sharpen clamps the
+ * sum, every other kernel clamps it to divisor times the max_value and
+ * rounds sum / divisor.  With BORDER_KEEP the pixels whose kernel reaches
+ * past an edge keep their values.
+ *
+ * @param[in]      in - the picture
+ * @param[in]      kernel - the weights, rows of equal length, odd sizes
+ * @param[in]      divisor - what the sum is divided by
+ * @param[in]      border - how the edges are read
+ * @param[in]      sharpen - clamps the sum without dividing it
+ *
+ * @returns the picture made
+ *
+ *****************************************************************************/
+static check_picture check_stencil( const check_picture &in,
+	const vector<vector<int>> &kernel, int divisor, const check_border &border,
+	bool sharpen )
+{
+	check_picture out = in;
+	int reach_rows = int(kernel.size()) / 2;
+	int reach_cols = int(kernel[0].size()) / 2;
+	int fill = min(border.fill, in.top);
+	int64_t most = int64_t(divisor) * in.top;
+
+	for (int i = 0; i < in.rows; i++)
+	{
+		for (int j = 0; j < in.cols; j++)
+		{
+			bool inside = i >= reach_rows && i < in.rows - reach_rows &&
+				j >= reach_cols && j < in.cols - reach_cols;
+
+			if (border.mode == BORDER_KEEP && !inside)
+				continue;
+
+			for (int c = 0; c < in.channels; c++)
+			{
+				int64_t sum = 0;
+
+				for (int r = 0; r < int(kernel.size()); r++)
+					for (int s = 0; s < int(kernel[r].size()); s++)
+					{
+						int y = check_index( i + r - reach_rows, in.rows,
+							border.mode );
+						int x = check_index( j + s - reach_cols, in.cols,
+							border.mode );
+
+						sum += int64_t(kernel[r][s]) * ((y < 0 || x < 0) ?
+							fill : in.at( y, x, c ));
+					}
+
+				if (sharpen)
+					out.at( i, j, c ) = int(min<int64_t>(in.top,
+						max<int64_t>(0, sum)));
+				else
+				{
+					sum = min(most, max<int64_t>(0, sum));
+					out.at( i, j, c ) = int((2 * sum + divisor) /
+						(2 * int64_t(divisor)));
+				}
+			}
+		}
+	}
+	return out;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives the weight filter gives a sample x pixels from the center
+ *
+ * @param[in]      filter - the resampling filter
+ * @param[in]      x - distance from the center, in pixels of the filter
+ *
+ * @returns the weight
+ *
+ *****************************************************************************/
+static double check_filter( resample_filter filter, double x )
+{
+	const double pi = 3.14159265358979323846;
+	const double a = -0.5;
+
+	x = fabs(x);
+	if (filter == RESAMPLE_BILINEAR)
+		return x < 1.0 ? 1.0 - x : 0.0;
+	if (filter == RESAMPLE_BICUBIC)
+	{
+		if (x < 1.0)
+			return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+		if (x < 2.0)
+			return ((a * x - 5.0 * a) * x + 8.0 * a) * x - 4.0 * a;
+		return 0.0;
+	}
+	if (x == 0.0)
+		return 1.0;
+	if (x >= 3.0)
+		return 0.0;
+	return 3.0 * sin(pi * x) * sin(pi * x / 3.0) / (pi * pi * x * x);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * makes the weights of each output pixel of one direction of a resample.
+ * Each is rounded to 14 bits and what the rounding lost is given to the
+ * largest, so every pixel's weights add up to 16384.
+ *
+ * @param[in]      from - pixels in the picture
+ * @param[in]      to - pixels wanted
+ * @param[in]      filter - the resampling filter
+ * @param[out]     first - first pixel read for each output pixel
+ * @param[out]     weights - the weights of the pixels read
+ *
+ *****************************************************************************/
+static void check_weights( int from, int to, resample_filter filter,
+	vector<int> &first, vector<vector<int>> &weights )
+{
+	double scale = double(from) / to;
+	double stretch = max(1.0, scale);
+	double radius = (filter == RESAMPLE_BILINEAR ? 1.0 :
+		filter == RESAMPLE_BICUBIC ? 2.0 : 3.0) * stretch;
+
+	first.assign(to, 0);
+	weights.assign(to, vector<int>());
+	for (int o = 0; o < to; o++)
+	{
+		double center = (o + 0.5) * scale;
+		int low = max(0, int(floor(center - radius)));
+		int high = min(from, int(ceil(center + radius)));
+		vector<double> raw;
+		double total = 0.0;
+		int largest = 0;
+		int sum = 0;
+
+		for (int k = low; k < high; k++)
+			raw.push_back(check_filter( filter, (k + 0.5 - center) /
+				stretch ));
+		for (double value : raw)
+			total += value;
+
+		first[o] = low;
+		for (size_t k = 0; k < raw.size(); k++)
+		{
+			weights[o].push_back(int(floor(raw[k] / total * 16384 + 0.5)));
+			sum += weights[o][k];
+			if (weights[o][k] > weights[o][largest])
+				largest = int(k);
+		}
+		weights[o][largest] += 16384 - sum;
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * resamples a picture across, keeping 8 more bits, then down, rounding
+ * and clamping to the max_value
+ *
+ * @param[in]      in - the picture
+ * @param[in]      cols - columns wanted
+ * @param[in]      rows - rows wanted
+ * @param[in]      filter - the resampling filter
+ *
+ * @returns the picture made
+ *
+ *****************************************************************************/
+static check_picture check_resample( const check_picture &in, int cols,
+	int rows, resample_filter filter )
+{
+	check_picture out = in;
+	vector<int> across_first, down_first;
+	vector<vector<int>> across, down;
+	vector<int64_t> middle(size_t(in.rows) * cols * in.channels);
+
+	if (cols == in.cols && rows == in.rows)
+		return out;
+
+	check_weights( in.cols, cols, filter, across_first, across );
+	check_weights( in.rows, rows, filter, down_first, down );
+
+	for (int i = 0; i < in.rows; i++)
+		for (int j = 0; j < cols; j++)
+			for (int c = 0; c < in.channels; c++)
+			{
+				int64_t sum = 0;
+				for (size_t t = 0; t < across[j].size(); t++)
+					sum += int64_t(in.at( i, across_first[j] + int(t), c )) *
+						across[j][t];
+				middle[(size_t(i) * cols + j) * in.channels + c] =
+					(sum + 128) >> 8;
+			}
+
+	out.rows = rows;
+	out.cols = cols;
+	out.samples.assign(size_t(rows) * cols * in.channels, 0);
+	for (int i = 0; i < rows; i++)
+		for (int j = 0; j < cols * in.channels; j++)
+		{
+			int64_t sum = int64_t(1) << 19;
+			for (size_t t = 0; t < down[i].size(); t++)
+				sum += middle[size_t(down_first[i] + int(t)) * cols *
+					in.channels + j] * down[i][t];
+			sum >>= 20;
+			out.samples[size_t(i) * cols * in.channels + j] =
+				int(min<int64_t>(in.top, max<int64_t>(0, sum)));
+		}
+	return out;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * reads a kernel written the way -k takes it, rows split by ; and weights
+ * by commas, with /divisor after it if the weights' sum is not wanted
+ *
+ * @param[in]      text - the kernel
+ * @param[out]     kernel - the weights
+ *
+ * @returns the divisor, the sum of the weights or 1 if that is not above 0
+ *
+ *****************************************************************************/
+static int check_kernel( const string &text, vector<vector<int>> &kernel )
+{
+	size_t slash = text.find('/');
+	istringstream rows(text.substr(0, slash));
+	string row;
+	string weight;
+	int sum = 0;
+
+	kernel.clear();
+	while (getline(rows, row, ';'))
+	{
+		istringstream weights(row);
+		kernel.push_back(vector<int>());
+		while (getline(weights, weight, ','))
+		{
+			kernel.back().push_back(stoi(weight));
+			sum += kernel.back().back();
+		}
+	}
+
+	if (slash != string::npos)
+		return stoi(text.substr(slash + 1));
+	return sum > 0 ? sum : 1;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * makes the grey picture -g, -c and -e work on.  The old weights are
+ * .3 red and .7 green in doubles, cut down to a whole number; BT.601 and
+ * BT.709 are rounded fixed point weights out of 32768.  A grey picture
+ * that has not been made grey yet is read as three equal colours.
+ *
+ * @param[in]      in - the picture
+ * @param[in]      weights - the weight set
+ *
+ * @returns the grey picture
+ *
+ *****************************************************************************/
+static check_picture check_grey( const check_picture &in,
+	grey_weights weights )
+{
+	check_picture out = in;
+	int scale[3] = { 9798, 19235, 3735 };
+
+	if (weights == GREY_BT709)
+	{
+		scale[0] = 6966;
+		scale[1] = 23436;
+		scale[2] = 2366;
+	}
+
+	out.channels = 1;
+	out.samples.assign(size_t(in.rows) * in.cols, 0);
+	for (int i = 0; i < in.rows; i++)
+		for (int j = 0; j < in.cols; j++)
+		{
+			int red = in.at( i, j, 0 );
+			int green = in.at( i, j, in.channels == 3 ? 1 : 0 );
+			int blue = in.at( i, j, in.channels == 3 ? 2 : 0 );
+
+			if (weights == GREY_LEGACY)
+				out.at( i, j, 0 ) = int(.3 * double(red) + .6 *
+					double(green) + .1 * double(green));
+			else
+				out.at( i, j, 0 ) = (red * scale[0] + green * scale[1] +
+					blue * scale[2] + 16384) >> 15;
+		}
+	return out;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * stretches the smallest to largest sample of a grey picture out to
+ * 0 - top, the model of -c.  A flat picture comes out black.
+ *
+ * @param[in]      in - the grey picture
+ *
+ * @returns the stretched picture
+ *
+ *****************************************************************************/
+static check_picture check_stretch( const check_picture &in )
+{
+	check_picture out = in;
+	int low = *min_element( in.samples.begin(), in.samples.end() );
+	int high = *max_element( in.samples.begin(), in.samples.end() );
+	double scale = double(in.top) / (high - low);
+
+	for (int &value : out.samples)
+		value = high == low ? 0 : int(scale * (value - low) + .5);
+	return out;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * the model of -e.  The grey picture is cut into up to 8 by 8 tiles and
+ * each tile counts its values.  Counts over clip times the tile's average,
+ * kept times the amount of values so the average is whole, are cut and
+ * the cut is handed back evenly, the remainder one at a time spread out
+ * from value 0.  A tile's table maps each value to the rounded share of
+ * the tile at or below it.  Each pixel blends the tables of the tile
+ * centers around it by its distance from them, out of 256 each way, and
+ * past the outer centers uses the outer tiles alone.
+ *
+ * @param[in]      in - the grey picture
+ * @param[in]      clip - the clip limit
+ *
+ * @returns the equalized picture
+ *
+ *****************************************************************************/
+static check_picture check_equalize( const check_picture &in, int clip )
+{
+	check_picture out = in;
+	int across = max(1, min(8, in.cols));
+	int down = max(1, min(8, in.rows));
+	uint64_t bins = uint64_t(in.top) + 1;
+	vector<vector<int>> tables(size_t(across) * down);
+
+	//first row or column of a tile, tiles for the far edge
+	auto edge = [] (int tile, int tiles, int total)
+		{ return int(int64_t(tile) * total / tiles); };
+
+	//tile a row or column takes most from and its share of the next tile
+	auto blend = [&edge] (int pos, int tiles, int total, int &first,
+		int &share)
+	{
+		first = 0;
+		share = 0;
+		for (int t = 0; t + 1 < tiles; t++)
+		{
+			//centers doubled so they stay whole
+			int here = edge( t, tiles, total ) + edge( t + 1, tiles,
+				total ) - 1;
+			int next = edge( t + 1, tiles, total ) + edge( t + 2, tiles,
+				total ) - 1;
+
+			if (2 * pos < here)
+				return;
+			first = t;
+			if (2 * pos < next)
+			{
+				share = ((2 * pos - here) * 256 + (next - here) / 2) /
+					(next - here);
+				return;
+			}
+		}
+		first = tiles - 1;
+	};
+
+	for (int down_at = 0; down_at < down; down_at++)
+		for (int across_at = 0; across_at < across; across_at++)
+		{
+			int top = edge( down_at, down, in.rows );
+			int bottom = edge( down_at + 1, down, in.rows );
+			int left = edge( across_at, across, in.cols );
+			int right = edge( across_at + 1, across, in.cols );
+			vector<uint64_t> counts(bins, 0);
+			vector<int> &table = tables[size_t(down_at) * across + across_at];
+			uint64_t pixels = uint64_t(bottom - top) * (right - left);
+			uint64_t limit = uint64_t(clip) * pixels;
+			uint64_t excess = 0;
+			uint64_t sum = 0;
+
+			for (int i = top; i < bottom; i++)
+				for (int j = left; j < right; j++)
+					counts[in.at( i, j, 0 )] += bins;
+			for (uint64_t &count : counts)
+			{
+				if (count > limit)
+				{
+					excess += count - limit;
+					count = limit;
+				}
+			}
+
+			uint64_t rest = excess % bins;
+			uint64_t step = rest ? max(bins / rest, uint64_t(1)) : bins;
+
+			table.resize(bins);
+			for (uint64_t v = 0; v < bins; v++)
+			{
+				sum += counts[v] + excess / bins;
+				if (v % step == 0 && v / step < rest)
+					sum++;
+				table[v] = int((sum * in.top + pixels * bins / 2) /
+					(pixels * bins));
+			}
+		}
+
+	for (int i = 0; i < in.rows; i++)
+	{
+		int up = 0;
+		int down_share = 0;
+
+		blend( i, down, in.rows, up, down_share );
+		for (int j = 0; j < in.cols; j++)
+		{
+			int left = 0;
+			int right_share = 0;
+			int value = in.at( i, j, 0 );
+			int mix[2] = { 0, 0 };
+
+			blend( j, across, in.cols, left, right_share );
+			for (int row = 0; row < 2; row++)
+			{
+				const vector<int> *tile = &tables[size_t(min(up + row,
+					down - 1)) * across];
+
+				mix[row] = tile[left][value] * (256 - right_share) +
+					tile[min(left + 1, across - 1)][value] * right_share;
+			}
+			out.at( i, j, 0 ) = int((int64_t(mix[0]) * (256 - down_share) +
+				int64_t(mix[1]) * down_share + 32768) >> 16);
+		}
+	}
+	return out;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs the models of the options on a picture, in the order given
+ *
+ * @param[in]      in - the picture
+ * @param[in]      options - the options the way prog1 takes them
+ *
+ * @returns the picture the options should make
+ *
+ *****************************************************************************/
+static check_picture check_model( const check_picture &in,
+	const string &options )
+{
+	check_picture pic = in;
+	check_border border;
+	bool grey = false;
+	istringstream words(options);
+	string word;
+	vector<string> rest;
+
+	while (words >> word)
+		rest.push_back(word);
+
+	for (size_t k = 0; k < rest.size(); k++)
+	{
+		vector<vector<int>> kernel;
+
+		if (rest[k] == "-n")
+		{
+			for (int &value : pic.samples)
+				value = pic.top - value;
+		}
+		else if (rest[k] == "-b")
+		{
+			int value = stoi(rest[++k]);
+
+			for (int &sample : pic.samples)
+				sample = max(0, min(pic.top, sample + value));
+		}
+		else if (rest[k] == "-g" || rest[k] == "-c" || rest[k] == "-e")
+		{
+			//-c and -e make the grey picture with the old weights
+			string option = rest[k];
+			grey_weights weights = GREY_LEGACY;
+			int clip = EQUALIZE_CLIP;
+
+			if (k + 1 < rest.size() && isdigit((unsigned char)
+				rest[k + 1][0]))
+			{
+				if (option == "-g")
+					weights = grey_weights(stoi(rest[++k]));
+				else
+					clip = stoi(rest[++k]);
+			}
+			if (!grey)
+				pic = check_grey( pic, weights );
+			grey = true;
+			if (option == "-c")
+				pic = check_stretch( pic );
+			else if (option == "-e")
+				pic = check_equalize( pic, clip );
+		}
+		else if (rest[k] == "-p")
+		{
+			kernel = { { 0, -1, 0 }, { -1, 5, -1 }, { 0, -1, 0 } };
+			pic = check_stencil( pic, kernel, 1, border, true );
+		}
+		else if (rest[k] == "-s")
+		{
+			int width = 2 * stoi(rest[++k]) + 1;
+
+			kernel.assign(width, vector<int>(width, 1));
+			pic = check_stencil( pic, kernel, width * width, border, false );
+		}
+		else if (rest[k] == "-k")
+		{
+			int divisor = check_kernel( rest[++k], kernel );
+			pic = check_stencil( pic, kernel, divisor, border, false );
+		}
+		else if (rest[k] == "-r")
+		{
+			int cols = stoi(rest[k + 1]);
+			int rows = stoi(rest[k + 2]);
+			resample_filter filter = RESAMPLE_LANCZOS;
+
+			k += 2;
+			if (k + 1 < rest.size() && rest[k + 1] == "bilinear")
+				filter = RESAMPLE_BILINEAR;
+			else if (k + 1 < rest.size() && rest[k + 1] == "bicubic")
+				filter = RESAMPLE_BICUBIC;
+			if (k + 1 < rest.size() && rest[k + 1][0] != '-')
+				k++;
+			pic = check_resample( pic, cols, rows, filter );
+		}
+		else if (rest[k] == "--border")
+		{
+			const char *names[] = { "keep", "clamp", "mirror", "wrap",
+				"constant" };
+
+			for (int mode = BORDER_KEEP; mode <= BORDER_CONSTANT; mode++)
+				if (rest[k + 1] == names[mode])
+					border.mode = border_mode(mode);
+			border.fill = 0;
+			k++;
+			if (border.mode == BORDER_CONSTANT && k + 1 < rest.size() &&
+				rest[k + 1][0] != '-')
+				border.fill = stoi(rest[++k]);
+		}
+	}
+	return pic;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * makes one pyramid level from the one before, each pixel the rounded
+ * average of a 2 by 2 block.  A picture 1 row or column high pairs it with
+ * itself.
+ *
+ * @param[in]      in - the level before
+ *
+ * @returns the level
+ *
+ *****************************************************************************/
+static check_picture check_half( const check_picture &in )
+{
+	check_picture out = in;
+
+	out.rows = max(1, in.rows / 2);
+	out.cols = max(1, in.cols / 2);
+	out.samples.assign(size_t(out.rows) * out.cols * in.channels, 0);
+	for (int i = 0; i < out.rows; i++)
+		for (int j = 0; j < out.cols; j++)
+			for (int c = 0; c < in.channels; c++)
+			{
+				int up = 2 * i;
+				int down = min(2 * i + 1, in.rows - 1);
+				int left = 2 * j;
+				int right = min(2 * j + 1, in.cols - 1);
+
+				out.at( i, j, c ) = (in.at( up, left, c ) +
+					in.at( up, right, c ) + in.at( down, left, c ) +
+					in.at( down, right, c ) + 2) >> 2;
+			}
+	return out;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * compares a picture with what the model says it should be.  A grey
+ * model is allowed to come out as colour with three equal colours, the way
+ * a grey picture is written until -g is used.
+ *
+ * @param[in]      what - names the check in the message
+ * @param[in]      got - the picture made
+ * @param[in]      want - the model's picture
+ *
+ * @returns true they match
+ * @returns false they differ, the first difference is printed
+ *
+ *****************************************************************************/
+static bool check_same( const string &what, const check_picture &got,
+	const check_picture &want )
+{
+	check_picture model = want;
+	size_t k = 0;
+
+	if (model.channels == 1 && got.channels == 3)
+	{
+		model.channels = 3;
+		model.samples.clear();
+		for (int value : want.samples)
+			model.samples.insert(model.samples.end(), 3, value);
+	}
+
+	if (got.rows != model.rows || got.cols != model.cols ||
+		got.channels != model.channels || got.top != model.top)
+	{
+		cout << what << ": made " << got.cols << "x" << got.rows << "x" <<
+			got.channels << " of " << got.top << ", model is " <<
+			model.cols << "x" << model.rows << "x" << model.channels <<
+			" of " << model.top << endl;
+		return false;
+	}
+
+	for (k = 0; k < model.samples.size(); k++)
+	{
+		if (got.samples[k] != model.samples[k])
+		{
+			size_t pixel_at = k / model.channels;
+			cout << what << ": row " << pixel_at / model.cols << " column " <<
+				pixel_at % model.cols << " colour " << k % model.channels <<
+				" is " << got.samples[k] << ", model gave " <<
+				model.samples[k] << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs every option on a picture through edit_image, written back in
+ * binary and in ascii, and compares each with the model
+ *
+ * @param[in]      pic - the picture
+ * @param[in]      name - names the picture in messages
+ *
+ * @returns the amount of checks that failed
+ *
+ *****************************************************************************/
+static int check_editor( const check_picture &pic, const string &name )
+{
+	string data = check_encode( pic );
+	int failures = 0;
+
+	for (const char *options : CHECK_OPTIONS)
+	{
+		check_picture want = check_model( pic, options );
+
+		for (int ascii = 0; ascii < 2; ascii++)
+		{
+			string what = name + " \"" + options + "\"" +
+				(ascii ? " ascii" : " binary");
+			edit_image editor;
+			vector<char> out;
+			check_picture got;
+			edit_status status = editor.load( data.data(), data.size() );
+
+			if (status == EDIT_OK)
+				status = editor.apply( string(options) );
+			if (status == EDIT_OK)
+				status = editor.encode( ascii != 0, out );
+			if (status != EDIT_OK)
+			{
+				cout << what << ": " << edit_message( status ) << endl;
+				failures++;
+				continue;
+			}
+
+			if (!check_decode( string(out.begin(), out.end()), got ))
+			{
+				cout << what << ": the picture written can not be read" <<
+					endl;
+				failures++;
+			}
+			else if (!check_same( what, got, want ))
+				failures++;
+		}
+	}
+	return failures;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives the bytes of a file
+ *
+ * @param[in]      name - the file
+ * @param[out]     data - its bytes
+ *
+ * @returns true the file was read
+ * @returns false it could not be opened
+ *
+ *****************************************************************************/
+static bool check_slurp( const string &name, string &data )
+{
+	ifstream fin(name, ios::binary);
+	ostringstream all;
+
+	if (!fin)
+		return false;
+	all << fin.rdbuf();
+	data = all.str();
+	return true;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * reads a picture file the way prog1 does, writes it back out in binary
+ * and ascii, and writes its pyramid, then compares every file written
+ * with the picture or the model of its level.  T is the sample type the
+ * picture's max_value needs.
+ *
+ * @param[in][out] vars - the header, already read from fin
+ * @param[in][out] fin - the file, just past the header
+ * @param[in]      input - name of the file
+ * @param[in]      pic - the picture the file holds
+ * @param[in]      base - start of the names written
+ * @param[in]      what - names the check in messages
+ *
+ * @returns the amount of checks that failed
+ *
+ *****************************************************************************/
+template <class T>
+static int check_files( basic_image<T> &vars, ifstream &fin,
+	const string &input, const check_picture &pic, const string &base,
+	const string &what )
+{
+	vector<pipeline_stage> stages;
+	check_picture want = pic;
+	check_picture got;
+	string data;
+	string checker;
+	int failures = 0;
+	int levels = pyramid_depth( pic.rows, pic.cols, CHECK_LEVELS );
+	int l = 0;
+
+	if (picture_fill( vars, fin, input.c_str(), stages ) != 0)
+	{
+		cout << what << ": the picture could not be read" << endl;
+		return 1;
+	}
+	fin.close();
+
+	for (const char *format : { "-ob", "-oa" })
+	{
+		checker = format;
+		vars.fileName = base + format + ".ppm";
+		if (picture_write( checker, vars ) != 0 ||
+			!check_slurp( vars.fileName, data ) ||
+			!check_decode( data, got ))
+		{
+			cout << what << " " << format << ": nothing was written" << endl;
+			failures++;
+		}
+		else if (!check_same( what + " " + format, got, pic ))
+			failures++;
+	}
+
+	checker = "-ob";
+	if (pyramid_write( vars, CHECK_LEVELS, base + "level", checker ) != 0)
+	{
+		cout << what << " -m: the levels were not written" << endl;
+		failures++;
+	}
+	else
+	{
+		for (l = 1; l <= levels; l++)
+		{
+			string level = what + " -m level " + to_string(l);
+
+			want = check_half( want );
+			if (!check_slurp( base + "level_" + to_string(l) + ".ppm",
+				data ) || !check_decode( data, got ))
+			{
+				cout << level << ": not written" << endl;
+				failures++;
+			}
+			else if (!check_same( level, got, want ))
+				failures++;
+		}
+	}
+
+	all_array_delete( vars );
+	return failures;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * writes a picture to a file and runs check_files on it
+ *
+ * @param[in]      pic - the picture
+ * @param[in]      folder - where the files go
+ * @param[in]      what - names the check in messages
+ *
+ * @returns the amount of checks that failed
+ *
+ *****************************************************************************/
+static int check_round_trip( const check_picture &pic, const string &folder,
+	const string &what )
+{
+	string input = folder + "/option_check_in.ppm";
+	string base = folder + "/option_check_";
+	image vars;
+
+	{
+		ofstream fout(input, ios::binary);
+		fout << check_encode( pic );
+		if (!fout)
+		{
+			cout << what << ": " << input << " could not be written" << endl;
+			return 1;
+		}
+	}
+
+	ifstream fin(input, ios::binary);
+	read_in_header( vars, fin );
+	if (vars.max_value > sample_traits<pixel>::largest)
+	{
+		wide_image wide_vars;
+		static_cast<picture_header &>(wide_vars) = vars;
+		return check_files( wide_vars, fin, input, pic, base, what );
+	}
+	return check_files( vars, fin, input, pic, base, what );
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * checks every option on random pictures of each size, max_value and
+ * colour, then their files and pyramids with io_uring and with the helper
+ * thread
+ *
+ * @param[in]      argc - amount of arguments
+ * @param[in]      argv - the arguments, the folder files are written to
+ *
+ * @returns 0 every picture matched its model
+ * @returns 1 a picture did not
+ *
+ *****************************************************************************/
+int main( int argc, char *argv[] )
+{
+	string folder = argc > 1 ? argv[1] : ".";
+	mt19937 random( 2024u );
+	int failures = 0;
+	int checked = 0;
+
+	for (const int *size : CHECK_SIZES)
+		for (int top : CHECK_TOPS)
+			for (int channels : { 3, 1 })
+			{
+				check_picture pic = check_random( random, size[0], size[1],
+					top, channels );
+				string name = to_string(size[0]) + "x" + to_string(size[1]) +
+					(channels == 3 ? " colour" : " grey") + " of " +
+					to_string(top);
+
+				failures += check_editor( pic, name );
+				for (int thread = 0; thread < 2; thread++)
+				{
+					io_force_thread( thread != 0 );
+					failures += check_round_trip( pic, folder, name +
+						(thread ? " thread" : " async") );
+				}
+				io_force_thread( false );
+				checked++;
+			}
+
+	cout << checked << " pictures checked, " << failures << " differed" <<
+		endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,333 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief The work stealing thread pool and the row band scheduler every
+ * picture option runs through.
+ ****************************************************************************/
+#include "threadpool.h"
+
+
+//bytes of one band a task should touch, small enough to stay in cache
+static const int BAND_BYTES = 256 * 1024;
+
+//bands handed to each thread so stealing can even out the work
+static const int BANDS_PER_THREAD = 4;
+
+//threads asked for with -j, 0 means one per processor
+static int thread_count = 0;
+
+//pool shared by all the options, made the first time it is needed
+static unique_ptr<thread_pool> pool;
+static mutex pool_lock;
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * starts the worker threads.  The thread that calls run is one of the
+ * threads, so a pool of size one starts no workers at all.
+ *
+ * @param[in]      threads - amount of threads, the caller included
+ *
+ *****************************************************************************/
+thread_pool::thread_pool( int threads )
+{
+	//loop variable
+	int i = 0;
+
+	if (threads < 1)
+		threads = 1;
+
+	remaining = 0;
+	for (i = 0; i < threads; i++)
+		queues.emplace_back(new task_queue);
+
+	for (i = 1; i < threads; i++)
+		workers.emplace_back(&thread_pool::work, this, i);
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * tells every worker to exit and waits for them
+ *
+ *****************************************************************************/
+thread_pool::~thread_pool()
+{
+	{
+		lock_guard<mutex> hold(lock);
+		stop = true;
+	}
+	wake.notify_all();
+
+	for (thread &worker : workers)
+		worker.join();
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs body(0) through body(tasks - 1) across the pool and returns once all
+ * of them have finished.  The tasks are dealt out in runs of neighbours so
+ * each thread starts on rows next to each other.  Runs from different
+ * threads take turns; body itself must not call run.
+ *
+ * @param[in]      tasks - amount of tasks
+ * @param[in]      body - the work for one task number
+ *
+ *****************************************************************************/
+void thread_pool::run( int tasks, const function<void(int)> &body )
+{
+	//loop variables
+	int i = 0;
+	int k = 0;
+
+	if (tasks <= 0)
+		return;
+
+	//nothing to share with, or nothing worth sharing
+	if (size() == 1 || tasks == 1)
+	{
+		for (i = 0; i < tasks; i++)
+			body(i);
+		return;
+	}
+
+	lock_guard<mutex> turn(running);
+
+	{
+		lock_guard<mutex> hold(lock);
+
+		this->body = &body;
+		remaining = tasks;
+
+		for (k = 0; k < size(); k++)
+		{
+			lock_guard<mutex> hold_queue(queues[k]->lock);
+			int first = int((long long) tasks * k / size());
+			int last = int((long long) tasks * (k + 1) / size());
+
+			for (i = first; i < last; i++)
+				queues[k]->tasks.push_back(i);
+		}
+		generation++;
+	}
+	wake.notify_all();
+
+	//the caller works too, then waits for the stragglers
+	finish(0);
+
+	unique_lock<mutex> hold(lock);
+	done.wait(hold, [this] { return remaining == 0; });
+	this->body = nullptr;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * the loop each worker thread runs, sleeping between calls to run
+ *
+ * @param[in]      self - the worker's queue number
+ *
+ *****************************************************************************/
+void thread_pool::work( int self )
+{
+	int seen = 0;
+
+	while (true)
+	{
+		{
+			unique_lock<mutex> hold(lock);
+			wake.wait(hold, [&] { return stop || generation != seen; });
+			if (stop)
+				return;
+			seen = generation;
+		}
+		finish(self);
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * runs tasks until no queue has any left
+ *
+ * @param[in]      self - queue number of the calling thread
+ *
+ *****************************************************************************/
+void thread_pool::finish( int self )
+{
+	int task = 0;
+
+	while (take(self, task))
+	{
+		(*body)(task);
+
+		if (--remaining == 0)
+		{
+			lock_guard<mutex> hold(lock);
+			done.notify_all();
+		}
+	}
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * takes the next task from the front of the thread's own queue, or steals
+ * one from the back of another thread's queue
+ *
+ * @param[in]      self - queue number of the calling thread
+ * @param[out]     task - the task to run
+ *
+ * @returns true a task was found
+ * @returns false every queue is empty
+ *
+ *****************************************************************************/
+bool thread_pool::take( int self, int &task )
+{
+	//loop variable
+	int k = 0;
+
+	{
+		lock_guard<mutex> hold(queues[self]->lock);
+		if (!queues[self]->tasks.empty())
+		{
+			task = queues[self]->tasks.front();
+			queues[self]->tasks.pop_front();
+			return true;
+		}
+	}
+
+	for (k = 1; k < size(); k++)
+	{
+		task_queue &victim = *queues[(self + k) % size()];
+		lock_guard<mutex> hold(victim.lock);
+
+		if (!victim.tasks.empty())
+		{
+			task = victim.tasks.back();
+			victim.tasks.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * sets how many threads the options use.  The pool is rebuilt the next
+ * time it is needed.
+ *
+ * @param[in]      threads - amount of threads, 0 for one per processor
+ *
+ *****************************************************************************/
+void set_threads( int threads )
+{
+	lock_guard<mutex> hold(pool_lock);
+
+	thread_count = (threads < 0) ? 0 : threads;
+	pool.reset();
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives the amount of threads the options will use
+ *
+ * @returns the thread count
+ *
+ *****************************************************************************/
+int get_threads()
+{
+	if (thread_count > 0)
+		return thread_count;
+
+	int cores = int(thread::hardware_concurrency());
+	return (cores > 0) ? cores : 1;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * gives the pool the options share, starting it if needed
+ *
+ * @returns the shared pool
+ *
+ *****************************************************************************/
+thread_pool &shared_pool()
+{
+	lock_guard<mutex> hold(pool_lock);
+
+	if (!pool)
+		pool.reset(new thread_pool(get_threads()));
+
+	return *pool;
+}
+
+/**************************************************************************//**
+ * @author Johnathan Ackerman
+ *
+ * @par Description:
+ * splits rows 0 to rows - 1 into bands and runs body on each band across
+ * the shared pool.  Bands are sized to stay in cache but there are always
+ * a few per thread.  With one thread the bands run in order on the
+ * caller.  Each band must only write its own rows; filters that
+ * read neighbouring rows read them from a copy nobody writes, so the halo
+ * above and below a band is always the finished input.
+ *
+ * @param[in]      rows - amount of rows in the picture
+ * @param[in]      cols - bytes in a row, used to size the bands
+ * @param[in]      body - work for rows first to last - 1
+ * @param[in]      min_height - fewest rows in a band, for work that redoes
+ *						rows at the edges of every band
+ *
+ *****************************************************************************/
+void parallel_rows( int rows, int cols,
+	const function<void(int first, int last)> &body, int min_height )
+{
+	if (rows <= 0)
+		return;
+
+	//loop variable
+	int first = 0;
+
+	int threads = get_threads();
+
+	//cache sized bands, but never so few that threads sit idle
+	int height = max(1, BAND_BYTES / max(cols, 1));
+	if (threads > 1)
+	{
+		int spread = (rows + threads * BANDS_PER_THREAD - 1) /
+			(threads * BANDS_PER_THREAD);
+		height = min(height, spread);
+	}
+	height = max(min_height, max(1, height));
+
+	//one thread still goes band by band so joined passes stay in cache
+	if (threads == 1)
+	{
+		for (first = 0; first < rows; first += height)
+			body(first, min(rows, first + height));
+		return;
+	}
+
+	int bands = (rows + height - 1) / height;
+
+	shared_pool().run(bands, [&] (int band)
+	{
+		int first = band * height;
+		body(first, min(rows, first + height));
+	});
+}
@@ -0,0 +1,80 @@
+/*************************************************************************//**
+ * @file
+ *
+ * @brief this file contains the thread pool the picture options run on and
+ * the row band scheduler that splits a picture between its threads.  It
+ * should be included with threadpool.cpp.
+ ****************************************************************************/
+#ifndef  __THREADPOOL__H__
+#define __THREADPOOL__H__
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <functional>
+
+#include "function.h"
+
+
+/*!
+ * @brief a fixed set of worker threads that run numbered tasks
+ *
+ * @details every thread, the caller included, gets its own queue of task
+ *				numbers.  A thread works from the front of its own queue
+ *				and when that runs dry steals from the back of the others,
+ *				so uneven bands still keep every thread busy.
+ */
+class thread_pool
+{
+public:
+	explicit thread_pool( int threads );
+	~thread_pool();
+
+	/*! @brief number of threads that run tasks, the caller included */
+	int size() const { return int(queues.size()); }
+
+	void run( int tasks, const function<void(int)> &body );
+
+private:
+	/*!
+	 * @brief the task numbers one thread still has to run
+	 */
+	struct task_queue
+	{
+		mutex lock;			/*!< guards tasks */
+		deque<int> tasks;	/*!< task numbers not yet taken */
+	};
+
+	void work( int self );
+	bool take( int self, int &task );
+	void finish( int self );
+
+	vector<thread> workers;					/*!< the worker threads */
+	vector<unique_ptr<task_queue>> queues;	/*!< one queue per thread */
+
+	mutex running;				/*!< lets only one run use the pool */
+	mutex lock;					/*!< guards the fields below */
+	condition_variable wake;	/*!< signals a new run or shutdown */
+	condition_variable done;	/*!< signals the last task finished */
+	const function<void(int)> *body = nullptr;	/*!< task being run */
+	int generation = 0;			/*!< counts calls to run */
+	bool stop = false;			/*!< tells the workers to exit */
+	atomic<int> remaining;		/*!< tasks not yet finished */
+};
+
+
+/*******************************************************************************
+ *                         Function Prototypes
+ ******************************************************************************/
+void set_threads( int threads );
+int get_threads();
+thread_pool &shared_pool();
+
+void parallel_rows( int rows, int cols,
+	const function<void(int first, int last)> &body, int min_height = 1 );
+
+
+#endif